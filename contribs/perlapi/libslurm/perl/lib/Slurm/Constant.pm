@@ -1174,6 +1174,8 @@ head2 SLURM ERRNO
 
 =item * ESLURMD_INVALID_SOCKET_NAME_LEN         4030
 
+=item * ESLURMD_FILE_CACHED                     4031
+
 =back
 
 =head3 slurmd errors in user batch job
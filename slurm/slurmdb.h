@@ -313,6 +313,12 @@ typedef struct {
 	List jobname_list;	/* list of char * */
 	uint32_t nodes_max;     /* number of nodes high range */
 	uint32_t nodes_min;     /* number of nodes low range */
+	char *page_cluster;	/* paged query: cluster of the last job of
+				 * the previous page, NULL for the first page */
+	uint32_t page_jobid;	/* paged query: highest job id of the previous
+				 * page */
+	uint32_t page_size;	/* paged query: job records per page, 0 to get
+				 * all jobs at once */
 	List partition_list;	/* list of char * */
 	List qos_list;  	/* list of char * */
 	List reason_list;	/* list of char * */
@@ -1320,6 +1326,10 @@ typedef struct {
 } slurmdb_rpc_obj_t;
 
 typedef struct {
+	uint32_t batch_cnt;		/* DBD_SEND_MULT_MSG batches processed */
+	uint32_t batch_max;		/* most records in one batch */
+	uint64_t batch_recs;		/* records processed in batches */
+	uint64_t batch_time;		/* total usecs processing batches */
 	slurmdb_rollup_stats_t *dbd_rollup_stats;
 	List rollup_stats;              /* List of Clusters rollup stats */
 	List rpc_list;                  /* list of RPCs sent to the dbd. */
@@ -60,9 +60,14 @@
 #include "src/api/step_launch.h"
 
 #define STDIO_MAX_FREE_BUF 1024
+/* Fewest outgoing buffers any one node may hold, regardless of step size */
+#define STDIO_MIN_NODE_BUF 16
+/* Most queued messages written to stdout or stderr per event loop pass */
+#define STDIO_MAX_FILE_MSGS 64
 
 struct io_buf {
 	int ref_count;
+	int node_id;	/* node holding this outgoing buffer, -1 if none */
 	uint32_t length;
 	void *data;
 	io_hdr_t header;
@@ -81,6 +86,7 @@ static int      _read_io_init_msg(int fd, client_io_t *cio, char *host);
 static int      _wid(int n);
 static bool     _incoming_buf_free(client_io_t *cio);
 static bool     _outgoing_buf_free(client_io_t *cio);
+static void     _outgoing_buf_put(client_io_t *cio, struct io_buf *msg);
 
 /**********************************************************************
  * Listening socket declarations
@@ -101,11 +107,17 @@ static int _server_read(eio_obj_t *obj, List objs);
 static bool _server_writable(eio_obj_t *obj);
 static int _server_write(eio_obj_t *obj, List objs);
 
+/*
+ * Other objects only change the servers' readable() and writable() through
+ * _outgoing_buf_put() and _file_read(), which call eio_obj_changed(). So the
+ * event loop does not ask every node's server on each pass.
+ */
 struct io_operations server_ops = {
 	.readable = &_server_readable,
 	.handle_read = &_server_read,
 	.writable = &_server_writable,
-	.handle_write = &_server_write
+	.handle_write = &_server_write,
+	.changes_reported = true
 };
 
 struct server_io_info {
@@ -254,6 +266,17 @@ _server_readable(eio_obj_t *obj)
 		return false;
 	}
 
+	/*
+	 * Leave the rest of the pool to the other nodes once this one holds
+	 * its share; TCP flow control then pushes back on its slurmstepd.
+	 */
+	if (!s->in_msg &&
+	    (s->cio->node_out_bufs[s->node_id] >= s->cio->node_out_limit)) {
+		debug4("  false, node %d holds %d buffers",
+		       s->node_id, s->cio->node_out_bufs[s->node_id]);
+		return false;
+	}
+
 	if (s->in_eof) {
 		debug4("  false, eof");
 		return false;
@@ -293,6 +316,8 @@ _server_read(eio_obj_t *obj, List objs)
 	if (s->in_msg == NULL) {
 		if (_outgoing_buf_free(s->cio)) {
 			s->in_msg = list_dequeue(s->cio->free_outgoing);
+			s->in_msg->node_id = s->node_id;
+			s->cio->node_out_bufs[s->node_id]++;
 		} else {
 			debug("List free_outgoing is empty!");
 			return SLURM_ERROR;
@@ -321,7 +346,7 @@ _server_read(eio_obj_t *obj, List objs)
 			obj->fd = -1;
 			s->in_eof = true;
 			s->out_eof = true;
-			list_enqueue(s->cio->free_outgoing, s->in_msg);
+			_outgoing_buf_put(s->cio, s->in_msg);
 			s->in_msg = NULL;
 			return SLURM_SUCCESS;
 		}
@@ -329,7 +354,7 @@ _server_read(eio_obj_t *obj, List objs)
 			if (s->cio->sls)
 				step_launch_clear_questionable_state(
 					s->cio->sls, s->node_id);
-			list_enqueue(s->cio->free_outgoing, s->in_msg);
+			_outgoing_buf_put(s->cio, s->in_msg);
 			s->in_msg = NULL;
 			s->testing_connection = false;
 			return SLURM_SUCCESS;
@@ -352,7 +377,7 @@ _server_read(eio_obj_t *obj, List objs)
 				&& s->remote_stderr_objs == 0) {
 				obj->shutdown = true;
 			}
-			list_enqueue(s->cio->free_outgoing, s->in_msg);
+			_outgoing_buf_put(s->cio, s->in_msg);
 			s->in_msg = NULL;
 			return SLURM_SUCCESS;
 		}
@@ -397,7 +422,7 @@ _server_read(eio_obj_t *obj, List objs)
 			obj->fd = -1;
 			s->in_eof = true;
 			s->out_eof = true;
-			list_enqueue(s->cio->free_outgoing, s->in_msg);
+			_outgoing_buf_put(s->cio, s->in_msg);
 			s->in_msg = NULL;
 			return SLURM_SUCCESS;
 		}
@@ -425,7 +450,7 @@ _server_read(eio_obj_t *obj, List objs)
 		info = (struct file_write_info *) obj->arg;
 		if (info->eof)
 			/* this output is closed, discard message */
-			list_enqueue(s->cio->free_outgoing, s->in_msg);
+			_outgoing_buf_put(s->cio, s->in_msg);
 		else
 			list_enqueue(info->msg_queue, s->in_msg);
 
@@ -569,13 +594,12 @@ static bool _file_writable(eio_obj_t *obj)
 	return false;
 }
 
-static int _file_write(eio_obj_t *obj, List objs)
+/* Write the current or next queued message to a file */
+static int _file_write_msg(eio_obj_t *obj, struct file_write_info *info)
 {
-	struct file_write_info *info = (struct file_write_info *) obj->arg;
 	void *ptr;
 	int n;
 
-	debug2("Entering %s", __func__);
 	/*
 	 * If we aren't already in the middle of sending a message, get the
 	 * next message from the queue.
@@ -605,7 +629,7 @@ static int _file_write(eio_obj_t *obj, List objs)
 					        info->cio->het_job_task_offset,
 					        info->cio->label,
 					        info->cio->taskid_width)) < 0) {
-			list_enqueue(info->cio->free_outgoing, info->out_msg);
+			_outgoing_buf_put(info->cio, info->out_msg);
 			info->eof = true;
 			return SLURM_ERROR;
 		}
@@ -620,13 +644,33 @@ static int _file_write(eio_obj_t *obj, List objs)
 	 */
 	info->out_msg->ref_count--;
 	if (info->out_msg->ref_count == 0)
-		list_enqueue(info->cio->free_outgoing, info->out_msg);
+		_outgoing_buf_put(info->cio, info->out_msg);
 	info->out_msg = NULL;
-	debug2("Leaving  %s", __func__);
 
 	return SLURM_SUCCESS;
 }
 
+/*
+ * Write a batch of queued messages rather than one per event loop pass, so
+ * that output from many nodes drains without a poll per message.
+ */
+static int _file_write(eio_obj_t *obj, List objs)
+{
+	struct file_write_info *info = (struct file_write_info *) obj->arg;
+	int i, rc = SLURM_SUCCESS;
+
+	debug2("Entering %s", __func__);
+	for (i = 0; i < STDIO_MAX_FILE_MSGS; i++) {
+		if ((rc = _file_write_msg(obj, info)) != SLURM_SUCCESS)
+			break;
+		if (!info->out_msg && list_is_empty(info->msg_queue))
+			break;
+	}
+	debug2("Leaving  %s", __func__);
+
+	return rc;
+}
+
 /**********************************************************************
  * File read functions
  **********************************************************************/
@@ -766,6 +810,7 @@ again:
 			else {
 				server = info->cio->ioserver[i]->arg;
 				list_enqueue(server->msg_queue, msg);
+				eio_obj_changed(info->cio->ioserver[i]);
 			}
 		}
 	} else if (header.type == SLURM_IO_STDIN) {
@@ -781,6 +826,7 @@ again:
 		} else {
 			server = info->cio->ioserver[nodeid]->arg;
 			list_enqueue(server->msg_queue, msg);
+			eio_obj_changed(info->cio->ioserver[nodeid]);
 		}
 	} else {
 		fatal("Unsupported header.type");
@@ -976,6 +1022,7 @@ _alloc_io_buf(void)
 	if (!buf)
 		return NULL;
 	buf->ref_count = 0;
+	buf->node_id = -1;
 	buf->length = 0;
 	/* The following "+ 1" is just temporary so I can stick a \0 at
 	   the end and do a printf of the data pointer */
@@ -1067,6 +1114,30 @@ _outgoing_buf_free(client_io_t *cio)
 	return false;
 }
 
+/*
+ * Return an outgoing buffer to the free list, releasing its node's share.
+ * The servers held back by their share or by an empty pool may read again.
+ */
+static void
+_outgoing_buf_put(client_io_t *cio, struct io_buf *msg)
+{
+	int i;
+
+	if (msg->node_id >= 0) {
+		cio->node_out_bufs[msg->node_id]--;
+		if (cio->ioserver[msg->node_id])
+			eio_obj_changed(cio->ioserver[msg->node_id]);
+		msg->node_id = -1;
+	}
+	list_enqueue(cio->free_outgoing, msg);
+	if (list_count(cio->free_outgoing) == 1) {
+		for (i = 0; i < cio->num_nodes; i++) {
+			if (cio->ioserver[i])
+				eio_obj_changed(cio->ioserver[i]);
+		}
+	}
+}
+
 static inline int
 _estimate_nports(int nclients, int cli_per_port)
 {
@@ -1155,6 +1226,9 @@ client_io_t *client_io_handler_create(slurm_step_io_fds_t fds, int num_tasks,
 	}
 	cio->free_outgoing = list_create(NULL); /* FIXME! Needs destructor */
 	cio->outgoing_count = 0;
+	cio->node_out_bufs = xcalloc(num_nodes, sizeof(int));
+	cio->node_out_limit = MAX(STDIO_MAX_FREE_BUF / MAX(num_nodes, 1),
+				  STDIO_MIN_NODE_BUF);
 	for (i = 0; i < STDIO_MAX_FREE_BUF; i++) {
 		list_enqueue(cio->free_outgoing, _alloc_io_buf());
 	}
@@ -1227,6 +1301,7 @@ client_io_handler_destroy(client_io_t *cio)
 	slurm_mutex_destroy(&cio->ioservers_lock);
 	FREE_NULL_BITMAP(cio->ioservers_ready_bits);
 	xfree(cio->ioserver); /* need to destroy the obj first? */
+	xfree(cio->node_out_bufs);
 	xfree(cio->listenport);
 	xfree(cio->listensock);
 	eio_handle_destroy(cio->eio);
@@ -1296,6 +1371,8 @@ client_io_handler_abort(client_io_t *cio)
 		}
 	}
 	slurm_mutex_unlock(&cio->ioservers_lock);
+
+	eio_signal_wakeup(cio->eio);
 }
 
 
@@ -88,6 +88,9 @@ struct client_io {
 			         * including free_incoming buffers and
 			         * buffers in use.
 			         */
+	int *node_out_bufs;	/* Outgoing buffers in use per node,
+				 * length "num_nodes" */
+	int node_out_limit;	/* Most outgoing buffers one node may hold */
 
 	struct step_launch_state *sls; /* Used to notify the main thread of an
 				       I/O problem.  */
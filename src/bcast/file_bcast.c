@@ -84,10 +84,25 @@ void *src;				/* source mmap'd address */
 struct stat f_stat;			/* source file stats */
 job_sbcast_cred_msg_t *sbcast_cred;	/* job alloc info and sbcast cred */
 
+/* State shared by the threads of a pipelined transfer */
+typedef struct {
+	file_bcast_msg_t *bcast_msg;	/* template for every block */
+	uint32_t cached_cnt;		/* nodes which had the file cached */
+	int64_t last_block_no;		/* last block number to send now */
+	pthread_mutex_t mutex;
+	int64_t next_block_no;		/* next block number to send */
+	struct bcast_parameters *params;
+	int rc;				/* highest error code so far */
+	uint64_t size_compressed;
+	uint64_t size_uncompressed;
+	uint32_t time_compression;
+} bcast_pipeline_t;
+
 static int   _bcast_file(struct bcast_parameters *params);
 static int   _file_bcast(struct bcast_parameters *params,
 			 file_bcast_msg_t *bcast_msg,
-			 job_sbcast_cred_msg_t *sbcast_cred);
+			 job_sbcast_cred_msg_t *sbcast_cred,
+			 uint32_t *cached_cnt);
 static int   _file_state(struct bcast_parameters *params);
 static int   _get_job_info(struct bcast_parameters *params);
 
@@ -158,10 +173,15 @@ static int _get_job_info(struct bcast_parameters *params)
 	return rc;
 }
 
-/* Issue the RPC to transfer the file's data */
+/*
+ * Issue the RPC to transfer the file's data
+ * OUT cached_cnt - incremented for each node which copied the file from its
+ *		    sbcast cache rather than waiting for its data
+ */
 static int _file_bcast(struct bcast_parameters *params,
 		       file_bcast_msg_t *bcast_msg,
-		       job_sbcast_cred_msg_t *sbcast_cred)
+		       job_sbcast_cred_msg_t *sbcast_cred,
+		       uint32_t *cached_cnt)
 {
 	List ret_list = NULL;
 	ListIterator itr;
@@ -187,6 +207,10 @@ static int _file_bcast(struct bcast_parameters *params,
 					       ret_data_info->data);
 		if (msg_rc == SLURM_SUCCESS)
 			continue;
+		if (msg_rc == ESLURMD_FILE_CACHED) {
+			(*cached_cnt)++;
+			continue;
+		}
 
 		error("REQUEST_FILE_BCAST(%s): %s",
 		      ret_data_info->node_name,
@@ -358,6 +382,211 @@ static int _next_block(struct bcast_parameters *params,
 	return _get_block_none(buffer, orig_len, more);
 }
 
+/* Return true if this build can compress with the given library */
+static bool _compress_supported(uint16_t compress)
+{
+	switch (compress) {
+	case COMPRESS_OFF:
+		return true;
+#if HAVE_LIBZ
+	case COMPRESS_ZLIB:
+		return true;
+#endif
+#if HAVE_LZ4
+	case COMPRESS_LZ4:
+		return true;
+#endif
+	}
+	return false;
+}
+
+/*
+ * Load and compress the block starting at "offset" into a new buffer.
+ * Unlike _next_block() this keeps no state between calls, so pipeline
+ * threads can compress different blocks at the same time. Each block is
+ * compressed independently, which is what the receiver expects anyway.
+ * RET length of data in buffer, -1 on error
+ */
+static int _get_block_at(struct bcast_parameters *params, int64_t offset,
+			 char **buffer, int32_t *orig_len)
+{
+	void *position = src + offset;
+	int size = MIN(block_len, f_stat.st_size - offset);
+
+	*orig_len = size;
+
+	switch (params->compress) {
+#if HAVE_LIBZ
+	case COMPRESS_ZLIB:
+	{
+		z_stream strm;
+		int max_out;
+
+		memset(&strm, 0, sizeof(strm));
+		if (deflateInit(&strm, Z_DEFAULT_COMPRESSION) != Z_OK)
+			return -1;
+		max_out = deflateBound(&strm, size);
+		*buffer = xmalloc(max_out);
+		strm.next_in = position;
+		strm.avail_in = size;
+		strm.next_out = (void *) *buffer;
+		strm.avail_out = max_out;
+		/* output buffer fits the whole block, one call suffices */
+		if (deflate(&strm, Z_FINISH) != Z_STREAM_END) {
+			(void) deflateEnd(&strm);
+			return -1;
+		}
+		(void) deflateEnd(&strm);
+		return (max_out - strm.avail_out);
+	}
+#endif
+#if HAVE_LZ4
+	case COMPRESS_LZ4:
+	{
+		int max_out = LZ4_compressBound(size), size_out;
+
+		*buffer = xmalloc(max_out);
+		if (!(size_out = LZ4_compress_default(position, *buffer,
+						      size, max_out)))
+			return -1;
+		return size_out;
+	}
+#endif
+	default:
+		*buffer = xmalloc(size);
+		memcpy(*buffer, position, size);
+		return size;
+	}
+}
+
+/* Compress and send blocks until none are left or a transfer fails */
+static void *_bcast_pipeline_thread(void *arg)
+{
+	bcast_pipeline_t *pipeline = arg;
+	file_bcast_msg_t bcast_msg;
+	int64_t block_no;
+	int32_t orig_len;
+	uint32_t cached_cnt;
+	int rc;
+	DEF_TIMERS;
+
+	while (1) {
+		cached_cnt = 0;
+		slurm_mutex_lock(&pipeline->mutex);
+		if (pipeline->rc ||
+		    (pipeline->next_block_no > pipeline->last_block_no)) {
+			slurm_mutex_unlock(&pipeline->mutex);
+			break;
+		}
+		block_no = pipeline->next_block_no++;
+		slurm_mutex_unlock(&pipeline->mutex);
+
+		memcpy(&bcast_msg, pipeline->bcast_msg, sizeof(bcast_msg));
+		bcast_msg.block_no = block_no;
+		bcast_msg.block_offset = (block_no - 1) * block_len;
+		bcast_msg.block = NULL;
+
+		START_TIMER;
+		bcast_msg.block_len = _get_block_at(pipeline->params,
+						    bcast_msg.block_offset,
+						    &bcast_msg.block,
+						    &orig_len);
+		END_TIMER;
+		bcast_msg.uncomp_len = orig_len;
+		debug("block %u, size %d", bcast_msg.block_no,
+		      (int) bcast_msg.block_len);
+
+		if ((int) bcast_msg.block_len < 0) {
+			error("Error compressing block %u", bcast_msg.block_no);
+			bcast_msg.block_len = 0;
+			rc = SLURM_ERROR;
+		} else {
+			rc = _file_bcast(pipeline->params, &bcast_msg,
+					 sbcast_cred, &cached_cnt);
+		}
+		xfree(bcast_msg.block);
+
+		slurm_mutex_lock(&pipeline->mutex);
+		pipeline->time_compression += DELTA_TIMER;
+		pipeline->size_uncompressed += orig_len;
+		pipeline->size_compressed += bcast_msg.block_len;
+		pipeline->rc = MAX(pipeline->rc, rc);
+		pipeline->cached_cnt += cached_cnt;
+		slurm_mutex_unlock(&pipeline->mutex);
+	}
+
+	return NULL;
+}
+
+/*
+ * Broadcast the file with up to params->pipeline blocks being compressed
+ * and in flight at once. The first block is sent alone since it creates
+ * the file on each node, and the last block is sent alone once all others
+ * have been written since it completes the file. Blocks in between may be
+ * written in any order; slurmd places each one at its block_offset.
+ */
+static int _bcast_file_pipelined(struct bcast_parameters *params,
+				 file_bcast_msg_t *bcast_msg)
+{
+	bcast_pipeline_t pipeline;
+	pthread_t *threads;
+	int64_t block_cnt = (f_stat.st_size + block_len - 1) / block_len;
+	int i, thread_cnt;
+
+	if (!_compress_supported(params->compress)) {
+		info("File compression type %u not supported, sending uncompressed file.",
+		     params->compress);
+		params->compress = COMPRESS_OFF;
+	}
+	bcast_msg->compress = params->compress;
+
+	memset(&pipeline, 0, sizeof(pipeline));
+	slurm_mutex_init(&pipeline.mutex);
+	pipeline.bcast_msg = bcast_msg;
+	pipeline.params = params;
+	pipeline.next_block_no = 1;
+
+	/* first block */
+	pipeline.last_block_no = 1;
+	if (block_cnt == 1)
+		bcast_msg->last_block = 1;
+	_bcast_pipeline_thread(&pipeline);
+	if (pipeline.cached_cnt == sbcast_cred->node_cnt) {
+		verbose("File found in sbcast cache of all nodes");
+		block_cnt = 1;
+	}
+
+	/* middle blocks */
+	pipeline.last_block_no = block_cnt - 1;
+	thread_cnt = MIN(params->pipeline, block_cnt - 2);
+	if (thread_cnt > 0) {
+		threads = xcalloc(thread_cnt, sizeof(pthread_t));
+		for (i = 0; i < thread_cnt; i++)
+			slurm_thread_create(&threads[i],
+					    _bcast_pipeline_thread, &pipeline);
+		for (i = 0; i < thread_cnt; i++)
+			pthread_join(threads[i], NULL);
+		xfree(threads);
+	}
+
+	/* last block */
+	if (block_cnt > 1) {
+		pipeline.last_block_no = block_cnt;
+		bcast_msg->last_block = 1;
+		_bcast_pipeline_thread(&pipeline);
+	}
+
+	slurm_mutex_destroy(&pipeline.mutex);
+
+	if (pipeline.size_uncompressed && (params->compress != 0)) {
+		verbose("File compressed from %"PRIu64" to %"PRIu64" in %u usec of compression time",
+			pipeline.size_uncompressed, pipeline.size_compressed,
+			pipeline.time_compression);
+	}
+
+	return pipeline.rc;
+}
+
 /* read and broadcast the file */
 static int _bcast_file(struct bcast_parameters *params)
 {
@@ -367,6 +596,7 @@ static int _bcast_file(struct bcast_parameters *params)
 	int32_t orig_len = 0;
 	uint64_t size_uncompressed = 0, size_compressed = 0;
 	uint32_t time_compression = 0;
+	uint32_t cached_cnt = 0;
 	bool more = true;
 	DEF_TIMERS;
 
@@ -391,10 +621,29 @@ static int _bcast_file(struct bcast_parameters *params)
 		bcast_msg.mtime     = f_stat.st_mtime;
 	}
 
+	/* nodes can skip the transfer if they have the contents cached */
+	if (f_stat.st_size &&
+	    xstrcasestr(slurm_conf.sbcast_parameters, "CacheDir=")) {
+		START_TIMER;
+		bcast_msg.file_hash = bcast_hash_data(src, f_stat.st_size,
+						      BCAST_HASH_INIT);
+		if (!bcast_msg.file_hash)	/* zero means no hash */
+			bcast_msg.file_hash = 1;
+		END_TIMER;
+		verbose("hash     = %016"PRIx64" in %s",
+			bcast_msg.file_hash, TIME_STR);
+	}
+
 	if (!params->fanout)
 		params->fanout = MAX_THREADS;
 	slurm_conf.tree_width = MIN(MAX_THREADS, params->fanout);
 
+	if ((params->pipeline > 1) && block_len) {
+		rc = _bcast_file_pipelined(params, &bcast_msg);
+		xfree(bcast_msg.user_name);
+		return rc;
+	}
+
 	while (more) {
 		START_TIMER;
 		bcast_msg.block_len = _next_block(params, &buffer, &orig_len,
@@ -411,11 +660,16 @@ static int _bcast_file(struct bcast_parameters *params)
 		if (!more)
 			bcast_msg.last_block = 1;
 
-		rc = _file_bcast(params, &bcast_msg, sbcast_cred);
+		rc = _file_bcast(params, &bcast_msg, sbcast_cred, &cached_cnt);
 		if (rc != SLURM_SUCCESS)
 			break;
 		if (bcast_msg.last_block)
 			break;	/* end of file */
+		if ((bcast_msg.block_no == 1) &&
+		    (cached_cnt == sbcast_cred->node_cnt)) {
+			verbose("File found in sbcast cache of all nodes");
+			break;
+		}
 		bcast_msg.block_no++;
 		bcast_msg.block_offset += orig_len;
 	}
@@ -537,6 +791,18 @@ extern int bcast_file(struct bcast_parameters *params)
 	return rc;
 }
 
+extern uint64_t bcast_hash_data(const void *data, size_t len, uint64_t hash)
+{
+	const unsigned char *ptr = data, *end = ptr + len;
+
+	while (ptr < end) {
+		hash ^= *ptr++;
+		hash *= 0x100000001b3ULL;
+	}
+
+	return hash;
+}
+
 extern int bcast_decompress_data(file_bcast_msg_t *req)
 {
 	switch (req->compress) {
@@ -46,6 +46,7 @@ struct bcast_parameters {
 	char *dst_fname;
 	int fanout;
 	bool force;
+	int pipeline;		/* blocks in flight, see _bcast_file_pipelined */
 	bool preserve;
 	slurm_selected_step_t *selected_step;
 	char *src_fname;
@@ -55,9 +56,12 @@ struct bcast_parameters {
 };
 
 typedef struct file_bcast_info {
+	bool cached;		/* file was copied from the sbcast cache,
+				 * ignore any further blocks */
 	void *data;		/* mmap of file data */
 	int fd;			/* file descriptor */
 	uint64_t file_size;	/* file size */
+	uint64_t file_hash;	/* hash of file contents, zero if not cached */
 	char *fname;		/* filename */
 	gid_t gid;		/* gid of owner */
 	uint32_t job_id;	/* job id */
@@ -69,6 +73,15 @@ typedef struct file_bcast_info {
 
 extern int bcast_file(struct bcast_parameters *params);
 
+/*
+ * Hash of file contents used to key the sbcast cache on compute nodes
+ * (SbcastParameters=CacheDir). Start with hash = BCAST_HASH_INIT and call
+ * once per region of the file, in order. This is FNV-1a, so it only
+ * detects accidental collisions; the cache is kept per user for that reason.
+ */
+#define BCAST_HASH_INIT 0xcbf29ce484222325ULL
+extern uint64_t bcast_hash_data(const void *data, size_t len, uint64_t hash);
+
 extern int bcast_decompress_data(file_bcast_msg_t *req);
 
 #endif
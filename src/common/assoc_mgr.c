@@ -53,12 +53,16 @@
 #define ASSOC_HASH_SIZE 1000
 #define ASSOC_HASH_ID_INX(_assoc_id)	(_assoc_id % ASSOC_HASH_SIZE)
 
+/* Clock skew allowed between us and the dbd when reading its txn log */
+#define ASSOC_MGR_TXN_SKEW 300
+
 slurmdb_assoc_rec_t *assoc_mgr_root_assoc = NULL;
 uint32_t g_qos_max_priority = 0;
 uint32_t g_assoc_max_priority = 0;
 uint32_t g_qos_count = 0;
 uint32_t g_user_assoc_count = 0;
 uint32_t g_tres_count = 0;
+uint32_t g_assoc_mgr_gen = 0;
 
 List assoc_mgr_tres_list = NULL;
 slurmdb_tres_rec_t **assoc_mgr_tres_array = NULL;
@@ -77,6 +81,26 @@ static slurmdb_assoc_rec_t **assoc_hash_id = NULL;
 static slurmdb_assoc_rec_t **assoc_hash = NULL;
 static int *assoc_mgr_tres_old_pos = NULL;
 
+/*
+ * The dbd logs a txn for each change to what we cache.  The id of the newest
+ * such txn when the lists were last read is the generation of the cache, a
+ * refresh only rereads the lists when a newer txn shows up.
+ */
+static uint16_t assoc_mgr_txn_actions[] = {
+	DBD_ADD_ACCOUNTS, DBD_ADD_ACCOUNT_COORDS, DBD_ADD_ASSOCS,
+	DBD_ADD_CLUSTERS, DBD_ADD_QOS, DBD_ADD_RES, DBD_ADD_TRES,
+	DBD_ADD_USERS, DBD_ADD_WCKEYS, DBD_MODIFY_ACCOUNTS, DBD_MODIFY_ASSOCS,
+	DBD_MODIFY_QOS, DBD_MODIFY_RES, DBD_MODIFY_USERS, DBD_MODIFY_WCKEYS,
+	DBD_REMOVE_ACCOUNTS, DBD_REMOVE_ACCOUNT_COORDS, DBD_REMOVE_ASSOCS,
+	DBD_REMOVE_CLUSTERS, DBD_REMOVE_QOS, DBD_REMOVE_RES, DBD_REMOVE_USERS,
+	DBD_REMOVE_WCKEYS, 0
+};
+static pthread_mutex_t txn_gen_lock = PTHREAD_MUTEX_INITIALIZER;
+static time_t txn_gen_time = 0;	/* when the lists were read, 0 if unknown */
+static uint32_t txn_gen = 0;	/* newest txn id at that time */
+
+static int _load_assoc_mgr_state(bool only_tres, bool from_cache);
+
 static bool _running_cache(void)
 {
 	if (init_setup.running_cache && *init_setup.running_cache)
@@ -1477,6 +1501,143 @@ extern int assoc_mgr_post_tres_list(List new_list)
 	return (changed_size || changed_pos) ? 1 : 0;
 }
 
+/*
+ * Get the id of the newest txn logged since "since" that changed something we
+ * cache, 0 if there is none.
+ */
+static int _get_txn_gen(void *db_conn, time_t since, uint32_t *gen)
+{
+	slurmdb_txn_cond_t txn_cond;
+	slurmdb_txn_rec_t *txn;
+	List txn_list;
+	ListIterator itr;
+	int i;
+
+	memset(&txn_cond, 0, sizeof(slurmdb_txn_cond_t));
+	txn_cond.action_list = list_create(xfree_ptr);
+	for (i = 0; assoc_mgr_txn_actions[i]; i++)
+		list_append(txn_cond.action_list,
+			    xstrdup_printf("%u", assoc_mgr_txn_actions[i]));
+	txn_cond.time_start = MAX(since, 1);
+
+	txn_list = acct_storage_g_get_txn(db_conn, getuid(), &txn_cond);
+	FREE_NULL_LIST(txn_cond.action_list);
+	if (!txn_list)
+		return SLURM_ERROR;
+
+	*gen = 0;
+	itr = list_iterator_create(txn_list);
+	while ((txn = list_next(itr)))
+		*gen = MAX(*gen, txn->id);
+	list_iterator_destroy(itr);
+	FREE_NULL_LIST(txn_list);
+
+	return SLURM_SUCCESS;
+}
+
+/* Note the generation of the lists we are about to read from the dbd */
+static void _set_txn_gen(void *db_conn)
+{
+	time_t now = time(NULL);
+	uint32_t gen = 0;
+
+	if (_get_txn_gen(db_conn, now - ASSOC_MGR_TXN_SKEW, &gen) !=
+	    SLURM_SUCCESS)
+		now = 0;
+
+	slurm_mutex_lock(&txn_gen_lock);
+	txn_gen_time = now;
+	txn_gen = gen;
+	slurm_mutex_unlock(&txn_gen_lock);
+}
+
+/*
+ * Check the txn log of the dbd for changes since the lists were read.  If
+ * there are none the lists are known to be current as of now.
+ * RET true if the lists need to be read again.
+ */
+static bool _txn_gen_changed(void *db_conn)
+{
+	time_t now = time(NULL), since;
+	uint32_t gen = 0, last_gen;
+
+	slurm_mutex_lock(&txn_gen_lock);
+	since = txn_gen_time;
+	last_gen = txn_gen;
+	slurm_mutex_unlock(&txn_gen_lock);
+
+	if (!since ||
+	    (_get_txn_gen(db_conn, since - ASSOC_MGR_TXN_SKEW, &gen) !=
+	     SLURM_SUCCESS) ||
+	    (gen > last_gen))
+		return true;
+
+	slurm_mutex_lock(&txn_gen_lock);
+	if (txn_gen_time == since)
+		txn_gen_time = now;
+	slurm_mutex_unlock(&txn_gen_lock);
+
+	return false;
+}
+
+/* Get the time the lists in the assoc_mgr_state file were read at */
+static time_t _get_state_time(void)
+{
+	char *state_file;
+	Buf buffer;
+	uint16_t ver = 0;
+	time_t buf_time = 0;
+
+	state_file = xstrdup_printf("%s/assoc_mgr_state",
+				    *init_setup.state_save_location);
+	buffer = create_mmap_buf(state_file);
+	xfree(state_file);
+	if (!buffer)
+		return 0;
+
+	safe_unpack16(&ver, buffer);
+	if (ver == SLURM_PROTOCOL_VERSION)
+		safe_unpack_time(&buf_time, buffer);
+
+unpack_error:
+	free_buf(buffer);
+	return buf_time;
+}
+
+/*
+ * Start from the lists in the assoc_mgr_state file if the txn log of the dbd
+ * shows nothing changed since they were read, rather than reading them all
+ * from the dbd again. The TRES must have been read from the dbd already.
+ */
+static int _load_cached_state(void *db_conn)
+{
+	time_t now = time(NULL), state_time;
+	uint32_t gen = 0;
+
+	if (!init_setup.state_save_location ||
+	    !*init_setup.state_save_location ||
+	    !(state_time = _get_state_time()))
+		return SLURM_ERROR;
+
+	if ((_get_txn_gen(db_conn, state_time - ASSOC_MGR_TXN_SKEW, &gen) !=
+	     SLURM_SUCCESS) || gen) {
+		debug("%s: database changed since %ld, not using state file",
+		      __func__, state_time);
+		return SLURM_ERROR;
+	}
+
+	if (_load_assoc_mgr_state(false, true) != SLURM_SUCCESS)
+		return SLURM_ERROR;
+
+	/* Nothing changed up to now, no need to look further back later */
+	slurm_mutex_lock(&txn_gen_lock);
+	txn_gen_time = now;
+	txn_gen = 0;
+	slurm_mutex_unlock(&txn_gen_lock);
+
+	return SLURM_SUCCESS;
+}
+
 static int _get_assoc_mgr_tres_list(void *db_conn, int enforce)
 {
 	slurmdb_tres_cond_t tres_q;
@@ -1752,6 +1913,10 @@ static int _refresh_assoc_mgr_assoc_list(void *db_conn, int enforce)
 		      __func__);
 	}
 
+	/*
+	 * Hold the locks while the dbd builds the list, or a DBD_UPDATE
+	 * received meanwhile would be applied to the list being replaced.
+	 */
 	assoc_mgr_lock(&locks);
 
 	current_assocs = assoc_mgr_assoc_list;
@@ -1973,6 +2138,7 @@ extern int assoc_mgr_init(void *db_conn, assoc_init_args_t *args,
 			  int db_conn_errno)
 {
 	static uint16_t checked_prio = 0;
+	bool empty_lists = false;
 
 	if (!checked_prio) {
 		if (xstrcmp(slurm_conf.priority_type, "priority/basic"))
@@ -1998,6 +2164,17 @@ extern int assoc_mgr_init(void *db_conn, assoc_init_args_t *args,
 	if (db_conn_errno != SLURM_SUCCESS)
 		return SLURM_ERROR;
 
+	/*
+	 * Note the generation before reading anything, the TRES included, so
+	 * a change made while the lists are read is seen by the next refresh.
+	 */
+	if (!assoc_mgr_assoc_list && !assoc_mgr_qos_list &&
+	    !assoc_mgr_res_list && !assoc_mgr_user_list &&
+	    !assoc_mgr_wckey_list) {
+		_set_txn_gen(db_conn);
+		empty_lists = true;
+	}
+
 	/* get tres before association and qos since it is used there */
 	if ((!assoc_mgr_tres_list)
 	    && (init_setup.cache_level & ASSOC_MGR_CACHE_TRES)) {
@@ -2006,6 +2183,9 @@ extern int assoc_mgr_init(void *db_conn, assoc_init_args_t *args,
 			return SLURM_ERROR;
 	}
 
+	if (empty_lists)
+		(void) _load_cached_state(db_conn);
+
 	/* get qos before association since it is used there */
 	if ((!assoc_mgr_qos_list)
 	    && (init_setup.cache_level & ASSOC_MGR_CACHE_QOS))
@@ -2193,6 +2373,11 @@ extern void assoc_mgr_lock(assoc_mgr_lock_t *locks)
 		slurm_rwlock_rdlock(&assoc_mgr_locks[WCKEY_LOCK]);
 	else if (locks->wckey == WRITE_LOCK)
 		slurm_rwlock_wrlock(&assoc_mgr_locks[WCKEY_LOCK]);
+
+	/* Any cached view of limits or usage is stale after a writer */
+	if ((locks->assoc == WRITE_LOCK) || (locks->qos == WRITE_LOCK) ||
+	    (locks->tres == WRITE_LOCK))
+		g_assoc_mgr_gen++;
 }
 
 extern void assoc_mgr_unlock(assoc_mgr_lock_t *locks)
@@ -5345,9 +5530,11 @@ extern int dump_assoc_mgr_state(void)
 	/* Now write the rest of the lists */
 	buffer = init_buf(high_buffer_size);
 
-	/* write header: version, time */
+	/* write header: version, time the lists were read from the dbd */
 	pack16(SLURM_PROTOCOL_VERSION, buffer);
-	pack_time(time(NULL), buffer);
+	slurm_mutex_lock(&txn_gen_lock);
+	pack_time(txn_gen_time, buffer);
+	slurm_mutex_unlock(&txn_gen_lock);
 
 	if (assoc_mgr_user_list) {
 		memset(&msg, 0, sizeof(dbd_list_msg_t));
@@ -5856,7 +6043,7 @@ unpack_error:
 	return SLURM_ERROR;
 }
 
-extern int load_assoc_mgr_state(bool only_tres)
+static int _load_assoc_mgr_state(bool only_tres, bool from_cache)
 {
 	int error_code = SLURM_SUCCESS;
 	uint16_t type = 0;
@@ -6013,14 +6200,39 @@ extern int load_assoc_mgr_state(bool only_tres)
 			break;
 	}
 
-	if (!only_tres && init_setup.running_cache)
-		*init_setup.running_cache = 1;
+	if (!only_tres) {
+		if (!from_cache && init_setup.running_cache)
+			*init_setup.running_cache = 1;
+
+		/* Older files have the time they were written at */
+		slurm_mutex_lock(&txn_gen_lock);
+		txn_gen_time = (ver >= SLURM_20_11_PROTOCOL_VERSION) ?
+			       buf_time : 0;
+		txn_gen = 0;
+		slurm_mutex_unlock(&txn_gen_lock);
+	}
 
 	free_buf(buffer);
 	assoc_mgr_unlock(&locks);
 	return SLURM_SUCCESS;
 
 unpack_error:
+	if (from_cache) {
+		error("Incomplete assoc mgr state file, reading the lists from the database");
+		FREE_NULL_LIST(assoc_mgr_assoc_list);
+		FREE_NULL_LIST(assoc_mgr_res_list);
+		FREE_NULL_LIST(assoc_mgr_qos_list);
+		FREE_NULL_LIST(assoc_mgr_user_list);
+		FREE_NULL_LIST(assoc_mgr_wckey_list);
+		assoc_mgr_root_assoc = NULL;
+		xfree(assoc_hash_id);
+		xfree(assoc_hash);
+
+		free_buf(buffer);
+		assoc_mgr_unlock(&locks);
+		return SLURM_ERROR;
+	}
+
 	if (!ignore_state_errors)
 		fatal("Incomplete assoc mgr state file, start with '-i' to ignore this. Warning: using -i will lose the data that can't be recovered.");
 	error("Incomplete assoc mgr state file");
@@ -6031,6 +6243,11 @@ unpack_error:
 	return SLURM_ERROR;
 }
 
+extern int load_assoc_mgr_state(bool only_tres)
+{
+	return _load_assoc_mgr_state(only_tres, false);
+}
+
 extern int assoc_mgr_refresh_lists(void *db_conn, uint16_t cache_level)
 {
 	bool partial_list = 1;
@@ -6038,6 +6255,13 @@ extern int assoc_mgr_refresh_lists(void *db_conn, uint16_t cache_level)
 	if (!cache_level) {
 		cache_level = init_setup.cache_level;
 		partial_list = 0;
+
+		if (!_txn_gen_changed(db_conn)) {
+			debug("%s: no changes in the database, keeping the cached lists",
+			      __func__);
+			goto end_it;
+		}
+		_set_txn_gen(db_conn);
 	}
 
 	/* get tres before association and qos since it is used there */
@@ -6073,6 +6297,7 @@ extern int assoc_mgr_refresh_lists(void *db_conn, uint16_t cache_level)
 			    db_conn, init_setup.enforce) == SLURM_ERROR)
 			return SLURM_ERROR;
 
+end_it:
 	if (!partial_list && _running_cache())
 		*init_setup.running_cache = 0;
 
@@ -40,6 +40,7 @@
 
 #include <errno.h>
 #include <poll.h>
+#include <string.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <unistd.h>
@@ -48,6 +49,11 @@
 #define POLLRDHUP POLLHUP
 #endif
 
+#if defined(__linux__)
+#  define EIO_EPOLL 1
+#  include <sys/epoll.h>
+#endif
+
 #include "src/common/fd.h"
 #include "src/common/eio.h"
 #include "src/common/log.h"
@@ -68,6 +74,7 @@ strong_alias(eio_message_socket_readable, slurm_eio_message_socket_readable);
 strong_alias(eio_message_socket_accept,	slurm_eio_message_socket_accept);
 strong_alias(eio_new_obj,		slurm_eio_new_obj);
 strong_alias(eio_new_initial_obj,	slurm_eio_new_initial_obj);
+strong_alias(eio_obj_changed,		slurm_eio_obj_changed);
 strong_alias(eio_obj_create,		slurm_eio_obj_create);
 strong_alias(eio_obj_destroy,		slurm_eio_obj_destroy);
 strong_alias(eio_remove_obj,		slurm_eio_remove_obj);
@@ -88,8 +95,49 @@ struct eio_handle_components {
 	uint16_t shutdown_wait;
 	List obj_list;
 	List new_objs;
+#ifdef EIO_EPOLL
+	int epfd;			/* epoll set, -1 to use poll() */
+	bool epoll_rebuild;		/* a stale registration was seen */
+	bool epoll_full;		/* ask every object on the next pass */
+	int nobjs;			/* objects on the last full pass */
+	int nactive;			/* objects with interest */
+	struct epoll_reg *reg;		/* registrations indexed by fd */
+	int reg_size;
+	int nreg;			/* fds registered in epfd */
+	uint32_t gen;			/* current setup pass */
+	uint32_t serial;		/* last registration serial */
+	struct epoll_event *events;
+	int max_events;
+	eio_obj_t **ready;		/* objects epoll can not watch */
+	short *ready_revents;
+	int ready_size;
+	eio_obj_t **polled;		/* objects asked on every pass */
+	int npolled;
+	int polled_size;
+	eio_obj_t **changed;		/* objects to ask on the next pass */
+	int nchanged;
+	int changed_size;
+#endif
+};
+
+#ifdef EIO_EPOLL
+/*
+ * An fd's registration in the epoll set. The serial is stored in the upper
+ * half of the event data so that events still queued for an fd that was
+ * closed and reused by another object can be told apart.
+ */
+struct epoll_reg {
+	eio_obj_t *obj;
+	uint32_t events;
+	uint32_t gen;
+	uint32_t serial;
+	bool registered;
 };
 
+#define EIO_EPOLL_WAKEUP UINT64_MAX
+#define EIO_EPOLL_MAX_EVENTS 1024
+#endif
+
 /* Function prototypes */
 
 static int          _poll_internal(struct pollfd *pfds, unsigned int nfds,
@@ -99,6 +147,12 @@ static void         _poll_dispatch(struct pollfd *, unsigned int, eio_obj_t **,
 		                   List objList);
 static void         _poll_handle_event(short revents, eio_obj_t *obj,
 		                       List objList);
+static int          _poll_mainloop(eio_handle_t *eio);
+#ifdef EIO_EPOLL
+static void         _epoll_init(eio_handle_t *eio);
+static void         _epoll_fini(eio_handle_t *eio);
+static int          _epoll_mainloop(eio_handle_t *eio);
+#endif
 
 eio_handle_t *eio_handle_create(uint16_t shutdown_wait)
 {
@@ -124,6 +178,10 @@ eio_handle_t *eio_handle_create(uint16_t shutdown_wait)
 	if (shutdown_wait > 0)
 		eio->shutdown_wait = shutdown_wait;
 
+#ifdef EIO_EPOLL
+	_epoll_init(eio);
+#endif
+
 	return eio;
 }
 
@@ -133,6 +191,9 @@ void eio_handle_destroy(eio_handle_t *eio)
 	xassert(eio->magic == EIO_MAGIC);
 	close(eio->fds[0]);
 	close(eio->fds[1]);
+#ifdef EIO_EPOLL
+	_epoll_fini(eio);
+#endif
 	FREE_NULL_LIST(eio->obj_list);
 	FREE_NULL_LIST(eio->new_objs);
 	slurm_mutex_destroy(&eio->shutdown_mutex);
@@ -273,6 +334,9 @@ static int _eio_wakeup_handler(eio_handle_t *eio)
 
 	/* move new eio objects from the new_objs to the obj_list */
 	list_transfer(eio->obj_list, eio->new_objs);
+#ifdef EIO_EPOLL
+	eio->epoll_full = true;
+#endif
 
 	if (rc < 0)
 		return error("eio_clear: read: %m");
@@ -281,6 +345,36 @@ static int _eio_wakeup_handler(eio_handle_t *eio)
 }
 
 int eio_handle_mainloop(eio_handle_t *eio)
+{
+	xassert (eio != NULL);
+	xassert (eio->magic == EIO_MAGIC);
+
+#ifdef EIO_EPOLL
+	if (eio->epfd >= 0)
+		return _epoll_mainloop(eio);
+#endif
+	return _poll_mainloop(eio);
+}
+
+/* Return true once the shutdown grace period is over */
+static bool _shutdown_expired(eio_handle_t *eio)
+{
+	time_t shutdown_time;
+
+	slurm_mutex_lock(&eio->shutdown_mutex);
+	shutdown_time = eio->shutdown_time;
+	slurm_mutex_unlock(&eio->shutdown_mutex);
+	if (shutdown_time &&
+	    (difftime(time(NULL), shutdown_time) >= eio->shutdown_wait)) {
+		error("%s: Abandoning IO %d secs after job shutdown initiated",
+		      __func__, eio->shutdown_wait);
+		return true;
+	}
+
+	return false;
+}
+
+static int _poll_mainloop(eio_handle_t *eio)
 {
 	int            retval  = 0;
 	struct pollfd *pollfds = NULL;
@@ -289,9 +383,6 @@ int eio_handle_mainloop(eio_handle_t *eio)
 	unsigned int   n       = 0;
 	time_t shutdown_time;
 
-	xassert (eio != NULL);
-	xassert (eio->magic == EIO_MAGIC);
-
 	while (1) {
 		/* Alloc memory for pfds and map if needed */
 		n = list_count(eio->obj_list);
@@ -334,15 +425,8 @@ int eio_handle_mainloop(eio_handle_t *eio)
 
 		_poll_dispatch(pollfds, nfds - 1, map, eio->obj_list);
 
-		slurm_mutex_lock(&eio->shutdown_mutex);
-		shutdown_time = eio->shutdown_time;
-		slurm_mutex_unlock(&eio->shutdown_mutex);
-		if (shutdown_time &&
-		    (difftime(time(NULL), shutdown_time)>=eio->shutdown_wait)) {
-			error("%s: Abandoning IO %d secs after job shutdown initiated",
-			      __func__, eio->shutdown_wait);
+		if (_shutdown_expired(eio))
 			break;
-		}
 	}
 
 error:
@@ -499,6 +583,371 @@ static void _poll_handle_event(short revents, eio_obj_t *obj, List objList)
 	}
 }
 
+#ifdef EIO_EPOLL
+/*
+ * epoll backend. The kernel keeps the set of watched fds between passes, so
+ * a pass only costs epoll_ctl() calls for the objects whose interest changed
+ * and epoll_wait() only returns the ready fds. Readiness is level-triggered
+ * because handlers may consume only part of what is available and rely on
+ * being called again.
+ *
+ * The readable() and writable() callbacks of every object are asked on a
+ * full pass, after objects were added or removed or the loop was woken up.
+ * Otherwise only the objects whose ops leave changes_reported unset are asked
+ * on every pass, the others only after their handlers ran or
+ * eio_obj_changed() was called for them.
+ */
+static void _epoll_init(eio_handle_t *eio)
+{
+	struct epoll_event ev = {
+		.events = EPOLLIN,
+		.data.u64 = EIO_EPOLL_WAKEUP,
+	};
+
+	eio->epoll_rebuild = false;
+	eio->epoll_full = true;
+	eio->nreg = 0;
+	if ((eio->epfd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+		error("%s: epoll_create1: %m, using poll()", __func__);
+		return;
+	}
+	if (epoll_ctl(eio->epfd, EPOLL_CTL_ADD, eio->fds[0], &ev) < 0) {
+		error("%s: epoll_ctl: %m, using poll()", __func__);
+		close(eio->epfd);
+		eio->epfd = -1;
+	}
+}
+
+static void _epoll_fini(eio_handle_t *eio)
+{
+	if (eio->epfd >= 0)
+		close(eio->epfd);
+	eio->epfd = -1;
+	xfree(eio->reg);
+	eio->reg_size = 0;
+	xfree(eio->events);
+	eio->max_events = 0;
+	xfree(eio->ready);
+	xfree(eio->ready_revents);
+	eio->ready_size = 0;
+	xfree(eio->polled);
+	eio->npolled = eio->polled_size = 0;
+	xfree(eio->changed);
+	eio->nchanged = eio->changed_size = 0;
+}
+
+/* Start over with an empty epoll set */
+static void _epoll_rebuild(eio_handle_t *eio)
+{
+	debug2("%s: rebuilding epoll set of %d fds", __func__, eio->nreg);
+	close(eio->epfd);
+	if (eio->reg)
+		memset(eio->reg, 0, sizeof(struct epoll_reg) * eio->reg_size);
+	_epoll_init(eio);
+}
+
+/* Append obj to an array of objects, growing it as needed */
+static void _epoll_obj_add(eio_obj_t ***objs, int *cnt, int *size,
+			   eio_obj_t *obj)
+{
+	if (*cnt >= *size) {
+		*size = MAX(16, *size * 2);
+		xrealloc(*objs, sizeof(eio_obj_t *) * *size);
+	}
+	(*objs)[(*cnt)++] = obj;
+}
+
+/* Ask obj for its interest again on the next pass */
+static void _epoll_changed(eio_handle_t *eio, eio_obj_t *obj)
+{
+	_epoll_obj_add(&eio->changed, &eio->nchanged, &eio->changed_size, obj);
+}
+
+/* Dispatch obj on this pass without waiting on its fd */
+static void _epoll_add_ready(eio_handle_t *eio, int *nready, eio_obj_t *obj,
+			     short revents)
+{
+	if (*nready >= eio->ready_size) {
+		eio->ready_size = MAX(16, eio->ready_size * 2);
+		xrealloc(eio->ready, sizeof(eio_obj_t *) * eio->ready_size);
+		xrealloc(eio->ready_revents, sizeof(short) * eio->ready_size);
+	}
+	eio->ready[*nready] = obj;
+	eio->ready_revents[*nready] = revents;
+	(*nready)++;
+}
+
+/* Remove the registration of fd */
+static void _epoll_unregister(eio_handle_t *eio, int fd)
+{
+	struct epoll_reg *r = &eio->reg[fd];
+
+	if (!r->registered)
+		return;
+	(void) epoll_ctl(eio->epfd, EPOLL_CTL_DEL, fd, NULL);
+	r->registered = false;
+	r->obj = NULL;
+	eio->nreg--;
+}
+
+/*
+ * Ask obj for its interest and bring its registration in line with it.
+ * On a full pass every fd is checked to be used by one object only.
+ * RET 0, -1 if the fd of obj is also used by another object, or 1 if the fd
+ *     is registered for another object and a full pass must tell which.
+ */
+static int _epoll_update(eio_handle_t *eio, eio_obj_t *obj, int *nready,
+			 bool full)
+{
+	bool writable = _is_writable(obj);
+	bool readable = _is_readable(obj);
+	struct epoll_reg *r;
+	struct epoll_event ev;
+	uint32_t events;
+	int fd;
+
+	if (writable && readable)
+		events = EPOLLOUT | EPOLLIN | EPOLLHUP | EPOLLRDHUP;
+	else if (readable)
+		events = EPOLLIN | EPOLLRDHUP;
+	else if (writable)
+		events = EPOLLOUT | EPOLLHUP;
+	else
+		events = 0;
+	if (!events != !obj->epoll_events)
+		eio->nactive += events ? 1 : -1;
+	obj->epoll_events = events;
+
+	/* poll() ignores negative fds */
+	fd = events ? obj->fd : -1;
+
+	/* Forget the fd the object does not watch anymore */
+	if ((obj->epoll_fd >= 0) && (obj->epoll_fd != fd)) {
+		if ((obj->epoll_fd < eio->reg_size) &&
+		    (eio->reg[obj->epoll_fd].obj == obj))
+			_epoll_unregister(eio, obj->epoll_fd);
+		obj->epoll_fd = -1;
+	}
+	if (fd < 0)
+		return 0;
+
+	if (fd >= eio->reg_size) {
+		int old_size = eio->reg_size;
+
+		eio->reg_size = MAX(fd + 1, eio->reg_size * 2);
+		xrealloc(eio->reg, sizeof(struct epoll_reg) * eio->reg_size);
+		memset(eio->reg + old_size, 0,
+		       sizeof(struct epoll_reg) * (eio->reg_size - old_size));
+	}
+	r = &eio->reg[fd];
+	if (full) {
+		if (r->gen == eio->gen) {
+			debug("%s: fd %d is shared by several objects, using poll()",
+			      __func__, fd);
+			return -1;
+		}
+		r->gen = eio->gen;
+	} else if (r->registered && (r->obj != obj)) {
+		return 1;
+	}
+
+	/* The fd of a new object may be registered to a freed one */
+	if (r->registered && (r->obj == obj) && (obj->epoll_fd == fd)) {
+		if (r->events == events)
+			return 0;
+		ev.events = events;
+		ev.data.u64 = ((uint64_t) r->serial << 32) | fd;
+		if (!epoll_ctl(eio->epfd, EPOLL_CTL_MOD, fd, &ev))
+			goto registered;
+	}
+	ev.events = events;
+	r->serial = ++eio->serial;
+	ev.data.u64 = ((uint64_t) r->serial << 32) | fd;
+	if (!epoll_ctl(eio->epfd, EPOLL_CTL_ADD, fd, &ev) ||
+	    ((errno == EEXIST) &&
+	     !epoll_ctl(eio->epfd, EPOLL_CTL_MOD, fd, &ev)))
+		goto registered;
+
+	/*
+	 * Regular files can not be watched, poll() always reports them
+	 * ready. A closed fd is reported as POLLNVAL.
+	 */
+	_epoll_unregister(eio, fd);
+	if (errno == EPERM)
+		_epoll_add_ready(eio, nready, obj,
+				 events & (EPOLLIN | EPOLLOUT));
+	else if (errno == EBADF)
+		_epoll_add_ready(eio, nready, obj, POLLNVAL);
+	else
+		error("%s: epoll_ctl(%d): %m", __func__, fd);
+	return 0;
+
+registered:
+	if (!r->registered)
+		eio->nreg++;
+	r->obj = obj;
+	r->events = events;
+	r->registered = true;
+	obj->epoll_fd = fd;
+	return 0;
+}
+
+/* Ask every object for its interest */
+static int _epoll_setup_full(eio_handle_t *eio, int *nready)
+{
+	ListIterator iter;
+	eio_obj_t *obj;
+	int i, rc = 0;
+
+	*nready = 0;
+	eio->gen++;
+	eio->nactive = 0;
+	eio->npolled = 0;
+	iter = list_iterator_create(eio->obj_list);
+	while ((obj = list_next(iter))) {
+		if (!obj->ops->changes_reported)
+			_epoll_obj_add(&eio->polled, &eio->npolled,
+				       &eio->polled_size, obj);
+		obj->epoll_events = 0;
+		if ((rc = _epoll_update(eio, obj, nready, true)))
+			break;
+	}
+	list_iterator_destroy(iter);
+
+	if (rc)
+		return -1;
+
+	/* Forget the fds of the objects removed since the last full pass */
+	for (i = 0; i < eio->reg_size; i++) {
+		if (eio->reg[i].gen != eio->gen)
+			_epoll_unregister(eio, i);
+	}
+	eio->nobjs = list_count(eio->obj_list);
+	eio->epoll_full = false;
+
+	return 0;
+}
+
+/*
+ * Bring the epoll set in line with the objects' current interest.
+ * Returns the number of objects with interest, or -1 if the set can not
+ * represent them (the same fd used by two objects).
+ */
+static int _epoll_setup(eio_handle_t *eio, int *nready)
+{
+	int i, rc = 0;
+
+	if (eio->epoll_rebuild)
+		_epoll_rebuild(eio);
+	if (eio->epfd < 0)
+		return -1;
+
+	*nready = 0;
+	if (eio->epoll_full || (list_count(eio->obj_list) != eio->nobjs)) {
+		rc = 1;
+	} else {
+		for (i = 0; !rc && (i < eio->npolled); i++)
+			rc = _epoll_update(eio, eio->polled[i], nready, false);
+		for (i = 0; !rc && (i < eio->nchanged); i++)
+			rc = _epoll_update(eio, eio->changed[i], nready, false);
+	}
+	eio->nchanged = 0;
+	if (rc && (_epoll_setup_full(eio, nready) < 0))
+		return -1;
+
+	if (eio->max_events < MIN(eio->nreg + 1, EIO_EPOLL_MAX_EVENTS)) {
+		eio->max_events = MIN(eio->nreg + 1, EIO_EPOLL_MAX_EVENTS);
+		xrealloc(eio->events,
+			 sizeof(struct epoll_event) * eio->max_events);
+	}
+
+	return eio->nactive;
+}
+
+static int _epoll_mainloop(eio_handle_t *eio)
+{
+	struct epoll_reg *r;
+	eio_obj_t *obj;
+	time_t shutdown_time;
+	int active, nready, n, i, fd, timeout;
+	bool wakeup;
+
+	while (1) {
+		debug4("eio: handling events for %d objects",
+		       list_count(eio->obj_list));
+		if ((active = _epoll_setup(eio, &nready)) < 0) {
+			_epoll_fini(eio);
+			return _poll_mainloop(eio);
+		}
+		if (!active)
+			return 0;
+
+		slurm_mutex_lock(&eio->shutdown_mutex);
+		shutdown_time = eio->shutdown_time;
+		slurm_mutex_unlock(&eio->shutdown_mutex);
+		if (nready)
+			timeout = 0;
+		else if (shutdown_time)
+			timeout = 1000;	/* Return every 1000 msec during shutdown */
+		else
+			timeout = -1;
+
+		while ((n = epoll_wait(eio->epfd, eio->events, eio->max_events,
+				       timeout)) < 0) {
+			if (errno == EINTR) {
+				n = 0;
+				break;
+			}
+			error("epoll_wait: %m");
+			return -1;
+		}
+
+		/* See if we've been told to shut down by eio_signal_shutdown */
+		wakeup = false;
+		for (i = 0; i < n; i++) {
+			if (eio->events[i].data.u64 == EIO_EPOLL_WAKEUP)
+				wakeup = true;
+		}
+		if (wakeup)
+			_eio_wakeup_handler(eio);
+
+		for (i = 0; i < n; i++) {
+			uint64_t data = eio->events[i].data.u64;
+
+			if (data == EIO_EPOLL_WAKEUP)
+				continue;
+			fd = data & 0xffffffff;
+			r = (fd < eio->reg_size) ? &eio->reg[fd] : NULL;
+			if (!r || !r->registered ||
+			    (r->serial != (data >> 32))) {
+				/*
+				 * The fd was closed while another descriptor
+				 * still refers to its file, so its old
+				 * registration can not be removed.
+				 */
+				eio->epoll_rebuild = true;
+				continue;
+			}
+			obj = r->obj;
+			_poll_handle_event(eio->events[i].events, obj,
+					   eio->obj_list);
+			_epoll_changed(eio, obj);
+		}
+		for (i = 0; i < nready; i++) {
+			obj = eio->ready[i];
+			_poll_handle_event(eio->ready_revents[i], obj,
+					   eio->obj_list);
+			_epoll_changed(eio, obj);
+		}
+
+		if (_shutdown_expired(eio))
+			return -1;
+	}
+
+	return 0;
+}
+#endif
+
 static struct io_operations *_ops_copy(struct io_operations *ops)
 {
 	struct io_operations *ret = xmalloc(sizeof(*ops));
@@ -515,6 +964,7 @@ eio_obj_t *eio_obj_create(int fd, struct io_operations *ops, void *arg)
 	obj->arg = arg;
 	obj->ops = _ops_copy(ops);
 	obj->shutdown = false;
+	obj->epoll_fd = -1;
 	return obj;
 }
 
@@ -547,6 +997,7 @@ void eio_new_initial_obj(eio_handle_t *eio, eio_obj_t *obj)
 	xassert(eio != NULL);
 	xassert(eio->magic == EIO_MAGIC);
 
+	obj->eio = eio;
 	list_enqueue(eio->obj_list, obj);
 }
 
@@ -559,10 +1010,21 @@ void eio_new_obj(eio_handle_t *eio, eio_obj_t *obj)
 	xassert(eio != NULL);
 	xassert(eio->magic == EIO_MAGIC);
 
+	obj->eio = eio;
 	list_enqueue(eio->new_objs, obj);
 	eio_signal_wakeup(eio);
 }
 
+void eio_obj_changed(eio_obj_t *obj)
+{
+	xassert(obj != NULL);
+
+#ifdef EIO_EPOLL
+	if (obj->eio)
+		_epoll_changed(obj->eio, obj);
+#endif
+}
+
 bool eio_remove_obj(eio_obj_t *obj, List objs)
 {
 	ListIterator i;
@@ -571,6 +1033,11 @@ bool eio_remove_obj(eio_obj_t *obj, List objs)
 
 	xassert(obj != NULL);
 
+#ifdef EIO_EPOLL
+	/* The registration of its fd goes on the next full pass */
+	if (obj->eio)
+		obj->eio->epoll_full = true;
+#endif
 	i  = list_iterator_create(objs);
 	while ((obj1 = list_next(i))) {
 		if (obj1 == obj) {
@@ -60,6 +60,12 @@ struct io_operations {
 	int  (*handle_error)(eio_obj_t *, List);
 	int  (*handle_close)(eio_obj_t *, List);
 	int  timeout;
+	/*
+	 * readable() and writable() only change in the object's own handlers,
+	 * or eio_obj_changed() is called when anything else changes them, so
+	 * they need not be asked on every pass of the event loop.
+	 */
+	bool changes_reported;
 };
 
 struct eio_obj {
@@ -67,6 +73,10 @@ struct eio_obj {
 	void *arg;                        /* application-specific data       */
 	struct io_operations *ops;        /* pointer to ops struct for obj   */
 	bool shutdown;
+	/* private to eio */
+	eio_handle_t *eio;                /* handle the obj was added to     */
+	uint32_t epoll_events;            /* interest last asked             */
+	int epoll_fd;                     /* fd registered in the epoll set  */
 };
 
 eio_handle_t *eio_handle_create(uint16_t);
@@ -113,6 +123,14 @@ int eio_message_socket_accept(eio_obj_t *obj, List objs);
 int eio_signal_wakeup(eio_handle_t *eio);
 int eio_signal_shutdown(eio_handle_t *eio);
 
+/*
+ * Have the readable() and writable() of an object whose ops set
+ * changes_reported asked again on the next pass of the event loop. Only to be
+ * called from the thread running it, other threads change objects and then
+ * call eio_signal_wakeup().
+ */
+void eio_obj_changed(eio_obj_t *obj);
+
 eio_obj_t *eio_obj_create(int fd, struct io_operations *ops, void *arg);
 void eio_obj_destroy(void *arg);
 
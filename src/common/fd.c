@@ -363,3 +363,72 @@ extern int receive_fd_over_pipe(int socket)
 
 	return fd;
 }
+
+extern int send_fds_over_socket(int socket, int *fds, int fd_cnt)
+{
+	struct msghdr msg = { 0 };
+	struct cmsghdr *cmsg;
+	struct iovec iov;
+	char data = 0;
+	size_t len = sizeof(int) * fd_cnt;
+	char buf[CMSG_SPACE(len)];
+
+	memset(buf, '\0', sizeof(buf));
+	iov.iov_base = &data;
+	iov.iov_len = sizeof(data);
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = buf;
+	msg.msg_controllen = sizeof(buf);
+
+	cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(len);
+	memmove(CMSG_DATA(cmsg), fds, len);
+	msg.msg_controllen = cmsg->cmsg_len;
+
+	if (sendmsg(socket, &msg, MSG_NOSIGNAL) < 0) {
+		error("%s: failed to send fds: %m", __func__);
+		return SLURM_ERROR;
+	}
+
+	return SLURM_SUCCESS;
+}
+
+extern int receive_fds_over_socket(int socket, int *fds, int fd_cnt)
+{
+	struct msghdr msg = { 0 };
+	struct cmsghdr *cmsg;
+	struct iovec iov;
+	char data;
+	size_t len = sizeof(int) * fd_cnt;
+	char buf[CMSG_SPACE(len)];
+	ssize_t rc;
+
+	iov.iov_base = &data;
+	iov.iov_len = sizeof(data);
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = buf;
+	msg.msg_controllen = sizeof(buf);
+
+	while ((rc = recvmsg(socket, &msg, MSG_CMSG_CLOEXEC)) < 0) {
+		if ((errno == EINTR) || (errno == EAGAIN))
+			continue;
+		error("%s: failed to receive fds: %m", __func__);
+		return -1;
+	}
+	if (rc == 0)
+		return 0;
+
+	cmsg = CMSG_FIRSTHDR(&msg);
+	if (!cmsg || (cmsg->cmsg_type != SCM_RIGHTS) ||
+	    (cmsg->cmsg_len != CMSG_LEN(len))) {
+		error("%s: invalid control message", __func__);
+		return -1;
+	}
+	memmove(fds, CMSG_DATA(cmsg), len);
+
+	return fd_cnt;
+}
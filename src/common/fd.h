@@ -150,4 +150,19 @@ extern char *poll_revents_to_str(const short revents);
 extern void send_fd_over_pipe(int socket, int fd);
 extern int receive_fd_over_pipe(int socket);
 
+/*
+ * Pass several open fds over a unix socket in a single message. Unlike
+ * send_fd_over_pipe() one byte of data accompanies the fds, so repeated
+ * messages on a stream socket stay distinct and EOF can be detected.
+ * RET SLURM_SUCCESS or SLURM_ERROR
+ */
+extern int send_fds_over_socket(int socket, int *fds, int fd_cnt);
+
+/*
+ * Receive fds sent by send_fds_over_socket()
+ * OUT fds - filled in with fd_cnt received fds
+ * RET fd_cnt on success, 0 on EOF, -1 on error
+ */
+extern int receive_fds_over_socket(int socket, int *fds, int fd_cnt);
+
 #endif /* !_FD_H */
@@ -35,8 +35,11 @@
  *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
 \*****************************************************************************/
 
+#include <fcntl.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <stdlib.h>
+#include <unistd.h>
 
 #include "src/common/pack.h"
 #include "src/common/parse_config.h"
@@ -52,6 +55,29 @@ static pthread_mutex_t conf_mutex = PTHREAD_MUTEX_INITIALIZER;
 static Buf acct_gather_options_buf = NULL;
 static bool inited = 0;
 
+#define NODE_RING_FILE "acct_gather_node_ring"
+#define NODE_RING_MAGIC 0x41474e52	/* "AGNR" */
+#define NODE_RING_SIZE 4
+
+/*
+ * Ring of node samples shared through a file mapped by the slurmd and the
+ * slurmstepds. The slurmd is the only writer. Readers take the slot last
+ * written and check its sequence number to detect a concurrent update.
+ */
+typedef struct {
+	uint32_t magic;
+	uint32_t size;		/* sizeof(acct_gather_node_sample_t) */
+	uint16_t interval;	/* seconds between samples */
+	uint32_t generation;	/* of the slurmd publishing the samples */
+	uint32_t head;		/* count of samples published */
+	acct_gather_node_sample_t slot[NODE_RING_SIZE];
+} node_ring_t;
+
+static pthread_mutex_t node_ring_lock = PTHREAD_MUTEX_INITIALIZER;
+static node_ring_t *node_ring = NULL;
+static char *node_ring_path = NULL;	/* file of the mapped ring */
+static bool node_ring_writer = false;	/* ring created by this process */
+
 static int _get_int(const char *my_str)
 {
 	char *end = NULL;
@@ -86,6 +112,28 @@ static int _process_tbl(s_p_hashtbl_t *tbl)
 	return rc;
 }
 
+/* Set the options received by acct_gather_recv_conf() in the plugins */
+static int _process_recv_conf(void)
+{
+	s_p_hashtbl_t *tbl;
+
+	set_buf_offset(acct_gather_options_buf, 0);
+	if (!(tbl = s_p_unpack_hashtbl(acct_gather_options_buf)))
+		return SLURM_ERROR;
+
+	/*
+	 * We need to set inited before calling _process_tbl or we will get
+	 * deadlock since the other acct_gather_* plugins will call
+	 * acct_gather_init().
+	 */
+	inited = true;
+	(void)_process_tbl(tbl);
+
+	s_p_hashtbl_destroy(tbl);
+
+	return SLURM_SUCCESS;
+}
+
 extern int acct_gather_conf_init(void)
 {
 	s_p_hashtbl_t *tbl = NULL;
@@ -97,6 +145,11 @@ extern int acct_gather_conf_init(void)
 
 	if (inited)
 		return SLURM_SUCCESS;
+
+	/* Options received from the slurmd by acct_gather_recv_conf() */
+	if (acct_gather_options_buf)
+		return _process_recv_conf();
+
 	inited = 1;
 
 	/* get options from plugins using acct_gather.conf */
@@ -172,34 +225,29 @@ rwfail:
 	return -1;
 }
 
-extern int acct_gather_read_conf(int fd)
+extern int acct_gather_recv_conf(int fd)
 {
 	int len;
-	s_p_hashtbl_t *tbl;
 
 	safe_read(fd, &len, sizeof(int));
 
+	FREE_NULL_BUFFER(acct_gather_options_buf);
 	acct_gather_options_buf = init_buf(len);
 	safe_read(fd, acct_gather_options_buf->head, len);
 
-	if (!(tbl = s_p_unpack_hashtbl(acct_gather_options_buf)))
-		return SLURM_ERROR;
-
-	/*
-	 * We need to set inited before calling _process_tbl or we will get
-	 * deadlock since the other acct_gather_* plugins will call
-	 * acct_gather_init().
-	 */
-	inited = true;
-	(void)_process_tbl(tbl);
-
-	s_p_hashtbl_destroy(tbl);
-
 	return SLURM_SUCCESS;
 rwfail:
 	return SLURM_ERROR;
 }
 
+extern int acct_gather_read_conf(int fd)
+{
+	if (acct_gather_recv_conf(fd) != SLURM_SUCCESS)
+		return SLURM_ERROR;
+
+	return _process_recv_conf();
+}
+
 extern int acct_gather_reconfig(void)
 {
 	acct_gather_conf_destroy();
@@ -357,3 +405,253 @@ extern bool acct_gather_suspend_test(void)
 	slurm_mutex_unlock(&suspended_mutex);
 	return rc;
 }
+
+/* Map an existing ring if it has the layout of this version */
+static node_ring_t *_node_ring_map(const char *path, bool writer)
+{
+	node_ring_t *ring;
+	struct stat st;
+	int fd;
+
+	if ((fd = open(path, (writer ? O_RDWR : O_RDONLY) | O_CLOEXEC)) < 0)
+		return NULL;
+	if ((fstat(fd, &st) < 0) || (st.st_size != sizeof(node_ring_t))) {
+		close(fd);
+		return NULL;
+	}
+	ring = mmap(NULL, sizeof(node_ring_t),
+		    writer ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED,
+		    fd, 0);
+	close(fd);
+	if (ring == MAP_FAILED)
+		return NULL;
+
+	if ((ring->magic != NODE_RING_MAGIC) ||
+	    (ring->size != sizeof(acct_gather_node_sample_t))) {
+		(void) munmap(ring, sizeof(node_ring_t));
+		return NULL;
+	}
+
+	return ring;
+}
+
+extern int acct_gather_node_ring_create(char *spooldir, uint16_t interval)
+{
+	char *tmp_path = NULL;
+	int fd, i;
+
+	acct_gather_node_ring_fini();
+
+	node_ring_path = xstrdup_printf("%s/%s", spooldir, NODE_RING_FILE);
+	node_ring_writer = true;
+
+	/*
+	 * Keep publishing into the ring left by an earlier slurmd or before a
+	 * reconfigure, running slurmstepds still have it mapped.
+	 */
+	if ((node_ring = _node_ring_map(node_ring_path, true))) {
+		/* Discard a sample whose update was cut short */
+		for (i = 0; i < NODE_RING_SIZE; i++) {
+			if (!(node_ring->slot[i].seq & 1))
+				continue;
+			memset(&node_ring->slot[i].sample_time, 0,
+			       sizeof(acct_gather_node_sample_t) -
+			       offsetof(acct_gather_node_sample_t,
+					sample_time));
+			__sync_synchronize();
+			node_ring->slot[i].seq++;
+		}
+		node_ring->interval = interval;
+		node_ring->generation++;
+		debug("%s: sampling node counters every %u seconds into existing %s",
+		      __func__, interval, node_ring_path);
+		return SLURM_SUCCESS;
+	}
+
+	tmp_path = xstrdup_printf("%s.new", node_ring_path);
+
+	/* Build it aside so a reader never maps a partial ring */
+	(void) unlink(tmp_path);
+	if ((fd = open(tmp_path, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC,
+		       0600)) < 0) {
+		error("%s: open(%s): %m", __func__, tmp_path);
+		goto fail;
+	}
+	if (ftruncate(fd, sizeof(node_ring_t)) < 0) {
+		error("%s: ftruncate(%s): %m", __func__, tmp_path);
+		close(fd);
+		goto fail;
+	}
+	node_ring = mmap(NULL, sizeof(node_ring_t), PROT_READ | PROT_WRITE,
+			 MAP_SHARED, fd, 0);
+	close(fd);
+	if (node_ring == MAP_FAILED) {
+		error("%s: mmap(%s): %m", __func__, tmp_path);
+		node_ring = NULL;
+		goto fail;
+	}
+
+	node_ring->size = sizeof(acct_gather_node_sample_t);
+	node_ring->interval = interval;
+	node_ring->generation = (uint32_t) time(NULL);
+	node_ring->magic = NODE_RING_MAGIC;
+
+	if (rename(tmp_path, node_ring_path) < 0) {
+		error("%s: rename(%s): %m", __func__, node_ring_path);
+		goto fail;
+	}
+	xfree(tmp_path);
+
+	debug("%s: sampling node counters every %u seconds into %s",
+	      __func__, interval, node_ring_path);
+	return SLURM_SUCCESS;
+
+fail:
+	(void) unlink(tmp_path);
+	xfree(tmp_path);
+	acct_gather_node_ring_fini();
+	return SLURM_ERROR;
+}
+
+extern void acct_gather_node_ring_remove(char *spooldir)
+{
+	char *path = xstrdup_printf("%s/%s", spooldir, NODE_RING_FILE);
+
+	if (!unlink(path))
+		debug("%s: removed %s", __func__, path);
+	xfree(path);
+}
+
+extern void acct_gather_node_ring_publish(acct_gather_node_sample_t *sample)
+{
+	acct_gather_node_sample_t *slot;
+	uint32_t seq;
+
+	if (!node_ring || !node_ring_writer)
+		return;
+
+	slot = &node_ring->slot[(node_ring->head + 1) % NODE_RING_SIZE];
+	seq = slot->seq + 1;
+	sample->generation = node_ring->generation;
+
+	slot->seq = seq;
+	__sync_synchronize();
+	memcpy(&slot->sample_time, &sample->sample_time,
+	       sizeof(*slot) - offsetof(acct_gather_node_sample_t,
+					sample_time));
+	__sync_synchronize();
+	slot->seq = seq + 1;
+	node_ring->head++;
+}
+
+extern int acct_gather_node_ring_attach(char *spooldir)
+{
+	char *path = xstrdup_printf("%s/%s", spooldir, NODE_RING_FILE);
+	node_ring_t *ring;
+
+	/* A forked slurmd must not publish into the ring it inherited */
+	acct_gather_node_ring_fini();
+
+	if (!(ring = _node_ring_map(path, false))) {
+		debug("%s: no node sample ring of this version at %s",
+		      __func__, path);
+		xfree(path);
+		return SLURM_ERROR;
+	}
+
+	slurm_mutex_lock(&node_ring_lock);
+	node_ring = ring;
+	node_ring_path = path;
+	slurm_mutex_unlock(&node_ring_lock);
+
+	debug("%s: reading node counters from %s", __func__, path);
+	return SLURM_SUCCESS;
+}
+
+extern void acct_gather_node_ring_fini(void)
+{
+	slurm_mutex_lock(&node_ring_lock);
+	if (node_ring) {
+		(void) munmap(node_ring, sizeof(node_ring_t));
+		node_ring = NULL;
+	}
+	xfree(node_ring_path);
+	node_ring_writer = false;
+	slurm_mutex_unlock(&node_ring_lock);
+}
+
+/* Copy the latest sample out of the ring, caller must hold node_ring_lock */
+static int _node_ring_read(acct_gather_node_sample_t *sample)
+{
+	acct_gather_node_sample_t *slot;
+	uint32_t head, seq;
+	int tries;
+
+	for (tries = 0; tries < 100; tries++) {
+		head = node_ring->head;
+		if (!head)
+			return SLURM_ERROR;
+		slot = &node_ring->slot[head % NODE_RING_SIZE];
+		seq = slot->seq;
+		__sync_synchronize();
+		if (seq & 1)
+			continue;
+		memcpy(sample, slot, sizeof(*sample));
+		__sync_synchronize();
+		if (slot->seq == seq)
+			return SLURM_SUCCESS;
+	}
+
+	return SLURM_ERROR;
+}
+
+extern int acct_gather_node_ring_read(acct_gather_node_sample_t *sample)
+{
+	static time_t last_stale_log = 0, last_remap = 0;
+	node_ring_t *ring;
+	time_t now = time(NULL);
+	int rc;
+
+	slurm_mutex_lock(&node_ring_lock);
+	/* The slurmd reads the counters itself to publish them */
+	if (!node_ring || node_ring_writer) {
+		slurm_mutex_unlock(&node_ring_lock);
+		return SLURM_ERROR;
+	}
+
+	rc = _node_ring_read(sample);
+	if ((rc == SLURM_SUCCESS) &&
+	    (now - sample->sample_time <= 3 * node_ring->interval)) {
+		slurm_mutex_unlock(&node_ring_lock);
+		return SLURM_SUCCESS;
+	}
+
+	/*
+	 * The slurmd may have replaced the ring with one of a new layout, map
+	 * the current file again once per interval.
+	 */
+	if (now - last_remap >= node_ring->interval) {
+		last_remap = now;
+		if ((ring = _node_ring_map(node_ring_path, false))) {
+			(void) munmap(node_ring, sizeof(node_ring_t));
+			node_ring = ring;
+			rc = _node_ring_read(sample);
+			if ((rc == SLURM_SUCCESS) &&
+			    (now - sample->sample_time <=
+			     3 * node_ring->interval)) {
+				slurm_mutex_unlock(&node_ring_lock);
+				return SLURM_SUCCESS;
+			}
+		}
+	}
+
+	if ((rc == SLURM_SUCCESS) && (now - last_stale_log > 300)) {
+		last_stale_log = now;
+		info("%s: latest node sample is %ld seconds old, reading the node counters directly",
+		     __func__, (long) (now - sample->sample_time));
+	}
+	slurm_mutex_unlock(&node_ring_lock);
+
+	/* Have the caller read the counters itself */
+	return SLURM_ERROR;
+}
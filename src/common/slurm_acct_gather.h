@@ -51,9 +51,29 @@ typedef struct acct_gather_data {
 	uint64_t	size_write; /* raw amount written (out) */
 } acct_gather_data_t;
 
+/*
+ * One sample of the node-level counters, taken by the slurmd when
+ * JobAcctGatherParams=NodeSampler is configured and read by the slurmstepds
+ * instead of each of them reading the same counters.
+ */
+typedef struct acct_gather_node_sample {
+	uint32_t seq;			/* odd while the sample is written */
+	time_t sample_time;
+	uint32_t generation;		/* changes with every slurmd, whose
+					 * totals count from its start */
+	acct_gather_energy_t energy;	/* node energy sum */
+	acct_gather_data_t filesystem;	/* node filesystem totals */
+	acct_gather_data_t interconnect; /* node interconnect totals */
+} acct_gather_node_sample_t;
+
 extern int acct_gather_conf_init(void);
 extern int acct_gather_write_conf(int fd);
 extern int acct_gather_read_conf(int fd);
+/*
+ * Receive the options like acct_gather_read_conf(), but only set them in the
+ * plugins at the next acct_gather_conf_init()
+ */
+extern int acct_gather_recv_conf(int fd);
 extern int acct_gather_reconfig(void);
 extern int acct_gather_conf_destroy(void);
 
@@ -66,4 +86,34 @@ extern void acct_gather_suspend_poll(void);
 extern void acct_gather_resume_poll(void);
 extern bool acct_gather_suspend_test(void);
 
+/*
+ * Create the shared memory ring of node samples in the slurmd spool
+ * directory, or reuse the one already there so that running slurmstepds
+ * keep getting samples across a slurmd restart or reconfigure. Only the
+ * slurmd writes to it. Its samples carry a new generation, readers take a new
+ * baseline when it changes.
+ * IN spooldir - slurmd spool directory
+ * IN interval - seconds between samples, used by readers to spot a stale ring
+ */
+extern int acct_gather_node_ring_create(char *spooldir, uint16_t interval);
+
+/* Remove the ring file, once node sampling is no longer configured */
+extern void acct_gather_node_ring_remove(char *spooldir);
+
+/* Add a new sample to the ring, replacing its oldest one */
+extern void acct_gather_node_ring_publish(acct_gather_node_sample_t *sample);
+
+/* Map the ring created by the slurmd read-only, from a slurmstepd */
+extern int acct_gather_node_ring_attach(char *spooldir);
+
+/* Unmap the ring, the file is left for the next slurmd to reuse */
+extern void acct_gather_node_ring_fini(void);
+
+/*
+ * Get the latest sample from the ring.
+ * RET SLURM_SUCCESS, or SLURM_ERROR if no ring is attached or it has no
+ *     recent sample, in which case the counters must be read directly.
+ */
+extern int acct_gather_node_ring_read(acct_gather_node_sample_t *sample);
+
 #endif
@@ -304,15 +304,70 @@ extern int acct_gather_energy_g_update_node_energy(void)
 	return retval;
 }
 
+/*
+ * Set a step's energy from the node energy sampled by the slurmd, counting
+ * from the first sample the step saw like the plugins do. The node
+ * consumed_energy only grows while the same slurmd samples it, so the step
+ * carries what it counted so far over a new slurmd or over direct reads.
+ */
+static void _energy_from_node_sample(acct_gather_energy_t *energy,
+				     acct_gather_node_sample_t *sample)
+{
+	static time_t start_time = 0, last_poll_time = 0;
+	static uint32_t generation = 0;
+	static uint64_t gen_base = 0, gen_carried = 0;
+	acct_gather_energy_t *node = &sample->energy;
+	time_t elapsed;
+
+	if (node->consumed_energy == NO_VAL64) {
+		energy->consumed_energy = NO_VAL64;
+		return;
+	}
+
+	if (!energy->poll_time) {
+		energy->base_consumed_energy = node->consumed_energy;
+		energy->consumed_energy = 0;
+		energy->ave_watts = node->current_watts;
+		if (!start_time)
+			start_time = sample->sample_time;
+		gen_base = node->consumed_energy;
+		gen_carried = 0;
+	} else {
+		if ((sample->generation != generation) ||
+		    (energy->poll_time != last_poll_time) ||
+		    (node->consumed_energy < gen_base)) {
+			gen_base = node->consumed_energy;
+			gen_carried = energy->consumed_energy;
+		}
+		energy->consumed_energy =
+			gen_carried + (node->consumed_energy - gen_base);
+		elapsed = sample->sample_time - start_time;
+		if (elapsed > 0)
+			energy->ave_watts = energy->consumed_energy / elapsed;
+	}
+	generation = sample->generation;
+	energy->current_watts = node->current_watts;
+	energy->previous_consumed_energy = node->consumed_energy;
+	energy->poll_time = sample->sample_time;
+	last_poll_time = energy->poll_time;
+}
+
 extern int acct_gather_energy_g_get_sum(enum acct_energy_type data_type,
 					acct_gather_energy_t *energy)
 {
 	int retval = SLURM_ERROR;
 	static acct_gather_energy_t *e, *energy_array;
+	acct_gather_node_sample_t sample;
 
 	if (slurm_acct_gather_energy_init() < 0)
 		return retval;
 
+	if ((data_type == ENERGY_DATA_NODE_ENERGY_UP) &&
+	    (acct_gather_node_ring_read(&sample) == SLURM_SUCCESS)) {
+		_energy_from_node_sample(energy, &sample);
+		return SLURM_SUCCESS;
+	}
+
 	slurm_mutex_lock(&g_context_lock);
 
 	if (g_context_num == 1) {
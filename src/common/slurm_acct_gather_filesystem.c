@@ -63,6 +63,7 @@ typedef struct slurm_acct_gather_filesystem_ops {
 	void (*conf_set)	(s_p_hashtbl_t *tbl);
 	void (*conf_values)        (List *data);
 	int (*get_data)		(acct_gather_data_t *data);
+	int (*get_node_data)	(acct_gather_data_t *data);
 } slurm_acct_gather_filesystem_ops_t;
 /*
  * These strings must be kept in the same order as the fields
@@ -74,6 +75,7 @@ static const char *syms[] = {
 	"acct_gather_filesystem_p_conf_set",
 	"acct_gather_filesystem_p_conf_values",
 	"acct_gather_filesystem_p_get_data",
+	"acct_gather_filesystem_p_get_node_data",
 };
 
 static slurm_acct_gather_filesystem_ops_t ops;
@@ -184,6 +186,20 @@ extern int acct_gather_filesystem_g_get_data(acct_gather_data_t *data)
 	return retval;
 }
 
+/*
+ * Get the node totals for the node sample published by the slurmd, see
+ * acct_gather_node_ring_publish().
+ */
+extern int acct_gather_filesystem_g_get_node_data(acct_gather_data_t *data)
+{
+	int retval = SLURM_SUCCESS;
+
+	if (acct_gather_filesystem_init() < 0)
+		return SLURM_ERROR;
+	retval = (*(ops.get_node_data))(data);
+	return retval;
+}
+
 extern int acct_gather_filesystem_startpoll(uint32_t frequency)
 {
 	int retval = SLURM_SUCCESS;
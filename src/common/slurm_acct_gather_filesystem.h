@@ -59,6 +59,7 @@ extern int acct_gather_filesystem_fini(void); /* unload the plugin */
 extern int acct_gather_filesystem_startpoll(uint32_t);
 extern int acct_gather_filesystem_g_node_update(void);
 extern int acct_gather_filesystem_g_get_data(acct_gather_data_t *data);
+extern int acct_gather_filesystem_g_get_node_data(acct_gather_data_t *data);
 /*
  * Define plugin local conf for acct_gather.conf
  *
@@ -64,6 +64,7 @@ typedef struct slurm_acct_gather_interconnect_ops {
 	void (*conf_set)	(s_p_hashtbl_t *tbl);
 	void (*conf_values)      (List *data);
 	int (*get_data)		(acct_gather_data_t *data);
+	int (*get_node_data)	(acct_gather_data_t *data);
 } slurm_acct_gather_interconnect_ops_t;
 /*
  * These strings must be kept in the same order as the fields
@@ -75,6 +76,7 @@ static const char *syms[] = {
 	"acct_gather_interconnect_p_conf_set",
 	"acct_gather_interconnect_p_conf_values",
 	"acct_gather_interconnect_p_get_data",
+	"acct_gather_interconnect_p_get_node_data",
 };
 
 static slurm_acct_gather_interconnect_ops_t *ops = NULL;
@@ -318,3 +320,27 @@ finished:
 	slurm_mutex_unlock(&g_context_lock);
 	return retval;
 }
+
+/*
+ * Get the node totals for the node sample published by the slurmd, see
+ * acct_gather_node_ring_publish(). The first plugin with data fills them.
+ */
+extern int acct_gather_interconnect_g_get_node_data(acct_gather_data_t *data)
+{
+	int i;
+	int retval = SLURM_ERROR;
+
+	if (acct_gather_interconnect_init() < 0)
+		return SLURM_ERROR;
+
+	slurm_mutex_lock(&g_context_lock);
+	for (i = 0; i < g_context_num; i++) {
+		if (!g_context[i])
+			continue;
+		if ((retval = (*(ops[i].get_node_data))(data)) ==
+		    SLURM_SUCCESS)
+			break;
+	}
+	slurm_mutex_unlock(&g_context_lock);
+	return retval;
+}
@@ -1156,6 +1156,8 @@ typedef struct file_bcast_msg {
 	uint32_t uncomp_len;	/* uncompressed length of this data block */
 	char *block;		/* data for this block */
 	uint64_t file_size;	/* file size */
+	uint64_t file_hash;	/* hash of file contents for the node's sbcast
+				 * cache, zero if not used */
 } file_bcast_msg_t;
 
 typedef struct multi_core_data {
@@ -211,6 +211,7 @@ extern slurm_step_layout_t *slurm_step_layout_copy(
 	layout = xmalloc(sizeof(slurm_step_layout_t));
 	layout->node_list = xstrdup(step_layout->node_list);
 	layout->node_cnt = step_layout->node_cnt;
+	layout->plane_size = step_layout->plane_size;
 	layout->start_protocol_ver = step_layout->start_protocol_ver;
 	layout->task_cnt = step_layout->task_cnt;
 	layout->task_dist = step_layout->task_dist;
@@ -1223,6 +1223,7 @@ extern void slurmdb_destroy_job_cond(void *object)
 		FREE_NULL_LIST(job_cond->constraint_list);
 		FREE_NULL_LIST(job_cond->groupid_list);
 		FREE_NULL_LIST(job_cond->jobname_list);
+		xfree(job_cond->page_cluster);
 		FREE_NULL_LIST(job_cond->partition_list);
 		FREE_NULL_LIST(job_cond->qos_list);
 		FREE_NULL_LIST(job_cond->reason_list);
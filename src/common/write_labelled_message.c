@@ -51,7 +51,7 @@
 static char *_build_label(int task_id, int task_id_width,
 			  uint32_t het_job_offset,
 			  uint32_t het_job_task_offset);
-static int _write_line(int fd, char *prefix, char *suffix, void *buf, int len);
+static int _write_all(int fd, void *buf, int len);
 
 /*
  * fd             is the file descriptor to write to
@@ -71,55 +71,63 @@ static int _write_line(int fd, char *prefix, char *suffix, void *buf, int len);
  * If the message ends in a partial line (line does not end
  * in a '\n'), then add a newline to the output file, but only
  * in label mode.
+ *
+ * The labelled lines of a message are assembled and written with a single
+ * write() rather than one per line, which keeps lines from multiple hetjob
+ * components from interleaving and keeps the cost per message constant.
  */
 extern int write_labelled_message(int fd, void *buf, int len, int task_id,
 				  uint32_t het_job_offset,
 				  uint32_t het_job_task_offset,
 				  bool label, int task_id_width)
 {
-	void *start, *end;
-	char *prefix = NULL, *suffix = NULL;
-	int remaining = len;
-	int written = 0;
-	int line_len;
-	int rc = -1;
+	char *prefix, *out, *ptr, *start, *end;
+	int remaining, line_len, pre, lines = 0, rc;
 
-	if (label) {
-		prefix = _build_label(task_id, task_id_width, het_job_offset,
-				      het_job_task_offset);
-	}
+	if (len <= 0)
+		return -1;
+	if (!label)
+		return _write_all(fd, buf, len);
 
+	prefix = _build_label(task_id, task_id_width, het_job_offset,
+			      het_job_task_offset);
+	pre = strlen(prefix);
+
+	start = buf;
+	remaining = len;
 	while (remaining > 0) {
-		start = buf + written;
-		end = memchr(start, '\n', remaining);
-		if (end == NULL) { /* no newline found */
-			if (label)
-				suffix = "\n";
-			rc = _write_line(fd, prefix, suffix, start, remaining);
-			if (rc <= 0) {
-				goto done;
-			} else {
-				remaining -= rc;
-				written += rc;
-			}
-		} else {
-			line_len = (int)(end - start) + 1;
-			rc = _write_line(fd, prefix, suffix, start, line_len);
-			if (rc <= 0) {
-				goto done;
-			} else {
-				remaining -= rc;
-				written += rc;
-			}
-		}
+		lines++;
+		if (!(end = memchr(start, '\n', remaining)))
+			break;
+		remaining -= end - start + 1;
+		start = end + 1;
+	}
 
+	/* Room for a label per line and a newline after a partial line */
+	out = ptr = xmalloc(len + (lines * pre) + 1);
+	start = buf;
+	remaining = len;
+	while (remaining > 0) {
+		if ((end = memchr(start, '\n', remaining)))
+			line_len = end - start + 1;
+		else
+			line_len = remaining;
+		memcpy(ptr, prefix, pre);
+		ptr += pre;
+		memcpy(ptr, start, line_len);
+		ptr += line_len;
+		if (!end)
+			*ptr++ = '\n';
+		start += line_len;
+		remaining -= line_len;
 	}
-done:
+
+	rc = _write_all(fd, out, ptr - out);
+	xfree(out);
 	xfree(prefix);
-	if (written > 0)
-		return written;
-	else
+	if (rc < 0)
 		return rc;
+	return len;
 }
 
 /*
@@ -148,33 +156,12 @@ static char *_build_label(int task_id, int task_id_width,
 
 /*
  * Blocks until write is complete, regardless of the file descriptor being in
- * non-blocking mode.
- * I/O from multiple hetjob components may be present, so add prefix/suffix to
- * buffer before issuing write to avoid interleaved output from multiple
- * components.
+ * non-blocking mode. Returns len or -1 on error.
  */
-static int _write_line(int fd, char *prefix, char *suffix, void *buf, int len)
+static int _write_all(int fd, void *buf, int len)
 {
-	int left, n, pre = 0, post = 0;
-	void *ptr, *tmp = NULL;
-
-	if (prefix || suffix) {
-		if (prefix)
-			pre = strlen(prefix);
-		if (suffix)
-			post = strlen(suffix);
-		tmp = xmalloc(pre + len + post);
-		if (prefix)
-			memcpy(tmp, prefix, pre);
-		memcpy(tmp + pre, buf, len);
-		if (suffix)
-			memcpy(tmp + pre + len, suffix, post);
-		ptr = tmp;
-		left = pre + len + post;
-	} else {
-		ptr = buf;
-		left = len;
-	}
+	int left = len, n;
+	void *ptr = buf;
 
 	while (left > 0) {
 	again:
@@ -182,16 +169,14 @@ static int _write_line(int fd, char *prefix, char *suffix, void *buf, int len)
 			if (errno == EINTR)
 				goto again;
 			if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
-				debug3("  got EAGAIN in _write_line");
+				debug3("  got EAGAIN in _write_all");
 				goto again;
 			}
-			len = -1;
-			break;
+			return -1;
 		}
 		left -= n;
 		ptr += n;
 	}
-	xfree(tmp);
 
 	return len;
 }
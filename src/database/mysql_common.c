@@ -50,6 +50,18 @@
 
 #define MAX_DEADLOCK_ATTEMPTS 10
 
+/*
+ * Send deferred statements once they get this big, well below the smallest
+ * default max_allowed_packet.
+ */
+#define MAX_DEFER_LEN (512 * 1024)
+
+/* Idle server connections kept for the next mysql_db_get_db_connection() */
+#define MAX_POOLED_CONNS 16
+
+/* Prepared statements kept per server connection */
+#define MAX_CACHED_STMTS 32
+
 static char *table_defs_table = "table_defs_table";
 
 typedef struct {
@@ -57,6 +69,20 @@ typedef struct {
 	char *columns;
 } db_key_t;
 
+typedef struct {
+	char *query;
+	MYSQL_STMT *stmt;
+} db_stmt_t;
+
+typedef struct {
+	MYSQL *db_conn;
+	char *key;
+	List stmt_list;
+} pooled_conn_t;
+
+static List conn_pool = NULL;
+static pthread_mutex_t conn_pool_lock = PTHREAD_MUTEX_INITIALIZER;
+
 static void _destroy_db_key(void *arg)
 {
 	db_key_t *db_key = (db_key_t *)arg;
@@ -68,6 +94,45 @@ static void _destroy_db_key(void *arg)
 	}
 }
 
+static void _destroy_db_stmt(void *arg)
+{
+	db_stmt_t *db_stmt = (db_stmt_t *)arg;
+
+	if (db_stmt) {
+		if (db_stmt->stmt)
+			mysql_stmt_close(db_stmt->stmt);
+		xfree(db_stmt->query);
+		xfree(db_stmt);
+	}
+}
+
+static int _find_db_stmt(void *x, void *key)
+{
+	db_stmt_t *db_stmt = (db_stmt_t *)x;
+
+	return !xstrcmp(db_stmt->query, (char *)key);
+}
+
+static void _destroy_pooled_conn(void *arg)
+{
+	pooled_conn_t *pooled = (pooled_conn_t *)arg;
+
+	if (pooled) {
+		FREE_NULL_LIST(pooled->stmt_list);
+		if (pooled->db_conn)
+			mysql_close(pooled->db_conn);
+		xfree(pooled->key);
+		xfree(pooled);
+	}
+}
+
+static int _find_pooled_conn(void *x, void *key)
+{
+	pooled_conn_t *pooled = (pooled_conn_t *)x;
+
+	return !xstrcmp(pooled->key, (char *)key);
+}
+
 /* NOTE: Ensure that mysql_conn->lock is set on function entry */
 static int _clear_results(MYSQL *db_conn)
 {
@@ -202,6 +267,86 @@ end_it:
 	return rc;
 }
 
+/* NOTE: Ensure that mysql_conn->lock is set on function entry */
+static void _drop_deferred(mysql_conn_t *mysql_conn)
+{
+	xfree(mysql_conn->defer_head);
+	xfree(mysql_conn->defer_query);
+	xfree(mysql_conn->defer_tail);
+	xfree(mysql_conn->defer_values);
+	mysql_conn->defer_values_pos = NULL;
+	mysql_conn->defer_rows = 0;
+	mysql_conn->defer_failed = false;
+}
+
+/* NOTE: Ensure that mysql_conn->lock is set on function entry */
+static void _end_deferred_rows(mysql_conn_t *mysql_conn)
+{
+	if (!mysql_conn->defer_head)
+		return;
+
+	xstrfmtcat(mysql_conn->defer_query, "%s%s%s%s;",
+		   mysql_conn->defer_head, mysql_conn->defer_values,
+		   mysql_conn->defer_tail ? " " : "",
+		   mysql_conn->defer_tail ? mysql_conn->defer_tail : "");
+	debug4("%s: conn %d merged %u rows into one insert",
+	       __func__, mysql_conn->conn, mysql_conn->defer_rows);
+	xfree(mysql_conn->defer_head);
+	xfree(mysql_conn->defer_tail);
+	xfree(mysql_conn->defer_values);
+	mysql_conn->defer_values_pos = NULL;
+	mysql_conn->defer_rows = 0;
+}
+
+/*
+ * Send the deferred statements of the connection as one multi-statement
+ * query. This has to happen before anything else is run on the connection so
+ * statements still run in the order they were issued. Once deferred
+ * statements failed, this keeps failing until the transaction is rolled back.
+ * NOTE: Ensure that mysql_conn->lock is set on function entry
+ */
+static int _flush_deferred(mysql_conn_t *mysql_conn)
+{
+	char *query;
+	int rc;
+	int deadlock_attempt = 0;
+
+	if (mysql_conn->defer_failed)
+		return SLURM_ERROR;
+
+	_end_deferred_rows(mysql_conn);
+	if (!mysql_conn->defer_query)
+		return SLURM_SUCCESS;
+
+	query = mysql_conn->defer_query;
+	mysql_conn->defer_query = NULL;
+try_again:
+	if ((rc = _mysql_query_internal(mysql_conn->db_conn, query))
+	    != SLURM_ERROR)
+		rc = _clear_results(mysql_conn->db_conn);
+	/*
+	 * A deadlock in a later statement only shows up in its result. It
+	 * rolled back the whole transaction, earlier statements included, so
+	 * send them all again.
+	 */
+	if ((rc != SLURM_SUCCESS) &&
+	    (mysql_errno(mysql_conn->db_conn) == ER_LOCK_DEADLOCK) &&
+	    (++deadlock_attempt < MAX_DEADLOCK_ATTEMPTS)) {
+		error("%s: conn %d deadlock detected attempt %u/%u",
+		      __func__, mysql_conn->conn, deadlock_attempt,
+		      MAX_DEADLOCK_ATTEMPTS);
+		goto try_again;
+	}
+	if (rc != SLURM_SUCCESS) {
+		error("%s: conn %d deferred statements failed",
+		      __func__, mysql_conn->conn);
+		mysql_conn->defer_failed = true;
+	}
+	xfree(query);
+
+	return rc;
+}
+
 /* NOTE: Ensure that mysql_conn->lock is NOT set on function entry */
 static int _mysql_make_table_current(mysql_conn_t *mysql_conn, char *table_name,
 				     storage_field_t *fields, char *ending)
@@ -759,6 +904,123 @@ extern int destroy_mysql_db_info(mysql_db_info_t *db_info)
 	return SLURM_SUCCESS;
 }
 
+/*
+ * Set up the session of a server connection. The client library loses this
+ * when it reconnects, so it is set again after a reconnect too.
+ * NOTE: Ensure that mysql_conn->lock is set on function entry
+ */
+static int _set_session(mysql_conn_t *mysql_conn)
+{
+	if (mysql_conn->rollback)
+		mysql_autocommit(mysql_conn->db_conn, 0);
+	return _mysql_query_internal(mysql_conn->db_conn,
+				     "SET session sql_mode='ANSI_QUOTES,"
+				     "NO_ENGINE_SUBSTITUTION';");
+}
+
+/*
+ * Deal with the client library having reconnected the server connection:
+ * the session settings and prepared statements are gone, and so is the
+ * transaction the deferred statements belonged to.
+ * NOTE: Ensure that mysql_conn->lock is set on function entry
+ */
+static void _reconnected(mysql_conn_t *mysql_conn)
+{
+	debug("%s: conn %d reconnected to the database server",
+	      __func__, mysql_conn->conn);
+	FREE_NULL_LIST(mysql_conn->stmt_list);
+	if (mysql_conn->defer_query || mysql_conn->defer_head)
+		mysql_conn->defer_failed = true;
+	_set_session(mysql_conn);
+}
+
+/*
+ * Take an idle server connection to the same database, with the prepared
+ * statements it still holds, from the pool.
+ * NOTE: Ensure that mysql_conn->lock is set on function entry
+ */
+static MYSQL *_pool_get(mysql_conn_t *mysql_conn)
+{
+	pooled_conn_t *pooled;
+	unsigned long thread_id;
+
+	while (1) {
+		slurm_mutex_lock(&conn_pool_lock);
+		pooled = conn_pool ?
+			list_remove_first(conn_pool, _find_pooled_conn,
+					  mysql_conn->pool_key) : NULL;
+		slurm_mutex_unlock(&conn_pool_lock);
+		if (!pooled)
+			return NULL;
+
+		if (mysql_thread_safe())
+			mysql_thread_init();
+
+		/*
+		 * A reconnect in mysql_ping() would lose the session settings
+		 * and the prepared statements, use a new connection instead.
+		 */
+		thread_id = mysql_thread_id(pooled->db_conn);
+		if (!mysql_ping(pooled->db_conn) &&
+		    (mysql_thread_id(pooled->db_conn) == thread_id)) {
+			MYSQL *db_conn = pooled->db_conn;
+
+			mysql_conn->stmt_list = pooled->stmt_list;
+			pooled->stmt_list = NULL;
+			pooled->db_conn = NULL;
+			_destroy_pooled_conn(pooled);
+			errno = 0;
+			return db_conn;
+		}
+
+		debug2("%s: conn %d dropping stale pooled connection",
+		       __func__, mysql_conn->conn);
+		_destroy_pooled_conn(pooled);
+	}
+}
+
+/*
+ * Keep the server connection of mysql_conn for the next connection to the
+ * same database instead of closing it.
+ * RET true if the connection was pooled
+ * NOTE: Ensure that mysql_conn->lock is set on function entry
+ */
+static bool _pool_put(mysql_conn_t *mysql_conn)
+{
+	pooled_conn_t *pooled;
+
+	if (!mysql_conn->pool_key)
+		return false;
+
+	/* clear out the old results so we don't get a 2014 error */
+	if (_clear_results(mysql_conn->db_conn) != SLURM_SUCCESS)
+		return false;
+
+	/* Don't hand an open transaction to the next connection */
+	if (mysql_conn->rollback && mysql_rollback(mysql_conn->db_conn))
+		return false;
+
+	slurm_mutex_lock(&conn_pool_lock);
+	if (!conn_pool)
+		conn_pool = list_create(_destroy_pooled_conn);
+	if (list_count(conn_pool) >= MAX_POOLED_CONNS) {
+		slurm_mutex_unlock(&conn_pool_lock);
+		return false;
+	}
+	pooled = xmalloc(sizeof(pooled_conn_t));
+	pooled->db_conn = mysql_conn->db_conn;
+	pooled->key = mysql_conn->pool_key;
+	pooled->stmt_list = mysql_conn->stmt_list;
+	list_prepend(conn_pool, pooled);
+	slurm_mutex_unlock(&conn_pool_lock);
+
+	mysql_conn->db_conn = NULL;
+	mysql_conn->pool_key = NULL;
+	mysql_conn->stmt_list = NULL;
+
+	return true;
+}
+
 extern int mysql_db_get_db_connection(mysql_conn_t *mysql_conn, char *db_name,
 				      mysql_db_info_t *db_info)
 {
@@ -772,6 +1034,20 @@ extern int mysql_db_get_db_connection(mysql_conn_t *mysql_conn, char *db_name,
 
 	slurm_mutex_lock(&mysql_conn->lock);
 
+	xfree(mysql_conn->pool_key);
+	mysql_conn->pool_key = xstrdup_printf("%s@%s:%u/%s%s",
+					      db_info->user, db_info->host,
+					      db_info->port, db_name,
+					      mysql_conn->rollback ?
+					      " rollback" : "");
+	if (!mysql_conn->db_conn &&
+	    (mysql_conn->db_conn = _pool_get(mysql_conn))) {
+		debug2("%s: conn %d reusing pooled connection to %s",
+		       __func__, mysql_conn->conn, mysql_conn->pool_key);
+		slurm_mutex_unlock(&mysql_conn->lock);
+		return SLURM_SUCCESS;
+	}
+
 	if (!(mysql_conn->db_conn = mysql_init(mysql_conn->db_conn))) {
 		slurm_mutex_unlock(&mysql_conn->lock);
 		fatal("mysql_init failed: %s",
@@ -834,11 +1110,7 @@ extern int mysql_db_get_db_connection(mysql_conn_t *mysql_conn, char *db_name,
 		}
 
 		storage_init = true;
-		if (mysql_conn->rollback)
-			mysql_autocommit(mysql_conn->db_conn, 0);
-		rc = _mysql_query_internal(mysql_conn->db_conn,
-					   "SET session sql_mode='ANSI_QUOTES,"
-					   "NO_ENGINE_SUBSTITUTION';");
+		rc = _set_session(mysql_conn);
 	}
 	slurm_mutex_unlock(&mysql_conn->lock);
 	errno = rc;
@@ -848,12 +1120,19 @@ extern int mysql_db_get_db_connection(mysql_conn_t *mysql_conn, char *db_name,
 extern int mysql_db_close_db_connection(mysql_conn_t *mysql_conn)
 {
 	slurm_mutex_lock(&mysql_conn->lock);
+	/* The transaction the deferred statements were part of is gone */
+	_drop_deferred(mysql_conn);
 	if (mysql_conn && mysql_conn->db_conn) {
+		if (!_pool_put(mysql_conn)) {
+			FREE_NULL_LIST(mysql_conn->stmt_list);
+			mysql_close(mysql_conn->db_conn);
+			mysql_conn->db_conn = NULL;
+		}
 		if (mysql_thread_safe())
 			mysql_thread_end();
-		mysql_close(mysql_conn->db_conn);
-		mysql_conn->db_conn = NULL;
 	}
+	FREE_NULL_LIST(mysql_conn->stmt_list);
+	xfree(mysql_conn->pool_key);
 	slurm_mutex_unlock(&mysql_conn->lock);
 	return SLURM_SUCCESS;
 }
@@ -862,6 +1141,10 @@ extern int mysql_db_cleanup()
 {
 	debug3("starting mysql cleaning up");
 
+	slurm_mutex_lock(&conn_pool_lock);
+	FREE_NULL_LIST(conn_pool);
+	slurm_mutex_unlock(&conn_pool_lock);
+
 #ifdef mysql_library_end
 	mysql_library_end();
 #else
@@ -880,7 +1163,8 @@ extern int mysql_db_query(mysql_conn_t *mysql_conn, char *query)
 		return 0;	/* For CLANG false positive */
 	}
 	slurm_mutex_lock(&mysql_conn->lock);
-	rc = _mysql_query_internal(mysql_conn->db_conn, query);
+	if ((rc = _flush_deferred(mysql_conn)) == SLURM_SUCCESS)
+		rc = _mysql_query_internal(mysql_conn->db_conn, query);
 	slurm_mutex_unlock(&mysql_conn->lock);
 	return rc;
 }
@@ -898,7 +1182,8 @@ extern int mysql_db_delete_affected_rows(mysql_conn_t *mysql_conn, char *query)
 		return 0;	/* For CLANG false positive */
 	}
 	slurm_mutex_lock(&mysql_conn->lock);
-	if (!(rc = _mysql_query_internal(mysql_conn->db_conn, query)))
+	if ((rc = _flush_deferred(mysql_conn)) == SLURM_SUCCESS &&
+	    !(rc = _mysql_query_internal(mysql_conn->db_conn, query)))
 		rc = mysql_affected_rows(mysql_conn->db_conn);
 	slurm_mutex_unlock(&mysql_conn->lock);
 	return rc;
@@ -907,6 +1192,7 @@ extern int mysql_db_delete_affected_rows(mysql_conn_t *mysql_conn, char *query)
 extern int mysql_db_ping(mysql_conn_t *mysql_conn)
 {
 	int rc;
+	unsigned long thread_id;
 
 	if (!mysql_conn->db_conn)
 		return -1;
@@ -914,7 +1200,10 @@ extern int mysql_db_ping(mysql_conn_t *mysql_conn)
 	/* clear out the old results so we don't get a 2014 error */
 	slurm_mutex_lock(&mysql_conn->lock);
 	_clear_results(mysql_conn->db_conn);
+	thread_id = mysql_thread_id(mysql_conn->db_conn);
 	rc = mysql_ping(mysql_conn->db_conn);
+	if (!rc && (mysql_thread_id(mysql_conn->db_conn) != thread_id))
+		_reconnected(mysql_conn);
 	/*
 	 * Starting in MariaDB 10.2 many of the api commands started
 	 * setting errno erroneously.
@@ -933,6 +1222,19 @@ extern int mysql_db_commit(mysql_conn_t *mysql_conn)
 		return SLURM_ERROR;
 
 	slurm_mutex_lock(&mysql_conn->lock);
+	if (_flush_deferred(mysql_conn) != SLURM_SUCCESS) {
+		/* Don't commit a transaction missing some of its statements */
+		error("%s: conn %d rolling back after deferred statements failed",
+		      __func__, mysql_conn->conn);
+		_drop_deferred(mysql_conn);
+		_clear_results(mysql_conn->db_conn);
+		if (mysql_rollback(mysql_conn->db_conn))
+			error("mysql_rollback failed: %d %s",
+			      mysql_errno(mysql_conn->db_conn),
+			      mysql_error(mysql_conn->db_conn));
+		rc = SLURM_ERROR;
+		goto end_it;
+	}
 	/* clear out the old results so we don't get a 2014 error */
 	_clear_results(mysql_conn->db_conn);
 	if (mysql_commit(mysql_conn->db_conn)) {
@@ -942,6 +1244,7 @@ extern int mysql_db_commit(mysql_conn_t *mysql_conn)
 		errno = mysql_errno(mysql_conn->db_conn);
 		rc = SLURM_ERROR;
 	}
+end_it:
 	slurm_mutex_unlock(&mysql_conn->lock);
 	return rc;
 }
@@ -954,6 +1257,7 @@ extern int mysql_db_rollback(mysql_conn_t *mysql_conn)
 		return SLURM_ERROR;
 
 	slurm_mutex_lock(&mysql_conn->lock);
+	_drop_deferred(mysql_conn);
 	/* clear out the old results so we don't get a 2014 error */
 	_clear_results(mysql_conn->db_conn);
 	if (mysql_rollback(mysql_conn->db_conn)) {
@@ -980,6 +1284,8 @@ extern MYSQL_RES *mysql_db_query_ret(mysql_conn_t *mysql_conn,
 	MYSQL_RES *result = NULL;
 
 	slurm_mutex_lock(&mysql_conn->lock);
+	if (_flush_deferred(mysql_conn) != SLURM_SUCCESS)
+		goto fini;
 	if (_mysql_query_internal(mysql_conn->db_conn, query) != SLURM_ERROR)  {
 		if (mysql_errno(mysql_conn->db_conn) == ER_NO_SUCH_TABLE)
 			goto fini;
@@ -1004,13 +1310,35 @@ fini:
 	return result;
 }
 
+extern MYSQL_RES *mysql_db_query_stream(mysql_conn_t *mysql_conn, char *query)
+{
+	MYSQL_RES *result = NULL;
+
+	slurm_mutex_lock(&mysql_conn->lock);
+	if ((_flush_deferred(mysql_conn) == SLURM_SUCCESS) &&
+	    (_mysql_query_internal(mysql_conn->db_conn, query) != SLURM_ERROR)) {
+		if (!(result = mysql_use_result(mysql_conn->db_conn)) &&
+		    mysql_field_count(mysql_conn->db_conn))
+			error("We should have gotten a result: '%s'",
+			      mysql_error(mysql_conn->db_conn));
+		/*
+		 * Starting in MariaDB 10.2 many of the api commands started
+		 * setting errno erroneously.
+		 */
+		errno = 0;
+	}
+	slurm_mutex_unlock(&mysql_conn->lock);
+	return result;
+}
+
 extern int mysql_db_query_check_after(mysql_conn_t *mysql_conn, char *query)
 {
 	int rc = SLURM_SUCCESS;
 
 	slurm_mutex_lock(&mysql_conn->lock);
-	if ((rc = _mysql_query_internal(
-		     mysql_conn->db_conn, query)) != SLURM_ERROR)
+	if (((rc = _flush_deferred(mysql_conn)) == SLURM_SUCCESS) &&
+	    ((rc = _mysql_query_internal(
+		     mysql_conn->db_conn, query)) != SLURM_ERROR))
 		rc = _clear_results(mysql_conn->db_conn);
 	slurm_mutex_unlock(&mysql_conn->lock);
 	return rc;
@@ -1021,7 +1349,8 @@ extern uint64_t mysql_db_insert_ret_id(mysql_conn_t *mysql_conn, char *query)
 	uint64_t new_id = 0;
 
 	slurm_mutex_lock(&mysql_conn->lock);
-	if (_mysql_query_internal(mysql_conn->db_conn, query) != SLURM_ERROR)  {
+	if ((_flush_deferred(mysql_conn) == SLURM_SUCCESS) &&
+	    (_mysql_query_internal(mysql_conn->db_conn, query) != SLURM_ERROR))  {
 		new_id = mysql_insert_id(mysql_conn->db_conn);
 		if (!new_id) {
 			/* should have new id */
@@ -1034,6 +1363,223 @@ extern uint64_t mysql_db_insert_ret_id(mysql_conn_t *mysql_conn, char *query)
 
 }
 
+extern void mysql_db_defer(mysql_conn_t *mysql_conn, char *query)
+{
+	slurm_mutex_lock(&mysql_conn->lock);
+	if (mysql_conn->defer_failed) {
+		/* The transaction is rolled back at commit anyway */
+		slurm_mutex_unlock(&mysql_conn->lock);
+		return;
+	}
+	_end_deferred_rows(mysql_conn);
+	xstrfmtcat(mysql_conn->defer_query, "%s%s",
+		   query, (query[strlen(query) - 1] == ';') ? "" : ";");
+	if (strlen(mysql_conn->defer_query) >= MAX_DEFER_LEN)
+		_flush_deferred(mysql_conn);
+	slurm_mutex_unlock(&mysql_conn->lock);
+}
+
+extern void mysql_db_defer_row(mysql_conn_t *mysql_conn, char *head,
+			       char *values, char *tail)
+{
+	slurm_mutex_lock(&mysql_conn->lock);
+	if (mysql_conn->defer_failed) {
+		/* The transaction is rolled back at commit anyway */
+		slurm_mutex_unlock(&mysql_conn->lock);
+		return;
+	}
+	if (xstrcmp(mysql_conn->defer_head, head) ||
+	    xstrcmp(mysql_conn->defer_tail, tail)) {
+		_end_deferred_rows(mysql_conn);
+		mysql_conn->defer_head = xstrdup(head);
+		mysql_conn->defer_tail = xstrdup(tail);
+	}
+	xstrfmtcatat(mysql_conn->defer_values, &mysql_conn->defer_values_pos,
+		     "%s%s", mysql_conn->defer_rows ? ", " : "", values);
+	mysql_conn->defer_rows++;
+	if ((mysql_conn->defer_values_pos - mysql_conn->defer_values) +
+	    (mysql_conn->defer_query ? strlen(mysql_conn->defer_query) : 0) >=
+	    MAX_DEFER_LEN)
+		_flush_deferred(mysql_conn);
+	slurm_mutex_unlock(&mysql_conn->lock);
+}
+
+extern int mysql_db_flush(mysql_conn_t *mysql_conn)
+{
+	int rc;
+
+	slurm_mutex_lock(&mysql_conn->lock);
+	rc = _flush_deferred(mysql_conn);
+	slurm_mutex_unlock(&mysql_conn->lock);
+	return rc;
+}
+
+/*
+ * Find the prepared statement of query, preparing it if the connection
+ * hasn't run it yet.
+ * NOTE: Ensure that mysql_conn->lock is set on function entry
+ */
+static MYSQL_STMT *_get_stmt(mysql_conn_t *mysql_conn, char *query)
+{
+	db_stmt_t *db_stmt;
+
+	if (!mysql_conn->stmt_list)
+		mysql_conn->stmt_list = list_create(_destroy_db_stmt);
+	else if ((db_stmt = list_find_first(mysql_conn->stmt_list,
+					    _find_db_stmt, query)))
+		return db_stmt->stmt;
+
+	if (list_count(mysql_conn->stmt_list) >= MAX_CACHED_STMTS)
+		_destroy_db_stmt(list_pop(mysql_conn->stmt_list));
+
+	db_stmt = xmalloc(sizeof(db_stmt_t));
+	if (!(db_stmt->stmt = mysql_stmt_init(mysql_conn->db_conn))) {
+		error("mysql_stmt_init failed: %d %s",
+		      mysql_errno(mysql_conn->db_conn),
+		      mysql_error(mysql_conn->db_conn));
+		xfree(db_stmt);
+		return NULL;
+	}
+	if (mysql_stmt_prepare(db_stmt->stmt, query, strlen(query))) {
+		error("mysql_stmt_prepare failed: %d %s\n%s",
+		      mysql_stmt_errno(db_stmt->stmt),
+		      mysql_stmt_error(db_stmt->stmt), query);
+		_destroy_db_stmt(db_stmt);
+		return NULL;
+	}
+	db_stmt->query = xstrdup(query);
+	list_append(mysql_conn->stmt_list, db_stmt);
+	debug4("%s: conn %d prepared statement %d\n%s", __func__,
+	       mysql_conn->conn, list_count(mysql_conn->stmt_list), query);
+
+	return db_stmt->stmt;
+}
+
+extern int mysql_db_stmt_exec(mysql_conn_t *mysql_conn, char *query,
+			      MYSQL_BIND *params, int param_cnt)
+{
+	MYSQL_STMT *stmt;
+	int rc = SLURM_SUCCESS;
+	int deadlock_attempt = 0;
+	bool prepared_again = false;
+
+	if (!mysql_conn || !mysql_conn->db_conn) {
+		fatal("You haven't inited this storage yet.");
+		return 0;	/* For CLANG false positive */
+	}
+	slurm_mutex_lock(&mysql_conn->lock);
+	if ((rc = _flush_deferred(mysql_conn)) != SLURM_SUCCESS)
+		goto end_it;
+	/* clear out the old results so we don't get a 2014 error */
+	_clear_results(mysql_conn->db_conn);
+
+try_again:
+	if (!(stmt = _get_stmt(mysql_conn, query))) {
+		rc = SLURM_ERROR;
+		goto end_it;
+	}
+
+	if (mysql_stmt_param_count(stmt) != param_cnt) {
+		error("%s: statement takes %lu parameters, %d given\n%s",
+		      __func__, mysql_stmt_param_count(stmt), param_cnt,
+		      query);
+		rc = SLURM_ERROR;
+		goto end_it;
+	}
+
+	if (mysql_stmt_bind_param(stmt, params) || mysql_stmt_execute(stmt)) {
+		const char *err_str = mysql_stmt_error(stmt);
+		errno = mysql_stmt_errno(stmt);
+		if (errno == ER_LOCK_DEADLOCK) {
+			/*
+			 * Mysql detected a deadlock and we should retry
+			 * a few times since this is mainly a race condition
+			 */
+			deadlock_attempt++;
+
+			if (deadlock_attempt < MAX_DEADLOCK_ATTEMPTS) {
+				error("%s: deadlock detected attempt %u/%u: %d %s",
+				      __func__, deadlock_attempt,
+				      MAX_DEADLOCK_ATTEMPTS, errno, err_str);
+				goto try_again;
+			}
+			fatal("%s: unable to resolve deadlock with attempts %u/%u: %d %s\nPlease call 'show engine innodb status;' in MySQL/MariaDB and open a bug report with SchedMD.",
+			      __func__, deadlock_attempt,
+			      MAX_DEADLOCK_ATTEMPTS, errno, err_str);
+		} else if (!prepared_again &&
+			   (errno == ER_UNKNOWN_STMT_HANDLER)) {
+			/* The server forgot the statement, prepare it again */
+			debug("%s: conn %d preparing statement again after %d %s",
+			      __func__, mysql_conn->conn, errno, err_str);
+			prepared_again = true;
+			list_delete_all(mysql_conn->stmt_list, _find_db_stmt,
+					query);
+			goto try_again;
+		} else if (!prepared_again &&
+			   ((errno == CR_SERVER_GONE_ERROR) ||
+			    (errno == CR_SERVER_LOST))) {
+			/*
+			 * The client library does not resend prepared
+			 * statements itself. Reconnect, then prepare the
+			 * statement again on the new connection.
+			 */
+			debug("%s: conn %d preparing statement again after %d %s",
+			      __func__, mysql_conn->conn, errno, err_str);
+			prepared_again = true;
+			if (mysql_ping(mysql_conn->db_conn)) {
+				error("%s: conn %d unable to reconnect: %d %s",
+				      __func__, mysql_conn->conn,
+				      mysql_errno(mysql_conn->db_conn),
+				      mysql_error(mysql_conn->db_conn));
+				rc = SLURM_ERROR;
+				goto end_it;
+			}
+			_reconnected(mysql_conn);
+			goto try_again;
+		}
+		error("mysql_stmt_execute failed: %d %s\n%s",
+		      errno, err_str, query);
+		rc = SLURM_ERROR;
+	}
+
+end_it:
+	/*
+	 * Starting in MariaDB 10.2 many of the api commands started
+	 * setting errno erroneously.
+	 */
+	if (!rc)
+		errno = 0;
+	slurm_mutex_unlock(&mysql_conn->lock);
+	return rc;
+}
+
+extern void mysql_db_bind_str(MYSQL_BIND *bind, char *str)
+{
+	memset(bind, 0, sizeof(MYSQL_BIND));
+	if (!str) {
+		bind->buffer_type = MYSQL_TYPE_NULL;
+		return;
+	}
+	bind->buffer_type = MYSQL_TYPE_STRING;
+	bind->buffer = str;
+	bind->buffer_length = strlen(str);
+}
+
+extern void mysql_db_bind_int64(MYSQL_BIND *bind, int64_t *val)
+{
+	memset(bind, 0, sizeof(MYSQL_BIND));
+	bind->buffer_type = MYSQL_TYPE_LONGLONG;
+	bind->buffer = val;
+}
+
+extern void mysql_db_bind_uint64(MYSQL_BIND *bind, uint64_t *val)
+{
+	memset(bind, 0, sizeof(MYSQL_BIND));
+	bind->buffer_type = MYSQL_TYPE_LONGLONG;
+	bind->buffer = val;
+	bind->is_unsigned = true;
+}
+
 extern int mysql_db_create_table(mysql_conn_t *mysql_conn, char *table_name,
 				 storage_field_t *fields, char *ending)
 {
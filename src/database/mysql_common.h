@@ -50,6 +50,7 @@
 #include "src/common/xstring.h"
 
 #include <mysql.h>
+#include <errmsg.h>
 #include <mysqld_error.h>
 
 typedef enum {
@@ -62,9 +63,18 @@ typedef struct {
 	bool cluster_deleted;
 	char *cluster_name;
 	MYSQL *db_conn;
+	bool defer_failed;	/* deferred statements failed, roll back */
+	char *defer_head;	/* insert the deferred rows are added to */
+	char *defer_query;	/* deferred statements, see mysql_db_defer() */
+	uint32_t defer_rows;	/* rows in defer_values */
+	char *defer_tail;	/* "on duplicate key" part of defer_head */
+	char *defer_values;	/* deferred rows of defer_head */
+	char *defer_values_pos;	/* end of defer_values */
 	pthread_mutex_t lock;
+	char *pool_key;		/* idle db_conn is pooled under this key */
 	char *pre_commit_query;
 	bool rollback;
+	List stmt_list;		/* prepared statements, see mysql_db_stmt_exec() */
 	List update_list;
 	int conn;
 } mysql_conn_t;
@@ -103,8 +113,59 @@ extern MYSQL_RES *mysql_db_query_ret(mysql_conn_t *mysql_conn,
 				     char *query, bool last);
 extern int mysql_db_query_check_after(mysql_conn_t *mysql_conn, char *query);
 
+/*
+ * Like mysql_db_query_ret() but rows are read from the server as they are
+ * fetched instead of all at once. Nothing else can be run on the connection
+ * until the result is freed.
+ */
+extern MYSQL_RES *mysql_db_query_stream(mysql_conn_t *mysql_conn, char *query);
+
 extern uint64_t mysql_db_insert_ret_id(mysql_conn_t *mysql_conn, char *query);
 
+/*
+ * Queue a statement to be sent along with the next query, commit or
+ * mysql_db_flush() on the connection, saving a round trip per statement.
+ * If a deferred statement fails, every later query and flush on the
+ * connection fails and mysql_db_commit() rolls the transaction back and
+ * fails, so only defer statements of a connection in rollback mode.
+ */
+extern void mysql_db_defer(mysql_conn_t *mysql_conn, char *query);
+
+/*
+ * Like mysql_db_defer(), but for a single row insert. Consecutive rows with
+ * the same head and tail are sent as one multi-row insert.
+ * head IN - "insert into ... (columns) values " part of the insert
+ * values IN - "(...)" row to insert
+ * tail IN - "on duplicate key update ..." part of the insert or NULL, must
+ *	     only refer to the row through VALUES()
+ */
+extern void mysql_db_defer_row(mysql_conn_t *mysql_conn, char *head,
+			       char *values, char *tail);
+
+/* Send the deferred statements of the connection now */
+extern int mysql_db_flush(mysql_conn_t *mysql_conn);
+
+/*
+ * Run an insert or update as a server side prepared statement. The statement
+ * is prepared the first time a connection runs it and then only the
+ * parameters are sent. Prepared statements stay with the server connection,
+ * also when it is pooled by mysql_db_close_db_connection().
+ * query IN - statement with a ? for every parameter
+ * params IN - parameters, set with the mysql_db_bind_*() functions
+ * param_cnt IN - number of params
+ * RET SLURM_SUCCESS or SLURM_ERROR
+ */
+extern int mysql_db_stmt_exec(mysql_conn_t *mysql_conn, char *query,
+			      MYSQL_BIND *params, int param_cnt);
+
+/*
+ * Set a parameter of mysql_db_stmt_exec(). Values are not copied, they must
+ * stay valid until the statement has run. A NULL str binds SQL NULL.
+ */
+extern void mysql_db_bind_str(MYSQL_BIND *bind, char *str);
+extern void mysql_db_bind_int64(MYSQL_BIND *bind, int64_t *val);
+extern void mysql_db_bind_uint64(MYSQL_BIND *bind, uint64_t *val);
+
 extern int mysql_db_create_table(mysql_conn_t *mysql_conn, char *table_name,
 				 storage_field_t *fields, char *ending);
 
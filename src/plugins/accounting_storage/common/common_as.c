@@ -822,6 +822,9 @@ extern int archive_run_script(slurmdb_archive_cond_t *arch_cond,
 	return SLURM_SUCCESS;
 }
 
+/* Serializes picking archive file names */
+static pthread_mutex_t local_file_lock = PTHREAD_MUTEX_INITIALIZER;
+
 static char *_make_archive_name(time_t period_start, time_t period_end,
 				char *cluster_name, char *arch_dir,
 				char *arch_type, uint32_t archive_period)
@@ -879,7 +882,6 @@ extern int archive_write_file(Buf buffer, char *cluster_name,
 	int fd = 0;
 	int rc = SLURM_SUCCESS;
 	char *new_file = NULL;
-	static pthread_mutex_t local_file_lock = PTHREAD_MUTEX_INITIALIZER;
 
 	xassert(buffer);
 
@@ -924,3 +926,46 @@ extern int archive_write_file(Buf buffer, char *cluster_name,
 
 	return rc;
 }
+
+extern int archive_open_file(char *cluster_name,
+			     time_t period_start, time_t period_end,
+			     char *arch_dir, char *arch_type,
+			     uint32_t archive_period, char **name)
+{
+	int fd;
+
+	slurm_mutex_lock(&local_file_lock);
+	*name = _make_archive_name(period_start, period_end,
+				   cluster_name, arch_dir,
+				   arch_type, archive_period);
+	debug("Storing %s archive for %s at %s",
+	      arch_type, cluster_name, *name);
+	if ((fd = open(*name, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC,
+		       0600)) < 0)
+		error("Can't save archive, create file %s error %m", *name);
+	slurm_mutex_unlock(&local_file_lock);
+
+	return fd;
+}
+
+extern int archive_write_buf(int fd, char *name, Buf buffer)
+{
+	char *data = get_buf_data(buffer);
+	uint32_t pos = 0, nwrite = get_buf_offset(buffer);
+	ssize_t amount;
+
+	while (nwrite > 0) {
+		amount = write(fd, &data[pos], nwrite);
+		if (amount < 0) {
+			if (errno == EINTR)
+				continue;
+			error("Error writing file %s, %m", name);
+			return SLURM_ERROR;
+		}
+		nwrite -= amount;
+		pos += amount;
+	}
+	set_buf_offset(buffer, 0);
+
+	return SLURM_SUCCESS;
+}
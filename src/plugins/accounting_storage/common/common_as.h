@@ -85,4 +85,18 @@ extern int archive_write_file(Buf buffer, char *cluster_name,
 			      char *arch_dir, char *arch_type,
 			      uint32_t archive_period);
 
+/*
+ * Create a new archive file for records of period_start to period_end, for
+ * archives written a piece at a time with archive_write_buf().
+ * OUT name - name of the file, must be xfreed
+ * RET file descriptor or -1 on error
+ */
+extern int archive_open_file(char *cluster_name,
+			     time_t period_start, time_t period_end,
+			     char *arch_dir, char *arch_type,
+			     uint32_t archive_period, char **name);
+
+/* Append what is packed in buffer to an archive file and empty buffer */
+extern int archive_write_buf(int fd, char *name, Buf buffer);
+
 #endif
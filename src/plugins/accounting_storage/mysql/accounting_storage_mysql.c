@@ -2768,6 +2768,7 @@ extern int acct_storage_p_commit(mysql_conn_t *mysql_conn, bool commit)
 	 * understand that. CID 44841.
 	 */
 	xassert(mysql_conn);
+	rc = SLURM_SUCCESS;
 
 	debug4("got %d commits", list_count(mysql_conn->update_list));
 
@@ -2776,7 +2777,6 @@ extern int acct_storage_p_commit(mysql_conn_t *mysql_conn, bool commit)
 			if (mysql_db_rollback(mysql_conn))
 				error("rollback failed");
 		} else {
-			int rc = SLURM_SUCCESS;
 			/*
 			 * Handle anything here we were unable to do
 			 * because of rollback issues.
@@ -2793,14 +2793,16 @@ extern int acct_storage_p_commit(mysql_conn_t *mysql_conn, bool commit)
 			if (rc != SLURM_SUCCESS) {
 				if (mysql_db_rollback(mysql_conn))
 					error("rollback failed");
-			} else {
-				if (mysql_db_commit(mysql_conn))
-					error("commit failed");
+			} else if ((rc = mysql_db_commit(mysql_conn))) {
+				/* Deferred statements may have failed */
+				error("commit failed");
 			}
 		}
 	}
 
-	if (commit && list_count(mysql_conn->update_list)) {
+	/* Nothing to tell the clusters about if the changes are gone */
+	if (commit && (rc == SLURM_SUCCESS) &&
+	    list_count(mysql_conn->update_list)) {
 		char *query = NULL;
 		MYSQL_RES *result = NULL;
 		MYSQL_ROW row;
@@ -2860,7 +2862,7 @@ extern int acct_storage_p_commit(mysql_conn_t *mysql_conn, bool commit)
 	xfree(mysql_conn->pre_commit_query);
 	list_flush(mysql_conn->update_list);
 
-	return SLURM_SUCCESS;
+	return rc;
 }
 
 extern int acct_storage_p_add_users(mysql_conn_t *mysql_conn, uint32_t uid,
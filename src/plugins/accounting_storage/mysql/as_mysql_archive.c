@@ -45,6 +45,19 @@
 #include "src/common/env.h"
 #include "src/common/slurm_time.h"
 #include "src/common/slurmdbd_defs.h"
+#include "src/common/xhash.h"
+
+/*
+ * The format of archive files is versioned apart from the protocol version
+ * their records are packed with. It follows ARCHIVE_FORMAT_MAGIC after the
+ * protocol version in the header. Archives written before have the upper half
+ * of their pack_time() there, which is 0, and are ARCHIVE_FORMAT_PLAIN.
+ */
+#define ARCHIVE_FORMAT_MAGIC 0x534c4152	/* "SLAR" */
+#define ARCHIVE_FORMAT_PLAIN 0
+#define ARCHIVE_FORMAT_DICT  1		/* jobs and steps dictionary-encoded */
+/* Format of the archives written */
+#define ARCHIVE_FORMAT ARCHIVE_FORMAT_DICT
 
 #define SLURM_18_08_PROTOCOL_VERSION ((33 << 8) | 0)
 #define SLURM_17_11_PROTOCOL_VERSION ((32 << 8) | 0)
@@ -64,6 +77,7 @@
 
 #define MAX_PURGE_LIMIT 50000 /* Number of records that are purged at a time
 				 so that locks can be periodically released. */
+#define MAX_PURGE_DELETE 5000 /* Number of records deleted per transaction. */
 #define MAX_ARCHIVE_AGE (60 * 60 * 24 * 60) /* If archive data is older than
 					       this then archive by month to
 					       handle large datasets. */
@@ -806,13 +820,215 @@ typedef enum {
 	PURGE_CLUSTER_USAGE
 } purge_type_t;
 
+/* An archive file being written as the records are read from the database */
+typedef struct {
+	Buf buffer;		/* records not written to the file yet */
+	uint32_t cnt;		/* records packed */
+	uint32_t cnt_offset;	/* where the record count is in the file */
+	int fd;
+	char *name;
+	int rc;
+} archive_out_t;
+
 static uint32_t _archive_table(purge_type_t type, mysql_conn_t *mysql_conn,
-			       char *cluster_name, time_t period_end,
-			       char *arch_dir, uint32_t archive_period,
-			       char *sql_table, uint32_t usage_info);
+			       char *cluster_name, time_t period_start,
+			       time_t period_end, char *arch_dir,
+			       uint32_t archive_period, char *sql_table,
+			       uint32_t usage_info);
 
 static uint32_t high_buffer_size = (1024 * 1024);
 
+/* Pack the header of an archive, the record count is filled in at the end */
+static Buf _archive_out_begin(archive_out_t *out, uint16_t type,
+			      char *cluster_name)
+{
+	out->buffer = init_buf(high_buffer_size);
+	pack16(SLURM_PROTOCOL_VERSION, out->buffer);
+	pack32(ARCHIVE_FORMAT_MAGIC, out->buffer);
+	pack16(ARCHIVE_FORMAT, out->buffer);
+	pack_time(time(NULL), out->buffer);
+	pack16(type, out->buffer);
+	packstr(cluster_name, out->buffer);
+	out->cnt_offset = get_buf_offset(out->buffer);
+	pack32(0, out->buffer);
+
+	return out->buffer;
+}
+
+/* Account for a packed record, writing the buffer out once it is full */
+static void _archive_out_row(archive_out_t *out)
+{
+	out->cnt++;
+	if (get_buf_offset(out->buffer) < high_buffer_size)
+		return;
+	if (out->rc == SLURM_SUCCESS)
+		out->rc = archive_write_buf(out->fd, out->name, out->buffer);
+	set_buf_offset(out->buffer, 0);
+}
+
+/* Finish the archive file, or remove it on error or if discard is set */
+static int _archive_out_end(archive_out_t *out, bool discard)
+{
+	uint32_t cnt = htonl(out->cnt);
+
+	if (out->buffer && !discard && (out->rc == SLURM_SUCCESS))
+		out->rc = archive_write_buf(out->fd, out->name, out->buffer);
+	if (!discard && (out->rc == SLURM_SUCCESS) &&
+	    (pwrite(out->fd, &cnt, sizeof(cnt), out->cnt_offset) !=
+	     sizeof(cnt))) {
+		error("Error writing file %s, %m", out->name);
+		out->rc = SLURM_ERROR;
+	}
+	if (!discard && (out->rc == SLURM_SUCCESS) && fsync(out->fd)) {
+		error("Error syncing file %s, %m", out->name);
+		out->rc = SLURM_ERROR;
+	}
+	close(out->fd);
+	if (discard || (out->rc != SLURM_SUCCESS))
+		(void) unlink(out->name);
+
+	FREE_NULL_BUFFER(out->buffer);
+	xfree(out->name);
+
+	return out->rc;
+}
+
+/*
+ * From ARCHIVE_FORMAT_DICT on, the columns of jobs and steps that repeat a
+ * lot (accounts, users, partitions, TRES...) are dictionary-encoded in
+ * archive files. The first time a value shows up in a column it is packed
+ * after ARCHIVE_DICT_NEW and gets the next number of that column, later it
+ * is packed as that number.
+ * Both ends number the values the same way while streaming the records, so
+ * no dictionary is stored apart from the records.
+ */
+#define ARCHIVE_DICT_MAX 4096		/* values numbered per column */
+#define ARCHIVE_DICT_NEW (NO_VAL - 1)	/* a packed value follows */
+
+typedef struct {
+	char *value;
+	uint32_t inx;
+} archive_dict_ent_t;
+
+typedef struct {
+	int col_cnt;
+	uint32_t *cnt;		/* values numbered in each column */
+	xhash_t **hash;		/* packing, value to archive_dict_ent_t */
+	char ***values;		/* unpacking, number to value */
+} archive_dict_t;
+
+#define safe_unpack_dict_str(valp, col, dict, buf) do {			\
+		if (_unpack_dict_str(valp, col, dict, buf) != SLURM_SUCCESS) \
+			goto unpack_error;				\
+	} while (0)
+
+static void _dict_ent_hash_id(void *item, const char **key, uint32_t *key_len)
+{
+	archive_dict_ent_t *ent = item;
+
+	*key = ent->value;
+	*key_len = strlen(ent->value);
+}
+
+static void _dict_ent_free(void *item)
+{
+	archive_dict_ent_t *ent = item;
+
+	xfree(ent->value);
+	xfree(ent);
+}
+
+static archive_dict_t *_archive_dict_create(int col_cnt)
+{
+	archive_dict_t *dict = xmalloc(sizeof(*dict));
+
+	dict->col_cnt = col_cnt;
+	dict->cnt = xcalloc(col_cnt, sizeof(*dict->cnt));
+	dict->hash = xcalloc(col_cnt, sizeof(*dict->hash));
+	dict->values = xcalloc(col_cnt, sizeof(*dict->values));
+
+	return dict;
+}
+
+static void _archive_dict_destroy(archive_dict_t *dict)
+{
+	int col;
+	uint32_t i;
+
+	if (!dict)
+		return;
+
+	for (col = 0; col < dict->col_cnt; col++) {
+		xhash_free(dict->hash[col]);
+		if (dict->values[col]) {
+			for (i = 0; i < dict->cnt[col]; i++)
+				xfree(dict->values[col][i]);
+			xfree(dict->values[col]);
+		}
+	}
+	xfree(dict->cnt);
+	xfree(dict->hash);
+	xfree(dict->values);
+	xfree(dict);
+}
+
+static void _pack_dict_str(char *value, int col, archive_dict_t *dict,
+			   Buf buffer)
+{
+	archive_dict_ent_t *ent;
+
+	if (!value) {
+		pack32(NO_VAL, buffer);
+		return;
+	}
+
+	if (!dict->hash[col])
+		dict->hash[col] = xhash_init(_dict_ent_hash_id,
+					     _dict_ent_free);
+	else if ((ent = xhash_get(dict->hash[col], value, strlen(value)))) {
+		pack32(ent->inx, buffer);
+		return;
+	}
+
+	pack32(ARCHIVE_DICT_NEW, buffer);
+	packstr(value, buffer);
+	if (dict->cnt[col] < ARCHIVE_DICT_MAX) {
+		ent = xmalloc(sizeof(*ent));
+		ent->value = xstrdup(value);
+		ent->inx = dict->cnt[col]++;
+		xhash_add(dict->hash[col], ent);
+	}
+}
+
+static int _unpack_dict_str(char **value, int col, archive_dict_t *dict,
+			    Buf buffer)
+{
+	uint32_t inx, tmp32;
+
+	*value = NULL;
+	safe_unpack32(&inx, buffer);
+	if (inx == NO_VAL)
+		return SLURM_SUCCESS;
+	if (inx != ARCHIVE_DICT_NEW) {
+		if (inx >= dict->cnt[col])
+			goto unpack_error;
+		*value = xstrdup(dict->values[col][inx]);
+		return SLURM_SUCCESS;
+	}
+
+	safe_unpackstr_xmalloc(value, &tmp32, buffer);
+	if (*value && (dict->cnt[col] < ARCHIVE_DICT_MAX)) {
+		if (!dict->values[col])
+			dict->values[col] = xcalloc(ARCHIVE_DICT_MAX,
+						    sizeof(char *));
+		dict->values[col][dict->cnt[col]++] = xstrdup(*value);
+	}
+	return SLURM_SUCCESS;
+
+unpack_error:
+	return SLURM_ERROR;
+}
+
 static void _pack_local_event(local_event_t *object,
 			      uint16_t rpc_version, Buf buffer)
 {
@@ -863,66 +1079,147 @@ unpack_error:
 	return SLURM_ERROR;
 }
 
-static void _pack_local_job(local_job_t *object,
+static void _pack_local_job(local_job_t *object, archive_dict_t *dict,
 			    uint16_t rpc_version, Buf buffer)
 {
-	packstr(object->account, buffer);
-	packstr(object->admin_comment, buffer);
-	packstr(object->alloc_nodes, buffer);
-	packstr(object->associd, buffer);
-	packstr(object->array_jobid, buffer);
-	packstr(object->array_max_tasks, buffer);
-	packstr(object->array_taskid, buffer);
-	packstr(object->array_task_pending, buffer);
-	packstr(object->array_task_str, buffer);
-	packstr(object->blockid, buffer);
-	packstr(object->constraints, buffer);
-	packstr(object->deleted, buffer);
-	packstr(object->derived_ec, buffer);
-	packstr(object->derived_es, buffer);
-	packstr(object->exit_code, buffer);
-	packstr(object->flags, buffer);
-	packstr(object->timelimit, buffer);
-	packstr(object->eligible, buffer);
-	packstr(object->end, buffer);
-	packstr(object->gid, buffer);
-	packstr(object->gres_alloc, buffer);
-	packstr(object->gres_req, buffer);
-	packstr(object->gres_used, buffer);
-	packstr(object->job_db_inx, buffer);
-	packstr(object->jobid, buffer);
-	packstr(object->kill_requid, buffer);
-	packstr(object->mcs_label, buffer);
-	packstr(object->mod_time, buffer);
-	packstr(object->name, buffer);
-	packstr(object->nodelist, buffer);
-	packstr(object->node_inx, buffer);
-	packstr(object->het_job_id, buffer);
-	packstr(object->het_job_offset, buffer);
-	packstr(object->partition, buffer);
-	packstr(object->priority, buffer);
-	packstr(object->qos, buffer);
-	packstr(object->req_cpus, buffer);
-	packstr(object->req_mem, buffer);
-	packstr(object->resvid, buffer);
-	packstr(object->start, buffer);
-	packstr(object->state, buffer);
-	packstr(object->state_reason_prev, buffer);
-	packstr(object->submit, buffer);
-	packstr(object->suspended, buffer);
-	packstr(object->system_comment, buffer);
-	packstr(object->track_steps, buffer);
-	packstr(object->tres_alloc_str, buffer);
-	packstr(object->tres_req_str, buffer);
-	packstr(object->uid, buffer);
-	packstr(object->wckey, buffer);
-	packstr(object->wckey_id, buffer);
-	packstr(object->work_dir, buffer);
+	if (rpc_version >= SLURM_20_11_PROTOCOL_VERSION) {
+		_pack_dict_str(object->account, JOB_REQ_ACCOUNT, dict, buffer);
+		_pack_dict_str(object->admin_comment, JOB_REQ_ADMIN_COMMENT,
+			       dict, buffer);
+		_pack_dict_str(object->alloc_nodes, JOB_REQ_ALLOC_NODES,
+			       dict, buffer);
+		_pack_dict_str(object->associd, JOB_REQ_ASSOCID, dict, buffer);
+		packstr(object->array_jobid, buffer);
+		_pack_dict_str(object->array_max_tasks, JOB_REQ_ARRAY_MAX,
+			       dict, buffer);
+		packstr(object->array_taskid, buffer);
+		_pack_dict_str(object->array_task_pending,
+			       JOB_REQ_ARRAY_TASK_PENDING, dict, buffer);
+		packstr(object->array_task_str, buffer);
+		_pack_dict_str(object->blockid, JOB_REQ_BLOCKID, dict, buffer);
+		_pack_dict_str(object->constraints, JOB_REQ_CONSTRAINTS,
+			       dict, buffer);
+		_pack_dict_str(object->deleted, JOB_REQ_DELETED, dict, buffer);
+		_pack_dict_str(object->derived_ec, JOB_REQ_DERIVED_EC,
+			       dict, buffer);
+		_pack_dict_str(object->derived_es, JOB_REQ_DERIVED_ES,
+			       dict, buffer);
+		_pack_dict_str(object->exit_code, JOB_REQ_EXIT_CODE,
+			       dict, buffer);
+		_pack_dict_str(object->flags, JOB_REQ_FLAGS, dict, buffer);
+		_pack_dict_str(object->timelimit, JOB_REQ_TIMELIMIT,
+			       dict, buffer);
+		packstr(object->eligible, buffer);
+		packstr(object->end, buffer);
+		_pack_dict_str(object->gid, JOB_REQ_GID, dict, buffer);
+		_pack_dict_str(object->gres_alloc, JOB_REQ_GRES_ALLOC,
+			       dict, buffer);
+		_pack_dict_str(object->gres_req, JOB_REQ_GRES_REQ,
+			       dict, buffer);
+		_pack_dict_str(object->gres_used, JOB_REQ_GRES_USED,
+			       dict, buffer);
+		packstr(object->job_db_inx, buffer);
+		packstr(object->jobid, buffer);
+		_pack_dict_str(object->kill_requid, JOB_REQ_KILL_REQUID,
+			       dict, buffer);
+		_pack_dict_str(object->mcs_label, JOB_REQ_MCS_LABEL,
+			       dict, buffer);
+		packstr(object->mod_time, buffer);
+		_pack_dict_str(object->name, JOB_REQ_NAME, dict, buffer);
+		_pack_dict_str(object->nodelist, JOB_REQ_NODELIST,
+			       dict, buffer);
+		_pack_dict_str(object->node_inx, JOB_REQ_NODE_INX,
+			       dict, buffer);
+		packstr(object->het_job_id, buffer);
+		_pack_dict_str(object->het_job_offset, JOB_REQ_HET_JOB_OFFSET,
+			       dict, buffer);
+		_pack_dict_str(object->partition, JOB_REQ_PARTITION,
+			       dict, buffer);
+		_pack_dict_str(object->priority, JOB_REQ_PRIORITY,
+			       dict, buffer);
+		_pack_dict_str(object->qos, JOB_REQ_QOS, dict, buffer);
+		_pack_dict_str(object->req_cpus, JOB_REQ_REQ_CPUS,
+			       dict, buffer);
+		_pack_dict_str(object->req_mem, JOB_REQ_REQ_MEM, dict, buffer);
+		_pack_dict_str(object->resvid, JOB_REQ_RESVID, dict, buffer);
+		packstr(object->start, buffer);
+		_pack_dict_str(object->state, JOB_REQ_STATE, dict, buffer);
+		_pack_dict_str(object->state_reason_prev, JOB_REQ_STATE_REASON,
+			       dict, buffer);
+		packstr(object->submit, buffer);
+		packstr(object->suspended, buffer);
+		_pack_dict_str(object->system_comment, JOB_REQ_SYSTEM_COMMENT,
+			       dict, buffer);
+		_pack_dict_str(object->track_steps, JOB_REQ_TRACKSTEPS,
+			       dict, buffer);
+		_pack_dict_str(object->tres_alloc_str, JOB_REQ_TRESA,
+			       dict, buffer);
+		_pack_dict_str(object->tres_req_str, JOB_REQ_TRESR,
+			       dict, buffer);
+		_pack_dict_str(object->uid, JOB_REQ_UID, dict, buffer);
+		_pack_dict_str(object->wckey, JOB_REQ_WCKEY, dict, buffer);
+		_pack_dict_str(object->wckey_id, JOB_REQ_WCKEYID, dict, buffer);
+		_pack_dict_str(object->work_dir, JOB_REQ_WORK_DIR,
+			       dict, buffer);
+	} else {
+		packstr(object->account, buffer);
+		packstr(object->admin_comment, buffer);
+		packstr(object->alloc_nodes, buffer);
+		packstr(object->associd, buffer);
+		packstr(object->array_jobid, buffer);
+		packstr(object->array_max_tasks, buffer);
+		packstr(object->array_taskid, buffer);
+		packstr(object->array_task_pending, buffer);
+		packstr(object->array_task_str, buffer);
+		packstr(object->blockid, buffer);
+		packstr(object->constraints, buffer);
+		packstr(object->deleted, buffer);
+		packstr(object->derived_ec, buffer);
+		packstr(object->derived_es, buffer);
+		packstr(object->exit_code, buffer);
+		packstr(object->flags, buffer);
+		packstr(object->timelimit, buffer);
+		packstr(object->eligible, buffer);
+		packstr(object->end, buffer);
+		packstr(object->gid, buffer);
+		packstr(object->gres_alloc, buffer);
+		packstr(object->gres_req, buffer);
+		packstr(object->gres_used, buffer);
+		packstr(object->job_db_inx, buffer);
+		packstr(object->jobid, buffer);
+		packstr(object->kill_requid, buffer);
+		packstr(object->mcs_label, buffer);
+		packstr(object->mod_time, buffer);
+		packstr(object->name, buffer);
+		packstr(object->nodelist, buffer);
+		packstr(object->node_inx, buffer);
+		packstr(object->het_job_id, buffer);
+		packstr(object->het_job_offset, buffer);
+		packstr(object->partition, buffer);
+		packstr(object->priority, buffer);
+		packstr(object->qos, buffer);
+		packstr(object->req_cpus, buffer);
+		packstr(object->req_mem, buffer);
+		packstr(object->resvid, buffer);
+		packstr(object->start, buffer);
+		packstr(object->state, buffer);
+		packstr(object->state_reason_prev, buffer);
+		packstr(object->submit, buffer);
+		packstr(object->suspended, buffer);
+		packstr(object->system_comment, buffer);
+		packstr(object->track_steps, buffer);
+		packstr(object->tres_alloc_str, buffer);
+		packstr(object->tres_req_str, buffer);
+		packstr(object->uid, buffer);
+		packstr(object->wckey, buffer);
+		packstr(object->wckey_id, buffer);
+		packstr(object->work_dir, buffer);
+	}
 }
 
 /* this needs to be allocated before calling, and since we aren't
  * doing any copying it needs to be used before destroying buffer */
-static int _unpack_local_job(local_job_t *object,
+static int _unpack_local_job(local_job_t *object, archive_dict_t *dict,
 			     uint16_t rpc_version, Buf buffer)
 {
 	uint32_t tmp32;
@@ -949,7 +1246,96 @@ static int _unpack_local_job(local_job_t *object,
 	 * and it unpacks in the expected order.
 	 */
 
-	if (rpc_version >= SLURM_20_02_PROTOCOL_VERSION) {
+	if (dict) {
+		safe_unpack_dict_str(&object->account, JOB_REQ_ACCOUNT,
+				     dict, buffer);
+		safe_unpack_dict_str(&object->admin_comment,
+				     JOB_REQ_ADMIN_COMMENT, dict, buffer);
+		safe_unpack_dict_str(&object->alloc_nodes, JOB_REQ_ALLOC_NODES,
+				     dict, buffer);
+		safe_unpack_dict_str(&object->associd, JOB_REQ_ASSOCID,
+				     dict, buffer);
+		safe_unpackstr_xmalloc(&object->array_jobid, &tmp32, buffer);
+		safe_unpack_dict_str(&object->array_max_tasks,
+				     JOB_REQ_ARRAY_MAX, dict, buffer);
+		safe_unpackstr_xmalloc(&object->array_taskid, &tmp32, buffer);
+		safe_unpack_dict_str(&object->array_task_pending,
+				     JOB_REQ_ARRAY_TASK_PENDING, dict, buffer);
+		safe_unpackstr_xmalloc(&object->array_task_str, &tmp32, buffer);
+		safe_unpack_dict_str(&object->blockid, JOB_REQ_BLOCKID,
+				     dict, buffer);
+		safe_unpack_dict_str(&object->constraints, JOB_REQ_CONSTRAINTS,
+				     dict, buffer);
+		safe_unpack_dict_str(&object->deleted, JOB_REQ_DELETED,
+				     dict, buffer);
+		safe_unpack_dict_str(&object->derived_ec, JOB_REQ_DERIVED_EC,
+				     dict, buffer);
+		safe_unpack_dict_str(&object->derived_es, JOB_REQ_DERIVED_ES,
+				     dict, buffer);
+		safe_unpack_dict_str(&object->exit_code, JOB_REQ_EXIT_CODE,
+				     dict, buffer);
+		safe_unpack_dict_str(&object->flags, JOB_REQ_FLAGS,
+				     dict, buffer);
+		safe_unpack_dict_str(&object->timelimit, JOB_REQ_TIMELIMIT,
+				     dict, buffer);
+		safe_unpackstr_xmalloc(&object->eligible, &tmp32, buffer);
+		safe_unpackstr_xmalloc(&object->end, &tmp32, buffer);
+		safe_unpack_dict_str(&object->gid, JOB_REQ_GID, dict, buffer);
+		safe_unpack_dict_str(&object->gres_alloc, JOB_REQ_GRES_ALLOC,
+				     dict, buffer);
+		safe_unpack_dict_str(&object->gres_req, JOB_REQ_GRES_REQ,
+				     dict, buffer);
+		safe_unpack_dict_str(&object->gres_used, JOB_REQ_GRES_USED,
+				     dict, buffer);
+		safe_unpackstr_xmalloc(&object->job_db_inx, &tmp32, buffer);
+		safe_unpackstr_xmalloc(&object->jobid, &tmp32, buffer);
+		safe_unpack_dict_str(&object->kill_requid, JOB_REQ_KILL_REQUID,
+				     dict, buffer);
+		safe_unpack_dict_str(&object->mcs_label, JOB_REQ_MCS_LABEL,
+				     dict, buffer);
+		safe_unpackstr_xmalloc(&object->mod_time, &tmp32, buffer);
+		safe_unpack_dict_str(&object->name, JOB_REQ_NAME, dict, buffer);
+		safe_unpack_dict_str(&object->nodelist, JOB_REQ_NODELIST,
+				     dict, buffer);
+		safe_unpack_dict_str(&object->node_inx, JOB_REQ_NODE_INX,
+				     dict, buffer);
+		safe_unpackstr_xmalloc(&object->het_job_id, &tmp32, buffer);
+		safe_unpack_dict_str(&object->het_job_offset,
+				     JOB_REQ_HET_JOB_OFFSET, dict, buffer);
+		safe_unpack_dict_str(&object->partition, JOB_REQ_PARTITION,
+				     dict, buffer);
+		safe_unpack_dict_str(&object->priority, JOB_REQ_PRIORITY,
+				     dict, buffer);
+		safe_unpack_dict_str(&object->qos, JOB_REQ_QOS, dict, buffer);
+		safe_unpack_dict_str(&object->req_cpus, JOB_REQ_REQ_CPUS,
+				     dict, buffer);
+		safe_unpack_dict_str(&object->req_mem, JOB_REQ_REQ_MEM,
+				     dict, buffer);
+		safe_unpack_dict_str(&object->resvid, JOB_REQ_RESVID,
+				     dict, buffer);
+		safe_unpackstr_xmalloc(&object->start, &tmp32, buffer);
+		safe_unpack_dict_str(&object->state, JOB_REQ_STATE,
+				     dict, buffer);
+		safe_unpack_dict_str(&object->state_reason_prev,
+				     JOB_REQ_STATE_REASON, dict, buffer);
+		safe_unpackstr_xmalloc(&object->submit, &tmp32, buffer);
+		safe_unpackstr_xmalloc(&object->suspended, &tmp32, buffer);
+		safe_unpack_dict_str(&object->system_comment,
+				     JOB_REQ_SYSTEM_COMMENT, dict, buffer);
+		safe_unpack_dict_str(&object->track_steps, JOB_REQ_TRACKSTEPS,
+				     dict, buffer);
+		safe_unpack_dict_str(&object->tres_alloc_str, JOB_REQ_TRESA,
+				     dict, buffer);
+		safe_unpack_dict_str(&object->tres_req_str, JOB_REQ_TRESR,
+				     dict, buffer);
+		safe_unpack_dict_str(&object->uid, JOB_REQ_UID, dict, buffer);
+		safe_unpack_dict_str(&object->wckey, JOB_REQ_WCKEY,
+				     dict, buffer);
+		safe_unpack_dict_str(&object->wckey_id, JOB_REQ_WCKEYID,
+				     dict, buffer);
+		safe_unpack_dict_str(&object->work_dir, JOB_REQ_WORK_DIR,
+				     dict, buffer);
+	} else if (rpc_version >= SLURM_20_02_PROTOCOL_VERSION) {
 		safe_unpackstr_xmalloc(&object->account, &tmp32, buffer);
 		safe_unpackstr_xmalloc(&object->admin_comment, &tmp32, buffer);
 		safe_unpackstr_xmalloc(&object->alloc_nodes, &tmp32, buffer);
@@ -1500,62 +1886,204 @@ unpack_error:
 	return SLURM_ERROR;
 }
 
-static void _pack_local_step(local_step_t *object,
+static void _pack_local_step(local_step_t *object, archive_dict_t *dict,
 			     uint16_t rpc_version, Buf buffer)
 {
-	packstr(object->act_cpufreq, buffer);
-	packstr(object->deleted, buffer);
-	packstr(object->exit_code, buffer);
-	packstr(object->consumed_energy, buffer);
-	packstr(object->job_db_inx, buffer);
-	packstr(object->kill_requid, buffer);
-	packstr(object->name, buffer);
-	packstr(object->nodelist, buffer);
-	packstr(object->nodes, buffer);
-	packstr(object->node_inx, buffer);
-	packstr(object->period_end, buffer);
-	packstr(object->period_start, buffer);
-	packstr(object->period_suspended, buffer);
-	packstr(object->req_cpufreq_min, buffer);
-	packstr(object->req_cpufreq_max, buffer);
-	packstr(object->req_cpufreq_gov, buffer);
-	packstr(object->state, buffer);
-	packstr(object->stepid, buffer);
-	packstr(object->step_het_comp, buffer);
-	packstr(object->sys_sec, buffer);
-	packstr(object->sys_usec, buffer);
-	packstr(object->tasks, buffer);
-	packstr(object->task_dist, buffer);
-	packstr(object->tres_alloc_str, buffer);
-	packstr(object->tres_usage_in_ave, buffer);
-	packstr(object->tres_usage_in_max, buffer);
-	packstr(object->tres_usage_in_max_nodeid, buffer);
-	packstr(object->tres_usage_in_max_taskid, buffer);
-	packstr(object->tres_usage_in_min, buffer);
-	packstr(object->tres_usage_in_min_nodeid, buffer);
-	packstr(object->tres_usage_in_min_taskid, buffer);
-	packstr(object->tres_usage_in_tot, buffer);
-	packstr(object->tres_usage_out_ave, buffer);
-	packstr(object->tres_usage_out_max, buffer);
-	packstr(object->tres_usage_out_max_nodeid, buffer);
-	packstr(object->tres_usage_out_max_taskid, buffer);
-	packstr(object->tres_usage_out_min, buffer);
-	packstr(object->tres_usage_out_min_nodeid, buffer);
-	packstr(object->tres_usage_out_min_taskid, buffer);
-	packstr(object->tres_usage_out_tot, buffer);
-	packstr(object->user_sec, buffer);
-	packstr(object->user_usec, buffer);
+	if (rpc_version >= SLURM_20_11_PROTOCOL_VERSION) {
+		_pack_dict_str(object->act_cpufreq, STEP_REQ_ACT_CPUFREQ,
+			       dict, buffer);
+		_pack_dict_str(object->deleted, STEP_REQ_DELETED, dict, buffer);
+		_pack_dict_str(object->exit_code, STEP_REQ_EXIT_CODE,
+			       dict, buffer);
+		packstr(object->consumed_energy, buffer);
+		packstr(object->job_db_inx, buffer);
+		_pack_dict_str(object->kill_requid, STEP_REQ_KILL_REQUID,
+			       dict, buffer);
+		_pack_dict_str(object->name, STEP_REQ_NAME, dict, buffer);
+		_pack_dict_str(object->nodelist, STEP_REQ_NODELIST,
+			       dict, buffer);
+		_pack_dict_str(object->nodes, STEP_REQ_NODES, dict, buffer);
+		_pack_dict_str(object->node_inx, STEP_REQ_NODE_INX,
+			       dict, buffer);
+		packstr(object->period_end, buffer);
+		packstr(object->period_start, buffer);
+		packstr(object->period_suspended, buffer);
+		_pack_dict_str(object->req_cpufreq_min,
+			       STEP_REQ_REQ_CPUFREQ_MIN, dict, buffer);
+		_pack_dict_str(object->req_cpufreq_max,
+			       STEP_REQ_REQ_CPUFREQ_MAX, dict, buffer);
+		_pack_dict_str(object->req_cpufreq_gov,
+			       STEP_REQ_REQ_CPUFREQ_GOV, dict, buffer);
+		_pack_dict_str(object->state, STEP_REQ_STATE, dict, buffer);
+		_pack_dict_str(object->stepid, STEP_REQ_STEPID, dict, buffer);
+		_pack_dict_str(object->step_het_comp, STEP_REQ_STEP_HET_COMP,
+			       dict, buffer);
+		packstr(object->sys_sec, buffer);
+		packstr(object->sys_usec, buffer);
+		_pack_dict_str(object->tasks, STEP_REQ_TASKS, dict, buffer);
+		_pack_dict_str(object->task_dist, STEP_REQ_TASKDIST,
+			       dict, buffer);
+		_pack_dict_str(object->tres_alloc_str, STEP_REQ_TRES,
+			       dict, buffer);
+		packstr(object->tres_usage_in_ave, buffer);
+		packstr(object->tres_usage_in_max, buffer);
+		_pack_dict_str(object->tres_usage_in_max_nodeid,
+			       STEP_TRES_USAGE_IN_MAX_NODEID, dict, buffer);
+		_pack_dict_str(object->tres_usage_in_max_taskid,
+			       STEP_TRES_USAGE_IN_MAX_TASKID, dict, buffer);
+		packstr(object->tres_usage_in_min, buffer);
+		_pack_dict_str(object->tres_usage_in_min_nodeid,
+			       STEP_TRES_USAGE_IN_MIN_NODEID, dict, buffer);
+		_pack_dict_str(object->tres_usage_in_min_taskid,
+			       STEP_TRES_USAGE_IN_MIN_TASKID, dict, buffer);
+		packstr(object->tres_usage_in_tot, buffer);
+		packstr(object->tres_usage_out_ave, buffer);
+		packstr(object->tres_usage_out_max, buffer);
+		_pack_dict_str(object->tres_usage_out_max_nodeid,
+			       STEP_TRES_USAGE_OUT_MAX_NODEID, dict, buffer);
+		_pack_dict_str(object->tres_usage_out_max_taskid,
+			       STEP_TRES_USAGE_OUT_MAX_TASKID, dict, buffer);
+		packstr(object->tres_usage_out_min, buffer);
+		_pack_dict_str(object->tres_usage_out_min_nodeid,
+			       STEP_TRES_USAGE_OUT_MIN_NODEID, dict, buffer);
+		_pack_dict_str(object->tres_usage_out_min_taskid,
+			       STEP_TRES_USAGE_OUT_MIN_TASKID, dict, buffer);
+		packstr(object->tres_usage_out_tot, buffer);
+		packstr(object->user_sec, buffer);
+		packstr(object->user_usec, buffer);
+	} else {
+		packstr(object->act_cpufreq, buffer);
+		packstr(object->deleted, buffer);
+		packstr(object->exit_code, buffer);
+		packstr(object->consumed_energy, buffer);
+		packstr(object->job_db_inx, buffer);
+		packstr(object->kill_requid, buffer);
+		packstr(object->name, buffer);
+		packstr(object->nodelist, buffer);
+		packstr(object->nodes, buffer);
+		packstr(object->node_inx, buffer);
+		packstr(object->period_end, buffer);
+		packstr(object->period_start, buffer);
+		packstr(object->period_suspended, buffer);
+		packstr(object->req_cpufreq_min, buffer);
+		packstr(object->req_cpufreq_max, buffer);
+		packstr(object->req_cpufreq_gov, buffer);
+		packstr(object->state, buffer);
+		packstr(object->stepid, buffer);
+		packstr(object->step_het_comp, buffer);
+		packstr(object->sys_sec, buffer);
+		packstr(object->sys_usec, buffer);
+		packstr(object->tasks, buffer);
+		packstr(object->task_dist, buffer);
+		packstr(object->tres_alloc_str, buffer);
+		packstr(object->tres_usage_in_ave, buffer);
+		packstr(object->tres_usage_in_max, buffer);
+		packstr(object->tres_usage_in_max_nodeid, buffer);
+		packstr(object->tres_usage_in_max_taskid, buffer);
+		packstr(object->tres_usage_in_min, buffer);
+		packstr(object->tres_usage_in_min_nodeid, buffer);
+		packstr(object->tres_usage_in_min_taskid, buffer);
+		packstr(object->tres_usage_in_tot, buffer);
+		packstr(object->tres_usage_out_ave, buffer);
+		packstr(object->tres_usage_out_max, buffer);
+		packstr(object->tres_usage_out_max_nodeid, buffer);
+		packstr(object->tres_usage_out_max_taskid, buffer);
+		packstr(object->tres_usage_out_min, buffer);
+		packstr(object->tres_usage_out_min_nodeid, buffer);
+		packstr(object->tres_usage_out_min_taskid, buffer);
+		packstr(object->tres_usage_out_tot, buffer);
+		packstr(object->user_sec, buffer);
+		packstr(object->user_usec, buffer);
+	}
 }
 
 /* this needs to be allocated before calling, and since we aren't
  * doing any copying it needs to be used before destroying buffer */
-static int _unpack_local_step(local_step_t *object,
+static int _unpack_local_step(local_step_t *object, archive_dict_t *dict,
 			      uint16_t rpc_version, Buf buffer)
 {
 	uint32_t tmp32;
 	char *tmp_char;
 
-	if (rpc_version >= SLURM_20_11_PROTOCOL_VERSION) {
+	if (dict) {
+		safe_unpack_dict_str(&object->act_cpufreq, STEP_REQ_ACT_CPUFREQ,
+				     dict, buffer);
+		safe_unpack_dict_str(&object->deleted, STEP_REQ_DELETED,
+				     dict, buffer);
+		safe_unpack_dict_str(&object->exit_code, STEP_REQ_EXIT_CODE,
+				     dict, buffer);
+		safe_unpackstr_xmalloc(&object->consumed_energy,
+				       &tmp32, buffer);
+		safe_unpackstr_xmalloc(&object->job_db_inx, &tmp32, buffer);
+		safe_unpack_dict_str(&object->kill_requid, STEP_REQ_KILL_REQUID,
+				     dict, buffer);
+		safe_unpack_dict_str(&object->name, STEP_REQ_NAME,
+				     dict, buffer);
+		safe_unpack_dict_str(&object->nodelist, STEP_REQ_NODELIST,
+				     dict, buffer);
+		safe_unpack_dict_str(&object->nodes, STEP_REQ_NODES,
+				     dict, buffer);
+		safe_unpack_dict_str(&object->node_inx, STEP_REQ_NODE_INX,
+				     dict, buffer);
+		safe_unpackstr_xmalloc(&object->period_end, &tmp32, buffer);
+		safe_unpackstr_xmalloc(&object->period_start, &tmp32, buffer);
+		safe_unpackstr_xmalloc(&object->period_suspended,
+				       &tmp32, buffer);
+		safe_unpack_dict_str(&object->req_cpufreq_min,
+				     STEP_REQ_REQ_CPUFREQ_MIN, dict, buffer);
+		safe_unpack_dict_str(&object->req_cpufreq_max,
+				     STEP_REQ_REQ_CPUFREQ_MAX, dict, buffer);
+		safe_unpack_dict_str(&object->req_cpufreq_gov,
+				     STEP_REQ_REQ_CPUFREQ_GOV, dict, buffer);
+		safe_unpack_dict_str(&object->state, STEP_REQ_STATE,
+				     dict, buffer);
+		safe_unpack_dict_str(&object->stepid, STEP_REQ_STEPID,
+				     dict, buffer);
+		safe_unpack_dict_str(&object->step_het_comp,
+				     STEP_REQ_STEP_HET_COMP, dict, buffer);
+		safe_unpackstr_xmalloc(&object->sys_sec, &tmp32, buffer);
+		safe_unpackstr_xmalloc(&object->sys_usec, &tmp32, buffer);
+		safe_unpack_dict_str(&object->tasks, STEP_REQ_TASKS,
+				     dict, buffer);
+		safe_unpack_dict_str(&object->task_dist, STEP_REQ_TASKDIST,
+				     dict, buffer);
+		safe_unpack_dict_str(&object->tres_alloc_str, STEP_REQ_TRES,
+				     dict, buffer);
+		safe_unpackstr_xmalloc(&object->tres_usage_in_ave,
+				       &tmp32, buffer);
+		safe_unpackstr_xmalloc(&object->tres_usage_in_max,
+				       &tmp32, buffer);
+		safe_unpack_dict_str(&object->tres_usage_in_max_nodeid,
+				     STEP_TRES_USAGE_IN_MAX_NODEID, dict, buffer);
+		safe_unpack_dict_str(&object->tres_usage_in_max_taskid,
+				     STEP_TRES_USAGE_IN_MAX_TASKID, dict, buffer);
+		safe_unpackstr_xmalloc(&object->tres_usage_in_min,
+				       &tmp32, buffer);
+		safe_unpack_dict_str(&object->tres_usage_in_min_nodeid,
+				     STEP_TRES_USAGE_IN_MIN_NODEID, dict, buffer);
+		safe_unpack_dict_str(&object->tres_usage_in_min_taskid,
+				     STEP_TRES_USAGE_IN_MIN_TASKID, dict, buffer);
+		safe_unpackstr_xmalloc(&object->tres_usage_in_tot,
+				       &tmp32, buffer);
+		safe_unpackstr_xmalloc(&object->tres_usage_out_ave,
+				       &tmp32, buffer);
+		safe_unpackstr_xmalloc(&object->tres_usage_out_max,
+				       &tmp32, buffer);
+		safe_unpack_dict_str(&object->tres_usage_out_max_nodeid,
+				     STEP_TRES_USAGE_OUT_MAX_NODEID, dict, buffer);
+		safe_unpack_dict_str(&object->tres_usage_out_max_taskid,
+				     STEP_TRES_USAGE_OUT_MAX_TASKID, dict, buffer);
+		safe_unpackstr_xmalloc(&object->tres_usage_out_min,
+				       &tmp32, buffer);
+		safe_unpack_dict_str(&object->tres_usage_out_min_nodeid,
+				     STEP_TRES_USAGE_OUT_MIN_NODEID, dict, buffer);
+		safe_unpack_dict_str(&object->tres_usage_out_min_taskid,
+				     STEP_TRES_USAGE_OUT_MIN_TASKID, dict, buffer);
+		safe_unpackstr_xmalloc(&object->tres_usage_out_tot,
+				       &tmp32, buffer);
+		safe_unpackstr_xmalloc(&object->user_sec, &tmp32, buffer);
+		safe_unpackstr_xmalloc(&object->user_usec, &tmp32, buffer);
+	} else if (rpc_version >= SLURM_20_11_PROTOCOL_VERSION) {
 		safe_unpackstr_xmalloc(&object->act_cpufreq, &tmp32, buffer);
 		safe_unpackstr_xmalloc(&object->deleted, &tmp32, buffer);
 		safe_unpackstr_xmalloc(&object->exit_code, &tmp32, buffer);
@@ -2820,25 +3348,16 @@ static char *_get_archive_columns(purge_type_t type)
 }
 
 
-static Buf _pack_archive_events(MYSQL_RES *result, char *cluster_name,
-				uint32_t cnt, uint32_t usage_info,
-				time_t *period_start)
+static void _pack_archive_events(MYSQL_RES *result, char *cluster_name,
+				 uint32_t usage_info, archive_out_t *out)
 {
 	MYSQL_ROW row;
 	Buf buffer;
 	local_event_t event;
 
-	buffer = init_buf(high_buffer_size);
-	pack16(SLURM_PROTOCOL_VERSION, buffer);
-	pack_time(time(NULL), buffer);
-	pack16(DBD_GOT_EVENTS, buffer);
-	packstr(cluster_name, buffer);
-	pack32(cnt, buffer);
+	buffer = _archive_out_begin(out, DBD_GOT_EVENTS, cluster_name);
 
 	while ((row = mysql_fetch_row(result))) {
-		if (period_start && !*period_start)
-			*period_start = slurm_atoul(row[EVENT_REQ_START]);
-
 		memset(&event, 0, sizeof(local_event_t));
 
 		event.cluster_nodes = row[EVENT_REQ_CNODES];
@@ -2851,9 +3370,8 @@ static Buf _pack_archive_events(MYSQL_RES *result, char *cluster_name,
 		event.tres_str = row[EVENT_REQ_TRES];
 
 		_pack_local_event(&event, SLURM_PROTOCOL_VERSION, buffer);
+		_archive_out_row(out);
 	}
-
-	return buffer;
 }
 
 /* returns sql statement from archived data or NULL on error */
@@ -2908,25 +3426,17 @@ _load_events(uint16_t rpc_version, Buf buffer, char *cluster_name,
 	return insert;
 }
 
-static Buf _pack_archive_jobs(MYSQL_RES *result, char *cluster_name,
-			      uint32_t cnt, uint32_t usage_info,
-			      time_t *period_start)
+static void _pack_archive_jobs(MYSQL_RES *result, char *cluster_name,
+			       uint32_t usage_info, archive_out_t *out)
 {
 	MYSQL_ROW row;
 	Buf buffer;
 	local_job_t job;
+	archive_dict_t *dict = _archive_dict_create(JOB_REQ_COUNT);
 
-	buffer = init_buf(high_buffer_size);
-	pack16(SLURM_PROTOCOL_VERSION, buffer);
-	pack_time(time(NULL), buffer);
-	pack16(DBD_GOT_JOBS, buffer);
-	packstr(cluster_name, buffer);
-	pack32(cnt, buffer);
+	buffer = _archive_out_begin(out, DBD_GOT_JOBS, cluster_name);
 
 	while ((row = mysql_fetch_row(result))) {
-		if (period_start && !*period_start)
-			*period_start = slurm_atoul(row[JOB_REQ_SUBMIT]);
-
 		memset(&job, 0, sizeof(local_job_t));
 
 		job.account = row[JOB_REQ_ACCOUNT];
@@ -2982,15 +3492,15 @@ static Buf _pack_archive_jobs(MYSQL_RES *result, char *cluster_name,
 		job.wckey_id = row[JOB_REQ_WCKEYID];
 		job.work_dir = row[JOB_REQ_WORK_DIR];
 
-		_pack_local_job(&job, SLURM_PROTOCOL_VERSION, buffer);
+		_pack_local_job(&job, dict, SLURM_PROTOCOL_VERSION, buffer);
+		_archive_out_row(out);
 	}
-
-	return buffer;
+	_archive_dict_destroy(dict);
 }
 
 /* returns sql statement from archived data or NULL on error */
-static char *_load_jobs(uint16_t rpc_version, Buf buffer,
-			char *cluster_name, uint32_t rec_cnt)
+static char *_load_jobs(uint16_t rpc_version, uint16_t arch_format,
+			Buf buffer, char *cluster_name, uint32_t rec_cnt)
 {
 	char *insert = NULL, *format = NULL;
 	int safe_attributes[] = {
@@ -3054,6 +3564,10 @@ static char *_load_jobs(uint16_t rpc_version, Buf buffer,
 
 	local_job_t object;
 	int i = 0;
+	archive_dict_t *dict = NULL;
+
+	if (arch_format >= ARCHIVE_FORMAT_DICT)
+		dict = _archive_dict_create(JOB_REQ_COUNT);
 
 	xstrfmtcat(insert, "insert into \"%s_%s\" (%s",
 		   cluster_name, job_table,job_req_inx[safe_attributes[0]]);
@@ -3066,7 +3580,7 @@ static char *_load_jobs(uint16_t rpc_version, Buf buffer,
 
 	for (i = 0; i < rec_cnt; i++) {
 
-		if (_unpack_local_job(&object, rpc_version, buffer)
+		if (_unpack_local_job(&object, dict, rpc_version, buffer)
 		    != SLURM_SUCCESS) {
 			error("issue unpacking");
 			xfree(insert);
@@ -3192,31 +3706,23 @@ static char *_load_jobs(uint16_t rpc_version, Buf buffer,
 		_free_local_job_members(&object);
 		xfree(format);
 	}
+	_archive_dict_destroy(dict);
 //	END_TIMER2("step query");
 //	info("job query took %s", TIME_STR);
 
 	return insert;
 }
 
-static Buf _pack_archive_resvs(MYSQL_RES *result, char *cluster_name,
-			       uint32_t cnt, uint32_t usage_info,
-			       time_t *period_start)
+static void _pack_archive_resvs(MYSQL_RES *result, char *cluster_name,
+				uint32_t usage_info, archive_out_t *out)
 {
 	MYSQL_ROW row;
 	Buf buffer;
 	local_resv_t resv;
 
-	buffer = init_buf(high_buffer_size);
-	pack16(SLURM_PROTOCOL_VERSION, buffer);
-	pack_time(time(NULL), buffer);
-	pack16(DBD_GOT_RESVS, buffer);
-	packstr(cluster_name, buffer);
-	pack32(cnt, buffer);
+	buffer = _archive_out_begin(out, DBD_GOT_RESVS, cluster_name);
 
 	while ((row = mysql_fetch_row(result))) {
-		if (period_start && !*period_start)
-			*period_start = slurm_atoul(row[RESV_REQ_START]);
-
 		memset(&resv, 0, sizeof(local_resv_t));
 
 		resv.assocs = row[RESV_REQ_ASSOCS];
@@ -3232,9 +3738,8 @@ static Buf _pack_archive_resvs(MYSQL_RES *result, char *cluster_name,
 		resv.unused_wall = row[RESV_REQ_UNUSED];
 
 		_pack_local_resv(&resv, SLURM_PROTOCOL_VERSION, buffer);
+		_archive_out_row(out);
 	}
-
-	return buffer;
 }
 
 /* returns sql statement from archived data or NULL on error */
@@ -3289,25 +3794,17 @@ static char *_load_resvs(uint16_t rpc_version, Buf buffer,
 	return insert;
 }
 
-static Buf _pack_archive_steps(MYSQL_RES *result, char *cluster_name,
-			       uint32_t cnt, uint32_t usage_info,
-			       time_t *period_start)
+static void _pack_archive_steps(MYSQL_RES *result, char *cluster_name,
+				uint32_t usage_info, archive_out_t *out)
 {
 	MYSQL_ROW row;
 	Buf buffer;
 	local_step_t step;
+	archive_dict_t *dict = _archive_dict_create(STEP_REQ_COUNT);
 
-	buffer = init_buf(high_buffer_size);
-	pack16(SLURM_PROTOCOL_VERSION, buffer);
-	pack_time(time(NULL), buffer);
-	pack16(DBD_STEP_START, buffer);
-	packstr(cluster_name, buffer);
-	pack32(cnt, buffer);
+	buffer = _archive_out_begin(out, DBD_STEP_START, cluster_name);
 
 	while ((row = mysql_fetch_row(result))) {
-		if (period_start && !*period_start)
-			*period_start = slurm_atoul(row[STEP_REQ_START]);
-
 		memset(&step, 0, sizeof(local_step_t));
 
 		step.act_cpufreq = row[STEP_REQ_ACT_CPUFREQ];
@@ -3361,19 +3858,23 @@ static Buf _pack_archive_steps(MYSQL_RES *result, char *cluster_name,
 		step.user_sec = row[STEP_REQ_USER_SEC];
 		step.user_usec = row[STEP_REQ_USER_USEC];
 
-		_pack_local_step(&step, SLURM_PROTOCOL_VERSION, buffer);
+		_pack_local_step(&step, dict, SLURM_PROTOCOL_VERSION, buffer);
+		_archive_out_row(out);
 	}
-
-	return buffer;
+	_archive_dict_destroy(dict);
 }
 
 /* returns sql statement from archived data or NULL on error */
-static char *_load_steps(uint16_t rpc_version, Buf buffer,
-			 char *cluster_name, uint32_t rec_cnt)
+static char *_load_steps(uint16_t rpc_version, uint16_t arch_format,
+			 Buf buffer, char *cluster_name, uint32_t rec_cnt)
 {
 	char *insert = NULL, *format = NULL;
 	local_step_t object;
 	int i;
+	archive_dict_t *dict = NULL;
+
+	if (arch_format >= ARCHIVE_FORMAT_DICT)
+		dict = _archive_dict_create(STEP_REQ_COUNT);
 
 	xstrfmtcat(insert, "insert into \"%s_%s\" (%s",
 		   cluster_name, step_table, step_req_inx[0]);
@@ -3386,7 +3887,7 @@ static char *_load_steps(uint16_t rpc_version, Buf buffer,
 	xstrcat(format, ")");
 	for (i=0; i<rec_cnt; i++) {
 		memset(&object, 0, sizeof(local_step_t));
-		if (_unpack_local_step(&object, rpc_version, buffer)
+		if (_unpack_local_step(&object, dict, rpc_version, buffer)
 		    != SLURM_SUCCESS) {
 			error("issue unpacking");
 			xfree(format);
@@ -3446,6 +3947,7 @@ static char *_load_steps(uint16_t rpc_version, Buf buffer,
 
 		_free_local_step_members(&object);
 	}
+	_archive_dict_destroy(dict);
 //	END_TIMER2("step query");
 //	info("step query took %s", TIME_STR);
 	xfree(format);
@@ -3453,25 +3955,16 @@ static char *_load_steps(uint16_t rpc_version, Buf buffer,
 	return insert;
 }
 
-static Buf _pack_archive_suspends(MYSQL_RES *result, char *cluster_name,
-				  uint32_t cnt, uint32_t usage_info,
-				  time_t *period_start)
+static void _pack_archive_suspends(MYSQL_RES *result, char *cluster_name,
+				   uint32_t usage_info, archive_out_t *out)
 {
 	MYSQL_ROW row;
 	Buf buffer;
 	local_suspend_t suspend;
 
-	buffer = init_buf(high_buffer_size);
-	pack16(SLURM_PROTOCOL_VERSION, buffer);
-	pack_time(time(NULL), buffer);
-	pack16(DBD_JOB_SUSPEND, buffer);
-	packstr(cluster_name, buffer);
-	pack32(cnt, buffer);
+	buffer = _archive_out_begin(out, DBD_JOB_SUSPEND, cluster_name);
 
 	while ((row = mysql_fetch_row(result))) {
-		if (period_start && !*period_start)
-			*period_start = slurm_atoul(row[SUSPEND_REQ_START]);
-
 		memset(&suspend, 0, sizeof(local_suspend_t));
 
 		suspend.job_db_inx = row[SUSPEND_REQ_DB_INX];
@@ -3480,9 +3973,8 @@ static Buf _pack_archive_suspends(MYSQL_RES *result, char *cluster_name,
 		suspend.period_end = row[SUSPEND_REQ_END];
 
 		_pack_local_suspend(&suspend, SLURM_PROTOCOL_VERSION, buffer);
+		_archive_out_row(out);
 	}
-
-	return buffer;
 }
 
 
@@ -3531,25 +4023,16 @@ static char *_load_suspend(uint16_t rpc_version, Buf buffer,
 	return insert;
 }
 
-static Buf _pack_archive_txns(MYSQL_RES *result, char *cluster_name,
-			      uint32_t cnt, uint32_t usage_info,
-			      time_t *period_start)
+static void _pack_archive_txns(MYSQL_RES *result, char *cluster_name,
+			       uint32_t usage_info, archive_out_t *out)
 {
 	MYSQL_ROW row;
 	Buf buffer;
 	local_txn_t txn;
 
-	buffer = init_buf(high_buffer_size);
-	pack16(SLURM_PROTOCOL_VERSION, buffer);
-	pack_time(time(NULL), buffer);
-	pack16(DBD_GOT_TXN, buffer);
-	packstr(cluster_name, buffer);
-	pack32(cnt, buffer);
+	buffer = _archive_out_begin(out, DBD_GOT_TXN, cluster_name);
 
 	while ((row = mysql_fetch_row(result))) {
-		if (period_start && !*period_start)
-			*period_start = slurm_atoul(row[TXN_REQ_TS]);
-
 		memset(&txn, 0, sizeof(local_txn_t));
 
 		txn.id = row[TXN_REQ_ID];
@@ -3561,9 +4044,8 @@ static Buf _pack_archive_txns(MYSQL_RES *result, char *cluster_name,
 		txn.cluster = row[TXN_REQ_CLUSTER];
 
 		_pack_local_txn(&txn, SLURM_PROTOCOL_VERSION, buffer);
+		_archive_out_row(out);
 	}
-
-	return buffer;
 }
 
 
@@ -3615,9 +4097,8 @@ static char *_load_txn(uint16_t rpc_version, Buf buffer,
 	return insert;
 }
 
-static Buf _pack_archive_usage(MYSQL_RES *result, char *cluster_name,
-			       uint32_t cnt, uint32_t usage_info,
-			       time_t *period_start)
+static void _pack_archive_usage(MYSQL_RES *result, char *cluster_name,
+				uint32_t usage_info, archive_out_t *out)
 {
 	MYSQL_ROW row;
 	Buf buffer;
@@ -3625,18 +4106,10 @@ static Buf _pack_archive_usage(MYSQL_RES *result, char *cluster_name,
 	uint16_t type = usage_info & 0x0000ffff;
 	uint16_t period = usage_info >> 16;
 
-	buffer = init_buf(high_buffer_size);
-	pack16(SLURM_PROTOCOL_VERSION, buffer);
-	pack_time(time(NULL), buffer);
-	pack16(type, buffer);
-	packstr(cluster_name, buffer);
-	pack32(cnt, buffer);
+	buffer = _archive_out_begin(out, type, cluster_name);
 	pack16(period, buffer);
 
 	while ((row = mysql_fetch_row(result))) {
-		if (period_start && !*period_start)
-			*period_start = slurm_atoul(row[USAGE_START]);
-
 		memset(&usage, 0, sizeof(local_usage_t));
 
 		usage.id = row[USAGE_ID];
@@ -3648,9 +4121,8 @@ static Buf _pack_archive_usage(MYSQL_RES *result, char *cluster_name,
 		usage.deleted = row[USAGE_DELETED];
 
 		_pack_local_usage(&usage, SLURM_PROTOCOL_VERSION, buffer);
+		_archive_out_row(out);
 	}
-
-	return buffer;
 }
 
 /* returns sql statement from archived data or NULL on error */
@@ -3743,27 +4215,18 @@ static char *_load_usage(uint16_t rpc_version, Buf buffer,
 	return insert;
 }
 
-static Buf _pack_archive_cluster_usage(MYSQL_RES *result, char *cluster_name,
-				       uint32_t cnt, uint32_t usage_info,
-				       time_t *period_start)
+static void _pack_archive_cluster_usage(MYSQL_RES *result, char *cluster_name,
+					uint32_t usage_info, archive_out_t *out)
 {
 	MYSQL_ROW row;
 	Buf buffer;
 	local_cluster_usage_t usage;
 	uint16_t period = usage_info >> 16;
 
-	buffer = init_buf(high_buffer_size);
-	pack16(SLURM_PROTOCOL_VERSION, buffer);
-	pack_time(time(NULL), buffer);
-	pack16(DBD_GOT_CLUSTER_USAGE, buffer);
-	packstr(cluster_name, buffer);
-	pack32(cnt, buffer);
+	buffer = _archive_out_begin(out, DBD_GOT_CLUSTER_USAGE, cluster_name);
 	pack16(period, buffer);
 
 	while ((row = mysql_fetch_row(result))) {
-		if (period_start && !*period_start)
-			*period_start = slurm_atoul(row[CLUSTER_START]);
-
 		memset(&usage, 0, sizeof(local_cluster_usage_t));
 
 		usage.tres_id = row[CLUSTER_TRES];
@@ -3781,9 +4244,8 @@ static Buf _pack_archive_cluster_usage(MYSQL_RES *result, char *cluster_name,
 
 		_pack_local_cluster_usage(
 			&usage, SLURM_PROTOCOL_VERSION, buffer);
+		_archive_out_row(out);
 	}
-
-	return buffer;
 }
 
 /* returns sql statement from archived data or NULL on error */
@@ -3857,20 +4319,24 @@ static char *_load_cluster_usage(uint16_t rpc_version, Buf buffer,
 }
 
 /* returns count of events archived or SLURM_ERROR on error */
+/*
+ * Archive the records up to period_end, the oldest of them being from
+ * period_start. The records are streamed from the database into the archive
+ * file, so the number of records only depends on how the caller bounds
+ * period_end.
+ * RET number of records archived or SLURM_ERROR
+ */
 static uint32_t _archive_table(purge_type_t type, mysql_conn_t *mysql_conn,
-			       char *cluster_name, time_t period_end,
-			       char *arch_dir, uint32_t archive_period,
-			       char *sql_table, uint32_t usage_info)
+			       char *cluster_name, time_t period_start,
+			       time_t period_end, char *arch_dir,
+			       uint32_t archive_period, char *sql_table,
+			       uint32_t usage_info)
 {
 	MYSQL_RES *result = NULL;
 	char *cols = NULL, *query = NULL;
-	time_t period_start = 0;
-	uint32_t cnt = 0;
-	Buf buffer;
-	int error_code = 0;
-	Buf (*pack_func)(MYSQL_RES *result, char *cluster_name,
-			 uint32_t cnt, uint32_t usage_info,
-			 time_t *period_start);
+	archive_out_t out;
+	void (*pack_func)(MYSQL_RES *result, char *cluster_name,
+			  uint32_t usage_info, archive_out_t *out);
 
 	cols = _get_archive_columns(type);
 
@@ -3908,63 +4374,66 @@ static uint32_t _archive_table(purge_type_t type, mysql_conn_t *mysql_conn,
 	case PURGE_TXN:
 		query = xstrdup_printf("select %s from \"%s\" where "
 				       "timestamp <= %ld && cluster='%s' "
-				       "order by timestamp asc LIMIT %d",
+				       "order by timestamp asc",
 				       cols, sql_table,
-				       period_end, cluster_name,
-				       MAX_PURGE_LIMIT);
+				       period_end, cluster_name);
 		break;
 	case PURGE_USAGE:
 	case PURGE_CLUSTER_USAGE:
 		query = xstrdup_printf("select %s from \"%s_%s\" where "
 				       "time_start <= %ld "
-				       "order by time_start asc LIMIT %d",
+				       "order by time_start asc",
 				       cols, cluster_name, sql_table,
-				       period_end, MAX_PURGE_LIMIT);
+				       period_end);
 		break;
 	case PURGE_JOB:
 		query = xstrdup_printf("select %s from \"%s_%s\" where "
 				       "time_submit <= %ld && time_end != 0 "
-				       "order by time_submit asc LIMIT %d",
+				       "order by time_submit asc",
 				       cols, cluster_name, job_table,
-				       period_end, MAX_PURGE_LIMIT);
+				       period_end);
 		break;
 	default:
 		query = xstrdup_printf("select %s from \"%s_%s\" where "
 				       "time_start <= %ld && time_end != 0 "
-				       "order by time_start asc LIMIT %d",
+				       "order by time_start asc",
 				       cols, cluster_name, sql_table,
-				       period_end, MAX_PURGE_LIMIT);
+				       period_end);
 		break;
 	}
 
 	xfree(cols);
 
+	memset(&out, 0, sizeof(out));
+	if ((out.fd = archive_open_file(cluster_name, period_start, period_end,
+					arch_dir, sql_table, archive_period,
+					&out.name)) < 0) {
+		xfree(out.name);
+		xfree(query);
+		return SLURM_ERROR;
+	}
+
 	DB_DEBUG(DB_ARCHIVE, mysql_conn->conn, "query\n%s", query);
-	if (!(result = mysql_db_query_ret(mysql_conn, query, 0))) {
+	if (!(result = mysql_db_query_stream(mysql_conn, query))) {
 		xfree(query);
+		_archive_out_end(&out, true);
 		return SLURM_ERROR;
 	}
 	xfree(query);
 
-	if (!(cnt = mysql_num_rows(result))) {
-		mysql_free_result(result);
-		return 0;
+	(*pack_func)(result, cluster_name, usage_info, &out);
+	if (mysql_errno(mysql_conn->db_conn)) {
+		error("%s: reading %s_%s failed: %d %s", __func__,
+		      cluster_name, sql_table, mysql_errno(mysql_conn->db_conn),
+		      mysql_error(mysql_conn->db_conn));
+		out.rc = SLURM_ERROR;
 	}
-
-	buffer = (*pack_func)(result, cluster_name, cnt, usage_info,
-			      &period_start);
 	mysql_free_result(result);
 
-	error_code = archive_write_file(buffer, cluster_name,
-					period_start, period_end,
-					arch_dir, sql_table,
-					archive_period);
-	free_buf(buffer);
-
-	if (error_code != SLURM_SUCCESS)
-		return error_code;
+	if (_archive_out_end(&out, !out.cnt) != SLURM_SUCCESS)
+		return SLURM_ERROR;
 
-	return cnt;
+	return out.cnt;
 }
 
 uint32_t _get_begin_next_month(time_t start)
@@ -3987,13 +4456,14 @@ uint32_t _get_begin_next_month(time_t start)
 	return slurm_mktime(&parts);
 }
 
-/* Get the oldest purge'able record.
+/* Get the time of the purge'able record at offset, 0 being the oldest one.
  * Returns SLURM_ERROR for mysql error, 0 no purge'able records found,
  * 1 found purgeable record.
  */
 static int _get_oldest_record(mysql_conn_t *mysql_conn, char *cluster,
 			      char *table, purge_type_t type, char *col_name,
-			      time_t period_end, time_t *record_start)
+			      time_t period_end, uint32_t offset,
+			      time_t *record_start)
 {
 	MYSQL_RES *result = NULL;
 	MYSQL_ROW row;
@@ -4007,24 +4477,24 @@ static int _get_oldest_record(mysql_conn_t *mysql_conn, char *cluster,
 	case PURGE_TXN:
 		query = xstrdup_printf(
 			"select %s from \"%s\" where %s <= %ld "
-			"&& cluster='%s' order by %s asc LIMIT 1",
+			"&& cluster='%s' order by %s asc LIMIT %u, 1",
 			col_name, table, col_name, period_end, cluster,
-			col_name);
+			col_name, offset);
 		break;
 	case PURGE_USAGE:
 	case PURGE_CLUSTER_USAGE:
 		query = xstrdup_printf(
 			"select %s from \"%s_%s\" where %s <= %ld "
-			"order by %s asc LIMIT 1",
+			"order by %s asc LIMIT %u, 1",
 			col_name, cluster, table, col_name, period_end,
-			col_name);
+			col_name, offset);
 		break;
 	default:
 		query = xstrdup_printf(
 			"select %s from \"%s_%s\" where %s <= %ld "
-			"&& time_end != 0 order by %s asc LIMIT 1",
+			"&& time_end != 0 order by %s asc LIMIT %u, 1",
 			col_name, cluster, table, col_name, period_end,
-			col_name);
+			col_name, offset);
 		break;
 	}
 
@@ -4059,9 +4529,12 @@ static int _archive_purge_table(purge_type_t purge_type, uint32_t usage_info,
 	uint16_t type, period;
 	time_t   last_submit = time(NULL);
 	time_t   curr_end    = 0, tmp_end = 0, record_start = 0;
+	time_t   chunk_end   = 0;
 	char    *query = NULL, *sql_table = NULL,
 		*col_name = NULL;
 	uint32_t tmp_archive_period;
+	uint64_t archived = 0, purged = 0;
+	int      deleted;
 
 	switch (purge_type) {
 	case PURGE_EVENT:
@@ -4178,7 +4651,7 @@ static int _archive_purge_table(purge_type_t purge_type, uint32_t usage_info,
 	while (1) {
 		rc = _get_oldest_record(mysql_conn, cluster_name, sql_table,
 					purge_type, col_name,
-					curr_end, &record_start);
+					curr_end, 0, &record_start);
 		if (!rc) /* no purgeable records found - base case */
 			break;
 		else if (rc == SLURM_ERROR)
@@ -4194,13 +4667,28 @@ static int _archive_purge_table(purge_type_t purge_type, uint32_t usage_info,
 		} else
 			tmp_end = curr_end;
 
+		/*
+		 * Bound the chunk by the time of its MAX_PURGE_LIMIT'th record
+		 * instead of a LIMIT, so the archive and the delete work on
+		 * exactly the same records (including those sharing the time
+		 * of the last one) and a chunk that was interrupted is simply
+		 * redone from the oldest record left.
+		 */
+		rc = _get_oldest_record(mysql_conn, cluster_name, sql_table,
+					purge_type, col_name, tmp_end,
+					MAX_PURGE_LIMIT - 1, &chunk_end);
+		if (rc == SLURM_ERROR)
+			return rc;
+		else if (rc)
+			tmp_end = chunk_end;
+
 		log_flag(DB_ARCHIVE, "Purging %s_%s before %ld",
 			 cluster_name, sql_table, tmp_end);
 
 		/* Do archive */
 		if (SLURMDB_PURGE_ARCHIVE_SET(purge_attr)) {
 			rc = _archive_table(purge_type, mysql_conn,
-					    cluster_name, tmp_end,
+					    cluster_name, record_start, tmp_end,
 					    arch_cond->archive_dir,
 					    tmp_archive_period,
 					    sql_table, usage_info);
@@ -4210,67 +4698,67 @@ static int _archive_purge_table(purge_type_t purge_type, uint32_t usage_info,
 				return SLURM_ERROR;
 			} else if (rc == SLURM_ERROR)
 				return rc;
+			archived += rc;
 		}
 
 		/*
 		 * The purge query should have the same where clause as the
-		 * archive query. The order by is very important so we get
-		 * records in the same order as we do when archiving, since we
-		 * only want to delete records that have been archived (if
-		 * archiving is enabled).
+		 * archive query, since we only want to delete records that
+		 * have been archived (if archiving is enabled).
 		 */
 		switch (purge_type) {
 		case PURGE_TXN:
 			query = xstrdup_printf(
 				"delete from \"%s\" where "
-				"%s <= %ld && cluster='%s' order by %s asc LIMIT %d",
+				"%s <= %ld && cluster='%s' LIMIT %d",
 				sql_table, col_name, tmp_end, cluster_name,
-				col_name, MAX_PURGE_LIMIT);
+				MAX_PURGE_DELETE);
 			break;
 		case PURGE_USAGE:
 		case PURGE_CLUSTER_USAGE:
 			query = xstrdup_printf(
 				"delete from \"%s_%s\" where "
-				"%s <= %ld order by %s asc LIMIT %d",
+				"%s <= %ld LIMIT %d",
 				cluster_name, sql_table, col_name,
-				tmp_end, col_name, MAX_PURGE_LIMIT);
+				tmp_end, MAX_PURGE_DELETE);
 			break;
 		default:
 			query = xstrdup_printf(
 				"delete from \"%s_%s\" where "
-				"%s <= %ld && time_end != 0 order by %s asc LIMIT %d",
+				"%s <= %ld && time_end != 0 LIMIT %d",
 				cluster_name, sql_table, col_name,
-				tmp_end, col_name, MAX_PURGE_LIMIT);
+				tmp_end, MAX_PURGE_DELETE);
 			break;
 		}
 		DB_DEBUG(DB_ARCHIVE, mysql_conn->conn, "query\n%s", query);
 
 		/*
-		 * Don't loop this query, just do it once, since we are only
-		 * archiving and purging MAX_PURGE_LIMIT rows at a time.
-		 * mysql_db_delete_affected_rows will return < 0 on failure or
-		 * 0 if no records are affected.
+		 * Delete the chunk MAX_PURGE_DELETE rows at a time, committing
+		 * each time so no transaction (and the locks it holds) gets
+		 * big. mysql_db_delete_affected_rows will return < 0 on
+		 * failure or 0 if no records are affected.
 		 */
-		if ((rc = mysql_db_delete_affected_rows(
-				mysql_conn, query)) > 0) {
-			/* Commit here every time since this could create a huge
-			 * transaction.
-			 */
-			if ((rc = mysql_db_commit(mysql_conn)))
+		do {
+			if ((deleted = mysql_db_delete_affected_rows(
+				     mysql_conn, query)) < 0)
+				break;
+			purged += deleted;
+			if (deleted && mysql_db_commit(mysql_conn)) {
 				error("Couldn't commit cluster (%s) purge",
 				      cluster_name);
-		}
+				deleted = -1;
+			}
+		} while (deleted == MAX_PURGE_DELETE);
 
 		xfree(query);
-		if (rc != SLURM_SUCCESS) {
+		if (deleted < 0) {
 			error("Couldn't remove old data from %s table",
 			      sql_table);
 			return SLURM_ERROR;
-		} else if (mysql_db_commit(mysql_conn)) {
-			error("Couldn't commit cluster (%s) purge",
-			      cluster_name);
-			break;
 		}
+
+		log_flag(DB_ARCHIVE, "%s_%s: %"PRIu64" records archived and %"PRIu64" purged so far, up to %ld",
+			 cluster_name, sql_table, archived, purged, tmp_end);
 	}
 
 	return SLURM_SUCCESS;
@@ -4407,7 +4895,8 @@ extern int as_mysql_jobacct_process_archive_load(
 	int error_code = SLURM_SUCCESS;
 	Buf buffer = NULL;
 	time_t buf_time;
-	uint16_t type = 0, ver = 0, period = 0;
+	uint16_t type = 0, ver = 0, arch_format = ARCHIVE_FORMAT_PLAIN;
+	uint16_t period = 0;
 	uint32_t data_size = 0, rec_cnt = 0, tmp32 = 0;
 	uint32_t rec_cnt_total = 0, rec_cnt_left = 0, pass_cnt = 0;
 
@@ -4502,6 +4991,21 @@ extern int as_mysql_jobacct_process_archive_load(
 		FREE_NULL_BUFFER(buffer);
 		return EFAULT;
 	}
+	safe_unpack32(&tmp32, buffer);
+	if (tmp32 == ARCHIVE_FORMAT_MAGIC)
+		safe_unpack16(&arch_format, buffer);
+	else	/* no format, this was the time */
+		set_buf_offset(buffer, get_buf_offset(buffer) - sizeof(tmp32));
+	DB_DEBUG(DB_ARCHIVE, mysql_conn->conn,
+	         "Format in archive header is %u", arch_format);
+	if (arch_format > ARCHIVE_FORMAT) {
+		error("***********************************************");
+		error("Can not recover archive file, incompatible format, "
+		      "got %u need <= %u", arch_format, ARCHIVE_FORMAT);
+		error("***********************************************");
+		FREE_NULL_BUFFER(buffer);
+		return EFAULT;
+	}
 	safe_unpack_time(&buf_time, buffer);
 	safe_unpack16(&type, buffer);
 	safe_unpackstr_xmalloc(&cluster_name, &tmp32, buffer);
@@ -4530,13 +5034,15 @@ pass:
 		data = _load_events(ver, buffer, cluster_name, rec_cnt);
 		break;
 	case DBD_GOT_JOBS:
-		data = _load_jobs(ver, buffer, cluster_name, rec_cnt);
+		data = _load_jobs(ver, arch_format, buffer, cluster_name,
+				  rec_cnt);
 		break;
 	case DBD_GOT_RESVS:
 		data = _load_resvs(ver, buffer, cluster_name, rec_cnt);
 		break;
 	case DBD_STEP_START:
-		data = _load_steps(ver, buffer, cluster_name, rec_cnt);
+		data = _load_steps(ver, arch_format, buffer, cluster_name,
+				   rec_cnt);
 		break;
 	case DBD_JOB_SUSPEND:
 		data = _load_suspend(ver, buffer, cluster_name, rec_cnt);
@@ -1364,6 +1364,31 @@ empty:
 	return ret_list;
 }
 
+/* End the open event of a node, as a prepared statement */
+static int _end_node_event(mysql_conn_t *mysql_conn, node_record_t *node_ptr,
+			   time_t event_time)
+{
+	char *query;
+	MYSQL_BIND params[2];
+	int64_t time_end = event_time;
+	int rc;
+
+	query = xstrdup_printf(
+		"update \"%s_%s\" set time_end=? where "
+		"time_end=0 and node_name=?;",
+		mysql_conn->cluster_name, event_table);
+
+	mysql_db_bind_int64(&params[0], &time_end);
+	mysql_db_bind_str(&params[1], node_ptr->name);
+
+	DB_DEBUG(DB_EVENT, mysql_conn->conn, "query\n%s\nfor node %s",
+		 query, node_ptr->name);
+	rc = mysql_db_stmt_exec(mysql_conn, query, params, 2);
+	xfree(query);
+
+	return rc;
+}
+
 extern int as_mysql_node_down(mysql_conn_t *mysql_conn,
 			      node_record_t *node_ptr,
 			      time_t event_time, char *reason,
@@ -1374,6 +1399,9 @@ extern int as_mysql_node_down(mysql_conn_t *mysql_conn,
 	char *my_reason;
 	MYSQL_RES *result = NULL;
 	MYSQL_ROW row;
+	MYSQL_BIND params[6];
+	uint64_t state, uid;
+	int64_t time_start;
 
 	if (check_connection(mysql_conn) != SLURM_SUCCESS)
 		return ESLURM_DB_CONNECTION;
@@ -1454,21 +1482,30 @@ extern int as_mysql_node_down(mysql_conn_t *mysql_conn,
 	         "inserting %s(%s) with tres of '%s'",
 		 node_ptr->name, mysql_conn->cluster_name, node_ptr->tres_str);
 
+	if ((rc = _end_node_event(mysql_conn, node_ptr, event_time))
+	    != SLURM_SUCCESS)
+		return rc;
+
 	query = xstrdup_printf(
-		"update \"%s_%s\" set time_end=%ld where "
-		"time_end=0 and node_name='%s';",
-		mysql_conn->cluster_name, event_table,
-		event_time, node_ptr->name);
-	xstrfmtcat(query,
-		   "insert into \"%s_%s\" "
-		   "(node_name, state, tres, time_start, "
-		   "reason, reason_uid) "
-		   "values ('%s', %u, '%s', %ld, '%s', %u);",
-		   mysql_conn->cluster_name, event_table,
-		   node_ptr->name, node_ptr->node_state,
-		   node_ptr->tres_str, event_time, my_reason, reason_uid);
-	DB_DEBUG(DB_EVENT, mysql_conn->conn, "query\n%s", query);
-	rc = mysql_db_query(mysql_conn, query);
+		"insert into \"%s_%s\" "
+		"(node_name, state, tres, time_start, reason, reason_uid) "
+		"values (?, ?, ?, ?, ?, ?);",
+		mysql_conn->cluster_name, event_table);
+
+	state = node_ptr->node_state;
+	time_start = event_time;
+	uid = reason_uid;
+
+	mysql_db_bind_str(&params[0], node_ptr->name);
+	mysql_db_bind_uint64(&params[1], &state);
+	mysql_db_bind_str(&params[2], node_ptr->tres_str);
+	mysql_db_bind_int64(&params[3], &time_start);
+	mysql_db_bind_str(&params[4], my_reason);
+	mysql_db_bind_uint64(&params[5], &uid);
+
+	DB_DEBUG(DB_EVENT, mysql_conn->conn, "query\n%s\nfor node %s",
+		 query, node_ptr->name);
+	rc = mysql_db_stmt_exec(mysql_conn, query, params, 6);
 	xfree(query);
 
 	return rc;
@@ -1478,9 +1515,6 @@ extern int as_mysql_node_up(mysql_conn_t *mysql_conn,
 			    node_record_t *node_ptr,
 			    time_t event_time)
 {
-	char* query;
-	int rc = SLURM_SUCCESS;
-
 	if (check_connection(mysql_conn) != SLURM_SUCCESS)
 		return ESLURM_DB_CONNECTION;
 
@@ -1489,15 +1523,7 @@ extern int as_mysql_node_up(mysql_conn_t *mysql_conn,
 		return SLURM_ERROR;
 	}
 
-	query = xstrdup_printf(
-		"update \"%s_%s\" set time_end=%ld where "
-		"time_end=0 and node_name='%s';",
-		mysql_conn->cluster_name, event_table,
-		event_time, node_ptr->name);
-	DB_DEBUG(DB_EVENT, mysql_conn->conn, "query\n%s", query);
-	rc = mysql_db_query(mysql_conn, query);
-	xfree(query);
-	return rc;
+	return _end_node_event(mysql_conn, node_ptr, event_time);
 }
 
 /* This function is not used in the slurmdbd. */
@@ -57,6 +57,17 @@ typedef struct {
 	uint32_t old;
 } id_switch_t;
 
+/* Refers to the row only through VALUES() so step rows can be merged */
+static char *step_start_update =
+	"on duplicate key update "
+	"nodes_alloc=VALUES(nodes_alloc), task_cnt=VALUES(task_cnt), "
+	"time_end=0, state=VALUES(state), nodelist=VALUES(nodelist), "
+	"node_inx=VALUES(node_inx), task_dist=VALUES(task_dist), "
+	"req_cpufreq=VALUES(req_cpufreq), "
+	"req_cpufreq_min=VALUES(req_cpufreq_min), "
+	"req_cpufreq_gov=VALUES(req_cpufreq_gov), "
+	"tres_alloc=VALUES(tres_alloc)";
+
 static int _find_id_switch(void *x, void *key)
 {
 	id_switch_t *id_switch = (id_switch_t *)x;
@@ -985,6 +996,9 @@ extern int as_mysql_job_complete(mysql_conn_t *mysql_conn,
 	time_t submit_time, end_time;
 	uint32_t exit_code = 0;
 	char *tres_alloc_str = NULL;
+	MYSQL_BIND params[10];
+	int64_t time_end, state, exit_code_val, kill_requid;
+	uint64_t derived_ec;
 
 	if (!job_ptr->db_index
 	    && ((!job_ptr->details || !job_ptr->details->submit_time)
@@ -1075,35 +1089,6 @@ extern int as_mysql_job_complete(mysql_conn_t *mysql_conn,
 		}
 	}
 
-	/*
-	 * make sure we handle any quotes that may be in the comment
-	 */
-
-	query = xstrdup_printf("update \"%s_%s\" set "
-			       "mod_time=UNIX_TIMESTAMP(), "
-			       "time_end=%ld, state=%d",
-			       mysql_conn->cluster_name, job_table,
-			       end_time, job_state);
-
-	if (job_ptr->derived_ec != NO_VAL)
-		xstrfmtcat(query, ", derived_ec=%u", job_ptr->derived_ec);
-
-	if (tres_alloc_str)
-		xstrfmtcat(query, ", tres_alloc='%s'", tres_alloc_str);
-	else if (job_ptr->tres_alloc_str)
-		xstrfmtcat(query, ", tres_alloc='%s'", job_ptr->tres_alloc_str);
-
-	if (job_ptr->comment)
-		xstrfmtcat(query, ", derived_es='%s'", job_ptr->comment);
-
-	if (job_ptr->admin_comment)
-		xstrfmtcat(query, ", admin_comment='%s'",
-			   job_ptr->admin_comment);
-
-	if (job_ptr->system_comment)
-		xstrfmtcat(query, ", system_comment='%s'",
-			   job_ptr->system_comment);
-
 	exit_code = job_ptr->exit_code;
 	if (exit_code == 1) {
 		/* This wasn't signaled, it was set by Slurm so don't
@@ -1112,13 +1097,48 @@ extern int as_mysql_job_complete(mysql_conn_t *mysql_conn,
 		exit_code = 256;
 	}
 
-	xstrfmtcat(query,
-		   ", exit_code=%d, kill_requid=%d where job_db_inx=%"PRIu64";",
-		   exit_code, job_ptr->requid,
-		   job_ptr->db_index);
-
-	DB_DEBUG(DB_JOB, mysql_conn->conn, "query\n%s", query);
-	rc = mysql_db_query(mysql_conn, query);
+	/*
+	 * This runs for every job, so it is a prepared statement. A NULL
+	 * parameter keeps the value the column already has. Binding the
+	 * comments also takes care of any quotes in them.
+	 */
+	query = xstrdup_printf("update \"%s_%s\" set "
+			       "mod_time=UNIX_TIMESTAMP(), "
+			       "time_end=?, state=?, "
+			       "derived_ec=IFNULL(?, derived_ec), "
+			       "tres_alloc=IFNULL(?, tres_alloc), "
+			       "derived_es=IFNULL(?, derived_es), "
+			       "admin_comment=IFNULL(?, admin_comment), "
+			       "system_comment=IFNULL(?, system_comment), "
+			       "exit_code=?, kill_requid=? "
+			       "where job_db_inx=?;",
+			       mysql_conn->cluster_name, job_table);
+
+	time_end = end_time;
+	state = job_state;
+	derived_ec = job_ptr->derived_ec;
+	exit_code_val = (int32_t) exit_code;
+	kill_requid = (int32_t) job_ptr->requid;
+
+	mysql_db_bind_int64(&params[0], &time_end);
+	mysql_db_bind_int64(&params[1], &state);
+	if (job_ptr->derived_ec != NO_VAL)
+		mysql_db_bind_uint64(&params[2], &derived_ec);
+	else
+		mysql_db_bind_str(&params[2], NULL);
+	mysql_db_bind_str(&params[3], tres_alloc_str ?
+			  tres_alloc_str : job_ptr->tres_alloc_str);
+	mysql_db_bind_str(&params[4], job_ptr->comment);
+	mysql_db_bind_str(&params[5], job_ptr->admin_comment);
+	mysql_db_bind_str(&params[6], job_ptr->system_comment);
+	mysql_db_bind_int64(&params[7], &exit_code_val);
+	mysql_db_bind_int64(&params[8], &kill_requid);
+	mysql_db_bind_uint64(&params[9], &job_ptr->db_index);
+
+	DB_DEBUG(DB_JOB, mysql_conn->conn,
+		 "query\n%s\nfor job %u db_index %"PRIu64,
+		 query, job_ptr->job_id, job_ptr->db_index);
+	rc = mysql_db_stmt_exec(mysql_conn, query, params, 10);
 	xfree(query);
 
 	xfree(tres_alloc_str);
@@ -1134,7 +1154,7 @@ extern int as_mysql_step_start(mysql_conn_t *mysql_conn,
 	char node_list[BUFFER_SIZE];
 	char *node_inx = NULL;
 	time_t start_time, submit_time;
-	char *query = NULL;
+	char *query = NULL, *head = NULL, *values = NULL;
 
 	if (!step_ptr->job_ptr->db_index
 	    && ((!step_ptr->job_ptr->details
@@ -1241,19 +1261,16 @@ extern int as_mysql_step_start(mysql_conn_t *mysql_conn,
 	/* we want to print a -1 for the requid so leave it a
 	   %d */
 	/* The stepid could be negative so use %d not %u */
-	query = xstrdup_printf(
+	head = xstrdup_printf(
 		"insert into \"%s_%s\" (job_db_inx, id_step, step_het_comp, "
 		"time_start, step_name, state, tres_alloc, "
 		"nodes_alloc, task_cnt, nodelist, node_inx, "
 		"task_dist, req_cpufreq, req_cpufreq_min, req_cpufreq_gov) "
-		"values (%"PRIu64", %d, %u, %d, '%s', %d, '%s', %d, %d, "
-		"'%s', '%s', %d, %u, %u, %u) "
-		"on duplicate key update "
-		"nodes_alloc=%d, task_cnt=%d, time_end=0, state=%d, "
-		"nodelist='%s', node_inx='%s', task_dist=%d, "
-		"req_cpufreq=%u, req_cpufreq_min=%u, req_cpufreq_gov=%u,"
-		"tres_alloc='%s';",
-		mysql_conn->cluster_name, step_table,
+		"values ",
+		mysql_conn->cluster_name, step_table);
+	values = xstrdup_printf(
+		"(%"PRIu64", %d, %u, %d, '%s', %d, '%s', %d, %d, "
+		"'%s', '%s', %d, %u, %u, %u)",
 		step_ptr->job_ptr->db_index,
 		step_ptr->step_id.step_id,
 		step_ptr->step_id.step_het_comp,
@@ -1261,13 +1278,30 @@ extern int as_mysql_step_start(mysql_conn_t *mysql_conn,
 		JOB_RUNNING, step_ptr->tres_alloc_str,
 		nodes, tasks, node_list, node_inx, task_dist,
 		step_ptr->cpu_freq_max, step_ptr->cpu_freq_min,
-		step_ptr->cpu_freq_gov, nodes, tasks, JOB_RUNNING,
-		node_list, node_inx, task_dist, step_ptr->cpu_freq_max,
-		step_ptr->cpu_freq_min, step_ptr->cpu_freq_gov,
-		step_ptr->tres_alloc_str);
-	DB_DEBUG(DB_STEP, mysql_conn->conn, "query\n%s", query);
-	rc = mysql_db_query(mysql_conn, query);
-	xfree(query);
+		step_ptr->cpu_freq_gov);
+
+	/*
+	 * The slurmdbd commits after each message, or batch of messages, from
+	 * the slurmctld, so queue the row and let the steps started in the
+	 * same batch go to the database as one insert. A failed insert fails
+	 * that commit and the slurmctld sends the records again. With
+	 * CommitDelay the commit comes too late to report that.
+	 */
+	if (slurmdbd_conf && mysql_conn->rollback &&
+	    !slurmdbd_conf->commit_delay) {
+		DB_DEBUG(DB_STEP, mysql_conn->conn, "deferred row\n%s%s %s",
+			 head, values, step_start_update);
+		mysql_db_defer_row(mysql_conn, head, values,
+				   step_start_update);
+	} else {
+		query = xstrdup_printf("%s%s %s;",
+				       head, values, step_start_update);
+		DB_DEBUG(DB_STEP, mysql_conn->conn, "query\n%s", query);
+		rc = mysql_db_query(mysql_conn, query);
+		xfree(query);
+	}
+	xfree(head);
+	xfree(values);
 
 	return rc;
 }
@@ -1514,22 +1548,24 @@ extern int as_mysql_step_complete(mysql_conn_t *mysql_conn,
 		   " where job_db_inx=%"PRIu64" and id_step=%d and step_het_comp=%u",
 		   step_ptr->job_ptr->db_index, step_ptr->step_id.step_id,
 		   step_ptr->step_id.step_het_comp);
-	DB_DEBUG(DB_STEP, mysql_conn->conn, "query\n%s", query);
-	rc = mysql_db_query(mysql_conn, query);
-	xfree(query);
 
 	/* set the energy for the entire job. */
-	if (step_ptr->job_ptr->tres_alloc_str) {
-		query = xstrdup_printf(
-			"update \"%s_%s\" set tres_alloc='%s' where "
-			"job_db_inx=%"PRIu64,
-			mysql_conn->cluster_name, job_table,
-			step_ptr->job_ptr->tres_alloc_str,
-			step_ptr->job_ptr->db_index);
-		DB_DEBUG(DB_STEP, mysql_conn->conn, "query\n%s", query);
-		rc = mysql_db_query(mysql_conn, query);
-		xfree(query);
-	}
+	if (step_ptr->job_ptr->tres_alloc_str)
+		xstrfmtcat(query,
+			   "; update \"%s_%s\" set tres_alloc='%s' where "
+			   "job_db_inx=%"PRIu64,
+			   mysql_conn->cluster_name, job_table,
+			   step_ptr->job_ptr->tres_alloc_str,
+			   step_ptr->job_ptr->db_index);
+	DB_DEBUG(DB_STEP, mysql_conn->conn, "query\n%s", query);
+
+	/* Sent along with the next statements, see as_mysql_step_start() */
+	if (slurmdbd_conf && mysql_conn->rollback &&
+	    !slurmdbd_conf->commit_delay)
+		mysql_db_defer(mysql_conn, query);
+	else
+		rc = mysql_db_query_check_after(mysql_conn, query);
+	xfree(query);
 
 	return rc;
 }
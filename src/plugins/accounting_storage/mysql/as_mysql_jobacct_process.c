@@ -456,15 +456,72 @@ static void _destroy_local_cluster(void *object)
 	}
 }
 
+static char *_job_tables(char *cluster_name)
+{
+	return xstrdup_printf("\"%s_%s\" as t1 "
+			      "left join \"%s_%s\" as t2 "
+			      "on t1.id_assoc=t2.id_assoc "
+			      "left join \"%s_%s\" as t3 "
+			      "on t1.id_resv=t3.id_resv && "
+			      "((t1.time_start && "
+			      "(t3.time_start < t1.time_start && "
+			      "(t3.time_end >= t1.time_start || "
+			      "t3.time_end = 0))) || "
+			      "(t1.time_start = 0 && "
+			      "((t3.time_start < t1.time_submit && "
+			      "(t3.time_end >= t1.time_submit || "
+			      "t3.time_end = 0)) || "
+			      "(t3.time_start > t1.time_submit))))",
+			      cluster_name, job_table,
+			      cluster_name, assoc_table,
+			      cluster_name, resv_table);
+}
+
+/*
+ * Get the id of the job that ends a page of page_size job records, all the
+ * records of that job id being part of the page.
+ * OUT page_end - id of the last job of the page, 0 if the records left fit in
+ *                the page
+ */
+static int _get_page_end(mysql_conn_t *mysql_conn, char *tables, char *extra,
+			 uint32_t page_size, uint32_t *page_end)
+{
+	MYSQL_RES *result = NULL;
+	MYSQL_ROW row;
+	char *query = xstrdup_printf("select t1.id_job from %s%s "
+				     "order by t1.id_job limit %u, 1",
+				     tables, extra, page_size - 1);
+
+	DB_DEBUG(DB_JOB, mysql_conn->conn, "query\n%s", query);
+	result = mysql_db_query_ret(mysql_conn, query, 0);
+	xfree(query);
+	if (!result)
+		return SLURM_ERROR;
+
+	if ((row = mysql_fetch_row(result)))
+		*page_end = slurm_atoul(row[0]);
+	else
+		*page_end = 0;
+	mysql_free_result(result);
+
+	return SLURM_SUCCESS;
+}
+
+/*
+ * IN/OUT page_jobid - for a paged query (page_size set) the jobs returned
+ *                     have a higher id than this, it is set to the last job id
+ *                     of the page or 0 once there are no jobs left
+ */
 static int _cluster_get_jobs(mysql_conn_t *mysql_conn,
 			     slurmdb_user_rec_t *user,
 			     slurmdb_job_cond_t *job_cond,
 			     char *cluster_name,
 			     char *job_fields, char *step_fields,
 			     char *sent_extra,
-			     bool is_admin, int only_pending, List sent_list)
+			     bool is_admin, int only_pending, List sent_list,
+			     uint32_t page_size, uint32_t *page_jobid)
 {
-	char *query = NULL;
+	char *query = NULL, *tables = NULL;
 	char *extra = xstrdup(sent_extra);
 	slurm_selected_step_t *selected_step = NULL;
 	MYSQL_RES *result = NULL, *step_result = NULL;
@@ -480,6 +537,12 @@ static int _cluster_get_jobs(mysql_conn_t *mysql_conn,
 	int rc = SLURM_SUCCESS;
 	int last_id = -1, curr_id = -1;
 	local_cluster_t *curr_cluster = NULL;
+	uint32_t page_start = 0;
+
+	if (page_size) {
+		page_start = *page_jobid;
+		*page_jobid = 0;
+	}
 
 	/* This is here to make sure we are looking at only this user
 	 * if this flag is set.  We also include any accounts they may be
@@ -547,23 +610,8 @@ static int _cluster_get_jobs(mysql_conn_t *mysql_conn,
 	setup_job_cluster_cond_limits(mysql_conn, job_cond,
 				      cluster_name, &extra);
 
-	query = xstrdup_printf("select %s from \"%s_%s\" as t1 "
-			       "left join \"%s_%s\" as t2 "
-			       "on t1.id_assoc=t2.id_assoc "
-			       "left join \"%s_%s\" as t3 "
-			       "on t1.id_resv=t3.id_resv && "
-			       "((t1.time_start && "
-			       "(t3.time_start < t1.time_start && "
-			       "(t3.time_end >= t1.time_start || "
-			       "t3.time_end = 0))) || "
-			       "(t1.time_start = 0 && "
-			       "((t3.time_start < t1.time_submit && "
-			       "(t3.time_end >= t1.time_submit || "
-			       "t3.time_end = 0)) || "
-			       "(t3.time_start > t1.time_submit))))",
-			       job_fields, cluster_name, job_table,
-			       cluster_name, assoc_table,
-			       cluster_name, resv_table);
+	tables = _job_tables(cluster_name);
+	query = xstrdup_printf("select %s from %s", job_fields, tables);
 
 	if (job_cond->flags & JOBCOND_FLAG_RUNAWAY) {
 		if (extra)
@@ -572,6 +620,25 @@ static int _cluster_get_jobs(mysql_conn_t *mysql_conn,
 			xstrcat(extra, " where (t1.time_end=0)");
 	}
 
+	if (page_size) {
+		uint32_t page_end = 0;
+
+		xstrfmtcat(extra, "%s(t1.id_job > %u)",
+			   extra ? " && " : " where ", page_start);
+		if (_get_page_end(mysql_conn, tables, extra, page_size,
+				  &page_end) != SLURM_SUCCESS) {
+			xfree(extra);
+			xfree(query);
+			xfree(tables);
+			rc = SLURM_ERROR;
+			goto end_it;
+		}
+		if (page_end)
+			xstrfmtcat(extra, " && (t1.id_job <= %u)", page_end);
+		*page_jobid = page_end;
+	}
+	xfree(tables);
+
 	if (extra) {
 		xstrcat(query, extra);
 		xfree(extra);
@@ -1694,7 +1761,8 @@ extern List as_mysql_jobacct_process_get_jobs(mysql_conn_t *mysql_conn,
 	slurmdb_user_rec_t user;
 	int only_pending = 0;
 	List use_cluster_list = as_mysql_cluster_list;
-	char *cluster_name;
+	char *cluster_name, *page_cluster = NULL;
+	uint32_t page_size = 0;
 	assoc_mgr_lock_t locks = { NO_LOCK, NO_LOCK, NO_LOCK, NO_LOCK,
 				   READ_LOCK, NO_LOCK, NO_LOCK };
 
@@ -1744,17 +1812,46 @@ extern List as_mysql_jobacct_process_get_jobs(mysql_conn_t *mysql_conn,
 
 	assoc_mgr_lock(&locks);
 
+	if (job_cond && job_cond->page_size) {
+		page_size = job_cond->page_size;
+		page_cluster = job_cond->page_cluster;
+	}
+
 	job_list = list_create(slurmdb_destroy_job_rec);
 	itr = list_iterator_create(use_cluster_list);
 	while ((cluster_name = list_next(itr))) {
 		int rc;
+		uint32_t page_jobid = 0;
+
+		/* A paged query resumes on the cluster of its last page */
+		if (page_cluster) {
+			if (xstrcmp(cluster_name, page_cluster))
+				continue;
+			page_cluster = NULL;
+			page_jobid = job_cond->page_jobid;
+		}
+
 		_setup_job_cond_selected_steps(job_cond, cluster_name, &extra);
-		if ((rc = _cluster_get_jobs(mysql_conn, &user, job_cond,
-					    cluster_name, tmp, tmp2, extra,
-					    is_admin, only_pending, job_list))
-		    != SLURM_SUCCESS)
-			error("Problem getting jobs for cluster %s",
-			      cluster_name);
+		/*
+		 * A page only holds jobs of one cluster. Keep going while the
+		 * jobs of a page were all filtered out so only an empty page
+		 * ends a paged query.
+		 */
+		do {
+			if ((rc = _cluster_get_jobs(mysql_conn, &user, job_cond,
+						    cluster_name, tmp, tmp2,
+						    extra, is_admin,
+						    only_pending, job_list,
+						    page_size, &page_jobid))
+			    != SLURM_SUCCESS) {
+				error("Problem getting jobs for cluster %s",
+				      cluster_name);
+				break;
+			}
+		} while (page_size && page_jobid && !list_count(job_list));
+
+		if (page_size && list_count(job_list))
+			break;
 	}
 	list_iterator_destroy(itr);
 
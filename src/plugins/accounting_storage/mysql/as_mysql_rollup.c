@@ -42,6 +42,11 @@
 #include "as_mysql_archive.h"
 #include "src/common/parse_time.h"
 #include "src/common/slurm_time.h"
+#include "src/common/xhash.h"
+
+/* Most connections used to roll up the hours of one cluster in parallel */
+#define MAX_HOUR_ROLLUP_THREADS 4
+#define MAX_TRES_CACHE 65536	/* parsed TRES strings kept per rollup thread */
 
 enum {
 	TIME_ALLOC,
@@ -55,6 +60,29 @@ enum {
 	WCKEY_TABLES
 };
 
+/* Columns of the job_str and suspend_str queries of the hourly rollup */
+enum {
+	JOB_REQ_DB_INX,
+//	JOB_REQ_JOBID,
+	JOB_REQ_ASSOCID,
+	JOB_REQ_WCKEYID,
+	JOB_REQ_ARRAY_PENDING,
+	JOB_REQ_ELG,
+	JOB_REQ_START,
+	JOB_REQ_END,
+	JOB_REQ_SUSPENDED,
+	JOB_REQ_RCPU,
+	JOB_REQ_RESVID,
+	JOB_REQ_TRES,
+	JOB_REQ_COUNT
+};
+
+enum {
+	SUSPEND_REQ_START,
+	SUSPEND_REQ_END,
+	SUSPEND_REQ_COUNT
+};
+
 typedef struct {
 	uint64_t count;
 	uint32_t id;
@@ -72,6 +100,14 @@ typedef struct {
 	List loc_tres;
 } local_id_usage_t;
 
+/* A TRES string parsed once for all the rows of a rollup using it */
+typedef struct {
+	int cnt;
+	uint64_t *count;
+	uint32_t *id;
+	char *tres_str;
+} local_tres_parsed_t;
+
 typedef struct {
 	time_t end;
 	int id; /*only needed for reservations */
@@ -88,10 +124,37 @@ typedef struct {
 			      over of type local_id_usage_t */
 	List loc_tres;
 	time_t orig_start;
+	double prev_unused_wall; /* unused_wall before this hour */
 	time_t start;
 	double unused_wall;
+	double used_wall; /* wall time used by jobs this hour */
 } local_resv_usage_t;
 
+/* What an hour of a parallel rollup did to the unused wall of a resv */
+typedef struct {
+	time_t hour;
+	int id;
+	time_t orig_start;
+	double prev_unused;
+	int seconds;
+	double used;
+} local_resv_wall_t;
+
+typedef struct {
+	char *cluster_name;
+	int conn;
+	int dims;
+	time_t end;
+	char *job_str;
+	pthread_mutex_t lock;	/* protects next_start, rc, resv_wall_list */
+	time_t next_start;	/* next hour for a thread to roll up */
+	time_t now;
+	int rc;
+	List resv_wall_list;	/* local_resv_wall_t, set if parallel */
+	char *suspend_str;
+	uint16_t track_wckey;
+} hour_rollup_t;
+
 static void _destroy_local_tres_usage(void *object)
 {
 	local_tres_usage_t *a_usage = (local_tres_usage_t *)object;
@@ -139,14 +202,12 @@ static int _find_loc_tres(void *x, void *key)
 	return 0;
 }
 
-static int _find_id_usage(void *x, void *key)
+static void _id_usage_hash_id(void *item, const char **key, uint32_t *key_len)
 {
-	local_id_usage_t *loc = (local_id_usage_t *)x;
-	uint32_t id = *(uint32_t *)key;
+	local_id_usage_t *loc = (local_id_usage_t *)item;
 
-	if (loc->id == id)
-		return 1;
-	return 0;
+	*key = (const char *) &loc->id;
+	*key_len = sizeof(loc->id);
 }
 
 static void _remove_job_tres_time_from_cluster(List c_tres, List j_tres,
@@ -278,6 +339,7 @@ static int _update_unused_wall(local_resv_usage_t *r_usage, List job_tres,
 	 * Here we are converting TRES seconds to wall seconds.  This is needed
 	 * to determine how much time is actually idle in the reservation.
 	 */
+	r_usage->used_wall += (double)job_seconds * tres_ratio;
 	r_usage->unused_wall -=	(double)job_seconds * tres_ratio;
 
 	if (r_usage->unused_wall < 0) {
@@ -322,43 +384,101 @@ static void _setup_cluster_tres(List tres_list, uint32_t id,
 	loc_tres->total_time += seconds * loc_tres->count;
 }
 
-static void _add_tres_2_list(List tres_list, char *tres_str, int seconds)
+static void _destroy_local_tres_parsed(void *object)
+{
+	local_tres_parsed_t *parsed = (local_tres_parsed_t *)object;
+
+	if (parsed) {
+		xfree(parsed->count);
+		xfree(parsed->id);
+		xfree(parsed->tres_str);
+		xfree(parsed);
+	}
+}
+
+static void _tres_parsed_hash_id(void *item, const char **key,
+				 uint32_t *key_len)
+{
+	local_tres_parsed_t *parsed = (local_tres_parsed_t *)item;
+
+	*key = parsed->tres_str;
+	*key_len = strlen(parsed->tres_str);
+}
+
+/*
+ * Return the parsed form of tres_str from tres_cache, parsing it the first
+ * time. The same strings show up on most jobs, events and reservations of a
+ * cluster and on every hour they span, so they are only parsed once per
+ * rollup thread.
+ */
+static local_tres_parsed_t *_get_tres_parsed(xhash_t *tres_cache,
+					     char *tres_str)
 {
+	local_tres_parsed_t *parsed;
 	char *tmp_str = tres_str;
-	int id;
-	uint64_t count;
+	int id, size = 0;
 
-	xassert(tres_list);
+	if ((parsed = xhash_get_str(tres_cache, tres_str)))
+		return parsed;
 
-	if (!tres_str || !tres_str[0])
-		return;
+	/* Don't let a rollup over many distinct strings grow without end */
+	if (xhash_count(tres_cache) >= MAX_TRES_CACHE)
+		xhash_clear(tres_cache);
+
+	parsed = xmalloc(sizeof(local_tres_parsed_t));
+	parsed->tres_str = xstrdup(tres_str);
 
 	while (tmp_str) {
 		id = atoi(tmp_str);
 		if (id < 1) {
-			error("_add_tres_2_list: no id "
-			      "found at %s instead", tmp_str);
+			error("%s: no id found at %s", __func__, tmp_str);
 			break;
 		}
+		if (!(tmp_str = strchr(tmp_str, '='))) {
+			error("%s: no value found for id %d '%s'",
+			      __func__, id, tres_str);
+			xassert(0);
+			break;
+		}
+		if (parsed->cnt >= size) {
+			size = size ? (size * 2) : 8;
+			xrecalloc(parsed->count, size, sizeof(uint64_t));
+			xrecalloc(parsed->id, size, sizeof(uint32_t));
+		}
+		parsed->id[parsed->cnt] = id;
+		parsed->count[parsed->cnt++] = slurm_atoull(++tmp_str);
+
+		if (!(tmp_str = strchr(tmp_str, ',')))
+			break;
+		tmp_str++;
+	}
+
+	xhash_add(tres_cache, parsed);
+
+	return parsed;
+}
+
+static void _add_tres_2_list(List tres_list, xhash_t *tres_cache,
+			     char *tres_str, int seconds)
+{
+	local_tres_parsed_t *parsed;
+	int i;
+
+	xassert(tres_list);
+
+	if (!tres_str || !tres_str[0])
+		return;
 
+	parsed = _get_tres_parsed(tres_cache, tres_str);
+	for (i = 0; i < parsed->cnt; i++) {
 		/* We don't run rollup on a node basis
 		 * because they are shared resources on
 		 * many systems so it will almost always
 		 * have over committed resources.
 		 */
-		if (id != TRES_NODE) {
-			if (!(tmp_str = strchr(tmp_str, '='))) {
-				error("_add_tres_2_list: no value found");
-				xassert(0);
-				break;
-			}
-			count = slurm_atoull(++tmp_str);
-			_setup_cluster_tres(tres_list, id, count, seconds);
-		}
-
-		if (!(tmp_str = strchr(tmp_str, ',')))
-			break;
-		tmp_str++;
+		if (parsed->id[i] != TRES_NODE)
+			_setup_cluster_tres(tres_list, parsed->id[i],
+					    parsed->count[i], seconds);
 	}
 
 	return;
@@ -406,35 +526,26 @@ static void _transfer_loc_tres(List *loc_tres, local_id_usage_t *usage)
 	}
 }
 
-static void _add_tres_time_2_list(List tres_list, char *tres_str,
-				  int type, int seconds, int suspend_seconds,
-				  bool times_count)
+static void _add_tres_time_2_list(List tres_list, xhash_t *tres_cache,
+				  char *tres_str, int type, int seconds,
+				  int suspend_seconds, bool times_count)
 {
-	char *tmp_str = tres_str;
-	int id;
+	local_tres_parsed_t *parsed;
+	uint32_t id;
 	uint64_t time, count;
 	local_tres_usage_t *loc_tres;
+	int i;
 
 	xassert(tres_list);
 
 	if (!tres_str || !tres_str[0])
 		return;
 
-	while (tmp_str) {
+	parsed = _get_tres_parsed(tres_cache, tres_str);
+	for (i = 0; i < parsed->cnt; i++) {
 		int loc_seconds = seconds;
 
-		id = atoi(tmp_str);
-		if (id < 1) {
-			error("_add_tres_time_2_list: no id "
-			      "found at %s", tmp_str);
-			break;
-		}
-		if (!(tmp_str = strchr(tmp_str, '='))) {
-			error("_add_tres_time_2_list: no value found for "
-			      "id %d '%s'", id, tres_str);
-			xassert(0);
-			break;
-		}
+		id = parsed->id[i];
 
 		/* Take away suspended time from TRES that are idle when the
 		 * job was suspended, currently only CPU's fill that bill.
@@ -445,7 +556,7 @@ static void _add_tres_time_2_list(List tres_list, char *tres_str,
 				loc_seconds = 0;
 		}
 
-		time = count = slurm_atoull(++tmp_str);
+		time = count = parsed->count[i];
 		/* ENERGY is already totalled for the entire job so don't
 		 * multiple with time.
 		 */
@@ -457,10 +568,6 @@ static void _add_tres_time_2_list(List tres_list, char *tres_str,
 
 		if (loc_tres && !loc_tres->count)
 			loc_tres->count = count;
-
-		if (!(tmp_str = strchr(tmp_str, ',')))
-			break;
-		tmp_str++;
 	}
 
 	return;
@@ -850,7 +957,8 @@ static local_cluster_usage_t *_setup_cluster_usage(mysql_conn_t *mysql_conn,
 						   time_t curr_end,
 						   List resv_usage_list,
 						   List cluster_down_list,
-						   int dims)
+						   int dims,
+						   xhash_t *tres_cache)
 {
 	local_cluster_usage_t *c_usage = NULL;
 	char *query = NULL;
@@ -962,7 +1070,7 @@ static local_cluster_usage_t *_setup_cluster_usage(mysql_conn_t *mysql_conn,
 
 			loc_c_usage->end = row_end;
 
-			_add_tres_2_list(loc_c_usage->loc_tres,
+			_add_tres_2_list(loc_c_usage->loc_tres, tres_cache,
 					 row[EVENT_REQ_TRES], seconds);
 
 			continue;
@@ -1002,14 +1110,14 @@ static local_cluster_usage_t *_setup_cluster_usage(mysql_conn_t *mysql_conn,
 
 			loc_tres = list_create(_destroy_local_tres_usage);
 
-			_add_tres_time_2_list(loc_tres,
+			_add_tres_time_2_list(loc_tres, tres_cache,
 					      row[EVENT_REQ_TRES],
 					      loc_r_usage->flags &
 					      RESERVE_FLAG_MAINT ?
 					      TIME_PDOWN : TIME_DOWN,
 					      resv_seconds,
 					      0, 0);
-			_add_tres_time_2_list(c_usage->loc_tres,
+			_add_tres_time_2_list(c_usage->loc_tres, tres_cache,
 					      row[EVENT_REQ_TRES],
 					      loc_r_usage->flags &
 					      RESERVE_FLAG_MAINT ?
@@ -1038,7 +1146,7 @@ static local_cluster_usage_t *_setup_cluster_usage(mysql_conn_t *mysql_conn,
 
 		seconds -= resv_seconds;
 		if (seconds > 0)
-			_add_tres_time_2_list(c_usage->loc_tres,
+			_add_tres_time_2_list(c_usage->loc_tres, tres_cache,
 					      row[EVENT_REQ_TRES],
 					      TIME_DOWN,
 					      seconds, 0, 0);
@@ -1086,7 +1194,8 @@ extern int _setup_resv_usage(mysql_conn_t *mysql_conn,
 			     time_t curr_start,
 			     time_t curr_end,
 			     List resv_usage_list,
-			     int dims)
+			     int dims,
+			     xhash_t *tres_cache)
 {
 	MYSQL_RES *result = NULL;
 	MYSQL_ROW row;
@@ -1197,7 +1306,7 @@ extern int _setup_resv_usage(mysql_conn_t *mysql_conn,
 		r_usage->loc_tres =
 			list_create(_destroy_local_tres_usage);
 
-		_add_tres_2_list(r_usage->loc_tres,
+		_add_tres_2_list(r_usage->loc_tres, tres_cache,
 				 row[RESV_REQ_TRES], resv_seconds);
 
 		/*
@@ -1207,6 +1316,7 @@ extern int _setup_resv_usage(mysql_conn_t *mysql_conn,
 		r_usage->orig_start = orig_start;
 		r_usage->start = row_start;
 		r_usage->end = row_end;
+		r_usage->prev_unused_wall = unused;
 		r_usage->unused_wall = unused + resv_seconds;
 		r_usage->hl = hostlist_create_dims(row[RESV_REQ_NODES], dims);
 		list_append(resv_usage_list, r_usage);
@@ -1216,17 +1326,97 @@ extern int _setup_resv_usage(mysql_conn_t *mysql_conn,
 	return SLURM_SUCCESS;
 }
 
-extern int as_mysql_hourly_rollup(mysql_conn_t *mysql_conn,
-				  char *cluster_name,
-				  time_t start, time_t end,
-				  uint16_t archive_data)
+static void _add_resv_wall(hour_rollup_t *roll, local_resv_usage_t *r_usage,
+			   time_t hour)
+{
+	local_resv_wall_t *wall = xmalloc(sizeof(local_resv_wall_t));
+
+	wall->id = r_usage->id;
+	wall->orig_start = r_usage->orig_start;
+	wall->hour = hour;
+	wall->prev_unused = r_usage->prev_unused_wall;
+	wall->seconds = r_usage->end - r_usage->start;
+	wall->used = r_usage->used_wall;
+
+	slurm_mutex_lock(&roll->lock);
+	list_append(roll->resv_wall_list, wall);
+	slurm_mutex_unlock(&roll->lock);
+}
+
+static int _sort_resv_wall(void *x, void *y)
+{
+	local_resv_wall_t *wall1 = *(local_resv_wall_t **)x;
+	local_resv_wall_t *wall2 = *(local_resv_wall_t **)y;
+
+	if (wall1->id != wall2->id)
+		return (wall1->id < wall2->id) ? -1 : 1;
+	if (wall1->orig_start != wall2->orig_start)
+		return (wall1->orig_start < wall2->orig_start) ? -1 : 1;
+	if (wall1->hour != wall2->hour)
+		return (wall1->hour < wall2->hour) ? -1 : 1;
+	return 0;
+}
+
+/*
+ * Replay the hours gathered by the threads of a parallel rollup in order to
+ * get the unused wall time each reservation would have had after rolling
+ * them up one after another.
+ */
+static int _update_resv_walls(mysql_conn_t *mysql_conn, hour_rollup_t *roll)
 {
+	ListIterator itr;
+	local_resv_wall_t *wall, *prev = NULL;
+	double unused_wall = 0;
+	char *query = NULL;
 	int rc = SLURM_SUCCESS;
-	int add_sec = 3600;
-	int i=0, dims;
-	time_t now = time(NULL);
-	time_t curr_start = start;
-	time_t curr_end = curr_start + add_sec;
+
+	list_sort(roll->resv_wall_list, _sort_resv_wall);
+	itr = list_iterator_create(roll->resv_wall_list);
+	while ((wall = list_next(itr))) {
+		if (!prev || (prev->id != wall->id) ||
+		    (prev->orig_start != wall->orig_start)) {
+			if (prev)
+				xstrfmtcat(query, "update \"%s_%s\" set unused_wall=%f where id_resv=%u and time_start=%ld;",
+					   roll->cluster_name, resv_table,
+					   unused_wall, prev->id,
+					   prev->orig_start);
+			unused_wall = wall->prev_unused;
+		}
+		/* Jobs only take time away, so clamping once is the same */
+		unused_wall += wall->seconds - wall->used;
+		if (unused_wall < 0)
+			unused_wall = 0;
+		prev = wall;
+	}
+	list_iterator_destroy(itr);
+	if (prev)
+		xstrfmtcat(query, "update \"%s_%s\" set unused_wall=%f where id_resv=%u and time_start=%ld;",
+			   roll->cluster_name, resv_table,
+			   unused_wall, prev->id, prev->orig_start);
+
+	if (query) {
+		DB_DEBUG(DB_USAGE, mysql_conn->conn, "query\n%s", query);
+		rc = mysql_db_query(mysql_conn, query);
+		xfree(query);
+		if (rc != SLURM_SUCCESS)
+			error("couldn't update reservations with unused time");
+	}
+
+	return rc;
+}
+
+/* Roll up the usage of one hour, curr_start to curr_end, of a cluster */
+static int _rollup_hour(mysql_conn_t *mysql_conn, hour_rollup_t *roll,
+			xhash_t *tres_cache, time_t curr_start,
+			time_t curr_end)
+{
+	int rc = SLURM_SUCCESS;
+	char *cluster_name = roll->cluster_name;
+	int dims = roll->dims;
+	char *job_str = roll->job_str;
+	time_t now = roll->now;
+	char *suspend_str = roll->suspend_str;
+	uint16_t track_wckey = roll->track_wckey;
 	char *query = NULL;
 	MYSQL_RES *result = NULL;
 	MYSQL_ROW row;
@@ -1238,623 +1428,719 @@ extern int as_mysql_hourly_rollup(mysql_conn_t *mysql_conn,
 	List cluster_down_list = list_create(_destroy_local_cluster_usage);
 	List wckey_usage_list = list_create(_destroy_local_id_usage);
 	List resv_usage_list = list_create(_destroy_local_resv_usage);
-	uint16_t track_wckey = slurm_get_track_wckey();
+	xhash_t *assoc_hash = xhash_init(_id_usage_hash_id, NULL);
+	xhash_t *wckey_hash = xhash_init(_id_usage_hash_id, NULL);
 	local_cluster_usage_t *loc_c_usage = NULL;
 	local_cluster_usage_t *c_usage = NULL;
 	local_resv_usage_t *r_usage = NULL;
 	local_id_usage_t *a_usage = NULL;
 	local_id_usage_t *w_usage = NULL;
-	/* char start_char[20], end_char[20]; */
-
-	char *job_req_inx[] = {
-		"job.job_db_inx",
-//		"job.id_job",
-		"job.id_assoc",
-		"job.id_wckey",
-		"job.array_task_pending",
-		"job.time_eligible",
-		"job.time_start",
-		"job.time_end",
-		"job.time_suspended",
-		"job.cpus_req",
-		"job.id_resv",
-		"job.tres_alloc"
-	};
-	char *job_str = NULL;
-	enum {
-		JOB_REQ_DB_INX,
-//		JOB_REQ_JOBID,
-		JOB_REQ_ASSOCID,
-		JOB_REQ_WCKEYID,
-		JOB_REQ_ARRAY_PENDING,
-		JOB_REQ_ELG,
-		JOB_REQ_START,
-		JOB_REQ_END,
-		JOB_REQ_SUSPENDED,
-		JOB_REQ_RCPU,
-		JOB_REQ_RESVID,
-		JOB_REQ_TRES,
-		JOB_REQ_COUNT
-	};
+	int last_id = -1;
+	int last_wckeyid = -1;
 
-	char *suspend_req_inx[] = {
-		"time_start",
-		"time_end"
-	};
-	char *suspend_str = NULL;
-	enum {
-		SUSPEND_REQ_START,
-		SUSPEND_REQ_END,
-		SUSPEND_REQ_COUNT
-	};
+	a_itr = list_iterator_create(assoc_usage_list);
+	c_itr = list_iterator_create(cluster_down_list);
+	w_itr = list_iterator_create(wckey_usage_list);
+	r_itr = list_iterator_create(resv_usage_list);
 
-	i=0;
-	xstrfmtcat(job_str, "%s", job_req_inx[i]);
-	for(i=1; i<JOB_REQ_COUNT; i++) {
-		xstrfmtcat(job_str, ", %s", job_req_inx[i]);
-	}
+	DB_DEBUG(DB_USAGE, mysql_conn->conn,
+	         "%s curr hour is now %ld-%ld",
+	         cluster_name, curr_start, curr_end);
+/* 		info("start %s", slurm_ctime2(&curr_start)); */
+/* 		info("end %s", slurm_ctime2(&curr_end)); */
 
-	i=0;
-	xstrfmtcat(suspend_str, "%s", suspend_req_inx[i]);
-	for(i=1; i<SUSPEND_REQ_COUNT; i++) {
-		xstrfmtcat(suspend_str, ", %s", suspend_req_inx[i]);
-	}
+	if ((rc = _setup_resv_usage(mysql_conn, cluster_name,
+				    curr_start, curr_end,
+				    resv_usage_list, dims, tres_cache))
+	    != SLURM_SUCCESS)
+		goto end_it;
 
-	/* We need to figure out the dimensions of this cluster */
-	query = xstrdup_printf("select dimensions from %s where name='%s'",
-			       cluster_table, cluster_name);
-	DB_DEBUG(DB_USAGE, mysql_conn->conn, "query\n%s", query);
-	result = mysql_db_query_ret(mysql_conn, query, 0);
-	xfree(query);
+	c_usage = _setup_cluster_usage(mysql_conn, cluster_name,
+				       curr_start, curr_end,
+				       resv_usage_list,
+				       cluster_down_list,
+				       dims, tres_cache);
 
-	if (!result) {
-		error("%s: error querying cluster_table", __func__);
-		rc = SLURM_ERROR;
-		goto end_it;
-	}
-	row = mysql_fetch_row(result);
+	if (c_usage)
+		xassert(c_usage->loc_tres);
+
+	/* now get the jobs during this time only  */
+	query = xstrdup_printf("select %s from \"%s_%s\" as job "
+			       "where (job.time_eligible && "
+			       "job.time_eligible < %ld && "
+			       "(job.time_end >= %ld || "
+			       "job.time_end = 0)) "
+			       "group by job.job_db_inx "
+			       "order by job.id_assoc, "
+			       "job.time_eligible",
+			       job_str, cluster_name, job_table,
+			       curr_end, curr_start);
 
-	if (!row) {
-		error("%s: no cluster by name %s known",
-		      __func__, cluster_name);
+	DB_DEBUG(DB_USAGE, mysql_conn->conn, "query\n%s", query);
+	if (!(result = mysql_db_query_ret(
+		      mysql_conn, query, 0))) {
 		rc = SLURM_ERROR;
 		goto end_it;
 	}
+	xfree(query);
 
-	dims = atoi(row[0]);
-	mysql_free_result(result);
-
-/* 	info("begin start %s", slurm_ctime2(&curr_start)); */
-/* 	info("begin end %s", slurm_ctime2(&curr_end)); */
-	a_itr = list_iterator_create(assoc_usage_list);
-	c_itr = list_iterator_create(cluster_down_list);
-	w_itr = list_iterator_create(wckey_usage_list);
-	r_itr = list_iterator_create(resv_usage_list);
-	while (curr_start < end) {
-		int last_id = -1;
-		int last_wckeyid = -1;
-
-		DB_DEBUG(DB_USAGE, mysql_conn->conn,
-		         "%s curr hour is now %ld-%ld",
-		         cluster_name, curr_start, curr_end);
-/* 		info("start %s", slurm_ctime2(&curr_start)); */
-/* 		info("end %s", slurm_ctime2(&curr_end)); */
-
-		if ((rc = _setup_resv_usage(mysql_conn, cluster_name,
-					    curr_start, curr_end,
-					    resv_usage_list, dims))
-		    != SLURM_SUCCESS)
-			goto end_it;
+	while ((row = mysql_fetch_row(result))) {
+		//uint32_t job_id = slurm_atoul(row[JOB_REQ_JOBID]);
+		uint32_t assoc_id = slurm_atoul(row[JOB_REQ_ASSOCID]);
+		uint32_t wckey_id = slurm_atoul(row[JOB_REQ_WCKEYID]);
+		uint32_t array_pending =
+			slurm_atoul(row[JOB_REQ_ARRAY_PENDING]);
+		uint32_t resv_id = slurm_atoul(row[JOB_REQ_RESVID]);
+		time_t row_eligible = slurm_atoul(row[JOB_REQ_ELG]);
+		time_t row_start = slurm_atoul(row[JOB_REQ_START]);
+		time_t row_end = slurm_atoul(row[JOB_REQ_END]);
+		uint32_t row_rcpu = slurm_atoul(row[JOB_REQ_RCPU]);
+		List loc_tres = NULL;
+		int loc_seconds = 0;
+		int seconds = 0, suspend_seconds = 0;
+
+		if (row_start && (row_start < curr_start))
+			row_start = curr_start;
 
-		c_usage = _setup_cluster_usage(mysql_conn, cluster_name,
-					       curr_start, curr_end,
-					       resv_usage_list,
-					       cluster_down_list,
-					       dims);
-
-		if (c_usage)
-			xassert(c_usage->loc_tres);
-
-		/* now get the jobs during this time only  */
-		query = xstrdup_printf("select %s from \"%s_%s\" as job "
-				       "where (job.time_eligible && "
-				       "job.time_eligible < %ld && "
-				       "(job.time_end >= %ld || "
-				       "job.time_end = 0)) "
-				       "group by job.job_db_inx "
-				       "order by job.id_assoc, "
-				       "job.time_eligible",
-				       job_str, cluster_name, job_table,
-				       curr_end, curr_start);
+		if (!row_start && row_end)
+			row_start = row_end;
 
-		DB_DEBUG(DB_USAGE, mysql_conn->conn, "query\n%s", query);
-		if (!(result = mysql_db_query_ret(
-			      mysql_conn, query, 0))) {
-			rc = SLURM_ERROR;
-			goto end_it;
-		}
-		xfree(query);
+		if (!row_end || row_end > curr_end)
+			row_end = curr_end;
 
-		while ((row = mysql_fetch_row(result))) {
-			//uint32_t job_id = slurm_atoul(row[JOB_REQ_JOBID]);
-			uint32_t assoc_id = slurm_atoul(row[JOB_REQ_ASSOCID]);
-			uint32_t wckey_id = slurm_atoul(row[JOB_REQ_WCKEYID]);
-			uint32_t array_pending =
-				slurm_atoul(row[JOB_REQ_ARRAY_PENDING]);
-			uint32_t resv_id = slurm_atoul(row[JOB_REQ_RESVID]);
-			time_t row_eligible = slurm_atoul(row[JOB_REQ_ELG]);
-			time_t row_start = slurm_atoul(row[JOB_REQ_START]);
-			time_t row_end = slurm_atoul(row[JOB_REQ_END]);
-			uint32_t row_rcpu = slurm_atoul(row[JOB_REQ_RCPU]);
-			List loc_tres = NULL;
-			int loc_seconds = 0;
-			int seconds = 0, suspend_seconds = 0;
-
-			if (row_start && (row_start < curr_start))
-				row_start = curr_start;
-
-			if (!row_start && row_end)
-				row_start = row_end;
-
-			if (!row_end || row_end > curr_end)
-				row_end = curr_end;
-
-			if (!row_start || ((row_end - row_start) < 1))
-				goto calc_cluster;
-
-			seconds = (row_end - row_start);
-
-			if (slurm_atoul(row[JOB_REQ_SUSPENDED])) {
-				MYSQL_RES *result2 = NULL;
-				MYSQL_ROW row2;
-				/* get the suspended time for this job */
-				query = xstrdup_printf(
-					"select %s from \"%s_%s\" where "
-					"(time_start < %ld && (time_end >= %ld "
-					"|| time_end = 0)) && job_db_inx=%s "
-					"order by time_start",
-					suspend_str, cluster_name,
-					suspend_table,
-					curr_end, curr_start,
-					row[JOB_REQ_DB_INX]);
-
-				debug4("%d(%s:%d) query\n%s",
-				       mysql_conn->conn, THIS_FILE,
-				       __LINE__, query);
-				if (!(result2 = mysql_db_query_ret(
-					      mysql_conn,
-					      query, 0))) {
-					rc = SLURM_ERROR;
-					mysql_free_result(result);
-					goto end_it;
-				}
-				xfree(query);
-				while ((row2 = mysql_fetch_row(result2))) {
-					int tot_time = 0;
-					time_t local_start = slurm_atoul(
-						row2[SUSPEND_REQ_START]);
-					time_t local_end = slurm_atoul(
-						row2[SUSPEND_REQ_END]);
-
-					if (!local_start)
-						continue;
-
-					if (row_start > local_start)
-						local_start = row_start;
-					if (!local_end || row_end < local_end)
-						local_end = row_end;
-					tot_time = (local_end - local_start);
-
-					if (tot_time > 0)
-						suspend_seconds += tot_time;
-				}
-				mysql_free_result(result2);
+		if (!row_start || ((row_end - row_start) < 1))
+			goto calc_cluster;
+
+		seconds = (row_end - row_start);
+
+		if (slurm_atoul(row[JOB_REQ_SUSPENDED])) {
+			MYSQL_RES *result2 = NULL;
+			MYSQL_ROW row2;
+			/* get the suspended time for this job */
+			query = xstrdup_printf(
+				"select %s from \"%s_%s\" where "
+				"(time_start < %ld && (time_end >= %ld "
+				"|| time_end = 0)) && job_db_inx=%s "
+				"order by time_start",
+				suspend_str, cluster_name,
+				suspend_table,
+				curr_end, curr_start,
+				row[JOB_REQ_DB_INX]);
+
+			debug4("%d(%s:%d) query\n%s",
+			       mysql_conn->conn, THIS_FILE,
+			       __LINE__, query);
+			if (!(result2 = mysql_db_query_ret(
+				      mysql_conn,
+				      query, 0))) {
+				rc = SLURM_ERROR;
+				mysql_free_result(result);
+				goto end_it;
 			}
+			xfree(query);
+			while ((row2 = mysql_fetch_row(result2))) {
+				int tot_time = 0;
+				time_t local_start = slurm_atoul(
+					row2[SUSPEND_REQ_START]);
+				time_t local_end = slurm_atoul(
+					row2[SUSPEND_REQ_END]);
+
+				if (!local_start)
+					continue;
 
-			if (last_id != assoc_id) {
-				a_usage = xmalloc(sizeof(local_id_usage_t));
-				a_usage->id = assoc_id;
-				list_append(assoc_usage_list, a_usage);
-				last_id = assoc_id;
-				/* a_usage->loc_tres is made later,
-				   don't do it here.
-				*/
-			}
+				if (row_start > local_start)
+					local_start = row_start;
+				if (!local_end || row_end < local_end)
+					local_end = row_end;
+				tot_time = (local_end - local_start);
 
-			/* Short circuit this so so we don't get a pointer. */
-			if (!track_wckey)
-				last_wckeyid = wckey_id;
+				if (tot_time > 0)
+					suspend_seconds += tot_time;
+			}
+			mysql_free_result(result2);
+		}
 
-			/* do the wckey calculation */
-			if (last_wckeyid != wckey_id) {
-				list_iterator_reset(w_itr);
-				while ((w_usage = list_next(w_itr)))
-					if (w_usage->id == wckey_id)
-						break;
+		if (last_id != assoc_id) {
+			a_usage = xmalloc(sizeof(local_id_usage_t));
+			a_usage->id = assoc_id;
+			list_append(assoc_usage_list, a_usage);
+			xhash_add(assoc_hash, a_usage);
+			last_id = assoc_id;
+			/* a_usage->loc_tres is made later,
+			   don't do it here.
+			*/
+		}
 
-				if (!w_usage) {
-					w_usage = xmalloc(
-						sizeof(local_id_usage_t));
-					w_usage->id = wckey_id;
-					list_append(wckey_usage_list,
-						    w_usage);
-					w_usage->loc_tres = list_create(
-						_destroy_local_tres_usage);
-				}
-				last_wckeyid = wckey_id;
+		/* Short circuit this so so we don't get a pointer. */
+		if (!track_wckey)
+			last_wckeyid = wckey_id;
+
+		/* do the wckey calculation */
+		if (last_wckeyid != wckey_id) {
+			if (!(w_usage = xhash_get(wckey_hash,
+						  (char *) &wckey_id,
+						  sizeof(wckey_id)))) {
+				w_usage = xmalloc(
+					sizeof(local_id_usage_t));
+				w_usage->id = wckey_id;
+				list_append(wckey_usage_list,
+					    w_usage);
+				xhash_add(wckey_hash, w_usage);
+				w_usage->loc_tres = list_create(
+					_destroy_local_tres_usage);
 			}
+			last_wckeyid = wckey_id;
+		}
 
-			/* do the cluster allocated calculation */
-		calc_cluster:
-
-			/*
-			 * We need to have this clean for each job
-			 * since we add the time to the cluster individually.
-			 */
-			loc_tres = list_create(_destroy_local_tres_usage);
+		/* do the cluster allocated calculation */
+	calc_cluster:
 
-			_add_tres_time_2_list(loc_tres, row[JOB_REQ_TRES],
+		/*
+		 * We need to have this clean for each job
+		 * since we add the time to the cluster individually.
+		 */
+		loc_tres = list_create(_destroy_local_tres_usage);
+
+		_add_tres_time_2_list(loc_tres, tres_cache, row[JOB_REQ_TRES],
+				      TIME_ALLOC, seconds,
+				      suspend_seconds, 0);
+		if (w_usage)
+			_add_tres_time_2_list(w_usage->loc_tres, tres_cache,
+					      row[JOB_REQ_TRES],
 					      TIME_ALLOC, seconds,
 					      suspend_seconds, 0);
-			if (w_usage)
-				_add_tres_time_2_list(w_usage->loc_tres,
-						      row[JOB_REQ_TRES],
-						      TIME_ALLOC, seconds,
-						      suspend_seconds, 0);
 
-			/*
-			 * Now figure out there was a disconnected
-			 * slurmctld during this job.
-			 */
-			list_iterator_reset(c_itr);
-			while ((loc_c_usage = list_next(c_itr))) {
-				int temp_end = row_end;
-				int temp_start = row_start;
-				if (loc_c_usage->start > temp_start)
-					temp_start = loc_c_usage->start;
-				if (loc_c_usage->end < temp_end)
-					temp_end = loc_c_usage->end;
-				loc_seconds = (temp_end - temp_start);
-				if (loc_seconds < 1)
-					continue;
-
-				_remove_job_tres_time_from_cluster(
-					loc_c_usage->loc_tres,
-					loc_tres,
-					loc_seconds);
-				/* info("Job %u was running for " */
-				/*      "%d seconds while " */
-				/*      "cluster %s's slurmctld " */
-				/*      "wasn't responding", */
-				/*      job_id, loc_seconds, cluster_name); */
-			}
+		/*
+		 * Now figure out there was a disconnected
+		 * slurmctld during this job.
+		 */
+		list_iterator_reset(c_itr);
+		while ((loc_c_usage = list_next(c_itr))) {
+			int temp_end = row_end;
+			int temp_start = row_start;
+			if (loc_c_usage->start > temp_start)
+				temp_start = loc_c_usage->start;
+			if (loc_c_usage->end < temp_end)
+				temp_end = loc_c_usage->end;
+			loc_seconds = (temp_end - temp_start);
+			if (loc_seconds < 1)
+				continue;
 
-			/* first figure out the reservation */
-			if (resv_id) {
-				if (seconds <= 0) {
-					_transfer_loc_tres(&loc_tres, a_usage);
-					continue;
-				}
-				/*
-				 * Since we have already added the entire
-				 * reservation as used time on the cluster we
-				 * only need to calculate the used time for the
-				 * reservation and then divy up the unused time
-				 * over the associations able to run in the
-				 * reservation. Since the job was to run, or ran
-				 * a reservation we don't care about eligible
-				 * time since that could totally skew the
-				 * clusters reserved time since the job may be
-				 * able to run outside of the reservation.
-				 */
-				list_iterator_reset(r_itr);
-				while ((r_usage = list_next(r_itr))) {
-					int temp_end, temp_start;
-					/*
-					 * since the reservation could have
-					 * changed in some way, thus making a
-					 * new reservation record in the
-					 * database, we have to make sure all
-					 * of the reservations are checked to
-					 * see if such a thing has happened
-					 */
-					if (r_usage->id != resv_id)
-						continue;
-					temp_end = row_end;
-					temp_start = row_start;
-					if (r_usage->start > temp_start)
-						temp_start =
-							r_usage->start;
-					if (r_usage->end < temp_end)
-						temp_end = r_usage->end;
-
-					loc_seconds = (temp_end - temp_start);
-
-					if (loc_seconds <= 0)
-						continue;
-
-					if (c_usage &&
-					    (r_usage->flags &
-					     RESERVE_FLAG_IGN_JOBS))
-						/*
-						 * job usage was not
-						 * bundled with resv
-						 * usage so need to
-						 * account for it
-						 * individually here
-						 */
-						_add_tres_time_2_list(
-							c_usage->loc_tres,
-							row[JOB_REQ_TRES],
-							TIME_ALLOC,
-							loc_seconds,
-							0, 0);
-
-					_add_time_tres_list(
-						r_usage->loc_tres,
-						loc_tres, TIME_ALLOC,
-						loc_seconds, 1);
-					if ((rc = _update_unused_wall(
-						     r_usage,
-						     loc_tres,
-						     loc_seconds))
-					    != SLURM_SUCCESS)
-						goto end_it;
-				}
+			_remove_job_tres_time_from_cluster(
+				loc_c_usage->loc_tres,
+				loc_tres,
+				loc_seconds);
+			/* info("Job %u was running for " */
+			/*      "%d seconds while " */
+			/*      "cluster %s's slurmctld " */
+			/*      "wasn't responding", */
+			/*      job_id, loc_seconds, cluster_name); */
+		}
 
+		/* first figure out the reservation */
+		if (resv_id) {
+			if (seconds <= 0) {
 				_transfer_loc_tres(&loc_tres, a_usage);
 				continue;
 			}
-
 			/*
-			 * only record time for the clusters that have
-			 * registered.  This continue should rarely if
-			 * ever happen.
+			 * Since we have already added the entire
+			 * reservation as used time on the cluster we
+			 * only need to calculate the used time for the
+			 * reservation and then divy up the unused time
+			 * over the associations able to run in the
+			 * reservation. Since the job was to run, or ran
+			 * a reservation we don't care about eligible
+			 * time since that could totally skew the
+			 * clusters reserved time since the job may be
+			 * able to run outside of the reservation.
 			 */
-			if (!c_usage) {
-				_transfer_loc_tres(&loc_tres, a_usage);
-				continue;
-			}
+			list_iterator_reset(r_itr);
+			while ((r_usage = list_next(r_itr))) {
+				int temp_end, temp_start;
+				/*
+				 * since the reservation could have
+				 * changed in some way, thus making a
+				 * new reservation record in the
+				 * database, we have to make sure all
+				 * of the reservations are checked to
+				 * see if such a thing has happened
+				 */
+				if (r_usage->id != resv_id)
+					continue;
+				temp_end = row_end;
+				temp_start = row_start;
+				if (r_usage->start > temp_start)
+					temp_start =
+						r_usage->start;
+				if (r_usage->end < temp_end)
+					temp_end = r_usage->end;
 
-			if (row_start && (seconds > 0)) {
-				/* info("%d assoc %d adds " */
-				/*      "(%d)(%d-%d) * %d = %d " */
-				/*      "to %d", */
-				/*      job_id, */
-				/*      a_usage->id, */
-				/*      seconds, */
-				/*      row_end, row_start, */
-				/*      row_acpu, */
-				/*      seconds * row_acpu, */
-				/*      row_acpu); */
-
-				_add_job_alloc_time_to_cluster(
-					c_usage->loc_tres,
-					loc_tres);
-			}
+				loc_seconds = (temp_end - temp_start);
 
-			/*
-			 * The loc_tres isn't needed after this so transfer to
-			 * the association and go on our merry way.
-			 */
-			_transfer_loc_tres(&loc_tres, a_usage);
+				if (loc_seconds <= 0)
+					continue;
 
-			/* now reserved time */
-			if (!row_start || (row_start >= c_usage->start)) {
-				int temp_end = row_start;
-				int temp_start = row_eligible;
-				if (c_usage->start > temp_start)
-					temp_start = c_usage->start;
-				if (c_usage->end < temp_end)
-					temp_end = c_usage->end;
-				loc_seconds = (temp_end - temp_start);
-				if (loc_seconds > 0) {
+				if (c_usage &&
+				    (r_usage->flags &
+				     RESERVE_FLAG_IGN_JOBS))
 					/*
-					 * If we have pending jobs in an array
-					 * they haven't been inserted into the
-					 * database yet as proper job records,
-					 * so handle them here.
+					 * job usage was not
+					 * bundled with resv
+					 * usage so need to
+					 * account for it
+					 * individually here
 					 */
-					if (array_pending)
-						loc_seconds *= array_pending;
-
-					/* info("%d assoc %d reserved " */
-					/*      "(%d)(%d-%d) * %d * %d = %d " */
-					/*      "to %d", */
-					/*      job_id, */
-					/*      assoc_id, */
-					/*      temp_end - temp_start, */
-					/*      temp_end, temp_start, */
-					/*      row_rcpu, */
-					/*      array_pending, */
-					/*      loc_seconds, */
-					/*      row_rcpu); */
-
-					_add_time_tres(c_usage->loc_tres,
-						       TIME_RESV, TRES_CPU,
-						       loc_seconds *
-						       (uint64_t) row_rcpu,
-						       0);
-				}
+					_add_tres_time_2_list(
+						c_usage->loc_tres, tres_cache,
+						row[JOB_REQ_TRES],
+						TIME_ALLOC,
+						loc_seconds,
+						0, 0);
+
+				_add_time_tres_list(
+					r_usage->loc_tres,
+					loc_tres, TIME_ALLOC,
+					loc_seconds, 1);
+				if ((rc = _update_unused_wall(
+					     r_usage,
+					     loc_tres,
+					     loc_seconds))
+				    != SLURM_SUCCESS)
+					goto end_it;
 			}
+
+			_transfer_loc_tres(&loc_tres, a_usage);
+			continue;
 		}
-		mysql_free_result(result);
 
-		/* now figure out how much more to add to the
-		   associations that could had run in the reservation
-		*/
-		query = NULL;
-		list_iterator_reset(r_itr);
-		while ((r_usage = list_next(r_itr))) {
-			ListIterator t_itr;
-			local_tres_usage_t *loc_tres;
+		/*
+		 * only record time for the clusters that have
+		 * registered.  This continue should rarely if
+		 * ever happen.
+		 */
+		if (!c_usage) {
+			_transfer_loc_tres(&loc_tres, a_usage);
+			continue;
+		}
+
+		if (row_start && (seconds > 0)) {
+			/* info("%d assoc %d adds " */
+			/*      "(%d)(%d-%d) * %d = %d " */
+			/*      "to %d", */
+			/*      job_id, */
+			/*      a_usage->id, */
+			/*      seconds, */
+			/*      row_end, row_start, */
+			/*      row_acpu, */
+			/*      seconds * row_acpu, */
+			/*      row_acpu); */
+
+			_add_job_alloc_time_to_cluster(
+				c_usage->loc_tres,
+				loc_tres);
+		}
 
+		/*
+		 * The loc_tres isn't needed after this so transfer to
+		 * the association and go on our merry way.
+		 */
+		_transfer_loc_tres(&loc_tres, a_usage);
+
+		/* now reserved time */
+		if (!row_start || (row_start >= c_usage->start)) {
+			int temp_end = row_start;
+			int temp_start = row_eligible;
+			if (c_usage->start > temp_start)
+				temp_start = c_usage->start;
+			if (c_usage->end < temp_end)
+				temp_end = c_usage->end;
+			loc_seconds = (temp_end - temp_start);
+			if (loc_seconds > 0) {
+				/*
+				 * If we have pending jobs in an array
+				 * they haven't been inserted into the
+				 * database yet as proper job records,
+				 * so handle them here.
+				 */
+				if (array_pending)
+					loc_seconds *= array_pending;
+
+				/* info("%d assoc %d reserved " */
+				/*      "(%d)(%d-%d) * %d * %d = %d " */
+				/*      "to %d", */
+				/*      job_id, */
+				/*      assoc_id, */
+				/*      temp_end - temp_start, */
+				/*      temp_end, temp_start, */
+				/*      row_rcpu, */
+				/*      array_pending, */
+				/*      loc_seconds, */
+				/*      row_rcpu); */
+
+				_add_time_tres(c_usage->loc_tres,
+					       TIME_RESV, TRES_CPU,
+					       loc_seconds *
+					       (uint64_t) row_rcpu,
+					       0);
+			}
+		}
+	}
+	mysql_free_result(result);
+
+	/* now figure out how much more to add to the
+	   associations that could had run in the reservation
+	*/
+	query = NULL;
+	list_iterator_reset(r_itr);
+	while ((r_usage = list_next(r_itr))) {
+		ListIterator t_itr;
+		local_tres_usage_t *loc_tres;
+
+		if (roll->resv_wall_list)
+			_add_resv_wall(roll, r_usage, curr_start);
+		else
 			xstrfmtcat(query, "update \"%s_%s\" set unused_wall=%f where id_resv=%u and time_start=%ld;",
 				   cluster_name, resv_table,
 				   r_usage->unused_wall, r_usage->id,
 				   r_usage->orig_start);
 
-			if (!r_usage->loc_tres ||
-			    !list_count(r_usage->loc_tres))
-				continue;
+		if (!r_usage->loc_tres ||
+		    !list_count(r_usage->loc_tres))
+			continue;
 
-			t_itr = list_iterator_create(r_usage->loc_tres);
-			while ((loc_tres = list_next(t_itr))) {
-				int64_t idle = loc_tres->total_time -
-					loc_tres->time_alloc;
-				char *assoc = NULL;
-				ListIterator tmp_itr = NULL;
-				int assoc_cnt, resv_unused_secs;
-
-				if (idle <= 0)
-					break; /* since this will be
-						* the same for all TRES	*/
-
-				/* now divide that time by the number of
-				   associations in the reservation and add
-				   them to each association */
-				resv_unused_secs = idle;
-				assoc_cnt = list_count(r_usage->local_assocs);
-				if (assoc_cnt)
-					resv_unused_secs /= assoc_cnt;
-				/* info("resv %d got %d seconds for TRES %u " */
-				/*      "for %d assocs", */
-				/*      r_usage->id, resv_unused_secs, */
-				/*      loc_tres->id, */
-				/*      list_count(r_usage->local_assocs)); */
-				tmp_itr = list_iterator_create(
-					r_usage->local_assocs);
-				while ((assoc = list_next(tmp_itr))) {
-					uint32_t associd = slurm_atoul(assoc);
-					if ((last_id != associd) &&
-					    !(a_usage = list_find_first(
-						      assoc_usage_list,
-						      _find_id_usage,
-						      &associd))) {
-						a_usage = xmalloc(
-							sizeof(local_id_usage_t));
-						a_usage->id = associd;
-						list_append(assoc_usage_list,
-							    a_usage);
-						last_id = associd;
-						a_usage->loc_tres = list_create(
-							_destroy_local_tres_usage);
-					}
-
-					_add_time_tres(a_usage->loc_tres,
-						       TIME_ALLOC, loc_tres->id,
-						       resv_unused_secs, 0);
+		t_itr = list_iterator_create(r_usage->loc_tres);
+		while ((loc_tres = list_next(t_itr))) {
+			int64_t idle = loc_tres->total_time -
+				loc_tres->time_alloc;
+			char *assoc = NULL;
+			ListIterator tmp_itr = NULL;
+			int assoc_cnt, resv_unused_secs;
+
+			if (idle <= 0)
+				break; /* since this will be
+					* the same for all TRES	*/
+
+			/* now divide that time by the number of
+			   associations in the reservation and add
+			   them to each association */
+			resv_unused_secs = idle;
+			assoc_cnt = list_count(r_usage->local_assocs);
+			if (assoc_cnt)
+				resv_unused_secs /= assoc_cnt;
+			/* info("resv %d got %d seconds for TRES %u " */
+			/*      "for %d assocs", */
+			/*      r_usage->id, resv_unused_secs, */
+			/*      loc_tres->id, */
+			/*      list_count(r_usage->local_assocs)); */
+			tmp_itr = list_iterator_create(
+				r_usage->local_assocs);
+			while ((assoc = list_next(tmp_itr))) {
+				uint32_t associd = slurm_atoul(assoc);
+				if ((last_id != associd) &&
+				    !(a_usage = xhash_get(
+					      assoc_hash,
+					      (char *) &associd,
+					      sizeof(associd)))) {
+					a_usage = xmalloc(
+						sizeof(local_id_usage_t));
+					a_usage->id = associd;
+					list_append(assoc_usage_list,
+						    a_usage);
+					xhash_add(assoc_hash, a_usage);
+					last_id = associd;
+					a_usage->loc_tres = list_create(
+						_destroy_local_tres_usage);
 				}
-				list_iterator_destroy(tmp_itr);
-			}
-			list_iterator_destroy(t_itr);
-		}
 
-		if (query) {
-			DB_DEBUG(DB_USAGE, mysql_conn->conn, "query\n%s",
-			         query);
-			rc = mysql_db_query(mysql_conn, query);
-			xfree(query);
-			if (rc != SLURM_SUCCESS) {
-				error("couldn't update reservations with unused time");
-				goto end_it;
+				_add_time_tres(a_usage->loc_tres,
+					       TIME_ALLOC, loc_tres->id,
+					       resv_unused_secs, 0);
 			}
+			list_iterator_destroy(tmp_itr);
 		}
+		list_iterator_destroy(t_itr);
+	}
 
-		/* now apply the down time from the slurmctld disconnects */
-		if (c_usage) {
-			list_iterator_reset(c_itr);
-			while ((loc_c_usage = list_next(c_itr))) {
-				local_tres_usage_t *loc_tres;
-				ListIterator tmp_itr = list_iterator_create(
-					loc_c_usage->loc_tres);
-				while ((loc_tres = list_next(tmp_itr)))
-					_add_time_tres(c_usage->loc_tres,
-						       TIME_DOWN,
-						       loc_tres->id,
-						       loc_tres->total_time,
-						       0);
-				list_iterator_destroy(tmp_itr);
-			}
-
-			if ((rc = _process_cluster_usage(
-				     mysql_conn, cluster_name, curr_start,
-				     curr_end, now, c_usage))
-			    != SLURM_SUCCESS) {
-				goto end_it;
-			}
+	if (query) {
+		DB_DEBUG(DB_USAGE, mysql_conn->conn, "query\n%s",
+		         query);
+		rc = mysql_db_query(mysql_conn, query);
+		xfree(query);
+		if (rc != SLURM_SUCCESS) {
+			error("couldn't update reservations with unused time");
+			goto end_it;
 		}
+	}
 
-		list_iterator_reset(a_itr);
-		while ((a_usage = list_next(a_itr)))
-			_create_id_usage_insert(cluster_name, ASSOC_TABLES,
-						curr_start, now,
-						a_usage, &query);
-		if (query) {
-			DB_DEBUG(DB_USAGE, mysql_conn->conn, "query\n%s",
-			         query);
-			rc = mysql_db_query(mysql_conn, query);
-			xfree(query);
-			if (rc != SLURM_SUCCESS) {
-				error("Couldn't add assoc hour rollup");
-				goto end_it;
-			}
+	/* now apply the down time from the slurmctld disconnects */
+	if (c_usage) {
+		list_iterator_reset(c_itr);
+		while ((loc_c_usage = list_next(c_itr))) {
+			local_tres_usage_t *loc_tres;
+			ListIterator tmp_itr = list_iterator_create(
+				loc_c_usage->loc_tres);
+			while ((loc_tres = list_next(tmp_itr)))
+				_add_time_tres(c_usage->loc_tres,
+					       TIME_DOWN,
+					       loc_tres->id,
+					       loc_tres->total_time,
+					       0);
+			list_iterator_destroy(tmp_itr);
 		}
 
-		if (!track_wckey)
-			goto end_loop;
-
-		list_iterator_reset(w_itr);
-		while ((w_usage = list_next(w_itr)))
-			_create_id_usage_insert(cluster_name, WCKEY_TABLES,
-						curr_start, now,
-						w_usage, &query);
-		if (query) {
-			DB_DEBUG(DB_USAGE, mysql_conn->conn, "query\n%s",
-			         query);
-			rc = mysql_db_query(mysql_conn, query);
-			xfree(query);
-			if (rc != SLURM_SUCCESS) {
-				error("Couldn't add wckey hour rollup");
-				goto end_it;
-			}
+		if ((rc = _process_cluster_usage(
+			     mysql_conn, cluster_name, curr_start,
+			     curr_end, now, c_usage))
+		    != SLURM_SUCCESS) {
+			goto end_it;
 		}
+	}
 
-	end_loop:
-		_destroy_local_cluster_usage(c_usage);
+	list_iterator_reset(a_itr);
+	while ((a_usage = list_next(a_itr)))
+		_create_id_usage_insert(cluster_name, ASSOC_TABLES,
+					curr_start, now,
+					a_usage, &query);
+	if (query) {
+		DB_DEBUG(DB_USAGE, mysql_conn->conn, "query\n%s",
+		         query);
+		rc = mysql_db_query(mysql_conn, query);
+		xfree(query);
+		if (rc != SLURM_SUCCESS) {
+			error("Couldn't add assoc hour rollup");
+			goto end_it;
+		}
+	}
 
-		c_usage     = NULL;
-		r_usage     = NULL;
-		a_usage     = NULL;
-		w_usage     = NULL;
+	if (!track_wckey)
+		goto end_it;
 
-		list_flush(assoc_usage_list);
-		list_flush(cluster_down_list);
-		list_flush(wckey_usage_list);
-		list_flush(resv_usage_list);
-		curr_start = curr_end;
-		curr_end = curr_start + add_sec;
+	list_iterator_reset(w_itr);
+	while ((w_usage = list_next(w_itr)))
+		_create_id_usage_insert(cluster_name, WCKEY_TABLES,
+					curr_start, now,
+					w_usage, &query);
+	if (query) {
+		DB_DEBUG(DB_USAGE, mysql_conn->conn, "query\n%s",
+		         query);
+		rc = mysql_db_query(mysql_conn, query);
+		xfree(query);
+		if (rc != SLURM_SUCCESS) {
+			error("Couldn't add wckey hour rollup");
+			goto end_it;
+		}
 	}
+
 end_it:
 	xfree(query);
-	xfree(suspend_str);
-	xfree(job_str);
 	_destroy_local_cluster_usage(c_usage);
 
-	if (a_itr)
-		list_iterator_destroy(a_itr);
-	if (c_itr)
-		list_iterator_destroy(c_itr);
-	if (w_itr)
-		list_iterator_destroy(w_itr);
-	if (r_itr)
-		list_iterator_destroy(r_itr);
+	list_iterator_destroy(a_itr);
+	list_iterator_destroy(c_itr);
+	list_iterator_destroy(w_itr);
+	list_iterator_destroy(r_itr);
 
+	xhash_free(assoc_hash);
+	xhash_free(wckey_hash);
 	FREE_NULL_LIST(assoc_usage_list);
 	FREE_NULL_LIST(cluster_down_list);
 	FREE_NULL_LIST(wckey_usage_list);
 	FREE_NULL_LIST(resv_usage_list);
 
+	return rc;
+}
+
+static void *_rollup_hour_thread(void *arg)
+{
+	hour_rollup_t *roll = arg;
+	mysql_conn_t mysql_conn;
+	xhash_t *tres_cache = xhash_init(_tres_parsed_hash_id,
+					 _destroy_local_tres_parsed);
+	time_t curr_start;
+	int rc;
+
+	memset(&mysql_conn, 0, sizeof(mysql_conn_t));
+	mysql_conn.rollback = 1;
+	mysql_conn.conn = roll->conn;
+	slurm_mutex_init(&mysql_conn.lock);
+
+	/* Each thread needs its own connection */
+	rc = check_connection(&mysql_conn);
+
+	while (rc == SLURM_SUCCESS) {
+		slurm_mutex_lock(&roll->lock);
+		if ((roll->rc != SLURM_SUCCESS) ||
+		    (roll->next_start >= roll->end)) {
+			slurm_mutex_unlock(&roll->lock);
+			break;
+		}
+		curr_start = roll->next_start;
+		roll->next_start += 3600;
+		slurm_mutex_unlock(&roll->lock);
+
+		/*
+		 * Commit each hour on its own to keep the threads from holding
+		 * locks on the usage tables for long. The caller only moves
+		 * last_ran on once all of them made it, so hours of a failed
+		 * rollup are just rolled up again.
+		 */
+		if (((rc = _rollup_hour(&mysql_conn, roll, tres_cache,
+					curr_start, curr_start + 3600))
+		     == SLURM_SUCCESS) &&
+		    mysql_db_commit(&mysql_conn)) {
+			char start[25];
+			error("Couldn't commit cluster (%s) hour rollup for %s",
+			      roll->cluster_name,
+			      slurm_ctime2_r(&curr_start, start));
+			rc = SLURM_ERROR;
+		}
+	}
+
+	if (rc != SLURM_SUCCESS) {
+		slurm_mutex_lock(&roll->lock);
+		roll->rc = rc;
+		slurm_mutex_unlock(&roll->lock);
+	}
+
+	mysql_db_close_db_connection(&mysql_conn);
+	slurm_mutex_destroy(&mysql_conn.lock);
+	xhash_free(tres_cache);
+
+	return NULL;
+}
+
+extern int as_mysql_hourly_rollup(mysql_conn_t *mysql_conn,
+				  char *cluster_name,
+				  time_t start, time_t end,
+				  uint16_t archive_data)
+{
+	int rc = SLURM_SUCCESS;
+	int add_sec = 3600;
+	int i=0, threads;
+	time_t curr_start = start;
+	time_t curr_end = curr_start + add_sec;
+	char *query = NULL;
+	MYSQL_RES *result = NULL;
+	MYSQL_ROW row;
+	hour_rollup_t roll;
+	pthread_t thread_id[MAX_HOUR_ROLLUP_THREADS];
+	xhash_t *tres_cache = NULL;
+	/* char start_char[20], end_char[20]; */
+
+	char *job_req_inx[] = {
+		"job.job_db_inx",
+//		"job.id_job",
+		"job.id_assoc",
+		"job.id_wckey",
+		"job.array_task_pending",
+		"job.time_eligible",
+		"job.time_start",
+		"job.time_end",
+		"job.time_suspended",
+		"job.cpus_req",
+		"job.id_resv",
+		"job.tres_alloc"
+	};
+	char *job_str = NULL;
+
+	char *suspend_req_inx[] = {
+		"time_start",
+		"time_end"
+	};
+	char *suspend_str = NULL;
+
+	i=0;
+	xstrfmtcat(job_str, "%s", job_req_inx[i]);
+	for(i=1; i<JOB_REQ_COUNT; i++) {
+		xstrfmtcat(job_str, ", %s", job_req_inx[i]);
+	}
+
+	i=0;
+	xstrfmtcat(suspend_str, "%s", suspend_req_inx[i]);
+	for(i=1; i<SUSPEND_REQ_COUNT; i++) {
+		xstrfmtcat(suspend_str, ", %s", suspend_req_inx[i]);
+	}
+
+	/* We need to figure out the dimensions of this cluster */
+	query = xstrdup_printf("select dimensions from %s where name='%s'",
+			       cluster_table, cluster_name);
+	DB_DEBUG(DB_USAGE, mysql_conn->conn, "query\n%s", query);
+	result = mysql_db_query_ret(mysql_conn, query, 0);
+	xfree(query);
+
+	if (!result) {
+		error("%s: error querying cluster_table", __func__);
+		rc = SLURM_ERROR;
+		goto end_it;
+	}
+	row = mysql_fetch_row(result);
+
+	if (!row) {
+		error("%s: no cluster by name %s known",
+		      __func__, cluster_name);
+		rc = SLURM_ERROR;
+		goto end_it;
+	}
+
+	memset(&roll, 0, sizeof(roll));
+	roll.cluster_name = cluster_name;
+	roll.conn = mysql_conn->conn;
+	roll.dims = atoi(row[0]);
+	roll.job_str = job_str;
+	roll.now = time(NULL);
+	roll.suspend_str = suspend_str;
+	roll.track_wckey = slurm_get_track_wckey();
+	mysql_free_result(result);
+
+	/*
+	 * The hours only depend on each other through the unused wall time
+	 * of the reservations, so when catching up on several hours roll them
+	 * up in parallel on their own connections and work out the unused
+	 * wall time from what each hour gathered afterwards.
+	 */
+	threads = (end - start + add_sec - 1) / add_sec;
+	if (threads > MAX_HOUR_ROLLUP_THREADS)
+		threads = MAX_HOUR_ROLLUP_THREADS;
+
+	if (threads > 1) {
+		roll.end = end;
+		roll.next_start = start;
+		roll.resv_wall_list = list_create(xfree_ptr);
+		slurm_mutex_init(&roll.lock);
+
+		for (i = 0; i < threads; i++)
+			slurm_thread_create(&thread_id[i], _rollup_hour_thread,
+					    &roll);
+		for (i = 0; i < threads; i++)
+			pthread_join(thread_id[i], NULL);
+
+		if ((rc = roll.rc) == SLURM_SUCCESS)
+			rc = _update_resv_walls(mysql_conn, &roll);
+		curr_end = end;
+
+		FREE_NULL_LIST(roll.resv_wall_list);
+		slurm_mutex_destroy(&roll.lock);
+		goto end_it;
+	}
+
+	tres_cache = xhash_init(_tres_parsed_hash_id,
+				_destroy_local_tres_parsed);
+	while (curr_start < end) {
+		if ((rc = _rollup_hour(mysql_conn, &roll, tres_cache,
+				       curr_start, curr_end))
+		    != SLURM_SUCCESS)
+			goto end_it;
+		curr_start = curr_end;
+		curr_end = curr_start + add_sec;
+	}
+
+end_it:
+	xfree(query);
+	xfree(suspend_str);
+	xfree(job_str);
+	xhash_free(tres_cache);
+
 /* 	info("stop start %s", slurm_ctime2(&curr_start)); */
 /* 	info("stop end %s", slurm_ctime2(&curr_end)); */
 
@@ -2882,6 +2882,11 @@ extern List jobacct_storage_p_get_jobs_cond(void *db_conn, uid_t uid,
 
 	memset(&get_msg, 0, sizeof(dbd_cond_msg_t));
 
+	/* An older slurmdbd can't page, it sends back all the jobs at once */
+	if (job_cond && job_cond->page_size &&
+	    (slurmdbd_conn_version() < SLURM_20_11_PROTOCOL_VERSION))
+		job_cond->page_size = 0;
+
 	get_msg.cond = job_cond;
 
 	req.msg_type = DBD_GET_JOBS_COND;
@@ -37,6 +37,8 @@
  *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
 \*****************************************************************************/
 
+#include <dirent.h>
+
 #include "src/common/slurm_xlator.h"
 
 #include "src/common/fd.h"
@@ -50,13 +52,15 @@
 
 enum {
 	MAX_DBD_ACTION_DISCARD,
-	MAX_DBD_ACTION_EXIT
+	MAX_DBD_ACTION_EXIT,
+	MAX_DBD_ACTION_SPOOL
 };
 
 #define DBD_MAGIC		0xDEAD3219
 #define SLURMDBD_TIMEOUT	900	/* Seconds SlurmDBD for response */
 #define DEBUG_PRINT_MAX_MSG_TYPES 10
 #define MAX_DBD_DEFAULT_ACTION MAX_DBD_ACTION_DISCARD
+#define DBD_SPOOL_SEG_MSGS	1000	/* Messages per spool segment file */
 
 static pthread_mutex_t agent_lock = PTHREAD_MUTEX_INITIALIZER;
 static pthread_cond_t  agent_cond = PTHREAD_COND_INITIALIZER;
@@ -72,6 +76,20 @@ static pthread_cond_t  slurmdbd_cond = PTHREAD_COND_INITIALIZER;
 
 static int max_dbd_msg_action = MAX_DBD_DEFAULT_ACTION;
 
+/*
+ * With max_dbd_msg_action=spool the messages that don't fit in agent_list
+ * are appended to the dbd.spool.<seq> segment files. Segments spool_first
+ * up to spool_next exist, the oldest is moved into agent_list once it is
+ * empty. While any segment exists, whatever the action, new messages are
+ * appended to the spool. Protected by agent_lock.
+ */
+static uint32_t  spool_first    = 0;
+static uint32_t  spool_next     = 0;
+static int       spool_fd       = -1;	/* segment being written */
+static uint32_t  spool_fd_msgs  = 0;	/* messages written to spool_fd */
+static bool      spool_loaded   = false; /* spool_first is in agent_list */
+static uint32_t  spool_msgs     = 0;	/* messages waiting in segments */
+
 static void _acct_full(void)
 {
 	if (running_in_slurmctld())
@@ -346,84 +364,96 @@ static Buf _load_dbd_rec(int fd)
 	return buffer;
 }
 
-static void _load_dbd_state(void)
+/*
+ * Append the messages saved in fname to agent_list
+ * RET number of messages recovered, -1 if the file could not be opened
+ */
+static int _load_dbd_file(char *fname)
 {
-	char *dbd_fname = NULL;
 	Buf buffer;
 	int fd, recovered = 0;
 	uint16_t rpc_version = 0;
+	char *ver_str = NULL;
+	uint32_t ver_str_len;
 
-	xstrfmtcat(dbd_fname, "%s/dbd.messages", slurm_conf.state_save_location);
-	fd = open(dbd_fname, O_RDONLY);
+	fd = open(fname, O_RDONLY);
 	if (fd < 0) {
 		/* don't print an error message if there is no file */
 		if (errno == ENOENT)
 			debug4("slurmdbd: There is no state save file to "
-			       "open by name %s", dbd_fname);
+			       "open by name %s", fname);
 		else
 			error("slurmdbd: Opening state save file %s: %m",
-			      dbd_fname);
-	} else {
-		char *ver_str = NULL;
-		uint32_t ver_str_len;
+			      fname);
+		return -1;
+	}
 
-		buffer = _load_dbd_rec(fd);
+	buffer = _load_dbd_rec(fd);
+	if (buffer == NULL)
+		goto end_it;
+	/* This is set to the end of the buffer for send so we
+	   need to set it back to 0 */
+	set_buf_offset(buffer, 0);
+	safe_unpackstr_xmalloc(&ver_str, &ver_str_len, buffer);
+	debug3("Version string in dbd_state header is %s", ver_str);
+unpack_error:
+	free_buf(buffer);
+	buffer = NULL;
+	if (ver_str) {
+		/* get the version after VER */
+		rpc_version = slurm_atoul(ver_str + 3);
+		xfree(ver_str);
+	}
+
+	while (1) {
+		/* If the buffer was not the VER%d string it
+		   was an actual message so we don't want to
+		   skip it.
+		*/
+		if (!buffer)
+			buffer = _load_dbd_rec(fd);
 		if (buffer == NULL)
-			goto end_it;
-		/* This is set to the end of the buffer for send so we
-		   need to set it back to 0 */
-		set_buf_offset(buffer, 0);
-		safe_unpackstr_xmalloc(&ver_str, &ver_str_len, buffer);
-		debug3("Version string in dbd_state header is %s", ver_str);
-	unpack_error:
-		free_buf(buffer);
-		buffer = NULL;
-		if (ver_str) {
-			/* get the version after VER */
-			rpc_version = slurm_atoul(ver_str + 3);
-			xfree(ver_str);
+			break;
+		if (rpc_version != SLURM_PROTOCOL_VERSION) {
+			/* unpack and repack with new
+			 * PROTOCOL_VERSION just so we keep
+			 * things up to date.
+			 */
+			persist_msg_t msg = {0};
+			int rc;
+			set_buf_offset(buffer, 0);
+			rc = unpack_slurmdbd_msg(
+				&msg, rpc_version, buffer);
+			free_buf(buffer);
+			if (rc == SLURM_SUCCESS)
+				buffer = pack_slurmdbd_msg(
+					&msg, SLURM_PROTOCOL_VERSION);
+			else
+				buffer = NULL;
 		}
-
-		while (1) {
-			/* If the buffer was not the VER%d string it
-			   was an actual message so we don't want to
-			   skip it.
-			*/
-			if (!buffer)
-				buffer = _load_dbd_rec(fd);
-			if (buffer == NULL)
-				break;
-			if (rpc_version != SLURM_PROTOCOL_VERSION) {
-				/* unpack and repack with new
-				 * PROTOCOL_VERSION just so we keep
-				 * things up to date.
-				 */
-				persist_msg_t msg = {0};
-				int rc;
-				set_buf_offset(buffer, 0);
-				rc = unpack_slurmdbd_msg(
-					&msg, rpc_version, buffer);
-				free_buf(buffer);
-				if (rc == SLURM_SUCCESS)
-					buffer = pack_slurmdbd_msg(
-						&msg, SLURM_PROTOCOL_VERSION);
-				else
-					buffer = NULL;
-			}
-			if (!buffer) {
-				error("no buffer given");
-				continue;
-			}
-			if (!list_enqueue(agent_list, buffer))
-				fatal("slurmdbd: list_enqueue, no memory");
-			recovered++;
-			buffer = NULL;
+		if (!buffer) {
+			error("no buffer given");
+			continue;
 		}
+		if (!list_enqueue(agent_list, buffer))
+			fatal("slurmdbd: list_enqueue, no memory");
+		recovered++;
+		buffer = NULL;
+	}
+
+end_it:
+	(void) close(fd);
+	return recovered;
+}
 
-	end_it:
+static void _load_dbd_state(void)
+{
+	char *dbd_fname = NULL;
+	int recovered;
+
+	xstrfmtcat(dbd_fname, "%s/dbd.messages", slurm_conf.state_save_location);
+	if ((recovered = _load_dbd_file(dbd_fname)) >= 0)
 		verbose("slurmdbd: recovered %d pending RPCs", recovered);
-		(void) close(fd);
-	}
 	xfree(dbd_fname);
 }
 
@@ -465,6 +495,179 @@ static int _save_dbd_rec(int fd, Buf buffer)
 	return SLURM_SUCCESS;
 }
 
+/* Write the VER%d header record of a state save or spool file */
+static int _save_dbd_ver(int fd)
+{
+	char curr_ver_str[10];
+	Buf buffer;
+	int rc;
+
+	snprintf(curr_ver_str, sizeof(curr_ver_str),
+		 "VER%d", SLURM_PROTOCOL_VERSION);
+	buffer = init_buf(strlen(curr_ver_str));
+	packstr(curr_ver_str, buffer);
+	rc = _save_dbd_rec(fd, buffer);
+	free_buf(buffer);
+
+	return rc;
+}
+
+static char *_spool_fname(uint32_t seq)
+{
+	return xstrdup_printf("%s/dbd.spool.%u",
+			      slurm_conf.state_save_location, seq);
+}
+
+/* Return true while newer messages than agent_list's are in the spool */
+static bool _spool_active(void)
+{
+	return (spool_first != spool_next);
+}
+
+static void _spool_close(void)
+{
+	if (spool_fd < 0)
+		return;
+
+	if (fsync_and_close(spool_fd, "dbd.spool"))
+		error("slurmdbd: error from fsync_and_close");
+	spool_fd = -1;
+}
+
+/* Count the messages of a spool segment without loading them */
+static uint32_t _spool_count(char *fname)
+{
+	uint32_t msg_size, cnt = 0;
+	int fd;
+
+	if ((fd = open(fname, O_RDONLY)) < 0)
+		return 0;
+	while (read(fd, &msg_size, sizeof(msg_size)) == sizeof(msg_size)) {
+		if (lseek(fd, msg_size + sizeof(uint32_t), SEEK_CUR) < 0)
+			break;
+		cnt++;
+	}
+	(void) close(fd);
+
+	/* Don't count the VER%d header */
+	return cnt ? (cnt - 1) : 0;
+}
+
+/* Find the spool segments left by a previous slurmctld */
+static void _spool_init(void)
+{
+	DIR *dir;
+	struct dirent *ent;
+	uint32_t seq, first = NO_VAL, last = 0;
+	char *fname, *end_ptr;
+
+	spool_first = spool_next = spool_msgs = 0;
+	spool_loaded = false;
+
+	if (!(dir = opendir(slurm_conf.state_save_location)))
+		return;
+	while ((ent = readdir(dir))) {
+		if (xstrncmp(ent->d_name, "dbd.spool.", 10))
+			continue;
+		seq = strtoul(ent->d_name + 10, &end_ptr, 10);
+		if (end_ptr[0])
+			continue;
+		if ((first == NO_VAL) || (seq < first))
+			first = seq;
+		if (seq > last)
+			last = seq;
+	}
+	closedir(dir);
+
+	if (first == NO_VAL)
+		return;
+
+	spool_first = first;
+	spool_next = last + 1;
+	for (seq = spool_first; seq != spool_next; seq++) {
+		fname = _spool_fname(seq);
+		spool_msgs += _spool_count(fname);
+		xfree(fname);
+	}
+	verbose("slurmdbd: %u pending RPCs spooled in %u files",
+		spool_msgs, spool_next - spool_first);
+}
+
+/* Append a message to the newest spool segment */
+static int _spool_msg(Buf buffer)
+{
+	char *fname;
+
+	if ((spool_fd >= 0) && (spool_fd_msgs >= DBD_SPOOL_SEG_MSGS))
+		_spool_close();
+
+	if (spool_fd < 0) {
+		fname = _spool_fname(spool_next);
+		spool_fd = open(fname, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+				0600);
+		if (spool_fd < 0) {
+			error("slurmdbd: Creating spool file %s: %m", fname);
+			xfree(fname);
+			return SLURM_ERROR;
+		}
+		if (!_spool_active())
+			info("slurmdbd: agent queue is full, spooling messages to %s",
+			     fname);
+		xfree(fname);
+		spool_next++;
+		spool_fd_msgs = 0;
+		if (_save_dbd_ver(spool_fd) != SLURM_SUCCESS) {
+			_spool_close();
+			return SLURM_ERROR;
+		}
+	}
+
+	if (_save_dbd_rec(spool_fd, buffer) != SLURM_SUCCESS) {
+		/* Don't append behind a partial record */
+		_spool_close();
+		return SLURM_ERROR;
+	}
+	spool_fd_msgs++;
+	spool_msgs++;
+
+	return SLURM_SUCCESS;
+}
+
+/*
+ * Move the oldest spool segment into the empty agent_list. The segment is
+ * only removed once the next one is needed, which is when all of its
+ * messages have been sent.
+ */
+static void _spool_load(void)
+{
+	char *fname;
+	int loaded;
+
+	while (!list_count(agent_list)) {
+		if (spool_loaded) {
+			fname = _spool_fname(spool_first++);
+			(void) unlink(fname);
+			xfree(fname);
+			spool_loaded = false;
+		}
+		if (!_spool_active())
+			return;
+
+		if (spool_first + 1 == spool_next)
+			_spool_close();	/* don't read what is being written */
+
+		fname = _spool_fname(spool_first);
+		loaded = _load_dbd_file(fname);
+		xfree(fname);
+		spool_loaded = true;
+		if (loaded > 0)
+			spool_msgs -= MIN(loaded, spool_msgs);
+
+		log_flag(AGENT, "%s: loaded %d spooled messages, %u left",
+			 __func__, loaded, spool_msgs);
+	}
+}
+
 static void _save_dbd_state(void)
 {
 	char *dbd_fname = NULL;
@@ -473,20 +676,25 @@ static void _save_dbd_state(void)
 	uint16_t msg_type;
 	uint32_t offset;
 
+	/*
+	 * What is left of the spool segment in agent_list is saved below,
+	 * the rest of the spool is loaded after it on the next start.
+	 */
+	_spool_close();
+	if (spool_loaded) {
+		char *spool_fname = _spool_fname(spool_first++);
+		(void) unlink(spool_fname);
+		xfree(spool_fname);
+		spool_loaded = false;
+	}
+
 	xstrfmtcat(dbd_fname, "%s/dbd.messages", slurm_conf.state_save_location);
 	(void) unlink(dbd_fname);	/* clear save state */
 	fd = open(dbd_fname, O_WRONLY | O_CREAT | O_TRUNC, 0600);
 	if (fd < 0) {
 		error("slurmdbd: Creating state save file %s", dbd_fname);
 	} else if (list_count(agent_list)) {
-		char curr_ver_str[10];
-		snprintf(curr_ver_str, sizeof(curr_ver_str),
-			 "VER%d", SLURM_PROTOCOL_VERSION);
-		buffer = init_buf(strlen(curr_ver_str));
-		packstr(curr_ver_str, buffer);
-		rc = _save_dbd_rec(fd, buffer);
-		free_buf(buffer);
-		if (rc != SLURM_SUCCESS)
+		if ((rc = _save_dbd_ver(fd)) != SLURM_SUCCESS)
 			goto end_it;
 
 		while ((buffer = list_dequeue(agent_list))) {
@@ -586,6 +794,10 @@ static int _purge_job_start_req(void)
 
 static void _max_dbd_msg_action(uint32_t *msg_cnt)
 {
+	/* Nothing is purged, messages over MaxDBDMsgs go to the spool */
+	if (max_dbd_msg_action == MAX_DBD_ACTION_SPOOL)
+		return;
+
 	if (max_dbd_msg_action == MAX_DBD_ACTION_EXIT) {
 		if (*msg_cnt < slurm_conf.max_dbd_msgs)
 			return;
@@ -792,6 +1004,10 @@ static void *_agent(void *x)
 
 		slurm_mutex_lock(&agent_lock);
 		cnt = list_count(agent_list);
+		if ((cnt == 0) && _spool_active()) {
+			_spool_load();
+			cnt = list_count(agent_list);
+		}
 		if ((cnt == 0) || (slurmdbd_conn->fd < 0) ||
 		    (fail_time && (difftime(time(NULL), fail_time) < 10))) {
 			slurm_mutex_unlock(&slurmdbd_lock);
@@ -936,6 +1152,7 @@ static void _create_agent(void)
 	if (agent_list == NULL) {
 		agent_list = list_create(slurmdbd_free_buffer);
 		_load_dbd_state();
+		_spool_init();
 	}
 
 	if (agent_tid == 0) {
@@ -1224,7 +1441,23 @@ extern int send_slurmdbd_msg(uint16_t rpc_version, persist_msg_t *req)
 	/* Handle action */
 	_max_dbd_msg_action(&cnt);
 
-	if (cnt < slurm_conf.max_dbd_msgs) {
+	/*
+	 * Once spooling, keep spooling until the spool has been sent, even
+	 * if MaxDBDMsgs' action changed since, so that no message gets ahead
+	 * of the spooled ones.
+	 */
+	if (_spool_active() ||
+	    ((max_dbd_msg_action == MAX_DBD_ACTION_SPOOL) &&
+	     (cnt >= slurm_conf.max_dbd_msgs))) {
+		if (_spool_msg(buffer) != SLURM_SUCCESS) {
+			error("slurmdbd: unable to spool, discarding %s:%u request",
+			      slurmdbd_msg_type_2_str(req->msg_type, 1),
+			      req->msg_type);
+			(slurmdbd_conn->trigger_callbacks.acct_full)();
+			rc = SLURM_ERROR;
+		}
+		free_buf(buffer);
+	} else if (cnt < slurm_conf.max_dbd_msgs) {
 		if (list_enqueue(agent_list, buffer) == NULL)
 			fatal("list_enqueue: memory allocation failure");
 	} else {
@@ -1251,9 +1484,17 @@ extern bool slurmdbd_conn_active(void)
 	return true;
 }
 
+extern uint16_t slurmdbd_conn_version(void)
+{
+	if (!slurmdbd_conn)
+		return 0;
+
+	return slurmdbd_conn->version;
+}
+
 extern int slurmdbd_agent_queue_count(void)
 {
-	return list_count(agent_list);
+	return list_count(agent_list) + spool_msgs;
 }
 
 extern void slurmdbd_agent_config_setup(void)
@@ -1280,6 +1521,8 @@ extern void slurmdbd_agent_config_setup(void)
 			max_dbd_msg_action = MAX_DBD_ACTION_DISCARD;
 		else if (!xstrcasecmp(type, "exit"))
 			max_dbd_msg_action = MAX_DBD_ACTION_EXIT;
+		else if (!xstrcasecmp(type, "spool"))
+			max_dbd_msg_action = MAX_DBD_ACTION_SPOOL;
 		else
 			fatal("Unknown SlurmctldParameters option for max_dbd_msg_action '%s'",
 			      type);
@@ -73,6 +73,9 @@ extern int send_slurmdbd_recv_rc_msg(uint16_t rpc_version,
 /* Return true if connection to slurmdbd is active, false otherwise. */
 extern bool slurmdbd_conn_active(void);
 
+/* Return the protocol version spoken with the slurmdbd, 0 if not connected */
+extern uint16_t slurmdbd_conn_version(void);
+
 /* Return the number of messages waiting to be sent to the DBD */
 extern int slurmdbd_agent_queue_count(void);
 
@@ -177,7 +177,7 @@ static int _check_lustre_fs(void)
 	return rc;
 }
 
-/* _read_lustre_counters()
+/* _read_lustre_stats()
  *
  * Read counters from all mounted lustre fs
  * from the file stats under the directories:
@@ -192,14 +192,13 @@ static int _check_lustre_fs(void)
  * write_bytes         9007 samples [bytes] 2 4194304 31008331389
  *
  */
-static int _read_lustre_counters(void)
+static int _read_lustre_stats(lustre_stats_t *stats)
 {
 	char *lustre_dir;
 	DIR *proc_dir;
 	struct dirent *entry;
 	FILE *fff;
 	char buffer[BUFSIZ];
-	static bool first = true;
 
 	lustre_dir = _llite_path();
 	if (!lustre_dir) {
@@ -213,6 +212,10 @@ static int _read_lustre_counters(void)
 		return SLURM_ERROR;
 	}
 
+	/* The stats files hold totals, so add them up from scratch */
+	stats->write_bytes = stats->read_bytes = 0;
+	stats->write_samples = stats->read_samples = 0;
+
 	while ((entry = readdir(proc_dir))) {
 		char *path_stats = NULL;
 		bool bread;
@@ -262,18 +265,40 @@ static int _read_lustre_counters(void)
 		}
 		fclose(fff);
 
-		lstats.write_bytes += write_bytes;
-		lstats.read_bytes += read_bytes;
-		lstats.write_samples += write_samples;
-		lstats.read_samples += read_samples;
+		stats->write_bytes += write_bytes;
+		stats->read_bytes += read_bytes;
+		stats->write_samples += write_samples;
+		stats->read_samples += read_samples;
 		debug3("%s: write_bytes %"PRIu64" read_bytes %"PRIu64,
-		       __func__, lstats.write_bytes, lstats.read_bytes);
+		       __func__, stats->write_bytes, stats->read_bytes);
 		debug3("%s: write_samples %"PRIu64" read_samples %"PRIu64,
-		       __func__, lstats.write_samples, lstats.read_samples);
+		       __func__, stats->write_samples, stats->read_samples);
 	} /* while ((entry = readdir(proc_dir))) */
 	closedir(proc_dir);
 
-	lstats.update_time = time(NULL);
+	stats->update_time = time(NULL);
+
+	return SLURM_SUCCESS;
+}
+
+/* _read_lustre_counters()
+ *
+ * Update lstats from the node sample published by the slurmd if there is
+ * one, else from the lustre stats files.
+ */
+static int _read_lustre_counters(void)
+{
+	acct_gather_node_sample_t sample;
+	static bool first = true;
+
+	if (acct_gather_node_ring_read(&sample) == SLURM_SUCCESS) {
+		lstats.read_samples = sample.filesystem.num_reads;
+		lstats.write_samples = sample.filesystem.num_writes;
+		lstats.read_bytes = sample.filesystem.size_read;
+		lstats.write_bytes = sample.filesystem.size_write;
+		lstats.update_time = sample.sample_time;
+	} else if (_read_lustre_stats(&lstats) != SLURM_SUCCESS)
+		return SLURM_ERROR;
 
 	if (first) {
 		memcpy(&lstats_prev, &lstats, sizeof(lustre_stats_t));
@@ -427,6 +452,25 @@ extern void acct_gather_filesystem_p_conf_values(List *data)
 	return;
 }
 
+extern int acct_gather_filesystem_p_get_node_data(acct_gather_data_t *data)
+{
+	lustre_stats_t stats;
+
+	/* No Lustre mounted on this node */
+	if (!_llite_path())
+		return SLURM_ERROR;
+
+	if (_read_lustre_stats(&stats) != SLURM_SUCCESS)
+		return SLURM_ERROR;
+
+	data->num_reads = stats.read_samples;
+	data->num_writes = stats.write_samples;
+	data->size_read = stats.read_bytes;
+	data->size_write = stats.write_bytes;
+
+	return SLURM_SUCCESS;
+}
+
 extern int acct_gather_filesystem_p_get_data(acct_gather_data_t *data)
 {
 	int retval = SLURM_SUCCESS;
@@ -124,3 +124,8 @@ extern int acct_gather_filesystem_p_get_data(acct_gather_data_t *data)
 {
 	return SLURM_SUCCESS;
 }
+
+extern int acct_gather_filesystem_p_get_node_data(acct_gather_data_t *data)
+{
+	return SLURM_ERROR;
+}
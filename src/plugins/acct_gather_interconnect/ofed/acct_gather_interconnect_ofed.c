@@ -170,15 +170,40 @@ static int _read_ofed_values(void)
 	static uint64_t last_update_xmtpkts = 0;
 	static uint64_t last_update_rcvpkts = 0;
 	static bool first = true;
+	static bool last_from_ring = false;	/* last_update_* source */
+	static uint32_t last_generation = 0;
 
 	int rc = SLURM_SUCCESS;
 
 	uint16_t cap_mask;
 	uint64_t send_val, recv_val, send_pkts, recv_pkts;
+	uint64_t data_mult = 4;	/* port data counters are in 4 octet units */
+	acct_gather_node_sample_t sample;
 
 	ofed_sens.last_update_time = ofed_sens.update_time;
 	ofed_sens.update_time = time(NULL);
 
+	/* Use the node totals sampled by the slurmd if there are some */
+	if (acct_gather_node_ring_read(&sample) == SLURM_SUCCESS) {
+		send_val = sample.interconnect.size_write;
+		recv_val = sample.interconnect.size_read;
+		send_pkts = sample.interconnect.num_writes;
+		recv_pkts = sample.interconnect.num_reads;
+		data_mult = 1;
+
+		/*
+		 * The totals count from the start of the slurmd, not from
+		 * the counters' reset, take a new base after a new slurmd or
+		 * after reading the counters directly.
+		 */
+		if (!last_from_ring || (sample.generation != last_generation)) {
+			last_from_ring = true;
+			last_generation = sample.generation;
+			goto save_last;
+		}
+		goto update;
+	}
+
 	if (first) {
 		int mgmt_classes[4] = {IB_SMI_CLASS, IB_SMI_DIRECT_CLASS,
 				       IB_SA_CLASS, IB_PERFORMANCE_CLASS};
@@ -218,6 +243,7 @@ static int _read_ofed_values(void)
 		log_flag(INTERCONNECT, "%s ofed init", plugin_name);
 
 		first = 0;
+		last_from_ring = false;
 		return SLURM_SUCCESS;
 	}
 
@@ -234,15 +260,23 @@ static int _read_ofed_values(void)
 	mad_decode_field(pc, IB_PC_EXT_XMT_PKTS_F, &send_pkts);
 	mad_decode_field(pc, IB_PC_EXT_RCV_PKTS_F, &recv_pkts);
 
-	ofed_sens.xmtdata = (send_val - last_update_xmtdata) * 4;
+	/* The last values were ring totals, start again from these */
+	if (last_from_ring) {
+		last_from_ring = false;
+		goto save_last;
+	}
+
+update:
+	ofed_sens.xmtdata = (send_val - last_update_xmtdata) * data_mult;
 	ofed_sens.total_xmtdata += ofed_sens.xmtdata;
-	ofed_sens.rcvdata = (recv_val - last_update_rcvdata) * 4;
+	ofed_sens.rcvdata = (recv_val - last_update_rcvdata) * data_mult;
 	ofed_sens.total_rcvdata += ofed_sens.rcvdata;
 	ofed_sens.xmtpkts = send_pkts - last_update_xmtpkts;
 	ofed_sens.total_xmtpkts += ofed_sens.xmtpkts;
 	ofed_sens.rcvpkts = recv_pkts - last_update_rcvpkts;
 	ofed_sens.total_rcvpkts += ofed_sens.rcvpkts;
 
+save_last:
 	last_update_xmtdata = send_val;
 	last_update_rcvdata = recv_val;
 	last_update_xmtpkts = send_pkts;
@@ -415,6 +449,26 @@ extern void acct_gather_interconnect_p_conf_values(List *data)
 	return;
 }
 
+extern int acct_gather_interconnect_p_get_node_data(acct_gather_data_t *data)
+{
+	slurm_mutex_lock(&ofed_lock);
+
+	if (_read_ofed_values() != SLURM_SUCCESS) {
+		debug2("%s: Cannot retrieve ofed counters", __func__);
+		slurm_mutex_unlock(&ofed_lock);
+		return SLURM_ERROR;
+	}
+
+	data->num_reads = ofed_sens.total_rcvpkts;
+	data->num_writes = ofed_sens.total_xmtpkts;
+	data->size_read = ofed_sens.total_rcvdata;
+	data->size_write = ofed_sens.total_xmtdata;
+
+	slurm_mutex_unlock(&ofed_lock);
+
+	return SLURM_SUCCESS;
+}
+
 extern int acct_gather_interconnect_p_get_data(acct_gather_data_t *data)
 {
 	int retval = SLURM_SUCCESS;
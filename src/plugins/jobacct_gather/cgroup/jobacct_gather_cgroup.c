@@ -103,13 +103,49 @@ const char plugin_name[] = "Job accounting gather cgroup plugin";
 const char plugin_type[] = "jobacct_gather/cgroup";
 const uint32_t plugin_version = SLURM_VERSION_NUMBER;
 
+/*
+ * Read a statistics file of a task cgroup. The file is opened on the first
+ * poll and reread with pread() on the following ones.
+ *
+ * RET the NUL terminated content in buf, or NULL on error
+ */
+static char *_read_task_cg_stat(task_cg_info_t *task_cg, char *param,
+				char *buf, size_t size)
+{
+	char file_path[PATH_MAX];
+	ssize_t n;
+
+	if (task_cg->stat_fd < 0) {
+		if (snprintf(file_path, PATH_MAX, "%s/%s",
+			     task_cg->task_cg.path, param) >= PATH_MAX)
+			return NULL;
+		if ((task_cg->stat_fd = open(file_path,
+					     O_RDONLY | O_CLOEXEC)) < 0) {
+			debug2("%s: unable to open %s: %m",
+			       __func__, file_path);
+			return NULL;
+		}
+	}
+
+	if ((n = pread(task_cg->stat_fd, buf, size - 1, 0)) < 0) {
+		debug2("%s: unable to read %s of %s: %m",
+		       __func__, param, task_cg->task_cg.path);
+		close(task_cg->stat_fd);
+		task_cg->stat_fd = -1;
+		return NULL;
+	}
+	buf[n] = '\0';
+
+	return buf;
+}
+
 static void _prec_extra(jag_prec_t *prec, uint32_t taskid)
 {
 	unsigned long utime, stime, total_rss, total_pgpgin;
+	char cpu_buf[256], memory_buf[4096];
 	char *cpu_time = NULL, *memory_stat = NULL, *ptr;
-	size_t cpu_time_size = 0, memory_stat_size = 0;
-	xcgroup_t *task_cpuacct_cg = NULL;;
-	xcgroup_t *task_memory_cg = NULL;
+	task_cg_info_t *task_cpuacct_cg = NULL;
+	task_cg_info_t *task_memory_cg = NULL;
 	bool exit_early = false;
 
 	/* Find which task cgroups to use */
@@ -141,8 +177,8 @@ static void _prec_extra(jag_prec_t *prec, uint32_t taskid)
 	//START_TIMER;
 	/* info("before"); */
 	/* print_jag_prec(prec); */
-	xcgroup_get_param(task_cpuacct_cg, "cpuacct.stat",
-			  &cpu_time, &cpu_time_size);
+	cpu_time = _read_task_cg_stat(task_cpuacct_cg, "cpuacct.stat",
+				      cpu_buf, sizeof(cpu_buf));
 	if (cpu_time == NULL) {
 		debug2("%s: failed to collect cpuacct.stat pid %d ppid %d",
 		       __func__, prec->pid, prec->ppid);
@@ -156,8 +192,8 @@ static void _prec_extra(jag_prec_t *prec, uint32_t taskid)
 		prec->ssec = stime;
 	}
 
-	xcgroup_get_param(task_memory_cg, "memory.stat",
-			  &memory_stat, &memory_stat_size);
+	memory_stat = _read_task_cg_stat(task_memory_cg, "memory.stat",
+					 memory_buf, sizeof(memory_buf));
 	if (memory_stat == NULL) {
 		debug2("%s: failed to collect memory.stat  pid %d ppid %d",
 		       __func__, prec->pid, prec->ppid);
@@ -184,9 +220,6 @@ static void _prec_extra(jag_prec_t *prec, uint32_t taskid)
 		}
 	}
 
-	xfree(cpu_time);
-	xfree(memory_stat);
-
 	/* FIXME: Enable when kernel support ready.
 	 *
 	 * "Read" and "Write" from blkio.throttle.io_service_bytes are
@@ -354,6 +387,8 @@ extern void free_task_cg_info(void *object)
 	task_cg_info_t *task_cg = (task_cg_info_t *)object;
 
 	if (task_cg) {
+		if (task_cg->stat_fd >= 0)
+			close(task_cg->stat_fd);
 		xcgroup_destroy(&task_cg->task_cg);
 		xfree(task_cg);
 	}
@@ -390,6 +425,7 @@ static int _handle_task_cgroup(const char *calling_func,
 					     &taskid))) {
 		task_cg_info = xmalloc(sizeof(*task_cg_info));
 		task_cg_info->taskid = taskid;
+		task_cg_info->stat_fd = -1;
 		need_to_add = true;
 	}
 	/*
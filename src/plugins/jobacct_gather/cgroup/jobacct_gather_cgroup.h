@@ -50,6 +50,7 @@
 typedef struct task_cg_info {
 	xcgroup_t task_cg;
 	uint32_t taskid;
+	int stat_fd;	/* statistics file kept open across polls */
 } task_cg_info_t;
 
 extern List task_memory_cg_list;
@@ -52,6 +52,8 @@
 #include "src/common/slurm_acct_gather_energy.h"
 #include "src/common/slurm_acct_gather_filesystem.h"
 #include "src/common/slurm_acct_gather_interconnect.h"
+#include "src/common/timers.h"
+#include "src/common/xhash.h"
 #include "src/common/xstring.h"
 #include "src/slurmd/common/proctrack.h"
 
@@ -77,6 +79,38 @@ static int my_pagesize = 0;
 static DIR  *slash_proc = NULL;
 static int energy_profile = ENERGY_DATA_NODE_ENERGY_UP;
 
+enum {
+	JAG_PROC_STAT,
+	JAG_PROC_STATM,
+	JAG_PROC_IO,
+	JAG_PROC_SMAPS,
+	JAG_PROC_STATUS,
+	JAG_PROC_FILE_CNT
+};
+
+static const char *proc_file_names[JAG_PROC_FILE_CNT] = {
+	"stat", "statm", "io", "smaps", "status"
+};
+
+/*
+ * The /proc/<pid> files of a process of the step are kept open from one poll
+ * to the next and reread with pread(), instead of being opened and closed on
+ * every poll. smaps is the exception, it shows the memory map the process had
+ * when it was opened, which an exec() replaces.
+ */
+typedef struct {
+	int fd[JAG_PROC_FILE_CNT];
+	bool in_step;		/* files are kept open between polls */
+	int is_lwp;		/* -1 until /proc/<pid>/status is read */
+	pid_t pid;
+	bool visited;		/* seen on the current poll */
+} jag_proc_t;
+
+static xhash_t *proc_hash = NULL;
+static char *proc_buf = NULL;
+static size_t proc_buf_size = 0;
+static uint32_t proc_files_opened = 0;
+
 static int _find_prec(void *x, void *key)
 {
 	jag_prec_t *prec = (jag_prec_t *) x;
@@ -140,65 +174,6 @@ inline static bool _get_freq(char *str)
 	return true;
 }
 
-/*
- * collects the Pss value from /proc/<pid>/smaps
- */
-static int _get_pss(char *proc_smaps_file, jag_prec_t *prec)
-{
-        uint64_t pss;
-	uint64_t p;
-        char line[128];
-        FILE *fp;
-	int i;
-
-	fp = fopen(proc_smaps_file, "r");
-        if (!fp) {
-                return -1;
-        }
-
-	if (fcntl(fileno(fp), F_SETFD, FD_CLOEXEC) == -1)
-		error("%s: fcntl(%s): %m", __func__, proc_smaps_file);
-	pss = 0;
-
-        while (fgets(line,sizeof(line),fp)) {
-
-                if (xstrncmp(line, "Pss:", 4) != 0) {
-                        continue;
-                }
-
-                for (i = 4; i < sizeof(line); i++) {
-
-                        if (!isdigit(line[i])) {
-                                continue;
-                        }
-                        if (sscanf(&line[i],"%"PRIu64"", &p) == 1) {
-                                pss += p;
-                        }
-                        break;
-                }
-        }
-
-	/* Check for error
-	 */
-	if (ferror(fp)) {
-		fclose(fp);
-		return -1;
-	}
-
-        fclose(fp);
-        /* Sanity checks */
-
-        if (pss > 0 && prec->tres_data[TRES_ARRAY_MEM].size_read > pss) {
-		pss *= 1024; /* Scale KB to B */
-                prec->tres_data[TRES_ARRAY_MEM].size_read = pss;
-        }
-
-	debug3("%s: read pss %"PRIu64" for process %s",
-	       __func__, pss, proc_smaps_file);
-
-        return 0;
-}
-
 static int _get_sys_interface_freq_line(uint32_t cpu, char *filename,
 					char * sbuf)
 {
@@ -246,60 +221,267 @@ static int _get_sys_interface_freq_line(uint32_t cpu, char *filename,
 	return 0;
 }
 
-static int _is_a_lwp(uint32_t pid)
+static void _proc_hash_id(void *item, const char **key, uint32_t *key_len)
 {
-	char *filename = NULL;
-	char bf[4096];
-	int fd, attempts = 1;
-	ssize_t n;
-	char *tgids = NULL;
-	pid_t tgid = -1;
+	jag_proc_t *proc = (jag_proc_t *) item;
 
-	xstrfmtcat(filename, "/proc/%u/status", pid);
+	*key = (const char *) &proc->pid;
+	*key_len = sizeof(proc->pid);
+}
 
-	fd = open(filename, O_RDONLY);
-	if (fd < 0) {
-		xfree(filename);
-		return SLURM_ERROR;
+static void _close_proc_files(jag_proc_t *proc)
+{
+	int i;
+
+	for (i = 0; i < JAG_PROC_FILE_CNT; i++) {
+		if (proc->fd[i] >= 0)
+			close(proc->fd[i]);
+		proc->fd[i] = -1;
 	}
+	proc->is_lwp = -1;
+}
 
-again:
-	n = read(fd, bf, sizeof(bf) - 1);
-	if (n == -1 && (errno == EINTR || errno == EAGAIN) && attempts < 100) {
-		attempts++;
-		goto again;
+static void _free_proc(void *x)
+{
+	jag_proc_t *proc = (jag_proc_t *) x;
+
+	_close_proc_files(proc);
+	xfree(proc);
+}
+
+/* Find or add the open files record of a process sampled on this poll */
+static jag_proc_t *_get_proc(pid_t pid)
+{
+	jag_proc_t *proc;
+	int i;
+
+	if (!proc_hash)
+		proc_hash = xhash_init(_proc_hash_id, _free_proc);
+
+	if (!(proc = xhash_get(proc_hash, (char *) &pid, sizeof(pid)))) {
+		proc = xmalloc(sizeof(*proc));
+		for (i = 0; i < JAG_PROC_FILE_CNT; i++)
+			proc->fd[i] = -1;
+		proc->is_lwp = -1;
+		proc->pid = pid;
+		xhash_add(proc_hash, proc);
 	}
-	if (n <= 0) {
-		close(fd);
-		xfree(filename);
-		return SLURM_ERROR;
+	proc->visited = true;
+
+	return proc;
+}
+
+static void _find_unvisited_proc(void *item, void *arg)
+{
+	jag_proc_t *proc = (jag_proc_t *) item;
+	List gone = (List) arg;
+
+	if (!proc->visited)
+		list_append(gone, &proc->pid);
+	proc->visited = false;
+}
+
+/* Close the files of the processes that were not seen on this poll */
+static void _sweep_procs(void)
+{
+	List gone;
+	pid_t *pid;
+
+	if (!proc_hash)
+		return;
+
+	gone = list_create(NULL);
+	xhash_walk(proc_hash, _find_unvisited_proc, gone);
+	while ((pid = list_pop(gone)))
+		xhash_delete(proc_hash, (char *) pid, sizeof(*pid));
+	FREE_NULL_LIST(gone);
+}
+
+static int _open_proc_file(jag_proc_t *proc, int file)
+{
+	static bool no_smaps_rollup = false;
+	char path[64];
+
+	if ((file == JAG_PROC_SMAPS) && !no_smaps_rollup) {
+		snprintf(path, sizeof(path), "/proc/%d/smaps_rollup",
+			 proc->pid);
+		proc_files_opened++;
+		if ((proc->fd[file] = open(path, O_RDONLY | O_CLOEXEC)) >= 0)
+			return proc->fd[file];
+		if (errno != ENOENT)
+			return -1;
+		/* Older kernel, fall back to summing every mapping */
+		no_smaps_rollup = true;
+	}
+
+	snprintf(path, sizeof(path), "/proc/%d/%s",
+		 proc->pid, proc_file_names[file]);
+	proc_files_opened++;
+	proc->fd[file] = open(path, O_RDONLY | O_CLOEXEC);
+
+	return proc->fd[file];
+}
+
+/*
+ * Reread a /proc file from its start into proc_buf. Only smaps may need more
+ * than one read, the other files are generated whole on each read.
+ */
+static ssize_t _pread_proc_file(int fd, bool whole)
+{
+	ssize_t len = 0, n;
+	int attempts = 1;
+
+	if (!proc_buf) {
+		proc_buf_size = 4096;
+		proc_buf = xmalloc(proc_buf_size);
+	}
+
+	while (1) {
+		n = pread(fd, proc_buf + len, proc_buf_size - len - 1, len);
+		if (n < 0) {
+			if (((errno == EINTR) || (errno == EAGAIN)) &&
+			    (attempts++ < 100))
+				continue;
+			return -1;
+		}
+		len += n;
+		if (!n || !whole)
+			break;
+		if (len + 1 >= proc_buf_size) {
+			proc_buf_size *= 2;
+			xrealloc(proc_buf, proc_buf_size);
+		}
+	}
+	proc_buf[len] = '\0';
+
+	return len;
+}
+
+/*
+ * Read a file of a sampled process through the descriptor kept open in its
+ * jag_proc_t, opening it on first use. The content is left NUL terminated in
+ * proc_buf.
+ *
+ * If a descriptor opened on an earlier poll can not be read the pid may have
+ * been reused since, so they are all closed and the file is opened and read
+ * once more.
+ *
+ * RET length read, or -1 if the process is gone
+ */
+static ssize_t _read_proc_file(jag_proc_t *proc, int file)
+{
+	ssize_t len = -1;
+	int retry;
+
+	for (retry = 0; retry < 2; retry++) {
+		bool opened = false;
+
+		if (proc->fd[file] < 0) {
+			if (_open_proc_file(proc, file) < 0)
+				return -1;
+			opened = true;
+		}
+		if ((len = _pread_proc_file(proc->fd[file],
+					    (file == JAG_PROC_SMAPS))) >= 0)
+			return len;
+		_close_proc_files(proc);
+		if (opened)
+			break;
 	}
-	bf[n] = '\0';
-	close(fd);
-	xfree(filename);
 
-	tgids = xstrstr(bf, "Tgid:");
+	return len;
+}
+
+/* Check /proc/<pid>/status once per process to see if it is a thread */
+static int _is_a_lwp(jag_proc_t *proc)
+{
+	char *tgids = NULL;
+	pid_t tgid = -1;
+
+	if (proc->is_lwp != -1)
+		return proc->is_lwp;
+
+	if (_read_proc_file(proc, JAG_PROC_STATUS) <= 0)
+		return SLURM_ERROR;
+
+	tgids = xstrstr(proc_buf, "Tgid:");
 
 	if (tgids) {
 		tgids += 5; /* strlen("Tgid:") */
 		tgid = atoi(tgids);
 	} else
-		error("%s: Tgid: string not found for pid=%u", __func__, pid);
+		error("%s: Tgid: string not found for pid=%d",
+		      __func__, proc->pid);
 
-	if (pid != (uint32_t)tgid) {
-		debug3("%s: pid=%u != tgid=%u is a lightweight process",
-		       __func__, pid, tgid);
-		return 1;
+	if (proc->pid != tgid) {
+		debug3("%s: pid=%d != tgid=%d is a lightweight process",
+		       __func__, proc->pid, tgid);
+		proc->is_lwp = 1;
 	} else {
-		debug3("%s: pid=%u == tgid=%u is the leader LWP",
-		       __func__, pid, tgid);
-		return 0;
+		debug3("%s: pid=%d == tgid=%d is the leader LWP",
+		       __func__, proc->pid, tgid);
+		proc->is_lwp = 0;
+	}
+
+	/* The status file is not needed again */
+	close(proc->fd[JAG_PROC_STATUS]);
+	proc->fd[JAG_PROC_STATUS] = -1;
+
+	return proc->is_lwp;
+}
+
+/*
+ * collects the Pss value from /proc/<pid>/smaps_rollup, or /proc/<pid>/smaps
+ * on kernels without it
+ */
+static int _get_pss(jag_proc_t *proc, jag_prec_t *prec)
+{
+	uint64_t pss;
+	uint64_t p;
+	char *line, *next;
+	int i;
+
+	if (_read_proc_file(proc, JAG_PROC_SMAPS) < 0)
+		return -1;
+
+	/* Open it again next time in case the process exec()ed */
+	close(proc->fd[JAG_PROC_SMAPS]);
+	proc->fd[JAG_PROC_SMAPS] = -1;
+
+	pss = 0;
+
+	for (line = proc_buf; line; line = next) {
+		if ((next = strchr(line, '\n')))
+			next++;
+
+		if (xstrncmp(line, "Pss:", 4) != 0)
+			continue;
+
+		for (i = 4; line[i] && (line[i] != '\n'); i++) {
+			if (!isdigit(line[i]))
+				continue;
+			if (sscanf(&line[i], "%"PRIu64"", &p) == 1)
+				pss += p;
+			break;
+		}
+	}
+
+	/* Sanity checks */
+
+	if (pss > 0 && prec->tres_data[TRES_ARRAY_MEM].size_read > pss) {
+		pss *= 1024; /* Scale KB to B */
+		prec->tres_data[TRES_ARRAY_MEM].size_read = pss;
 	}
+
+	debug3("%s: read pss %"PRIu64" for process %d",
+	       __func__, pss, proc->pid);
+
+	return 0;
 }
 
 /* _get_process_data_line() - get line of data from /proc/<pid>/stat
  *
- * IN:	in - input file descriptor
+ * IN:	proc - the process to read
  * OUT:	prec - the destination for the data
  *
  * RETVAL:	==0 - no valid data
@@ -310,9 +492,9 @@ again:
  * embedded ')'s. Such names confuse %s (see scanf(3)), so the string is split
  * and %39c is used instead. (except for embedded ')' "(%[^)]c)" would work.
  */
-static int _get_process_data_line(int in, jag_prec_t *prec) {
-	char sbuf[512], *tmp;
-	int num_read, nvals;
+static int _get_process_data_line(jag_proc_t *proc, jag_prec_t *prec) {
+	char *sbuf, *tmp;
+	int nvals;
 	char cmd[40], state[1];
 	int ppid, pgrp, session, tty_nr, tpgid;
 	long unsigned flags, minflt, cminflt, majflt, cmajflt;
@@ -321,10 +503,9 @@ static int _get_process_data_line(int in, jag_prec_t *prec) {
 	long unsigned f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13;
 	int exit_signal, last_cpu;
 
-	num_read = read(in, sbuf, (sizeof(sbuf) - 1));
-	if (num_read <= 0)
+	if (_read_proc_file(proc, JAG_PROC_STAT) <= 0)
 		return 0;
-	sbuf[num_read] = '\0';
+	sbuf = proc_buf;
 
 	/*
 	 * split into "PID (cmd" and "<rest>" replace trailing ')' with NULL
@@ -362,7 +543,7 @@ static int _get_process_data_line(int in, jag_prec_t *prec) {
 	 * or there was an error, skip it, we will only account the original
 	 * process (pid==tgid).
 	 */
-	if (_is_a_lwp(prec->pid))
+	if (_is_a_lwp(proc))
 		return 0;
 
 	/* Copy the values that slurm records into our data structure */
@@ -384,7 +565,7 @@ static int _get_process_data_line(int in, jag_prec_t *prec) {
 
 /* _get_process_memory_line() - get line of data from /proc/<pid>/statm
  *
- * IN:	in - input file descriptor
+ * IN:	proc - the process to read
  * OUT:	prec - the destination for the data
  *
  * RETVAL:	==0 - no valid data
@@ -395,18 +576,15 @@ static int _get_process_data_line(int in, jag_prec_t *prec) {
  * and return the updated struct.
  *
  */
-static int _get_process_memory_line(int in, jag_prec_t *prec)
+static int _get_process_memory_line(jag_proc_t *proc, jag_prec_t *prec)
 {
-	char sbuf[256];
-	int num_read, nvals;
+	int nvals;
 	long int size, rss, share, text, lib, data, dt;
 
-	num_read = read(in, sbuf, (sizeof(sbuf) - 1));
-	if (num_read <= 0)
+	if (_read_proc_file(proc, JAG_PROC_STATM) <= 0)
 		return 0;
-	sbuf[num_read] = '\0';
 
-	nvals = sscanf(sbuf,
+	nvals = sscanf(proc_buf,
 		       "%ld %ld %ld %ld %ld %ld %ld",
 		       &size, &rss, &share, &text, &lib, &data, &dt);
 	/* There are some additional fields, which we do not scan or use */
@@ -426,54 +604,34 @@ static int _get_process_memory_line(int in, jag_prec_t *prec)
 	return 1;
 }
 
-static int _remove_share_data(char *proc_stat_file, jag_prec_t *prec)
-{
-	FILE *statm_fp = NULL;
-	char proc_statm_file[256];	/* Allow ~20x extra length */
-	int rc = 0, fd;
-
-	snprintf(proc_statm_file, sizeof(proc_statm_file), "%sm",
-		 proc_stat_file);
-	if (!(statm_fp = fopen(proc_statm_file, "r")))
-		return rc;  /* Assume the process went away */
-	fd = fileno(statm_fp);
-	if (fcntl(fd, F_SETFD, FD_CLOEXEC) == -1)
-		error("%s: fcntl(%s): %m", __func__, proc_statm_file);
-	rc = _get_process_memory_line(fd, prec);
-	fclose(statm_fp);
-	return rc;
-}
-
 /* _get_process_io_data_line() - get line of data from /proc/<pid>/io
  *
- * IN:	in - input file descriptor
+ * IN:	proc - the process to read
  * OUT:	prec - the destination for the data
  *
  * RETVAL:	==0 - no valid data
  * 		!=0 - data are valid
+ *		<0 - the file could not be read
  *
  * /proc/<pid>/io content format is:
  * rchar: <# of characters read>
  * wrchar: <# of characters written>
  *   . . .
  */
-static int _get_process_io_data_line(int in, jag_prec_t *prec) {
-	char sbuf[256];
+static int _get_process_io_data_line(jag_proc_t *proc, jag_prec_t *prec) {
 	char f1[7], f3[7];
-	int num_read, nvals;
+	int nvals;
 	uint64_t rchar, wchar;
 
-	num_read = read(in, sbuf, (sizeof(sbuf) - 1));
-	if (num_read <= 0)
-		return 0;
-	sbuf[num_read] = '\0';
+	if (_read_proc_file(proc, JAG_PROC_IO) < 0)
+		return -1;
 
-	nvals = sscanf(sbuf, "%s %"PRIu64" %s %"PRIu64"",
+	nvals = sscanf(proc_buf, "%6s %"PRIu64" %6s %"PRIu64"",
 		       f1, &rchar, f3, &wchar);
 	if (nvals < 4)
 		return 0;
 
-	if (_is_a_lwp(prec->pid))
+	if (_is_a_lwp(proc))
 		return 0;
 
 	/* keep real value here since we aren't doubles */
@@ -483,16 +641,18 @@ static int _get_process_io_data_line(int in, jag_prec_t *prec) {
 	return 1;
 }
 
-static void _handle_stats(List prec_list, char *proc_stat_file,
-			  char *proc_io_file, char *proc_smaps_file,
+/*
+ * IN in_step - the process is known to be part of the step, keep its files
+ *	open for the next poll
+ */
+static void _handle_stats(List prec_list, pid_t pid,
 			  jag_callbacks_t *callbacks,
-			  int tres_count)
+			  int tres_count, bool in_step)
 {
 	static int no_share_data = -1;
 	static int use_pss = -1;
-	FILE *stat_fp = NULL;
-	FILE *io_fp = NULL;
-	int fd, fd2, i;
+	int i;
+	jag_proc_t *proc;
 	jag_prec_t *prec = NULL;
 
 	if (no_share_data == -1) {
@@ -507,21 +667,9 @@ static void _handle_stats(List prec_list, char *proc_stat_file,
 			use_pss = 0;
 	}
 
-	if (!(stat_fp = fopen(proc_stat_file, "r")))
-		return;  /* Assume the process went away */
-	/*
-	 * Close the file on exec() of user tasks.
-	 *
-	 * NOTE: If we fork() slurmstepd after the
-	 * fopen() above and before the fcntl() below,
-	 * then the user task may have this extra file
-	 * open, which can cause problems for
-	 * checkpoint/restart, but this should be a very rare
-	 * problem in practice.
-	 */
-	fd = fileno(stat_fp);
-	if (fcntl(fd, F_SETFD, FD_CLOEXEC) == -1)
-		error("%s: fcntl(%s): %m", __func__, proc_stat_file);
+	proc = _get_proc(pid);
+	if (in_step)
+		proc->in_step = true;
 
 	prec = xmalloc(sizeof(jag_prec_t));
 
@@ -546,12 +694,9 @@ static void _handle_stats(List prec_list, char *proc_stat_file,
 		prec->tres_data[i].size_write = INFINITE64;
 	}
 
-	if (!_get_process_data_line(fd, prec)) {
-		fclose(stat_fp);
+	/* A missing stat file means the process went away */
+	if (!_get_process_data_line(proc, prec))
 		goto bail_out;
-	}
-
-	fclose(stat_fp);
 
 	if (acct_gather_filesystem_g_get_data(prec->tres_data) < 0) {
 		debug2("problem retrieving filesystem data");
@@ -562,48 +707,119 @@ static void _handle_stats(List prec_list, char *proc_stat_file,
 	}
 
 	/* Remove shared data from rss */
-	if (no_share_data && !_remove_share_data(proc_stat_file, prec))
+	if (no_share_data && !_get_process_memory_line(proc, prec))
 		goto bail_out;
 
 	/* Use PSS instead if RSS */
-	if (use_pss && _get_pss(proc_smaps_file, prec) == -1)
+	if (use_pss && _get_pss(proc, prec) == -1)
 		goto bail_out;
 
-	if ((io_fp = fopen(proc_io_file, "r"))) {
-		fd2 = fileno(io_fp);
-		if (fcntl(fd2, F_SETFD, FD_CLOEXEC) == -1)
-			error("%s: fcntl: %m", __func__);
-		if (!_get_process_io_data_line(fd2, prec)) {
-			fclose(io_fp);
-			goto bail_out;
-		}
-		fclose(io_fp);
-	}
+	/* The io file is optional, it needs CONFIG_TASK_IO_ACCOUNTING */
+	if (!_get_process_io_data_line(proc, prec))
+		goto bail_out;
 
 	list_append(prec_list, prec);
-	return;
+	goto done;
 
 bail_out:
 	xfree(prec->tres_data);
 	xfree(prec);
+done:
+	if (!proc->in_step)
+		_close_proc_files(proc);
 	return;
 }
 
+static int _find_task_pid(void *x, void *key)
+{
+	struct jobacctinfo *jobacct = (struct jobacctinfo *) x;
+	pid_t pid = *(pid_t *) key;
+
+	if (jobacct->pid == pid)
+		return 1;
+
+	return 0;
+}
+
+static int _find_prec_by_ppid(void *x, void *key)
+{
+	jag_prec_t *prec = (jag_prec_t *) x;
+	pid_t ppid = *(pid_t *) key;
+
+	return (!prec->visited && (prec->ppid == ppid));
+}
+
+static int _set_proc_in_step(void *x, void *arg)
+{
+	jag_prec_t *prec = (jag_prec_t *) x;
+	jag_proc_t *proc;
+
+	if (!(proc = xhash_get(proc_hash, (char *) &prec->pid,
+			       sizeof(prec->pid))))
+		return 0;
+
+	proc->in_step = prec->visited;
+	if (!proc->in_step)
+		_close_proc_files(proc);
+	prec->visited = false;
+
+	return 0;
+}
+
+/*
+ * Find which of the processes read from all of /proc are the tasks or their
+ * descendants, so only their files are kept open until the next poll.
+ */
+static void _mark_step_procs(List task_list, List prec_list)
+{
+	ListIterator itr;
+	struct jobacctinfo *task;
+	jag_prec_t *prec, *parent;
+	List queue = list_create(NULL);
+
+	itr = list_iterator_create(task_list);
+	while ((task = list_next(itr))) {
+		if ((prec = list_find_first(prec_list, _find_prec, task)) &&
+		    !prec->visited) {
+			prec->visited = true;
+			list_append(queue, prec);
+		}
+	}
+	list_iterator_destroy(itr);
+
+	while ((parent = list_dequeue(queue))) {
+		while ((prec = list_find_first(prec_list, _find_prec_by_ppid,
+					       &parent->pid))) {
+			prec->visited = true;
+			list_append(queue, prec);
+		}
+	}
+	FREE_NULL_LIST(queue);
+
+	(void) list_for_each(prec_list, _set_proc_in_step, NULL);
+}
+
 static List _get_precs(List task_list, bool pgid_plugin, uint64_t cont_id,
 		       jag_callbacks_t *callbacks)
 {
 	List prec_list = list_create(destroy_jag_prec);
-	char	proc_stat_file[256];	/* Allow ~20x extra length */
-	char	proc_io_file[256];	/* Allow ~20x extra length */
-	char	proc_smaps_file[256];	/* Allow ~20x extra length */
 	static	int	slash_proc_open = 0;
 	int i;
+	bool tasks_only;
 	struct jobacctinfo *jobacct = NULL;
 
 	xassert(task_list);
 
 	jobacct = list_peek(task_list);
 
+	/*
+	 * Only the tasks' own processes are matched in jag_common_poll_data()
+	 * unless their offspring are folded in too. That is the case with
+	 * jobacct_gather/cgroup, whose task cgroups already aggregate the
+	 * usage of all the descendants, so don't sample every other process.
+	 */
+	tasks_only = !callbacks->get_offspring_data;
+
 	if (!pgid_plugin) {
 		pid_t *pids = NULL;
 		int npids = 0;
@@ -631,17 +847,25 @@ static List _get_precs(List task_list, bool pgid_plugin, uint64_t cont_id,
 			goto finished;
 		}
 		for (i = 0; i < npids; i++) {
-			snprintf(proc_stat_file, 256, "/proc/%d/stat", pids[i]);
-			snprintf(proc_io_file, 256, "/proc/%d/io", pids[i]);
-			snprintf(proc_smaps_file, 256, "/proc/%d/smaps", pids[i]);
-			_handle_stats(prec_list, proc_stat_file, proc_io_file,
-				      proc_smaps_file, callbacks,
-				      jobacct ? jobacct->tres_count : 0);
+			if (tasks_only &&
+			    !list_find_first(task_list, _find_task_pid,
+					     &pids[i]))
+				continue;
+			_handle_stats(prec_list, pids[i], callbacks,
+				      jobacct ? jobacct->tres_count : 0, true);
 		}
 		xfree(pids);
+	} else if (tasks_only) {
+		ListIterator itr = list_iterator_create(task_list);
+		struct jobacctinfo *task;
+
+		while ((task = list_next(itr)))
+			_handle_stats(prec_list, task->pid, callbacks,
+				      jobacct->tres_count, true);
+		list_iterator_destroy(itr);
 	} else {
 		struct dirent *slash_proc_entry;
-		char  *iptr = NULL, *optr = NULL, *optr2 = NULL;
+		char *iptr;
 
 		if (slash_proc_open) {
 			rewinddir(slash_proc);
@@ -653,84 +877,36 @@ static List _get_precs(List task_list, bool pgid_plugin, uint64_t cont_id,
 			}
 			slash_proc_open=1;
 		}
-		strcpy(proc_stat_file, "/proc/");
-		strcpy(proc_io_file, "/proc/");
-		strcpy(proc_smaps_file, "/proc/");
 
+		/*
+		 * Every process on the node is read, but only the files of
+		 * those found to be in the step on the previous poll are kept
+		 * open, or a stepd could hold several per process.
+		 */
 		while ((slash_proc_entry = readdir(slash_proc))) {
+			pid_t pid;
 
-			/* Save a few cyles by simulating
-			 * strcat(statFileName, slash_proc_entry->d_name);
-			 * strcat(statFileName, "/stat");
-			 * while checking for a numeric filename (which really
-			 * should be a pid). Then do the same for the
-			 * /proc/<pid>/io file name.
-			 */
-			optr = proc_stat_file + sizeof("/proc");
+			/* Only numeric names, which should be pids */
 			iptr = slash_proc_entry->d_name;
-			i = 0;
 			do {
-				if ((*iptr < '0') ||
-				    ((*optr++ = *iptr++) > '9')) {
-					i = -1;
+				if ((*iptr < '0') || (*iptr > '9'))
 					break;
-				}
-			} while (*iptr);
+			} while (*++iptr);
 
-			if (i == -1)
+			if (*iptr)
 				continue;
-			iptr = (char*)"/stat";
-
-			do {
-				*optr++ = *iptr++;
-			} while (*iptr);
-			*optr = 0;
-
-			optr2 = proc_io_file + sizeof("/proc");
-			iptr = slash_proc_entry->d_name;
-			i = 0;
-			do {
-				if ((*iptr < '0') ||
-				    ((*optr2++ = *iptr++) > '9')) {
-					i = -1;
-					break;
-				}
-			} while (*iptr);
-			if (i == -1)
-				continue;
-			iptr = (char*)"/io";
-
-			do {
-				*optr2++ = *iptr++;
-			} while (*iptr);
-			*optr2 = 0;
-
-			optr2 = proc_smaps_file + sizeof("/proc");
-			iptr = slash_proc_entry->d_name;
-			i = 0;
-			do {
-				if ((*iptr < '0') ||
-				    ((*optr2++ = *iptr++) > '9')) {
-					i = -1;
-					break;
-				}
-			} while (*iptr);
-			if (i == -1)
-				continue;
-			iptr = (char*)"/smaps";
-
-			do {
-				*optr2++ = *iptr++;
-			} while (*iptr);
-			*optr2 = 0;
 
-			_handle_stats(prec_list, proc_stat_file, proc_io_file,
-				      proc_smaps_file,callbacks,
-				      jobacct ? jobacct->tres_count : 0);
+			pid = atoi(slash_proc_entry->d_name);
+			_handle_stats(prec_list, pid, callbacks,
+				      jobacct ? jobacct->tres_count : 0,
+				      list_find_first(task_list, _find_task_pid,
+						      &pid));
 		}
+		_mark_step_procs(task_list, prec_list);
 	}
 
 finished:
+	_sweep_procs();
 
 	return prec_list;
 }
@@ -881,6 +1057,9 @@ extern void jag_common_fini(void)
 {
 	if (slash_proc)
 		(void) closedir(slash_proc);
+	xhash_free(proc_hash);
+	xfree(proc_buf);
+	proc_buf_size = 0;
 }
 
 extern void destroy_jag_prec(void *object)
@@ -929,8 +1108,10 @@ extern void jag_common_poll_data(
 	static int processing = 0;
 	char sbuf[72];
 	int energy_counted = 0;
+	int prec_cnt = 0;
 	time_t ct;
 	int i = 0;
+	DEF_TIMERS;
 
 	xassert(callbacks);
 
@@ -944,6 +1125,7 @@ extern void jag_common_poll_data(
 		return;
 	}
 	processing = 1;
+	START_TIMER;
 
 	if (!callbacks->get_precs)
 		callbacks->get_precs = _get_precs;
@@ -951,6 +1133,7 @@ extern void jag_common_poll_data(
 	ct = time(NULL);
 	prec_list = (*(callbacks->get_precs))(task_list, pgid_plugin, cont_id,
 					      callbacks);
+	prec_cnt = list_count(prec_list);
 
 	if (!list_count(prec_list) || !task_list || !list_count(task_list))
 		goto finished;	/* We have no business being here! */
@@ -1116,5 +1299,9 @@ extern void jag_common_poll_data(
 
 finished:
 	FREE_NULL_LIST(prec_list);
+	END_TIMER;
+	debug2("%s: sampled %d processes, opened %u files, usec=%ld",
+	       __func__, prec_cnt, proc_files_opened, DELTA_TIMER);
+	proc_files_opened = 0;
 	processing = 0;
 }
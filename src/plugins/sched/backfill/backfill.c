@@ -203,6 +203,7 @@ static int max_backfill_job_per_user_part = 0;
 static int max_backfill_jobs_start = 0;
 static bool backfill_continue = false;
 static bool assoc_limit_stop = false;
+static bool bf_shape_cache = false;
 static int max_rpc_cnt = 0;
 static int yield_interval = YIELD_INTERVAL;
 static int yield_sleep   = YIELD_SLEEP;
@@ -940,6 +941,11 @@ static void _load_config(void)
 	else
 		bf_running_job_reserve = false;
 
+	if (xstrcasestr(sched_params, "job_shape_cache"))
+		bf_shape_cache = true;
+	else
+		bf_shape_cache = false;
+
 	if ((tmp_ptr = xstrcasestr(sched_params, "max_rpc_cnt=")))
 		max_rpc_cnt = atoi(tmp_ptr + 12);
 	else if ((tmp_ptr = xstrcasestr(sched_params, "max_rpc_count=")))
@@ -1593,6 +1599,8 @@ static int _attempt_backfill(void)
 	time_t tmp_preempt_start_time = 0;
 	bool tmp_preempt_in_progress = false;
 	bitstr_t *tmp_bitmap = NULL;
+	job_shape_cache_t *shape_cache = NULL;
+	char *shape_key = NULL;
 	/* QOS Read lock */
 	assoc_mgr_lock_t qos_read_lock =
 		{ NO_LOCK, NO_LOCK, READ_LOCK, NO_LOCK,
@@ -1682,6 +1690,9 @@ static int _attempt_backfill(void)
 	/* Ignore nodes that have been set as available during this cycle. */
 	bit_clear_all(bf_ignore_node_bitmap);
 
+	if (bf_shape_cache)
+		shape_cache = job_shape_cache_create();
+
 	while (1) {
 		uint32_t bf_array_task_id, bf_job_priority,
 			prio_reserve;
@@ -1740,6 +1751,8 @@ static int _attempt_backfill(void)
 			}
 			if (stop_backfill)
 				break;
+			/* Resources may have been released while unlocked */
+			job_shape_cache_clear(shape_cache);
 			/* Reset backfill scheduling timers, resume testing */
 			sched_start = time(NULL);
 			gettimeofday(&start_tv, NULL);
@@ -1991,6 +2004,20 @@ next_task:
 			deadline_time_limit = (job_ptr->deadline - now) / 60;
 		}
 
+		/*
+		 * Skip the job if one with the same shape already could not
+		 * be started or reserved in this cycle. The node space map
+		 * only becomes more constrained until locks are yielded.
+		 */
+		xfree(shape_key);
+		if (shape_cache &&
+		    (shape_key = job_shape_key(job_ptr, job_no_reserve)) &&
+		    job_shape_cache_test(shape_cache, job_ptr, shape_key)) {
+			log_flag(BACKFILL, "%pJ has same shape as a job which could not start",
+				 job_ptr);
+			continue;
+		}
+
 		/* Determine job's expected completion time */
 		if (part_ptr->max_time == INFINITE)
 			part_time_limit = YEAR_MINUTES;
@@ -2071,6 +2098,8 @@ next_task:
 			}
 			if (stop_backfill)
 				break;
+			/* Resources may have been released while unlocked */
+			job_shape_cache_clear(shape_cache);
 
 			/* Reset backfill scheduling timers, resume testing */
 			sched_start = time(NULL);
@@ -2190,6 +2219,7 @@ next_task:
 			}
 
 			/* Job can not start until too far in the future */
+			job_shape_cache_add(shape_cache, job_ptr, shape_key);
 			_set_job_time_limit(job_ptr, orig_time_limit);
 			/*
 			 * Use orig_start_time if job can't
@@ -2308,6 +2338,7 @@ next_task:
 				goto TRY_LATER;
 			}
 			job_ptr->start_time = orig_start_time;
+			job_shape_cache_add(shape_cache, job_ptr, shape_key);
 			continue;	/* not runable in this partition */
 		}
 
@@ -2751,6 +2782,13 @@ skip_start:
 	FREE_NULL_BITMAP(exc_core_bitmap);
 	FREE_NULL_BITMAP(resv_bitmap);
 
+	if (shape_cache) {
+		log_flag(BACKFILL, "skipped %u jobs with the same shape as jobs unable to start",
+			 job_shape_cache_hits(shape_cache));
+		job_shape_cache_destroy(shape_cache);
+	}
+	xfree(shape_key);
+
 	for (i = 0; ; ) {
 		FREE_NULL_BITMAP(node_space[i].avail_bitmap);
 		if ((i = node_space[i].next) == 0)
@@ -55,6 +55,7 @@
 #define OPT_LONG_FEDR      0x105
 #define OPT_LONG_WHETJOB   0x106
 #define OPT_LONG_LOCAL_UID 0x107
+#define OPT_LONG_PAGE_SIZE 0x108
 
 #define JOB_HASH_SIZE 1000
 
@@ -419,6 +420,11 @@ sacct [<OPTION>]                                                            \n \
                    for a list of available fields).                         \n\
      -p, --parsable: output will be '|' delimited with a '|' at the end     \n\
      -P, --parsable2: output will be '|' delimited without a '|' at the end \n\
+     --page-size[=records]:                                                 \n\
+                   Get the jobs of a single cluster from the slurmdbd this  \n\
+                   many records at a time (default 5000), printing each     \n\
+                   page as it comes. Jobs are then only sorted within a     \n\
+                   page. By default all jobs are gotten at once.            \n\
      -q, --qos:                                                             \n\
                    Only send data about jobs using these qos.  Default is all.\n\
      -r, --partition:                                                       \n\
@@ -609,12 +615,27 @@ extern int get_data(void)
 		jobs = slurmdb_jobcomp_jobs_get(job_cond);
 		return SLURM_SUCCESS;
 	} else {
+		FREE_NULL_LIST(jobs);
 		jobs = slurmdb_jobs_get(acct_db_conn, job_cond);
 	}
 
 	if (!jobs)
 		return SLURM_ERROR;
 
+	/* The next page starts after the last job of this one */
+	if (job_cond->page_size && list_count(jobs)) {
+		xfree(job_cond->page_cluster);
+		job_cond->page_jobid = 0;
+		itr = list_iterator_create(jobs);
+		while ((job = list_next(itr))) {
+			if (!job_cond->page_cluster)
+				job_cond->page_cluster = xstrdup(job->cluster);
+			job_cond->page_jobid = MAX(job_cond->page_jobid,
+						   job->jobid);
+		}
+		list_iterator_destroy(itr);
+	}
+
 	/*
 	 * Remove duplicate federated jobs. The db will remove duplicates for
 	 * one cluster but not when jobs for multiple clusters are requested.
@@ -727,6 +748,7 @@ extern void parse_command_line(int argc, char **argv)
                 {"format",         required_argument, 0,    'o'},
                 {"parsable",       no_argument,       0,    'p'},
                 {"parsable2",      no_argument,       0,    'P'},
+                {"page-size",      optional_argument, 0,    OPT_LONG_PAGE_SIZE},
                 {"qos",            required_argument, 0,    'q'},
                 {"partition",      required_argument, 0,    'r'},
                 {"reason",         required_argument, 0,    'R'},
@@ -896,6 +918,17 @@ extern void parse_command_line(int argc, char **argv)
 		case OPT_LONG_NOCONVERT:
 			params.convert_flags |= CONVERT_NUM_UNIT_NO;
 			break;
+		case OPT_LONG_PAGE_SIZE:
+			if (!optarg) {
+				params.opt_page_size = SACCT_PAGE_SIZE;
+			} else if (parse_uint32(optarg,
+						&params.opt_page_size) ||
+				   !params.opt_page_size) {
+				error("Invalid --page-size value \"%s\"",
+				      optarg);
+				exit(1);
+			}
+			break;
 		case OPT_LONG_UNITS:
 		{
 			int type = get_unit_type(*optarg);
@@ -1186,6 +1219,17 @@ extern void parse_command_line(int argc, char **argv)
 		}
 	}
 
+	/*
+	 * If asked to, page through the jobs of a single cluster, printing
+	 * each page as it comes. Jobs are then only sorted within a page. The
+	 * jobs of several clusters are sorted and deduplicated together, so
+	 * they are gotten all at once.
+	 */
+	if (params.opt_page_size && !params.opt_completion &&
+	    job_cond->cluster_list &&
+	    (list_count(job_cond->cluster_list) == 1))
+		job_cond->page_size = params.opt_page_size;
+
 	/* if any jobs or nodes are specified set to look for all users if none
 	   are set */
 	if (!job_cond->userid_list || !list_count(job_cond->userid_list))
@@ -1409,6 +1453,12 @@ static inline bool _test_local_job(uint32_t job_id)
 	return false;
 }
 
+/* Return true if a paged query has more jobs to get */
+extern bool more_data(void)
+{
+	return (params.job_cond->page_size && jobs && list_count(jobs));
+}
+
 /* do_list() -- List the assembled data
  *
  * In:	Nothing explicit.
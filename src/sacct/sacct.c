@@ -182,12 +182,14 @@ int main(int argc, char **argv)
 	switch (op) {
 	case SACCT_LIST:
 		print_fields_header(print_fields_list);
-		if (get_data() == SLURM_ERROR)
-			exit(errno);
-		if (params.opt_completion)
-			do_list_completion();
-		else
-			do_list();
+		do {
+			if (get_data() == SLURM_ERROR)
+				exit(errno);
+			if (params.opt_completion)
+				do_list_completion();
+			else
+				do_list();
+		} while (more_data());
 		break;
 	case SACCT_HELP:
 		do_help();
@@ -71,6 +71,7 @@
 #define LONG_COMP_FIELDS "jobid,uid,jobname,partition,nnodes,nodelist,state,start,end,timelimit"
 
 #define MAX_PRINTFIELDS 100
+#define SACCT_PAGE_SIZE 5000	/* job records gotten from the dbd at a time */
 #define FORMAT_STRING_SIZE 34
 
 #define SECONDS_IN_MINUTE 60
@@ -208,6 +209,7 @@ typedef struct {
 	int opt_help;		/* --help */
 	bool opt_local;		/* --local */
 	int opt_noheader;	/* can only be cleared */
+	uint32_t opt_page_size;	/* --page-size */
 	int opt_uid;		/* running persons uid */
 	int units;		/* --units*/
 	bool use_local_uid;	/* --use-local-uid */
@@ -231,6 +233,7 @@ void print_fields(type_t type, void *object);
 
 /* options.c */
 int  get_data(void);
+bool more_data(void);
 void parse_command_line(int argc, char **argv);
 void do_help(void);
 void do_list(void);
@@ -320,6 +320,19 @@ extern int sacctmgr_list_stats(int argc, char **argv)
 	type = 1;
 	list_for_each(stats_rec->user_list, _print_rpc_obj, &type);
 
+	if (stats_rec->batch_cnt) {
+		printf("\nBatched records (DBD_SEND_MULT_MSG) statistics\n");
+		printf("\tBatches:         %u\n", stats_rec->batch_cnt);
+		printf("\tRecords:         %"PRIu64"\n", stats_rec->batch_recs);
+		printf("\tMax records:     %u\n", stats_rec->batch_max);
+		printf("\tMean records:    %"PRIu64"\n",
+		       stats_rec->batch_recs / stats_rec->batch_cnt);
+		printf("\tTotal time:      %"PRIu64"\n", stats_rec->batch_time);
+		if (stats_rec->batch_recs)
+			printf("\tMean per record: %"PRIu64"\n",
+			       stats_rec->batch_time / stats_rec->batch_recs);
+	}
+
 	slurmdb_destroy_stats_rec(stats_rec);
 
 	return error_code;
@@ -57,6 +57,7 @@
 
 #define OPT_LONG_HELP   0x100
 #define OPT_LONG_USAGE  0x101
+#define OPT_LONG_PIPELINE 0x102
 
 /* getopt_long options, integers but not characters */
 
@@ -79,6 +80,7 @@ extern void parse_command_line(int argc, char **argv)
 		{"fanout",    required_argument, 0, 'F'},
 		{"force",     no_argument,       0, 'f'},
 		{"jobid",     required_argument, 0, 'j'},
+		{"pipeline",  required_argument, 0, OPT_LONG_PIPELINE},
 		{"preserve",  no_argument,       0, 'p'},
 		{"size",      required_argument, 0, 's'},
 		{"timeout",   required_argument, 0, 't'},
@@ -106,6 +108,8 @@ extern void parse_command_line(int argc, char **argv)
 	if (getenv("SBCAST_FORCE"))
 		params.force = true;
 
+	if ((env_val = getenv("SBCAST_PIPELINE")))
+		params.pipeline = atoi(env_val);
 	if (getenv("SBCAST_PRESERVE"))
 		params.preserve = true;
 	if ( ( env_val = getenv("SBCAST_SIZE") ) )
@@ -139,6 +143,9 @@ extern void parse_command_line(int argc, char **argv)
 		case (int)'p':
 			params.preserve = true;
 			break;
+		case (int) OPT_LONG_PIPELINE:
+			params.pipeline = atoi(optarg);
+			break;
 		case (int) 's':
 			params.block_size = _map_size(optarg);
 			break;
@@ -240,6 +247,7 @@ static void _print_options( void )
 	info("compress   = %u", params.compress);
 	info("force      = %s", params.force ? "true" : "false");
 	info("fanout     = %d", params.fanout);
+	info("pipeline   = %d", params.pipeline);
 	info("jobid      = %s",
 	     slurm_get_selected_step_id(job_id_str, sizeof(job_id_str),
 					params.selected_step));
@@ -266,6 +274,7 @@ Usage: sbcast [OPTIONS] SOURCE DEST\n\
   -F, --fanout=num      specify message fanout\n\
   -j, --jobid=#[+#][.#] specify job ID with optional hetjob offset and/or step ID\n\
   -p, --preserve        preserve modes and times of source file\n\
+      --pipeline=num    number of blocks to have in flight at once\n\
   -s, --size=num        block size in bytes (rounded off)\n\
   -t, --timeout=secs    specify message timeout (seconds)\n\
   -v, --verbose         provide detailed event logging\n\
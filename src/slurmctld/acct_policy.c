@@ -45,6 +45,7 @@
 #include "src/slurmctld/acct_policy.h"
 #include "src/common/node_select.h"
 #include "src/common/slurm_priority.h"
+#include "src/common/xhash.h"
 
 #define _DEBUG 0
 
@@ -69,6 +70,22 @@ typedef struct het_job_limits {
 	slurmdb_qos_rec_t *qos_ptr_2;
 } het_job_limits_t;
 
+/*
+ * Remaining TRES an association and all of its parents allow a new job to
+ * use, valid while g_assoc_mgr_gen is unchanged. Only built when the
+ * association chain has no TRES minute or per node limits.
+ */
+typedef struct {
+	char key[16];		/* association ID */
+	uint32_t gen;		/* g_assoc_mgr_gen when built */
+	bool usable;		/* false if other limits must be tested */
+	uint32_t tres_cnt;
+	uint64_t *headroom;	/* INFINITE64 if unlimited */
+} assoc_headroom_t;
+
+static pthread_mutex_t headroom_mutex = PTHREAD_MUTEX_INITIALIZER;
+static xhash_t *headroom_hash = NULL;
+
 /*
  * Update a job's allocated node count to reflect only nodes that are not
  * already allocated to this association.  Needed to enforce GrpNode limit.
@@ -3600,6 +3617,127 @@ end_it:
 	return rc;
 }
 
+static void _headroom_id(void *item, const char **key, uint32_t *key_len)
+{
+	assoc_headroom_t *headroom = (assoc_headroom_t *) item;
+
+	*key = headroom->key;
+	*key_len = strlen(headroom->key);
+}
+
+static void _headroom_free(void *item)
+{
+	assoc_headroom_t *headroom = (assoc_headroom_t *) item;
+
+	xfree(headroom->headroom);
+	xfree(headroom);
+}
+
+static bool _tres_limit_set(uint64_t *tres_limit_array)
+{
+	int i;
+
+	if (!tres_limit_array)
+		return false;
+	for (i = 0; i < g_tres_count; i++) {
+		if (tres_limit_array[i] != INFINITE64)
+			return true;
+	}
+	return false;
+}
+
+static void _headroom_min(uint64_t *headroom, uint64_t *limit, uint64_t *used)
+{
+	uint64_t room;
+	int i;
+
+	if (!limit)
+		return;
+	for (i = 0; i < g_tres_count; i++) {
+		if (limit[i] == INFINITE64)
+			continue;
+		room = limit[i];
+		if (used)
+			room = (used[i] >= limit[i]) ? 0 : (limit[i] - used[i]);
+		headroom[i] = MIN(headroom[i], room);
+	}
+}
+
+/* Fill in headroom for assoc_ptr and its parents, assoc read lock needed */
+static void _headroom_build(assoc_headroom_t *headroom,
+			    slurmdb_assoc_rec_t *assoc_ptr)
+{
+	int i;
+
+	if (headroom->tres_cnt != g_tres_count) {
+		xfree(headroom->headroom);
+		headroom->tres_cnt = g_tres_count;
+		headroom->headroom = xcalloc(g_tres_count, sizeof(uint64_t));
+	}
+	for (i = 0; i < g_tres_count; i++)
+		headroom->headroom[i] = INFINITE64;
+	headroom->gen = g_assoc_mgr_gen;
+	headroom->usable = false;
+
+	if (_tres_limit_set(assoc_ptr->max_tres_mins_ctld) ||
+	    _tres_limit_set(assoc_ptr->max_tres_pn_ctld))
+		return;
+	_headroom_min(headroom->headroom, assoc_ptr->max_tres_ctld, NULL);
+
+	for ( ; assoc_ptr; assoc_ptr = assoc_ptr->usage->parent_assoc_ptr) {
+		if (_tres_limit_set(assoc_ptr->grp_tres_mins_ctld) ||
+		    _tres_limit_set(assoc_ptr->grp_tres_run_mins_ctld))
+			return;
+		_headroom_min(headroom->headroom, assoc_ptr->grp_tres_ctld,
+			      assoc_ptr->usage->grp_used_tres);
+	}
+	headroom->usable = true;
+}
+
+/*
+ * Return true if the job's association limits can not be exceeded by
+ * tres_req_cnt. Limits skipped by the full test (admin set, already imposed
+ * by a QOS or GrpNodes on shared nodes) are applied here anyway, so false
+ * only means the full test is needed. assoc read lock needed.
+ */
+static bool _assoc_headroom_fits(slurmdb_assoc_rec_t *assoc_ptr,
+				 uint64_t *tres_req_cnt)
+{
+	assoc_headroom_t *headroom;
+	char key[16];
+	bool fits = false;
+	int i;
+
+	if (!assoc_ptr)
+		return false;
+
+	snprintf(key, sizeof(key), "%u", assoc_ptr->id);
+	slurm_mutex_lock(&headroom_mutex);
+	if (!headroom_hash)
+		headroom_hash = xhash_init(_headroom_id, _headroom_free);
+	if (!(headroom = xhash_get_str(headroom_hash, key))) {
+		headroom = xmalloc(sizeof(*headroom));
+		strlcpy(headroom->key, key, sizeof(headroom->key));
+		_headroom_build(headroom, assoc_ptr);
+		xhash_add(headroom_hash, headroom);
+	} else if ((headroom->gen != g_assoc_mgr_gen) ||
+		   (headroom->tres_cnt != g_tres_count))
+		_headroom_build(headroom, assoc_ptr);
+
+	if (headroom->usable) {
+		fits = true;
+		for (i = 0; i < headroom->tres_cnt; i++) {
+			if (tres_req_cnt[i] > headroom->headroom[i]) {
+				fits = false;
+				break;
+			}
+		}
+	}
+	slurm_mutex_unlock(&headroom_mutex);
+
+	return fits;
+}
+
 /*
  * acct_policy_job_runnable_post_select - After nodes have been
  *	selected for the job verify the counts don't exceed aggregated limits.
@@ -3704,6 +3842,10 @@ extern bool acct_policy_job_runnable_post_select(job_record_t *job_ptr,
 						 job_tres_time_limit)))
 		goto end_it;
 
+	/* Skip walking the association tree if no limit can be reached */
+	if (_assoc_headroom_fits(job_ptr->assoc_ptr, tres_req_cnt))
+		goto end_it;
+
 	assoc_ptr = job_ptr->assoc_ptr;
 	while (assoc_ptr) {
 		for (i = 0; i < slurmctld_tres_cnt; i++) {
@@ -4918,3 +5060,21 @@ extern slurmdb_used_limits_t *acct_policy_get_user_used_limits(
 
 	return used_limits;
 }
+
+extern void acct_policy_remove_assoc(uint32_t assoc_id)
+{
+	char key[16];
+
+	snprintf(key, sizeof(key), "%u", assoc_id);
+	slurm_mutex_lock(&headroom_mutex);
+	if (headroom_hash)
+		xhash_delete_str(headroom_hash, key);
+	slurm_mutex_unlock(&headroom_mutex);
+}
+
+extern void acct_policy_fini(void)
+{
+	slurm_mutex_lock(&headroom_mutex);
+	xhash_free(headroom_hash);
+	slurm_mutex_unlock(&headroom_mutex);
+}
@@ -197,4 +197,13 @@ extern slurmdb_used_limits_t *acct_policy_get_acct_used_limits(
 extern slurmdb_used_limits_t *acct_policy_get_user_used_limits(
 	 List *user_limit_list, uint32_t user_id);
 
+/*
+ * acct_policy_remove_assoc - Forget what is cached about an association
+ *	removed from the assoc_mgr
+ */
+extern void acct_policy_remove_assoc(uint32_t assoc_id);
+
+/* acct_policy_fini - Free the memory cached by the accounting policy */
+extern void acct_policy_fini(void);
+
 #endif /* !_HAVE_ACCT_POLICY_H */
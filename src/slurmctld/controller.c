@@ -889,6 +889,7 @@ int main(int argc, char **argv)
 	purge_front_end_state();
 	resv_fini();
 	trigger_fini();
+	acct_policy_fini();
 	assoc_mgr_fini(1);
 	reserve_port_config(NULL);
 
@@ -1431,6 +1432,7 @@ static void _remove_assoc(slurmdb_assoc_rec_t *rec)
 	bb_g_reconfig();
 
 	cnt = job_hold_by_assoc_id(rec->id);
+	acct_policy_remove_assoc(rec->id);
 
 	if (cnt) {
 		info("Removed association id:%u user:%s, held %u jobs",
@@ -84,6 +84,7 @@
 #include "src/common/tres_frequency.h"
 #include "src/common/uid.h"
 #include "src/common/xassert.h"
+#include "src/common/xhash.h"
 #include "src/common/xstring.h"
 
 #include "src/slurmctld/acct_policy.h"
@@ -166,6 +167,7 @@ static uint32_t job_id_sequence = 0;	/* first job_id to assign new job */
 static struct   job_record **job_hash = NULL;
 static struct   job_record **job_array_hash_j = NULL;
 static struct   job_record **job_array_hash_t = NULL;
+static xhash_t *singleton_index = NULL;	/* jobs by user ID and job name */
 static bool     kill_invalid_dep;
 static time_t   last_file_write_time = (time_t) 0;
 static uint32_t max_array_size = NO_VAL;
@@ -176,6 +178,7 @@ static bool     validate_cfgd_licenses = true;
 /* Local functions */
 static void _add_job_hash(job_record_t *job_ptr);
 static void _add_job_array_hash(job_record_t *job_ptr);
+static void _add_singleton_index(job_record_t *job_ptr);
 static void _clear_job_gres_details(job_record_t *job_ptr);
 static int  _copy_job_desc_to_file(job_desc_msg_t * job_desc,
 				   uint32_t job_id);
@@ -228,6 +231,7 @@ static int  _read_data_array_from_file(int fd, char *file_name, char ***data,
 				       uint32_t *size, job_record_t *job_ptr);
 static void _remove_defunct_batch_dirs(List batch_dirs);
 static void _remove_job_hash(job_record_t *job_ptr, job_hash_type_t type);
+static void _remove_singleton_index(job_record_t *job_ptr);
 static int  _reset_detail_bitmaps(job_record_t *job_ptr);
 static void _reset_step_bitmaps(job_record_t *job_ptr);
 static void _resp_array_add(resp_array_struct_t **resp, job_record_t *job_ptr,
@@ -2128,6 +2132,7 @@ static int _load_job_state(Buf buffer, uint16_t protocol_version)
 	xfree(job_ptr->mcs_label);
 	job_ptr->mcs_label    = mcs_label;
 	mcs_label	      = NULL;   /* reused, nothing left to free */
+	_remove_singleton_index(job_ptr);	/* in case duplicate record */
 	xfree(job_ptr->name);		/* in case duplicate record */
 	job_ptr->name         = name;
 	name                  = NULL;	/* reused, nothing left to free */
@@ -2253,6 +2258,7 @@ static int _load_job_state(Buf buffer, uint16_t protocol_version)
 
 	_add_job_hash(job_ptr);
 	_add_job_array_hash(job_ptr);
+	_add_singleton_index(job_ptr);
 
 	memset(&assoc_rec, 0, sizeof(assoc_rec));
 
@@ -3191,6 +3197,141 @@ extern job_record_t *find_job_record(uint32_t job_id)
 	return NULL;
 }
 
+/*
+ * Singleton index: every job record grouped by user ID and job name, so that
+ * a singleton dependency test only examines jobs which can block it. Jobs
+ * without a name are kept under the user ID alone since they match any name.
+ */
+typedef struct {
+	char *key;
+	List jobs;			/* job_record_t, not freed */
+} singleton_rec_t;
+
+static void _singleton_rec_id(void *item, const char **key, uint32_t *key_len)
+{
+	singleton_rec_t *rec = (singleton_rec_t *) item;
+
+	*key = rec->key;
+	*key_len = strlen(rec->key);
+}
+
+static void _singleton_rec_free(void *item)
+{
+	singleton_rec_t *rec = (singleton_rec_t *) item;
+
+	xfree(rec->key);
+	FREE_NULL_LIST(rec->jobs);
+	xfree(rec);
+}
+
+static char *_singleton_key(uint32_t user_id, char *name)
+{
+	if (name)
+		return xstrdup_printf("%u:%s", user_id, name);
+	return xstrdup_printf("%u", user_id);
+}
+
+/* _add_singleton_index - add a job to the singleton index, user_id and name
+ *	must already be set */
+static void _add_singleton_index(job_record_t *job_ptr)
+{
+	singleton_rec_t *rec;
+	char *key;
+
+	if (!singleton_index)
+		singleton_index = xhash_init(_singleton_rec_id,
+					     _singleton_rec_free);
+
+	key = _singleton_key(job_ptr->user_id, job_ptr->name);
+	if (!(rec = xhash_get_str(singleton_index, key))) {
+		rec = xmalloc(sizeof(*rec));
+		rec->key = key;
+		rec->jobs = list_create(NULL);
+		xhash_add(singleton_index, rec);
+	} else
+		xfree(key);
+	list_append(rec->jobs, job_ptr);
+}
+
+/* _remove_singleton_index - remove a job from the singleton index, must be
+ *	called before the job's user_id or name changes */
+static void _remove_singleton_index(job_record_t *job_ptr)
+{
+	singleton_rec_t *rec;
+	char *key;
+
+	if (!singleton_index)
+		return;
+
+	key = _singleton_key(job_ptr->user_id, job_ptr->name);
+	if ((rec = xhash_get_str(singleton_index, key)) &&
+	    list_delete_ptr(rec->jobs, job_ptr) &&
+	    !list_count(rec->jobs))
+		xhash_delete_str(singleton_index, key);
+	xfree(key);
+}
+
+/* Running or suspended job, or pending job submitted before key's job */
+static int _singleton_blocks(void *x, void *key)
+{
+	job_record_t *qjob_ptr = (job_record_t *) x;
+	job_record_t *job_ptr = (job_record_t *) key;
+
+	xassert(qjob_ptr->magic == JOB_MAGIC);
+
+	if (IS_JOB_RUNNING(qjob_ptr) || IS_JOB_SUSPENDED(qjob_ptr) ||
+	    (IS_JOB_PENDING(qjob_ptr) &&
+	     (qjob_ptr->job_id < job_ptr->job_id)))
+		return 1;
+
+	return 0;
+}
+
+static int _find_singleton_job(void *x, void *key)
+{
+	job_record_t *qjob_ptr = (job_record_t *) x;
+	job_record_t *job_ptr = (job_record_t *) key;
+
+	if (qjob_ptr->user_id != job_ptr->user_id)
+		return 0;
+	return _singleton_blocks(x, key);
+}
+
+/*
+ * find_singleton_job - return a job which prevents a singleton dependency of
+ *	the given job from being satisfied: a running or suspended job, or an
+ *	earlier pending job, of the same user and job name
+ * IN job_ptr - job with the singleton dependency
+ * RET pointer to the blocking job's record, NULL if none
+ */
+extern job_record_t *find_singleton_job(job_record_t *job_ptr)
+{
+	singleton_rec_t *rec;
+	job_record_t *block_ptr = NULL;
+	char *key;
+
+	if (!job_ptr->name)	/* Any job of this user can match */
+		return list_find_first(job_list, _find_singleton_job, job_ptr);
+	if (!singleton_index)
+		return NULL;
+
+	key = _singleton_key(job_ptr->user_id, job_ptr->name);
+	if ((rec = xhash_get_str(singleton_index, key)))
+		block_ptr = list_find_first(rec->jobs, _singleton_blocks,
+					    job_ptr);
+	xfree(key);
+	if (block_ptr)
+		return block_ptr;
+
+	key = _singleton_key(job_ptr->user_id, NULL);
+	if ((rec = xhash_get_str(singleton_index, key)))
+		block_ptr = list_find_first(rec->jobs, _singleton_blocks,
+					    job_ptr);
+	xfree(key);
+
+	return block_ptr;
+}
+
 /* rebuild a job's partition name list based upon the contents of its
  *	part_ptr_list */
 static void _rebuild_part_name_list(job_record_t *job_ptr)
@@ -4270,6 +4411,8 @@ extern job_record_t *job_array_split(job_record_t *job_ptr)
 	job_ptr_pend->details  = save_details;
 	job_ptr_pend->db_flags = 0;
 	job_ptr_pend->step_list = save_step_list;
+	job_ptr_pend->step_hash = NULL;
+	job_ptr_pend->step_layout_cache = NULL;
 	job_ptr_pend->db_index = save_db_index;
 
 	job_ptr_pend->prio_factors = save_prio_factors;
@@ -4333,6 +4476,7 @@ extern job_record_t *job_array_split(job_record_t *job_ptr)
 	job_ptr_pend->mail_user = xstrdup(job_ptr->mail_user);
 	job_ptr_pend->mcs_label = xstrdup(job_ptr->mcs_label);
 	job_ptr_pend->name = xstrdup(job_ptr->name);
+	_add_singleton_index(job_ptr_pend);
 	job_ptr_pend->network = xstrdup(job_ptr->network);
 	job_ptr_pend->node_addr = NULL;
 	job_ptr_pend->node_bitmap = NULL;
@@ -4400,6 +4544,8 @@ extern job_record_t *job_array_split(job_record_t *job_ptr)
 	 * for a period before preempting more jobs.
 	 */
 	details_new->preempt_start_time = 0;
+	details_new->depend_gen = 0;
+	job_details->depend_gen = 0;	/* job_ptr has a new job ID */
 
 	details_new->acctg_freq = xstrdup(job_details->acctg_freq);
 	if (job_details->argc) {
@@ -7866,6 +8012,7 @@ static int _copy_job_desc_to_job_record(job_desc_msg_t *job_desc,
 
 	job_ptr->user_id    = (uid_t) job_desc->user_id;
 	job_ptr->group_id   = (gid_t) job_desc->group_id;
+	_add_singleton_index(job_ptr);
 	job_ptr->job_state  = JOB_PENDING;
 	job_ptr->time_limit = job_desc->time_limit;
 	job_ptr->deadline   = job_desc->deadline;
@@ -9126,7 +9273,9 @@ static void _list_delete_job(void *job_entry)
 	xassert (job_ptr->magic == JOB_MAGIC);
 	job_ptr->magic = 0;	/* make sure we don't delete record twice */
 
+	depend_index_job_update(job_ptr, true);
 	_delete_job_common(job_ptr);
+	_remove_singleton_index(job_ptr);
 
 	if (job_ptr->array_recs) {
 		job_array_size = MAX(1, job_ptr->array_recs->task_cnt);
@@ -12842,8 +12991,10 @@ static int _update_job(job_record_t *job_ptr, job_desc_msg_t *job_specs,
 			sched_debug("%s: new name identical to old name %pJ",
 				    __func__, job_ptr);
 		} else {
+			_remove_singleton_index(job_ptr);
 			xfree(job_ptr->name);
 			job_ptr->name = xstrdup(job_specs->name);
+			_add_singleton_index(job_ptr);
 
 			sched_info("%s: setting name to %s for %pJ",
 				   __func__, job_ptr->name, job_ptr);
@@ -14975,6 +15126,7 @@ void job_fini (void)
 {
 	FREE_NULL_LIST(job_list);
 	xfree(job_hash);
+	xhash_free(singleton_index);
 	xfree(job_array_hash_j);
 	xfree(job_array_hash_t);
 	FREE_NULL_LIST(purge_files_list);
@@ -15069,6 +15221,7 @@ extern void job_completion_logger(job_record_t *job_ptr, bool requeue)
 
 	xassert(job_ptr);
 
+	depend_index_job_update(job_ptr, false);
 	acct_policy_remove_job_submit(job_ptr);
 	if (job_ptr->nodes && ((job_ptr->bit_flags & JOB_KILL_HURRY) == 0)
 	    && !IS_JOB_RESIZING(job_ptr)) {
@@ -16174,6 +16327,7 @@ static int _job_requeue_op(uid_t uid, job_record_t *job_ptr, bool preempt,
 		job_ptr->job_state |= JOB_COMPLETING;
 		deallocate_nodes(job_ptr, false, is_suspended, preempt);
 		job_ptr->job_state &= (~JOB_COMPLETING);
+		depend_index_job_update(job_ptr, false);
 	}
 
 	/* do this after the epilog complete, setting it here is too early */
@@ -17124,6 +17278,8 @@ extern void build_cg_bitmap(job_record_t *job_ptr)
 		job_ptr->node_bitmap_cg = bit_alloc(node_record_count);
 		job_ptr->job_state &= (~JOB_COMPLETING);
 	}
+	if (!IS_JOB_COMPLETING(job_ptr))
+		depend_index_job_update(job_ptr, false);
 }
 
 /* job_hold_requeue()
@@ -72,6 +72,7 @@
 #include "src/common/track_script.h"
 #include "src/common/uid.h"
 #include "src/common/xassert.h"
+#include "src/common/xhash.h"
 #include "src/common/xstring.h"
 
 #include "src/slurmctld/acct_policy.h"
@@ -134,34 +135,6 @@ static int sched_min_interval = 2;
 static int bb_array_stage_cnt = 10;
 extern diag_stats_t slurmctld_diag_stats;
 
-static int _find_singleton_job (void *x, void *key)
-{
-	struct job_record *qjob_ptr = (struct job_record *) x;
-	struct job_record *job_ptr = (struct job_record *) key;
-
-	xassert (qjob_ptr->magic == JOB_MAGIC);
-
-	/*
-	 * get user jobs with the same user and name
-	 */
-	if (qjob_ptr->user_id != job_ptr->user_id)
-		return 0;
-	if (qjob_ptr->name && job_ptr->name &&
-	    xstrcmp(qjob_ptr->name, job_ptr->name))
-		return 0;
-	/*
-	 * already running/suspended job or previously
-	 * submitted pending job
-	 */
-	if (IS_JOB_RUNNING(qjob_ptr) || IS_JOB_SUSPENDED(qjob_ptr) ||
-	    (IS_JOB_PENDING(qjob_ptr) &&
-	     (qjob_ptr->job_id < job_ptr->job_id))) {
-		return 1;
-	}
-
-	return 0;
-}
-
 /*
  * Calculate how busy the system is by figuring out how busy each node is.
  */
@@ -943,6 +916,158 @@ extern void fill_array_reasons(job_record_t *job_ptr,
 	}
 }
 
+typedef struct {
+	char *key;		/* shape key, see job_shape_key() */
+	uint32_t state_reason;	/* reason of the job which failed */
+	char *state_desc;	/* description of the job which failed */
+} job_shape_rec_t;
+
+struct job_shape_cache {
+	uint32_t hits;		/* jobs skipped using the cache */
+	xhash_t *table;		/* job_shape_rec_t records, by key */
+};
+
+static void _job_shape_key_id(void *item, const char **key, uint32_t *key_len)
+{
+	job_shape_rec_t *shape_rec = item;
+
+	*key = shape_rec->key;
+	*key_len = strlen(shape_rec->key);
+}
+
+static void _job_shape_free(void *item)
+{
+	job_shape_rec_t *shape_rec = item;
+
+	if (!shape_rec)
+		return;
+	xfree(shape_rec->key);
+	xfree(shape_rec->state_desc);
+	xfree(shape_rec);
+}
+
+extern job_shape_cache_t *job_shape_cache_create(void)
+{
+	job_shape_cache_t *cache = xmalloc(sizeof(job_shape_cache_t));
+
+	cache->table = xhash_init(_job_shape_key_id, _job_shape_free);
+	return cache;
+}
+
+extern void job_shape_cache_destroy(job_shape_cache_t *cache)
+{
+	if (!cache)
+		return;
+	xhash_free(cache->table);
+	xfree(cache);
+}
+
+extern void job_shape_cache_clear(job_shape_cache_t *cache)
+{
+	if (cache)
+		xhash_clear(cache->table);
+}
+
+extern char *job_shape_key(job_record_t *job_ptr, uint32_t flags)
+{
+	struct job_details *detail_ptr = job_ptr->details;
+	multi_core_data_t *mc_ptr;
+	char *key = NULL;
+
+	/*
+	 * HetJob components are scheduled as a unit and burst buffer state is
+	 * unique to each job, so neither can share a result with other jobs.
+	 */
+	if (!detail_ptr || job_ptr->het_job_id || job_ptr->burst_buffer ||
+	    job_ptr->preempt_in_progress || !job_ptr->part_ptr)
+		return NULL;
+
+	xstrfmtcat(key, "%x|%p|%p|%x|%u|%u|%u|%u|%u|%u|%u|%ld|%x|%u|%u|%u",
+		   flags, job_ptr->part_ptr, job_ptr->resv_ptr,
+		   (job_ptr->bit_flags & JOB_MAGNETIC), job_ptr->user_id,
+		   job_ptr->group_id, job_ptr->assoc_id, job_ptr->qos_id,
+		   job_ptr->priority, job_ptr->time_limit, job_ptr->time_min,
+		   (long) job_ptr->deadline, job_ptr->power_flags,
+		   job_ptr->reboot, job_ptr->req_switch, job_ptr->wait4switch);
+	xstrfmtcat(key, "|%u|%u|%u|%u|%u|%u|%u|%u|%"PRIu64"|%u|%u|%u|%u|%u|%u",
+		   detail_ptr->min_cpus, detail_ptr->max_cpus,
+		   detail_ptr->min_nodes, detail_ptr->max_nodes,
+		   detail_ptr->num_tasks, detail_ptr->ntasks_per_node,
+		   detail_ptr->cpus_per_task, detail_ptr->pn_min_cpus,
+		   detail_ptr->pn_min_memory, detail_ptr->pn_min_tmp_disk,
+		   detail_ptr->contiguous, detail_ptr->core_spec,
+		   detail_ptr->share_res, detail_ptr->whole_node,
+		   detail_ptr->overcommit);
+	xstrfmtcat(key, "|%u|%u", detail_ptr->task_dist,
+		   detail_ptr->plane_size);
+	if ((mc_ptr = detail_ptr->mc_ptr)) {
+		xstrfmtcat(key, "|%u|%u|%u|%u|%u|%u|%u|%u|%u",
+			   mc_ptr->boards_per_node, mc_ptr->sockets_per_board,
+			   mc_ptr->sockets_per_node, mc_ptr->cores_per_socket,
+			   mc_ptr->threads_per_core, mc_ptr->ntasks_per_board,
+			   mc_ptr->ntasks_per_socket, mc_ptr->ntasks_per_core,
+			   mc_ptr->plane_size);
+	}
+	xstrfmtcat(key, "|%s|%s|%s|%s|%s|%s|%s|%s|%s|%s|%s|%s|%s|%s",
+		   detail_ptr->features, job_ptr->batch_features,
+		   detail_ptr->req_nodes, detail_ptr->exc_nodes,
+		   job_ptr->tres_req_str, job_ptr->tres_per_job,
+		   job_ptr->tres_per_node, job_ptr->tres_per_socket,
+		   job_ptr->tres_per_task, job_ptr->cpus_per_tres,
+		   job_ptr->mem_per_tres, job_ptr->licenses,
+		   job_ptr->network, job_ptr->mcs_label);
+
+	return key;
+}
+
+extern bool job_shape_cache_test(job_shape_cache_t *cache,
+				 job_record_t *job_ptr, const char *key)
+{
+	job_shape_rec_t *shape_rec;
+
+	if (!cache || !key)
+		return false;
+	if (!(shape_rec = xhash_get_str(cache->table, key)))
+		return false;
+
+	cache->hits++;
+	if ((job_ptr->state_reason != shape_rec->state_reason) ||
+	    xstrcmp(job_ptr->state_desc, shape_rec->state_desc)) {
+		job_ptr->state_reason = shape_rec->state_reason;
+		xfree(job_ptr->state_desc);
+		job_ptr->state_desc = xstrdup(shape_rec->state_desc);
+		last_job_update = time(NULL);
+	}
+	debug3("%s: %pJ has same shape as a job which failed to start, Reason=%s",
+	       __func__, job_ptr, job_reason_string(job_ptr->state_reason));
+
+	return true;
+}
+
+extern void job_shape_cache_add(job_shape_cache_t *cache,
+				job_record_t *job_ptr, const char *key)
+{
+	job_shape_rec_t *shape_rec;
+
+	if (!cache || !key || job_ptr->preempt_in_progress)
+		return;
+	if (xhash_get_str(cache->table, key))
+		return;
+
+	shape_rec = xmalloc(sizeof(job_shape_rec_t));
+	shape_rec->key = xstrdup(key);
+	shape_rec->state_reason = job_ptr->state_reason;
+	shape_rec->state_desc = xstrdup(job_ptr->state_desc);
+	xhash_add(cache->table, shape_rec);
+}
+
+extern uint32_t job_shape_cache_hits(job_shape_cache_t *cache)
+{
+	if (!cache)
+		return 0;
+	return cache->hits;
+}
+
 extern void job_queue_append_internal(job_queue_req_t *job_queue_req)
 {
 	job_queue_rec_t *job_queue_rec;
@@ -991,12 +1116,15 @@ static int _schedule(uint32_t job_limit)
 	static int max_jobs_per_part = 0;
 	static int defer_rpc_cnt = 0;
 	static bool reduce_completing_frag = false;
+	static bool shape_cache_enabled = false;
 	time_t now, last_job_sched_start, sched_start;
 	job_record_t *reject_array_job = NULL;
 	part_record_t *reject_array_part = NULL;
 	bool fail_by_part, wait_on_resv;
 	uint32_t deadline_time_limit, save_time_limit = 0;
 	uint32_t prio_reserve;
+	job_shape_cache_t *shape_cache = NULL;
+	char *shape_key = NULL;
 #if HAVE_SYS_PRCTL_H
 	char get_name[16];
 #endif
@@ -1133,6 +1261,11 @@ static int _schedule(uint32_t job_limit)
 		else
 			reduce_completing_frag = false;
 
+		if (xstrcasestr(slurm_conf.sched_params, "job_shape_cache"))
+			shape_cache_enabled = true;
+		else
+			shape_cache_enabled = false;
+
 		if ((tmp_ptr = xstrcasestr(slurm_conf.sched_params,
 		                           "max_rpc_cnt=")))
 			defer_rpc_cnt = atoi(tmp_ptr + 12);
@@ -1260,6 +1393,8 @@ static int _schedule(uint32_t job_limit)
 	failed_resv = xmalloc(sizeof(struct slurmctld_resv*) * MAX_FAILED_RESV);
 	save_avail_node_bitmap = bit_copy(avail_node_bitmap);
 	bit_or(avail_node_bitmap, rs_node_bitmap);
+	if (shape_cache_enabled)
+		shape_cache = job_shape_cache_create();
 
 	/* Avoid resource fragmentation if important */
 	if (reduce_completing_frag) {
@@ -1685,6 +1820,19 @@ next_task:
 			job_ptr->time_limit = deadline_time_limit;
 		}
 
+		/*
+		 * Resources only become less available during this cycle, so
+		 * a job with the same shape as one which already failed to
+		 * get resources will fail the same way.
+		 */
+		xfree(shape_key);
+		if (shape_cache &&
+		    (shape_key = job_shape_key(job_ptr, 0)) &&
+		    job_shape_cache_test(shape_cache, job_ptr, shape_key)) {
+			error_code = ESLURM_NODES_BUSY;
+			goto skip_start;
+		}
+
 		/* get fed job lock from origin cluster */
 		if (fed_mgr_job_lock(job_ptr)) {
 			error_code = ESLURM_FED_JOB_LOCK;
@@ -1694,6 +1842,9 @@ next_task:
 		error_code = select_nodes(job_ptr, false, NULL, NULL, false,
 					  SLURMDB_JOB_FLAG_SCHED);
 
+		if (error_code == ESLURM_NODES_BUSY)
+			job_shape_cache_add(shape_cache, job_ptr, shape_key);
+
 		if (error_code == SLURM_SUCCESS) {
 			/*
 			 * If the following fails because of network
@@ -1887,6 +2038,13 @@ fail_this_part:	if (fail_by_part) {
 	avail_node_bitmap = save_avail_node_bitmap;
 	xfree(failed_parts);
 	xfree(failed_resv);
+	if (shape_cache) {
+		if (job_shape_cache_hits(shape_cache))
+			sched_debug("skipped %u jobs with the same shape as jobs unable to start",
+				    job_shape_cache_hits(shape_cache));
+		job_shape_cache_destroy(shape_cache);
+	}
+	xfree(shape_key);
 	if (fifo_sched) {
 		if (job_iterator)
 			list_iterator_destroy(job_iterator);
@@ -2864,6 +3022,190 @@ static void _test_dependency_state(depend_spec_t *dep_ptr, bool *or_satisfied,
 	}
 }
 
+/*
+ * Reverse dependency index: maps a dependee job ID to the IDs of pending jobs
+ * whose cached LOCAL_DEPEND result was computed against it. A job's cached
+ * result is valid while job_ptr->details->depend_gen equals depend_index_gen.
+ * State changes of a dependee invalidate only the jobs listed under its ID.
+ */
+#define DEPEND_INDEX_REFRESH 60	/* seconds between full re-tests */
+
+typedef struct {
+	char key[16];			/* dependee job ID as a string */
+	List dependents;		/* uint32_t job IDs */
+} depend_edge_t;
+
+static pthread_mutex_t depend_index_mutex = PTHREAD_MUTEX_INITIALIZER;
+static xhash_t *depend_index = NULL;
+static uint32_t depend_index_gen = 1;
+static time_t depend_index_time = 0;
+
+static void _depend_edge_id(void *item, const char **key, uint32_t *key_len)
+{
+	depend_edge_t *edge = (depend_edge_t *) item;
+
+	*key = edge->key;
+	*key_len = strlen(edge->key);
+}
+
+static void _depend_edge_free(void *item)
+{
+	depend_edge_t *edge = (depend_edge_t *) item;
+
+	FREE_NULL_LIST(edge->dependents);
+	xfree(edge);
+}
+
+static int _find_uint32(void *x, void *key)
+{
+	if (*(uint32_t *) x == *(uint32_t *) key)
+		return 1;
+	return 0;
+}
+
+/* Add a dependee -> dependent edge. Caller must hold depend_index_mutex */
+static void _depend_edge_add(uint32_t dependee_id, uint32_t job_id)
+{
+	depend_edge_t *edge;
+	char key[16];
+	uint32_t *id_ptr;
+
+	snprintf(key, sizeof(key), "%u", dependee_id);
+	if (!(edge = xhash_get_str(depend_index, key))) {
+		edge = xmalloc(sizeof(*edge));
+		strlcpy(edge->key, key, sizeof(edge->key));
+		edge->dependents = list_create(xfree_ptr);
+		xhash_add(depend_index, edge);
+	} else if (list_find_first(edge->dependents, _find_uint32, &job_id))
+		return;
+
+	id_ptr = xmalloc(sizeof(*id_ptr));
+	*id_ptr = job_id;
+	list_append(edge->dependents, id_ptr);
+}
+
+/*
+ * Only dependencies whose state can change solely through the dependee's
+ * start, completion or purge may be cached.
+ */
+static bool _depend_cacheable(depend_spec_t *dep_ptr)
+{
+	if (dep_ptr->depend_flags & SLURM_FLAGS_REMOTE)
+		return false;
+	if (dep_ptr->depend_time)
+		return false;
+	if ((dep_ptr->depend_type == SLURM_DEPEND_SINGLETON) ||
+	    (dep_ptr->depend_type == SLURM_DEPEND_BURST_BUFFER) ||
+	    (dep_ptr->depend_type == SLURM_DEPEND_EXPAND))
+		return false;
+	return true;
+}
+
+/* Record a job's LOCAL_DEPEND result in the index if it can be cached */
+static void _depend_index_register(job_record_t *job_ptr)
+{
+	ListIterator depend_iter;
+	depend_spec_t *dep_ptr;
+	bool cacheable = true;
+
+	if (fed_mgr_fed_rec)
+		return;
+
+	depend_iter = list_iterator_create(job_ptr->details->depend_list);
+	while ((dep_ptr = list_next(depend_iter))) {
+		if (!_depend_cacheable(dep_ptr)) {
+			cacheable = false;
+			break;
+		}
+	}
+	if (!cacheable) {
+		list_iterator_destroy(depend_iter);
+		return;
+	}
+
+	slurm_mutex_lock(&depend_index_mutex);
+	if (!depend_index)
+		depend_index = xhash_init(_depend_edge_id, _depend_edge_free);
+	list_iterator_reset(depend_iter);
+	while ((dep_ptr = list_next(depend_iter))) {
+		if (dep_ptr->depend_state == DEPEND_NOT_FULFILLED)
+			_depend_edge_add(dep_ptr->job_id, job_ptr->job_id);
+	}
+	job_ptr->details->depend_gen = depend_index_gen;
+	slurm_mutex_unlock(&depend_index_mutex);
+	list_iterator_destroy(depend_iter);
+}
+
+/* Invalidate every job depending upon dependee_id, then drop the edge */
+static void _depend_index_notify(uint32_t dependee_id)
+{
+	depend_edge_t *edge;
+	job_record_t *dep_job_ptr;
+	uint32_t *id_ptr;
+	char key[16];
+
+	snprintf(key, sizeof(key), "%u", dependee_id);
+	if (!(edge = xhash_pop_str(depend_index, key)))
+		return;
+	while ((id_ptr = list_pop(edge->dependents))) {
+		if ((dep_job_ptr = find_job_record(*id_ptr)) &&
+		    dep_job_ptr->details)
+			dep_job_ptr->details->depend_gen = 0;
+		xfree(id_ptr);
+	}
+	_depend_edge_free(edge);
+}
+
+extern void depend_index_job_update(job_record_t *job_ptr, bool purge)
+{
+	xassert(job_ptr);
+
+	slurm_mutex_lock(&depend_index_mutex);
+	if (depend_index) {
+		_depend_index_notify(job_ptr->job_id);
+		if (job_ptr->array_job_id &&
+		    (job_ptr->array_job_id != job_ptr->job_id))
+			_depend_index_notify(job_ptr->array_job_id);
+		if (job_ptr->het_job_id &&
+		    (job_ptr->het_job_id != job_ptr->job_id))
+			_depend_index_notify(job_ptr->het_job_id);
+	}
+	slurm_mutex_unlock(&depend_index_mutex);
+
+	if (purge && job_ptr->details)
+		job_ptr->details->depend_gen = 0;
+}
+
+extern void depend_index_invalidate(job_record_t *job_ptr)
+{
+	if (job_ptr->details)
+		job_ptr->details->depend_gen = 0;
+}
+
+/*
+ * Return true if the job's last LOCAL_DEPEND result is still valid. The
+ * index generation is advanced periodically so that any state change not
+ * routed through depend_index_job_update() is still picked up.
+ */
+static bool _depend_index_cached(job_record_t *job_ptr)
+{
+	time_t now = time(NULL);
+	bool cached;
+
+	slurm_mutex_lock(&depend_index_mutex);
+	if ((now - depend_index_time) >= DEPEND_INDEX_REFRESH) {
+		depend_index_time = now;
+		if (++depend_index_gen == 0)
+			depend_index_gen = 1;
+		if (depend_index)
+			xhash_clear(depend_index);
+	}
+	cached = (job_ptr->details->depend_gen == depend_index_gen);
+	slurm_mutex_unlock(&depend_index_mutex);
+
+	return cached;
+}
+
 /*
  * Determine if a job's dependencies are met
  * Inputs: job_ptr
@@ -2896,6 +3238,14 @@ extern int test_job_dependency(job_record_t *job_ptr, bool *was_changed)
 		return NO_DEPEND;
 	}
 
+	if (_depend_index_cached(job_ptr)) {
+		job_ptr->bit_flags |= JOB_DEPENDENT;
+		acct_policy_remove_accrue_time(job_ptr, false);
+		if (was_changed)
+			*was_changed = false;
+		return LOCAL_DEPEND;
+	}
+
 	depend_iter = list_iterator_create(job_ptr->details->depend_list);
 	while ((dep_ptr = list_next(depend_iter))) {
 		bool clear_dep = false, failure = false;
@@ -2935,8 +3285,7 @@ extern int test_job_dependency(job_record_t *job_ptr, bool *was_changed)
 		djob_ptr = dep_ptr->job_ptr;
 		if ((dep_ptr->depend_type == SLURM_DEPEND_SINGLETON) &&
 		    job_ptr->name) {
-			if (list_find_first(job_list, _find_singleton_job,
-					    job_ptr) ||
+			if (find_singleton_job(job_ptr) ||
 			    !fed_mgr_is_singleton_satisfied(job_ptr,
 							    dep_ptr, true)) {
 				/* Still depends */
@@ -3026,6 +3375,8 @@ extern int test_job_dependency(job_record_t *job_ptr, bool *was_changed)
 			/* Still dependent */
 			results = has_local_depend ? LOCAL_DEPEND :
 				REMOTE_DEPEND;
+		if (results == LOCAL_DEPEND)
+			_depend_index_register(job_ptr);
 	}
 
 	if (was_changed)
@@ -3575,6 +3926,8 @@ extern int update_job_dependency(job_record_t *job_ptr, char *new_depend)
 			select_hetero = 0;
 	}
 
+	depend_index_invalidate(job_ptr);
+
 	/* Clear dependencies on NULL, "0", or empty dependency input */
 	job_ptr->details->expanding_jobid = 0;
 	if ((new_depend == NULL) || (new_depend[0] == '\0') ||
@@ -4892,6 +5245,7 @@ void cleanup_completing(job_record_t *job_ptr)
 	delete_step_records(job_ptr);
 	job_ptr->job_state &= (~JOB_COMPLETING);
 	job_hold_requeue(job_ptr);
+	depend_index_job_update(job_ptr, false);
 
 	/*
 	 * Clear alloc tres fields after a requeue. job_set_alloc_tres will
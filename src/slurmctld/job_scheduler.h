@@ -253,6 +253,18 @@ extern int sort_job_queue2(void *x, void *y);
  */
 extern int test_job_dependency(job_record_t *job_ptr, bool *was_changed);
 
+/*
+ * Notify the dependency index that a job started, completed or is being
+ * purged. Jobs with a cached dependency result against it are re-tested
+ * on their next call to test_job_dependency().
+ * IN job_ptr - job whose state changed
+ * IN purge - true if the job record is about to be deleted
+ */
+extern void depend_index_job_update(job_record_t *job_ptr, bool purge);
+
+/* Discard a job's cached test_job_dependency() result */
+extern void depend_index_invalidate(job_record_t *job_ptr);
+
 /*
  * Parse a job dependency string and use it to establish a "depend_spec"
  * list of dependencies. We accept both old format (a single job ID) and
@@ -288,6 +300,53 @@ extern bool update_job_dependency_list(job_record_t *job_ptr,
 extern void fill_array_reasons(struct job_record *job_ptr,
 			       struct job_record *reject_arr_job);
 
+/*
+ * Job shape cache. Pending jobs which request identical resources (same
+ * partition, reservation, QOS, association, node counts, TRES, features, etc.)
+ * fail resource selection identically within a scheduling cycle, since
+ * resources only become less available as the cycle progresses. The main and
+ * backfill schedulers record such failures here and skip later jobs of the
+ * same shape instead of repeating the expensive node selection.
+ * Enabled with SchedulerParameters=job_shape_cache.
+ */
+typedef struct job_shape_cache job_shape_cache_t;
+
+/* Create an empty job shape cache, free with job_shape_cache_destroy() */
+extern job_shape_cache_t *job_shape_cache_create(void);
+
+/* Free a job shape cache and all of its records */
+extern void job_shape_cache_destroy(job_shape_cache_t *cache);
+
+/*
+ * Discard all records in the cache. Must be called when resources may have
+ * become available (e.g. after the scheduler releases its locks).
+ */
+extern void job_shape_cache_clear(job_shape_cache_t *cache);
+
+/*
+ * Build the shape key of a job.
+ * job_ptr IN - job to evaluate, with part_ptr set to the partition to test
+ * flags IN - scheduler specific flags which alter the result of a test
+ * RET key string, or NULL if the job can not be cached (e.g. HetJob
+ *     components or jobs with a burst buffer). Free with xfree().
+ */
+extern char *job_shape_key(job_record_t *job_ptr, uint32_t flags);
+
+/*
+ * Test if a job of the same shape already failed resource selection.
+ * If so, copy that job's state_reason and state_desc into job_ptr.
+ * RET true if the job is known to be unable to start
+ */
+extern bool job_shape_cache_test(job_shape_cache_t *cache,
+				 job_record_t *job_ptr, const char *key);
+
+/* Record that a job failed resource selection in this cycle */
+extern void job_shape_cache_add(job_shape_cache_t *cache,
+				job_record_t *job_ptr, const char *key);
+
+/* Return count of jobs skipped since the cache was created */
+extern uint32_t job_shape_cache_hits(job_shape_cache_t *cache);
+
 
 /* Add a job_queue_rec_t to job_queue */
 extern void job_queue_append_internal(job_queue_req_t *job_queue_req);
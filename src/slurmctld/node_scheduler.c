@@ -66,6 +66,7 @@
 #include "src/common/slurm_topology.h"
 #include "src/common/uid.h"
 #include "src/common/xassert.h"
+#include "src/common/xhash.h"
 #include "src/common/xmalloc.h"
 #include "src/common/xstring.h"
 
@@ -85,6 +86,7 @@
 
 #define _DEBUG	0
 #define MAX_FEATURES  32	/* max exclusive features "[fs1|fs2]"=2 */
+#define MAX_FEATURE_EXPR 1024	/* max cached feature expressions */
 
 struct node_set {		/* set of nodes with same configuration */
 	uint16_t cpus_per_node;	/* NOTE: This is the minimum count */
@@ -99,6 +101,14 @@ struct node_set {		/* set of nodes with same configuration */
 					 * node_weight and flags */
 };
 
+/* Result of _match_feature() for a feature expression, shared by all jobs */
+typedef struct {
+	char *expr;			/* feature names, operators and
+					 * parenthesis in list order */
+	bitstr_t *inactive_bitmap;	/* nodes without all of the required
+					 * features active, NULL if none */
+} feature_expr_t;
+
 #define NODE_SET_NOFLAG		0x00
 #define NODE_SET_REBOOT		0x01
 #define NODE_SET_OUTSIDE_FLEX	0x02
@@ -146,6 +156,10 @@ static bitstr_t *_valid_features(job_record_t *job_ptr,
 
 static uint32_t reboot_weight = 0;
 
+static pthread_mutex_t feature_expr_mutex = PTHREAD_MUTEX_INITIALIZER;
+static xhash_t *feature_expr_cache = NULL;
+static uint32_t feature_expr_gen = 0;
+
 /*
  * _get_ntasks_per_core - Retrieve the value of ntasks_per_core from
  *	the given job_details record.  If it wasn't set, return 0xffff.
@@ -644,6 +658,13 @@ extern void find_feature_nodes(List feature_list, bool can_reboot)
 		return;
 	feat_iter = list_iterator_create(feature_list);
 	while ((job_feat_ptr = list_next(feat_iter))) {
+		/* Bitmaps still current since node features last changed */
+		if ((job_feat_ptr->bitmap_gen == node_features_gen) &&
+		    (!job_feat_ptr->changeable ||
+		     (job_feat_ptr->bitmap_reboot == can_reboot)))
+			continue;
+		job_feat_ptr->bitmap_gen = node_features_gen;
+		job_feat_ptr->bitmap_reboot = can_reboot;
 		FREE_NULL_BITMAP(job_feat_ptr->node_bitmap_active);
 		FREE_NULL_BITMAP(job_feat_ptr->node_bitmap_avail);
 		node_feat_ptr = list_find_first(active_feature_list,
@@ -787,6 +808,76 @@ static int _match_feature(List feature_list, bitstr_t **inactive_bitmap)
 	return 1;
 }
 
+static void _feature_expr_key_id(void *item, const char **key,
+				 uint32_t *key_len)
+{
+	feature_expr_t *feature_expr = item;
+
+	*key = feature_expr->expr;
+	*key_len = strlen(feature_expr->expr);
+}
+
+static void _feature_expr_free(void *item)
+{
+	feature_expr_t *feature_expr = item;
+
+	if (!feature_expr)
+		return;
+	xfree(feature_expr->expr);
+	FREE_NULL_BITMAP(feature_expr->inactive_bitmap);
+	xfree(feature_expr);
+}
+
+/*
+ * Return a bitmap of nodes lacking some of the active features required by
+ *	feature_list, or NULL if no such node exists. Results are cached by
+ *	feature expression until the node features are next changed, so that
+ *	jobs with identical constraints evaluate the expression only once.
+ * RET bitmap which must be freed by the caller or NULL
+ */
+static bitstr_t *_inactive_feature_bitmap(List feature_list)
+{
+	ListIterator feat_iter;
+	job_feature_t *job_feat_ptr;
+	feature_expr_t *feature_expr;
+	bitstr_t *inactive_bitmap = NULL;
+	char *expr = NULL;
+
+	feat_iter = list_iterator_create(feature_list);
+	while ((job_feat_ptr = list_next(feat_iter))) {
+		xstrfmtcat(expr, "%s:%u:%u,", job_feat_ptr->name,
+			   job_feat_ptr->op_code, job_feat_ptr->paren);
+	}
+	list_iterator_destroy(feat_iter);
+
+	slurm_mutex_lock(&feature_expr_mutex);
+	if (!feature_expr_cache) {
+		feature_expr_cache = xhash_init(_feature_expr_key_id,
+						_feature_expr_free);
+	} else if ((feature_expr_gen != node_features_gen) ||
+		   (xhash_count(feature_expr_cache) >= MAX_FEATURE_EXPR)) {
+		xhash_clear(feature_expr_cache);
+	}
+	feature_expr_gen = node_features_gen;
+
+	if (!(feature_expr = xhash_get_str(feature_expr_cache, expr))) {
+		/* Only node_bitmap_active is used, independent of reboot */
+		find_feature_nodes(feature_list, false);
+		feature_expr = xmalloc(sizeof(feature_expr_t));
+		feature_expr->expr = expr;
+		expr = NULL;
+		(void) _match_feature(feature_list,
+				      &feature_expr->inactive_bitmap);
+		xhash_add(feature_expr_cache, feature_expr);
+	}
+	if (feature_expr->inactive_bitmap)
+		inactive_bitmap = bit_copy(feature_expr->inactive_bitmap);
+	slurm_mutex_unlock(&feature_expr_mutex);
+	xfree(expr);
+
+	return inactive_bitmap;
+}
+
 /*
  * For a given job, if the available nodes differ from those with currently
  *	active features, return a bitmap of nodes with the job's required
@@ -803,16 +894,13 @@ extern void build_active_feature_bitmap(job_record_t *job_ptr,
 {
 	struct job_details *details_ptr = job_ptr->details;
 	bitstr_t *tmp_bitmap = NULL;
-	bool can_reboot;
 
 	*active_bitmap = NULL;
 	if (!details_ptr->feature_list ||	/* nothing to look for */
 	    (node_features_g_count() == 0))	/* No inactive features */
 		return;
 
-	can_reboot = node_features_g_user_update(job_ptr->user_id);
-	find_feature_nodes(details_ptr->feature_list, can_reboot);
-	if (_match_feature(details_ptr->feature_list, &tmp_bitmap) == 0)
+	if (!(tmp_bitmap = _inactive_feature_bitmap(details_ptr->feature_list)))
 		return;		/* No inactive features */
 
 	bit_not(tmp_bitmap);
@@ -2311,6 +2399,7 @@ static void _end_null_job(job_record_t *job_ptr)
 	gres_plugin_job_clear(job_ptr->gres_list);
 	job_ptr->job_state = JOB_RUNNING;
 	job_ptr->bit_flags |= JOB_WAS_RUNNING;
+	depend_index_job_update(job_ptr, false);
 	FREE_NULL_BITMAP(job_ptr->node_bitmap);
 	xfree(job_ptr->nodes);
 	xfree(job_ptr->sched_nodes);
@@ -2848,6 +2937,7 @@ extern int select_nodes(job_record_t *job_ptr, bool test_only,
 
 	job_ptr->job_state = JOB_RUNNING;
 	job_ptr->bit_flags |= JOB_WAS_RUNNING;
+	depend_index_job_update(job_ptr, false);
 
 	if (select_g_select_nodeinfo_set(job_ptr) != SLURM_SUCCESS) {
 		error("select_g_select_nodeinfo_set(%pJ): %m", job_ptr);
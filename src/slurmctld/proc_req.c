@@ -1936,9 +1936,27 @@ static void  _slurm_rpc_epilog_complete(slurm_msg_t *msg,
 	log_flag(ROUTE, "%s: node_name = %s, JobId=%u",
 		 __func__, epilog_msg->node_name, epilog_msg->job_id);
 
-	if (job_epilog_complete(epilog_msg->job_id, epilog_msg->node_name,
-				epilog_msg->return_code))
-		*run_scheduler = true;
+	if (!epilog_msg->node_name || !strpbrk(epilog_msg->node_name, "[,")) {
+		if (job_epilog_complete(epilog_msg->job_id,
+					epilog_msg->node_name,
+					epilog_msg->return_code))
+			*run_scheduler = true;
+	} else {
+		/*
+		 * Completions of several nodes gathered along the reverse
+		 * tree by the slurmds (SlurmdParameters=aggregate_epilog)
+		 */
+		hostlist_t hl = hostlist_create(epilog_msg->node_name);
+		char *node_name;
+
+		while ((node_name = hostlist_shift(hl))) {
+			if (job_epilog_complete(epilog_msg->job_id, node_name,
+						epilog_msg->return_code))
+				*run_scheduler = true;
+			free(node_name);
+		}
+		hostlist_destroy(hl);
+	}
 
 	job_ptr = find_job_record(epilog_msg->job_id);
 
@@ -4741,6 +4741,8 @@ TRY_AVAIL:
 					tmp_bitmap);
 				tmp_bitmap = feat_ptr->node_bitmap_avail;
 			}
+			/* Bitmaps modified, rebuild on next find_feature_nodes */
+			feat_ptr->bitmap_gen = 0;
 			if (feat_ptr->paren == 1)
 				continue;
 		}
@@ -221,6 +221,8 @@ extern uint32_t   cluster_cpus;
 extern bool disable_remote_singleton;
 extern int max_depend_depth;
 extern bool node_features_updated;
+extern uint32_t node_features_gen;	/* incremented whenever the active or
+					 * available node features change */
 extern pthread_cond_t purge_thread_cond;
 extern pthread_mutex_t purge_thread_lock;
 extern pthread_mutex_t check_bf_running_lock;
@@ -487,6 +489,10 @@ extern time_t last_job_update;	/* time of last update to job records */
 #define FEATURE_OP_END  4		/* last entry lacks separator */
 typedef struct job_feature {
 	char *name;			/* name of feature */
+	uint32_t bitmap_gen;		/* node_features_gen value when the
+					 * node bitmaps below were built */
+	bool bitmap_reboot;		/* can_reboot value used to build
+					 * node_bitmap_avail */
 	bool changeable;		/* return value of
 					 * node_features_g_changeable_feature */
 	uint16_t count;			/* count of nodes with this feature */
@@ -535,6 +541,9 @@ struct job_details {
 	uint16_t orig_cpus_per_task;	/* requested value of cpus_per_task */
 	List depend_list;		/* list of job_ptr:state pairs */
 	char *dependency;		/* wait for other jobs */
+	uint32_t depend_gen;		/* test_job_dependency() result is
+					 * cached while this matches the
+					 * dependency index generation */
 	char *orig_dependency;		/* original value (for archiving) */
 	uint16_t env_cnt;		/* size of env_sup (see below) */
 	char **env_sup;			/* supplemental environment variables */
@@ -645,6 +654,17 @@ typedef struct {
 	uint32_t priority;		/* whole hetjob calculated priority */
 } het_job_details_t;
 
+/* Layout of a job's last simple step, reused by step_layout_create() */
+typedef struct {
+	uint16_t cpus_per_task;		/* cpus_per_task the layout was built
+					 * with */
+	job_resources_t *job_resrcs;	/* job resources the layout was built
+					 * from */
+	slurm_step_layout_t *layout;	/* cached step layout */
+	uint16_t node_protocol_ver;	/* lowest slurmd version of the
+					 * layout's nodes */
+} step_layout_cache_t;
+
 /*
  * NOTE: When adding fields to the job_record, or any underlying structures,
  * be sure to sync with job_array_split.
@@ -833,6 +853,9 @@ struct job_record {
 					 * priority or resources, only stored in
 					 * the database. */
 	List step_list;			/* list of job's steps */
+	xhash_t *step_hash;		/* job's steps indexed by step ID,
+					 * see find_step_record() */
+	step_layout_cache_t *step_layout_cache; /* see step_layout_create() */
 	time_t suspend_time;		/* time job last suspended or resumed */
 	char *system_comment;		/* slurmctld's arbitrary comment */
 	time_t time_last_active;	/* time of last job activity */
@@ -1246,6 +1269,15 @@ extern job_record_t *find_het_job_record(uint32_t job_id, uint32_t het_job_id);
  */
 extern job_record_t *find_job_record(uint32_t job_id);
 
+/*
+ * find_singleton_job - return a job which prevents a singleton dependency of
+ *	the given job from being satisfied: a running or suspended job, or an
+ *	earlier pending job, of the same user and job name
+ * IN job_ptr - job with the singleton dependency
+ * RET pointer to the blocking job's record, NULL if none
+ */
+extern job_record_t *find_singleton_job(job_record_t *job_ptr);
+
 /*
  * find_first_node_record - find a record for first node in the bitmap
  * IN node_bitmap
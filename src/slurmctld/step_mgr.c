@@ -116,6 +116,8 @@ static hostlist_t _step_range_to_hostlist(step_record_t *step_ptr,
 					  uint32_t range_last);
 static int _step_hostname_to_inx(step_record_t *step_ptr, char *node_name);
 static void _step_dealloc_lps(step_record_t *step_ptr);
+static void _step_index_add(step_record_t *step_ptr);
+static void _step_index_remove(step_record_t *step_ptr);
 
 /* Determine how many more CPUs are required for a job step */
 static int  _opt_cpu_cnt(uint32_t step_min_cpus, bitstr_t *node_bitmap,
@@ -205,6 +207,63 @@ static step_record_t *_create_step_record(job_record_t *job_ptr,
 	return step_ptr;
 }
 
+/*
+ * Steps are indexed in job_ptr->step_hash by the binary key formed by their
+ * adjacent step_het_comp and step_id fields.
+ */
+#define STEP_INDEX_KEY_LEN (sizeof(uint32_t) * 2)
+
+static void _step_index_identify(void *item, const char **key,
+				 uint32_t *key_len)
+{
+	step_record_t *step_ptr = (step_record_t *) item;
+
+	*key = (const char *) &step_ptr->step_id.step_het_comp;
+	*key_len = STEP_INDEX_KEY_LEN;
+}
+
+/*
+ * Add a step to its job's step index, call once step_ptr->step_id is set.
+ * Pending steps share one step ID and are only found by scanning step_list.
+ */
+static void _step_index_add(step_record_t *step_ptr)
+{
+	job_record_t *job_ptr = step_ptr->job_ptr;
+	step_record_t *old_ptr;
+
+	if (step_ptr->step_id.step_id == SLURM_PENDING_STEP)
+		return;
+
+	if (!job_ptr->step_hash)
+		job_ptr->step_hash = xhash_init(_step_index_identify, NULL);
+
+	old_ptr = xhash_get(job_ptr->step_hash,
+			    (char *) &step_ptr->step_id.step_het_comp,
+			    STEP_INDEX_KEY_LEN);
+	if (old_ptr == step_ptr)
+		return;
+	if (old_ptr)
+		xhash_pop(job_ptr->step_hash,
+			  (char *) &step_ptr->step_id.step_het_comp,
+			  STEP_INDEX_KEY_LEN);
+	xhash_add(job_ptr->step_hash, step_ptr);
+}
+
+static void _step_index_remove(step_record_t *step_ptr)
+{
+	job_record_t *job_ptr = step_ptr->job_ptr;
+
+	if (!job_ptr || !job_ptr->step_hash)
+		return;
+
+	if (xhash_get(job_ptr->step_hash,
+		      (char *) &step_ptr->step_id.step_het_comp,
+		      STEP_INDEX_KEY_LEN) == step_ptr)
+		xhash_pop(job_ptr->step_hash,
+			  (char *) &step_ptr->step_id.step_het_comp,
+			  STEP_INDEX_KEY_LEN);
+}
+
 /* Purge any duplicate job steps for this PID */
 static int _purge_duplicate_steps(job_record_t *job_ptr,
 				  job_step_create_request_msg_t *step_specs)
@@ -443,6 +502,11 @@ extern void step_list_purge(job_record_t *job_ptr)
 	}
 	list_iterator_destroy(step_iterator);
 	FREE_NULL_LIST(job_ptr->step_list);
+	xhash_free(job_ptr->step_hash);
+	if (job_ptr->step_layout_cache) {
+		slurm_step_layout_destroy(job_ptr->step_layout_cache->layout);
+		xfree(job_ptr->step_layout_cache);
+	}
 }
 
 /* _free_step_rec - delete a step record's data structures */
@@ -450,6 +514,7 @@ static void _free_step_rec(step_record_t *step_ptr)
 {
 	xassert(step_ptr);
 	xassert(step_ptr->magic == STEP_MAGIC);
+	_step_index_remove(step_ptr);
 /*
  * FIXME: If job step record is preserved after completion,
  * the switch_g_job_step_complete() must be called upon completion
@@ -597,9 +662,24 @@ dump_step_desc(job_step_create_request_msg_t *step_spec)
  */
 step_record_t *find_step_record(job_record_t *job_ptr, slurm_step_id_t *step_id)
 {
+	step_record_t *step_ptr;
+
 	if (job_ptr == NULL)
 		return NULL;
 
+	if (job_ptr->step_hash && (step_id->step_id != NO_VAL) &&
+	    (step_id->step_id != SLURM_PENDING_STEP)) {
+		step_ptr = xhash_get(job_ptr->step_hash,
+				     (char *) &step_id->step_het_comp,
+				     STEP_INDEX_KEY_LEN);
+		if (step_ptr)
+			return verify_step_id(&step_ptr->step_id, step_id) ?
+				step_ptr : NULL;
+		/* Any component of a het step, or not found */
+		if (step_id->step_het_comp != NO_VAL)
+			return NULL;
+	}
+
 	return list_find_first(job_ptr->step_list, _find_step_id, step_id);
 }
 
@@ -2627,6 +2707,7 @@ extern int step_create(job_step_create_request_msg_t *step_specs,
 	} else {
 		step_ptr->step_id.step_id = job_ptr->next_step_id++;
 	}
+	_step_index_add(step_ptr);
 
 	/* Here is where the node list is set for the step */
 	if (step_specs->node_list &&
@@ -2917,6 +2998,75 @@ extern int step_create(job_step_create_request_msg_t *step_specs,
 	return SLURM_SUCCESS;
 }
 
+/*
+ * A step which is not exclusive, has no GRES and no per-CPU memory limit
+ * gets the same layout every time for a given node list and task geometry,
+ * independent of what other steps are using.
+ */
+static bool _step_layout_cacheable(step_record_t *step_ptr)
+{
+	if (step_ptr->exclusive)
+		return false;
+	if (step_ptr->gres_list && list_count(step_ptr->gres_list))
+		return false;
+	if ((step_ptr->pn_min_memory & MEM_PER_CPU) && _is_mem_resv())
+		return false;
+	return true;
+}
+
+/* Return a copy of the job's cached layout if it matches the request */
+static slurm_step_layout_t *_step_layout_cache_get(step_record_t *step_ptr,
+						   char *step_node_list,
+						   uint32_t node_count,
+						   uint32_t num_tasks,
+						   uint16_t cpus_per_task,
+						   uint32_t task_dist,
+						   uint16_t plane_size)
+{
+	step_layout_cache_t *cache = step_ptr->job_ptr->step_layout_cache;
+	slurm_step_layout_t *step_layout;
+
+	if (!cache || !_step_layout_cacheable(step_ptr))
+		return NULL;
+	if ((cache->job_resrcs != step_ptr->job_ptr->job_resrcs) ||
+	    (cache->cpus_per_task != cpus_per_task) ||
+	    (cache->layout->node_cnt != node_count) ||
+	    (cache->layout->task_cnt != num_tasks) ||
+	    (cache->layout->task_dist != task_dist) ||
+	    (cache->layout->plane_size != plane_size) ||
+	    xstrcmp(cache->layout->node_list, step_node_list))
+		return NULL;
+
+	step_ptr->start_protocol_ver = MIN(step_ptr->start_protocol_ver,
+					   cache->node_protocol_ver);
+	step_layout = slurm_step_layout_copy(cache->layout);
+	step_layout->start_protocol_ver = step_ptr->start_protocol_ver;
+
+	return step_layout;
+}
+
+static void _step_layout_cache_set(step_record_t *step_ptr,
+				   slurm_step_layout_t *step_layout,
+				   uint16_t cpus_per_task,
+				   uint16_t node_protocol_ver)
+{
+	job_record_t *job_ptr = step_ptr->job_ptr;
+	step_layout_cache_t *cache;
+
+	if (!_step_layout_cacheable(step_ptr))
+		return;
+
+	if (!(cache = job_ptr->step_layout_cache))
+		cache = job_ptr->step_layout_cache = xmalloc(sizeof(*cache));
+	else
+		slurm_step_layout_destroy(cache->layout);
+
+	cache->cpus_per_task = cpus_per_task;
+	cache->job_resrcs = job_ptr->job_resrcs;
+	cache->layout = slurm_step_layout_copy(step_layout);
+	cache->node_protocol_ver = node_protocol_ver;
+}
+
 extern slurm_step_layout_t *step_layout_create(step_record_t *step_ptr,
 					       char *step_node_list,
 					       uint32_t node_count,
@@ -2942,6 +3092,7 @@ extern slurm_step_layout_t *step_layout_create(step_record_t *step_ptr,
 	uint32_t cpus_task = 0;
 	uint16_t ntasks_per_core = 0;
 	uint16_t ntasks_per_socket = 0;
+	uint16_t node_protocol_ver = NO_VAL16;
 	bool first_step_node = true;
 
 	xassert(job_resrcs_ptr);
@@ -2965,6 +3116,12 @@ extern slurm_step_layout_t *step_layout_create(step_record_t *step_ptr,
 			step_ptr->job_ptr->front_end_ptr->protocol_version;
 #endif
 
+	if ((step_layout = _step_layout_cache_get(step_ptr, step_node_list,
+						  node_count, num_tasks,
+						  cpus_per_task, task_dist,
+						  plane_size)))
+		return step_layout;
+
 	if (job_ptr->details && job_ptr->details->mc_ptr) {
 		multi_core_data_t *mc_ptr = job_ptr->details->mc_ptr;
 		if (mc_ptr->ntasks_per_core &&
@@ -2995,6 +3152,8 @@ extern slurm_step_layout_t *step_layout_create(step_record_t *step_ptr,
 			    node_ptr->protocol_version)
 				step_ptr->start_protocol_ver =
 					node_ptr->protocol_version;
+			node_protocol_ver = MIN(node_protocol_ver,
+						node_ptr->protocol_version);
 #endif
 
 			/* find out the position in the job */
@@ -3152,6 +3311,8 @@ extern slurm_step_layout_t *step_layout_create(step_record_t *step_ptr,
 
 	if ((step_layout = slurm_step_layout_create(&step_layout_req))) {
 		step_layout->start_protocol_ver = step_ptr->start_protocol_ver;
+		_step_layout_cache_set(step_ptr, step_layout, cpus_per_task,
+				       node_protocol_ver);
 	}
 
 	return step_layout;
@@ -4254,6 +4415,7 @@ extern int load_step_state(job_record_t *job_ptr, Buf buffer,
 
 	/* set new values */
 	memcpy(&step_ptr->step_id, &step_id, sizeof(step_ptr->step_id));
+	_step_index_add(step_ptr);
 
 	step_ptr->cpu_count    = cpu_count;
 	step_ptr->cpus_per_task= cpus_per_task;
@@ -4766,6 +4928,7 @@ extern step_record_t *build_extern_step(job_record_t *job_ptr)
 	step_ptr->step_id.job_id = job_ptr->job_id;
 	step_ptr->step_id.step_id = SLURM_EXTERN_CONT;
 	step_ptr->step_id.step_het_comp = NO_VAL;
+	_step_index_add(step_ptr);
 	if (job_ptr->node_bitmap)
 		step_ptr->step_node_bitmap =
 			bit_copy(job_ptr->node_bitmap);
@@ -4804,6 +4967,7 @@ extern step_record_t *build_batch_step(job_record_t *job_ptr_in)
 	step_ptr->step_id.job_id = job_ptr->job_id;
 	step_ptr->step_id.step_id = SLURM_BATCH_SCRIPT;
 	step_ptr->step_id.step_het_comp = NO_VAL;
+	_step_index_add(step_ptr);
 	step_ptr->batch_step = 1;
 
 	if (node_name2bitmap(job_ptr->batch_host, false,
@@ -42,8 +42,12 @@
 #include "config.h"
 
 #include <ctype.h>
+#include <dirent.h>
 #include <fcntl.h>
 #include <grp.h>
+#ifdef __linux__
+#include <linux/fs.h>	/* FICLONE */
+#endif
 #ifdef HAVE_NUMA
 #undef NUMA_VERSION1_COMPATIBILITY
 #include <numa.h>
@@ -54,6 +58,7 @@
 #include <signal.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/ioctl.h>
 #include <sys/param.h>
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -80,6 +85,7 @@
 #include "src/common/node_select.h"
 #include "src/common/plugstack.h"
 #include "src/common/prep.h"
+#include "src/common/proc_args.h"
 #include "src/common/read_config.h"
 #include "src/common/slurm_auth.h"
 #include "src/common/slurm_cred.h"
@@ -178,6 +184,7 @@ static void _rpc_health_check(slurm_msg_t *);
 static void _rpc_acct_gather_update(slurm_msg_t *);
 static void _rpc_acct_gather_energy(slurm_msg_t *);
 static void _rpc_step_complete(slurm_msg_t *msg);
+static void _rpc_epilog_complete(slurm_msg_t *msg);
 static void _rpc_stat_jobacct(slurm_msg_t *msg);
 static void _rpc_list_pids(slurm_msg_t *msg);
 static void _rpc_daemon_status(slurm_msg_t *msg);
@@ -191,6 +198,8 @@ static bool _pause_for_job_completion(uint32_t jobid, char *nodes,
 				      int maxtime);
 static bool _slurm_authorized_user(uid_t uid);
 static void _sync_messages_kill(kill_job_msg_t *req);
+static bool _epilog_aggr_own(kill_job_msg_t *req, int rc);
+static void _epilog_aggr_flush(bool all);
 static int  _waiter_init (uint32_t jobid);
 static int  _waiter_complete (uint32_t jobid);
 
@@ -248,6 +257,7 @@ static pthread_mutex_t prolog_mutex = PTHREAD_MUTEX_INITIALIZER;
 static pthread_mutex_t prolog_serial_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 #define FILE_BCAST_TIMEOUT 300
+#define FILE_BCAST_CACHE_SIZE 1024	/* default sbcast CacheSize in MB */
 static pthread_mutex_t file_bcast_mutex = PTHREAD_MUTEX_INITIALIZER;
 static pthread_cond_t  file_bcast_cond  = PTHREAD_COND_INITIALIZER;
 static int fb_read_lock = 0, fb_write_wait_lock = 0, fb_write_lock = 0;
@@ -255,12 +265,40 @@ static List file_bcast_list = NULL;
 
 static pthread_mutex_t waiter_mutex = PTHREAD_MUTEX_INITIALIZER;
 
+/*
+ * SlurmdParameters=aggregate_epilog, see _epilog_aggr_own(). Successful
+ * epilog completions are gathered along the reverse tree of the job's nodes
+ * for up to EPILOG_AGGR_WAIT seconds. Flushed jobs are remembered for
+ * EPILOG_AGGR_KEEP seconds so late completions go straight to slurmctld.
+ */
+#define EPILOG_AGGR_WAIT 5
+#define EPILOG_AGGR_KEEP 300
+typedef struct {
+	uint32_t job_id;
+	hostlist_t hl;		/* nodes of this subtree that completed */
+	int children;		/* direct children, -1 until own epilog done */
+	int reported;		/* direct children that reported */
+	char *parent;		/* parent node, NULL to send to slurmctld */
+	time_t start;		/* when the first completion arrived */
+	time_t sent;		/* when the completions were forwarded */
+} epilog_aggr_t;
+static pthread_mutex_t epilog_aggr_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t epilog_aggr_cond = PTHREAD_COND_INITIALIZER;
+static List epilog_aggr_list = NULL;
+static int epilog_aggr_pending = 0;
+static bool epilog_aggr_running = false;
+
+/* LaunchParameters=slurmstepd_zygote, see _stepd_zygote_fork() */
+static pthread_mutex_t zygote_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int zygote_fd = -1;
+
 void
 slurmd_req(slurm_msg_t *msg)
 {
 	if (msg == NULL) {
 		if (startup == 0)
 			startup = time(NULL);
+		_epilog_aggr_flush(true);
 		slurm_mutex_lock(&waiter_mutex);
 		FREE_NULL_LIST(waiters);
 		slurm_mutex_unlock(&waiter_mutex);
@@ -315,6 +353,9 @@ slurmd_req(slurm_msg_t *msg)
 		last_slurmctld_msg = time(NULL);
 		_rpc_terminate_job(msg);
 		break;
+	case MESSAGE_EPILOG_COMPLETE:
+		_rpc_epilog_complete(msg);
+		break;
 	case REQUEST_COMPLETE_BATCH_SCRIPT:
 		_rpc_complete_batch(msg);
 		break;
@@ -433,10 +474,140 @@ rwfail:
 	return (-1);
 }
 
+/* Send the configuration which slurmstepd reads before any step data */
+static int _send_slurmstepd_conf(int fd)
+{
+	/* send conf over to slurmstepd */
+	if (send_slurmd_conf_lite(fd, conf) < 0)
+		return -1;
+
+	/* send cgroup conf over to slurmstepd */
+	if (xcgroup_write_conf(fd) < 0)
+		return -1;
+
+	/* send acct_gather.conf over to slurmstepd */
+	if (acct_gather_write_conf(fd) < 0)
+		return -1;
+
+	return 0;
+}
+
+/*
+ * Start a "slurmstepd zygote" process which loads its configuration and
+ * plugins once, then forks a ready step manager whenever it is sent a
+ * step's pipes. Like other slurmstepds it is double forked, so its parent
+ * is init. It exits when zygote_fd is closed. Caller must hold zygote_mutex.
+ */
+static void _stepd_zygote_start(void)
+{
+	char *const argv[3] = { (char *)conf->stepd_loc, "zygote", NULL };
+	int sock[2], i;
+	pid_t pid;
+
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, sock) < 0) {
+		error("%s: socketpair: %m", __func__);
+		return;
+	}
+
+	if ((pid = fork()) < 0) {
+		error("%s: fork: %m", __func__);
+		close(sock[0]);
+		close(sock[1]);
+		return;
+	} else if (pid == 0) {
+		if (setsid() < 0)
+			error("%s: setsid: %m", __func__);
+		if ((pid = fork()) < 0) {
+			error("%s: Unable to fork grandchild: %m", __func__);
+			_exit(1);
+		} else if (pid > 0) {
+			_exit(0);
+		}
+		for (i = 3; i < 256; i++)
+			(void) fcntl(i, F_SETFD, FD_CLOEXEC);
+		if ((dup2(sock[1], STDIN_FILENO) == -1) ||
+		    (dup2(devnull, STDOUT_FILENO) == -1) ||
+		    (dup2(devnull, STDERR_FILENO) == -1)) {
+			error("%s: dup2: %m", __func__);
+			_exit(1);
+		}
+		log_fini();
+		execvp(argv[0], argv);
+		error("exec of slurmstepd zygote failed: %m");
+		_exit(2);
+	}
+
+	close(sock[1]);
+	if (waitpid(pid, NULL, 0) < 0)
+		error("%s: Unable to reap slurmd child process", __func__);
+	fd_set_close_on_exec(sock[0]);
+
+	if (_send_slurmstepd_conf(sock[0]) < 0) {
+		error("%s: unable to send configuration to zygote", __func__);
+		close(sock[0]);
+		return;
+	}
+	zygote_fd = sock[0];
+	debug("%s: slurmstepd zygote started", __func__);
+}
+
+extern void stepd_zygote_init(void)
+{
+	if (!xstrcasestr(slurm_conf.launch_params, "slurmstepd_zygote"))
+		return;
+
+	slurm_mutex_lock(&zygote_mutex);
+	if (zygote_fd < 0)
+		_stepd_zygote_start();
+	slurm_mutex_unlock(&zygote_mutex);
+}
+
+extern void stepd_zygote_fini(void)
+{
+	slurm_mutex_lock(&zygote_mutex);
+	if (zygote_fd >= 0) {
+		close(zygote_fd);
+		zygote_fd = -1;
+	}
+	slurm_mutex_unlock(&zygote_mutex);
+}
+
+/*
+ * Have the zygote fork a slurmstepd which uses stepd_in/stepd_out in place
+ * of the pipes that a directly exec'd slurmstepd gets as stdin/stdout.
+ * RET SLURM_SUCCESS, or SLURM_ERROR if slurmstepd must be fork/exec'd
+ */
+static int _stepd_zygote_fork(int stepd_in, int stepd_out)
+{
+	int fds[2] = { stepd_in, stepd_out };
+	int rc = SLURM_ERROR;
+
+	if (!xstrcasestr(slurm_conf.launch_params, "slurmstepd_zygote"))
+		return SLURM_ERROR;
+
+	slurm_mutex_lock(&zygote_mutex);
+	if (zygote_fd < 0)
+		_stepd_zygote_start();
+	if (zygote_fd >= 0) {
+		if (send_fds_over_socket(zygote_fd, fds, 2) == SLURM_SUCCESS) {
+			rc = SLURM_SUCCESS;
+		} else {
+			error("%s: slurmstepd zygote failed, launching directly",
+			      __func__);
+			close(zygote_fd);
+			zygote_fd = -1;
+		}
+	}
+	slurm_mutex_unlock(&zygote_mutex);
+
+	return rc;
+}
+
 static int
 _send_slurmstepd_init(int fd, int type, void *req,
 		      slurm_addr_t *cli, slurm_addr_t *self,
-		      hostset_t step_hset, uint16_t protocol_version)
+		      hostset_t step_hset, uint16_t protocol_version,
+		      bool zygote)
 {
 	int len = 0;
 	Buf buffer = NULL;
@@ -449,16 +620,8 @@ _send_slurmstepd_init(int fd, int type, void *req,
 
 	slurm_msg_t_init(&msg);
 
-	/* send conf over to slurmstepd */
-	if (send_slurmd_conf_lite(fd, conf) < 0)
-		goto rwfail;
-
-	/* send cgroup conf over to slurmstepd */
-	if (xcgroup_write_conf(fd) < 0)
-		goto rwfail;
-
-	/* send acct_gather.conf over to slurmstepd */
-	if (acct_gather_write_conf(fd) < 0)
+	/* a zygote slurmstepd received the configuration at startup */
+	if (!zygote && (_send_slurmstepd_conf(fd) < 0))
 		goto rwfail;
 
 	/* send type over to slurmstepd */
@@ -640,9 +803,10 @@ _forkexec_slurmstepd(uint16_t type, void *req,
 		     slurm_addr_t *cli, slurm_addr_t *self,
 		     const hostset_t step_hset, uint16_t protocol_version)
 {
-	pid_t pid;
+	pid_t pid = -1;
 	int to_stepd[2] = {-1, -1};
 	int to_slurmd[2] = {-1, -1};
+	bool zygote = false;
 
 	if (pipe(to_stepd) < 0 || pipe(to_slurmd) < 0) {
 		error("%s: pipe failed: %m", __func__);
@@ -654,6 +818,11 @@ _forkexec_slurmstepd(uint16_t type, void *req,
 		return SLURM_ERROR;
 	}
 
+#if (SLURMSTEPD_MEMCHECK == 0)
+	if (_stepd_zygote_fork(to_stepd[0], to_slurmd[1]) == SLURM_SUCCESS)
+		zygote = true;
+	else
+#endif
 	if ((pid = fork()) < 0) {
 		error("%s: fork: %m", __func__);
 		close(to_stepd[0]);
@@ -662,7 +831,9 @@ _forkexec_slurmstepd(uint16_t type, void *req,
 		close(to_slurmd[1]);
 		_remove_starting_step(type, req);
 		return SLURM_ERROR;
-	} else if (pid > 0) {
+	}
+
+	if (zygote || (pid > 0)) {
 		int rc = SLURM_SUCCESS;
 #if (SLURMSTEPD_MEMCHECK == 0)
 		int i;
@@ -681,7 +852,8 @@ _forkexec_slurmstepd(uint16_t type, void *req,
 		if ((rc = _send_slurmstepd_init(to_stepd[1], type,
 						req, cli, self,
 						step_hset,
-						protocol_version)) != 0) {
+						protocol_version,
+						zygote)) != 0) {
 			error("Unable to init slurmstepd");
 			goto done;
 		}
@@ -721,8 +893,8 @@ _forkexec_slurmstepd(uint16_t type, void *req,
 		if (_remove_starting_step(type, req))
 			error("Error cleaning up starting_step list");
 
-		/* Reap child */
-		if (waitpid(pid, NULL, 0) < 0)
+		/* Reap child, the zygote reaps its own */
+		if (!zygote && (waitpid(pid, NULL, 0) < 0))
 			error("Unable to reap slurmd child process");
 		if (close(to_stepd[1]) < 0)
 			error("close write to_stepd in parent: %m");
@@ -4012,6 +4184,10 @@ static int _bcast_find_in_list_to_remove(void *x, void *y)
 	file_bcast_info_t *f = (file_bcast_info_t *)x;
 	time_t *now = (time_t *) y;
 
+	/* sbcast skips the remaining blocks once all nodes had it cached */
+	if (f->cached && (f->last_update + FILE_BCAST_TIMEOUT < *now))
+		return true;
+
 	if (f->last_update + FILE_BCAST_TIMEOUT < *now) {
 		error("Removing stalled file_bcast transfer from uid "
 		      "%u to file `%s`", f->uid, f->fname);
@@ -4044,6 +4220,315 @@ void file_bcast_purge(void)
 	/* destroying list before exit, no need to unlock */
 }
 
+/* Set the modes, owner and times of a completely transferred file */
+static void _bcast_set_file_attrs(int fd, file_bcast_msg_t *req,
+				  file_bcast_info_t *key)
+{
+	if (fchmod(fd, (req->modes & 0777))) {
+		error("sbcast: uid:%u can't chmod `%s`: %m",
+		      key->uid, key->fname);
+	}
+	if (fchown(fd, key->uid, key->gid)) {
+		error("sbcast: uid:%u gid:%u can't chown `%s`: %m",
+		      key->uid, key->gid, key->fname);
+	}
+	if (req->atime) {
+		struct utimbuf time_buf;
+		time_buf.actime  = req->atime;
+		time_buf.modtime = req->mtime;
+		if (utime(key->fname, &time_buf)) {
+			error("sbcast: uid:%u can't utime `%s`: %m",
+			      key->uid, key->fname);
+		}
+	}
+}
+
+/*
+ * The sbcast cache (SbcastParameters=CacheDir=<dir>[,CacheSize=<MB>]) keeps
+ * a root owned copy of files broadcast to this node, named by owner, content
+ * hash and size. When a later sbcast by the same user sends the same content
+ * the destination is filled from the cache and the node replies to the first
+ * block with ESLURMD_FILE_CACHED. Entries are keyed per user so a hash
+ * collision can not expose one user's file to another. The least recently
+ * used entries are removed to stay within CacheSize.
+ */
+static pthread_mutex_t bcast_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+typedef struct {
+	char *cache_dir;
+	int fd;
+	uint64_t file_hash;
+	uint64_t file_size;
+	uid_t uid;
+} bcast_cache_add_t;
+
+typedef struct {
+	char *path;
+	time_t mtime;
+	uint64_t size;
+} bcast_cache_entry_t;
+
+/* RET xmalloc'd cache directory, NULL if the cache is not configured */
+static char *_bcast_cache_dir(void)
+{
+	char *tmp, *sep, *dir = NULL;
+
+	if ((tmp = xstrcasestr(slurm_conf.sbcast_parameters, "CacheDir="))) {
+		dir = xstrdup(tmp + 9);
+		if ((sep = strchr(dir, ',')))
+			sep[0] = '\0';
+		if (!dir[0])
+			xfree(dir);
+	}
+	return dir;
+}
+
+/* RET cache size limit in bytes */
+static uint64_t _bcast_cache_limit(void)
+{
+	char *tmp, *sep, *size_str;
+	uint64_t size_mb = FILE_BCAST_CACHE_SIZE;
+
+	if ((tmp = xstrcasestr(slurm_conf.sbcast_parameters, "CacheSize="))) {
+		size_str = xstrdup(tmp + 10);
+		if ((sep = strchr(size_str, ',')))
+			sep[0] = '\0';
+		if ((size_mb = str_to_mbytes(size_str)) == NO_VAL64) {
+			error("Invalid SbcastParameters CacheSize=%s",
+			      size_str);
+			size_mb = FILE_BCAST_CACHE_SIZE;
+		}
+		xfree(size_str);
+	}
+	return size_mb * 1024 * 1024;
+}
+
+static char *_bcast_cache_path(char *cache_dir, uid_t uid, uint64_t file_hash,
+			       uint64_t file_size)
+{
+	return xstrdup_printf("%s/%u.%016"PRIx64".%"PRIu64,
+			      cache_dir, uid, file_hash, file_size);
+}
+
+/* RET fd of the cached copy of a file, -1 if not cached */
+static int _bcast_cache_open(char *cache_dir, uid_t uid, uint64_t file_hash,
+			     uint64_t file_size)
+{
+	char *path = _bcast_cache_path(cache_dir, uid, file_hash, file_size);
+	struct stat stat_buf;
+	int fd;
+
+	if ((fd = open(path, O_RDONLY | O_CLOEXEC)) < 0) {
+		xfree(path);
+		return -1;
+	}
+	if (fstat(fd, &stat_buf) || !S_ISREG(stat_buf.st_mode) ||
+	    (stat_buf.st_uid != 0) || (stat_buf.st_size != file_size)) {
+		close(fd);
+		xfree(path);
+		return -1;
+	}
+
+	/* the modification time orders entries for eviction */
+	(void) utime(path, NULL);
+	xfree(path);
+	return fd;
+}
+
+/*
+ * Copy file_size bytes from in_fd to out_fd, sharing the data blocks with
+ * a reflink where the file system supports it.
+ * IN hash - if non-zero, fail unless the copied data has this hash
+ * RET 0 on success, -1 on error
+ */
+static int _bcast_copy_fd(int in_fd, int out_fd, uint64_t file_size,
+			  uint64_t hash)
+{
+	char *buf;
+	off_t offset = 0;
+	ssize_t in, out, written;
+	uint64_t data_hash = BCAST_HASH_INIT;
+	int rc = 0;
+
+#ifdef FICLONE
+	if (!hash && (ioctl(out_fd, FICLONE, in_fd) == 0))
+		return 0;
+#endif
+
+	buf = xmalloc(1024 * 1024);
+	while (offset < file_size) {
+		in = pread(in_fd, buf, 1024 * 1024, offset);
+		if (in < 0) {
+			if ((errno == EINTR) || (errno == EAGAIN))
+				continue;
+			rc = -1;
+			break;
+		} else if (in == 0) {
+			rc = -1;	/* file shorter than expected */
+			break;
+		}
+		if (hash)
+			data_hash = bcast_hash_data(buf, in, data_hash);
+		for (written = 0; written < in; written += out) {
+			out = pwrite(out_fd, buf + written, in - written,
+				     offset + written);
+			if (out < 0) {
+				if ((errno == EINTR) || (errno == EAGAIN)) {
+					out = 0;
+					continue;
+				}
+				rc = -1;
+				break;
+			}
+		}
+		if (rc)
+			break;
+		offset += in;
+	}
+	xfree(buf);
+
+	if (!rc && hash && (data_hash != hash))
+		rc = -1;
+	return rc;
+}
+
+static int _bcast_cache_entry_cmp(void *x, void *y)
+{
+	bcast_cache_entry_t *entry1 = *(bcast_cache_entry_t **) x;
+	bcast_cache_entry_t *entry2 = *(bcast_cache_entry_t **) y;
+
+	if (entry1->mtime < entry2->mtime)
+		return -1;
+	if (entry1->mtime > entry2->mtime)
+		return 1;
+	return 0;
+}
+
+static void _bcast_cache_entry_free(void *x)
+{
+	bcast_cache_entry_t *entry = x;
+
+	xfree(entry->path);
+	xfree(entry);
+}
+
+/* Remove least recently used entries until the cache fits its limit */
+static void _bcast_cache_evict(char *cache_dir, uint64_t limit)
+{
+	DIR *dir;
+	struct dirent *ent;
+	struct stat stat_buf;
+	bcast_cache_entry_t *entry;
+	uint64_t total = 0;
+	List entries;
+
+	if (!(dir = opendir(cache_dir)))
+		return;
+
+	entries = list_create(_bcast_cache_entry_free);
+	while ((ent = readdir(dir))) {
+		char *path;
+
+		if (ent->d_name[0] == '.')	/* including partial copies */
+			continue;
+		path = xstrdup_printf("%s/%s", cache_dir, ent->d_name);
+		if (stat(path, &stat_buf) || !S_ISREG(stat_buf.st_mode)) {
+			xfree(path);
+			continue;
+		}
+		entry = xmalloc(sizeof(*entry));
+		entry->path = path;
+		entry->mtime = stat_buf.st_mtime;
+		entry->size = stat_buf.st_size;
+		total += entry->size;
+		list_append(entries, entry);
+	}
+	closedir(dir);
+
+	if (total > limit) {
+		list_sort(entries, _bcast_cache_entry_cmp);
+		while ((total > limit) && (entry = list_pop(entries))) {
+			debug("sbcast: removing %s from cache", entry->path);
+			if (unlink(entry->path) == 0)
+				total -= entry->size;
+			_bcast_cache_entry_free(entry);
+		}
+	}
+	FREE_NULL_LIST(entries);
+}
+
+static void *_bcast_cache_add_thread(void *arg)
+{
+	bcast_cache_add_t *add = arg;
+	char *path, *tmp_path;
+	uint64_t limit = _bcast_cache_limit();
+	int fd;
+
+	if (add->file_size > limit)
+		goto fini;
+
+	path = _bcast_cache_path(add->cache_dir, add->uid, add->file_hash,
+				 add->file_size);
+	tmp_path = xstrdup_printf("%s/.%u.%016"PRIx64".%"PRIu64".tmp",
+				  add->cache_dir, add->uid, add->file_hash,
+				  add->file_size);
+
+	slurm_mutex_lock(&bcast_cache_mutex);
+	if ((mkdir(add->cache_dir, 0700) < 0) && (errno != EEXIST)) {
+		error("sbcast: can't create cache directory %s: %m",
+		      add->cache_dir);
+	} else if (access(path, F_OK) == 0) {
+		;	/* another transfer already added it */
+	} else if ((fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC |
+			      O_CLOEXEC, 0600)) < 0) {
+		error("sbcast: can't create %s: %m", tmp_path);
+	} else {
+		/* verify the hash sent matches the data written */
+		if (_bcast_copy_fd(add->fd, fd, add->file_size,
+				   add->file_hash) ||
+		    rename(tmp_path, path)) {
+			debug("sbcast: not caching %s", path);
+			(void) unlink(tmp_path);
+		}
+		close(fd);
+		_bcast_cache_evict(add->cache_dir, limit);
+	}
+	slurm_mutex_unlock(&bcast_cache_mutex);
+
+	xfree(path);
+	xfree(tmp_path);
+fini:
+	close(add->fd);
+	xfree(add->cache_dir);
+	xfree(add);
+	return NULL;
+}
+
+/* Copy a completely transferred file into the cache in the background */
+static void _bcast_cache_add(file_bcast_info_t *file_info)
+{
+	bcast_cache_add_t *add;
+	int fd;
+
+	if ((fd = dup(file_info->fd)) < 0) {
+		error("%s: dup: %m", __func__);
+		return;
+	}
+	fd_set_close_on_exec(fd);
+
+	add = xmalloc(sizeof(*add));
+	if (!(add->cache_dir = _bcast_cache_dir())) {
+		close(fd);
+		xfree(add);
+		return;
+	}
+	add->fd = fd;
+	add->file_hash = file_info->file_hash;
+	add->file_size = file_info->file_size;
+	add->uid = file_info->uid;
+	slurm_thread_create_detached(NULL, _bcast_cache_add_thread, add);
+}
+
 static void _rpc_file_bcast(slurm_msg_t *msg)
 {
 	int rc;
@@ -4112,6 +4597,16 @@ static void _rpc_file_bcast(slurm_msg_t *msg)
 		goto done;
 	}
 
+	/* file was copied from the cache when it was registered */
+	if (file_info->cached) {
+		file_info->last_update = time(NULL);
+		_fb_rdunlock();
+		if (req->last_block)
+			_file_bcast_close_file(&key);
+		rc = SLURM_SUCCESS;
+		goto done;
+	}
+
 	/* now decompress file */
 	if (bcast_decompress_data(req) < 0) {
 		error("sbcast: data decompression error for UID %u, file %s",
@@ -4121,10 +4616,15 @@ static void _rpc_file_bcast(slurm_msg_t *msg)
 		goto done;
 	}
 
+	/*
+	 * Write at the block's offset rather than the file position since
+	 * a pipelined sbcast can have several blocks in flight at once.
+	 */
 	offset = 0;
 	while (req->block_len - offset) {
-		inx = write(file_info->fd, &req->block[offset],
-			    (req->block_len - offset));
+		inx = pwrite(file_info->fd, &req->block[offset],
+			     (req->block_len - offset),
+			     req->block_offset + offset);
 		if (inx == -1) {
 			if ((errno == EINTR) || (errno == EAGAIN))
 				continue;
@@ -4139,23 +4639,11 @@ static void _rpc_file_bcast(slurm_msg_t *msg)
 
 	file_info->last_update = time(NULL);
 
-	if (req->last_block && fchmod(file_info->fd, (req->modes & 0777))) {
-		error("sbcast: uid:%u can't chmod `%s`: %m",
-		      key.uid, key.fname);
-	}
-	if (req->last_block && fchown(file_info->fd, key.uid, key.gid)) {
-		error("sbcast: uid:%u gid:%u can't chown `%s`: %m",
-		      key.uid, key.gid, key.fname);
-	}
-	if (req->last_block && req->atime) {
-		struct utimbuf time_buf;
-		time_buf.actime  = req->atime;
-		time_buf.modtime = req->mtime;
-		if (utime(key.fname, &time_buf)) {
-			error("sbcast: uid:%u can't utime `%s`: %m",
-			      key.uid, key.fname);
-		}
-	}
+	if (req->last_block)
+		_bcast_set_file_attrs(file_info->fd, req, &key);
+
+	if (req->last_block && file_info->file_hash)
+		_bcast_cache_add(file_info);
 
 	_fb_rdunlock();
 
@@ -4172,8 +4660,9 @@ static int _file_bcast_register_file(slurm_msg_t *msg,
 				     file_bcast_info_t *key)
 {
 	file_bcast_msg_t *req = msg->data;
-	int fd, flags;
+	int fd, flags, cache_fd = -1, rc = SLURM_SUCCESS;
 	file_bcast_info_t *file_info;
+	char *cache_dir = NULL;
 
 	/* may still be unset in credential */
 	if (!cred_arg->ngids || !cred_arg->gids)
@@ -4181,7 +4670,13 @@ static int _file_bcast_register_file(slurm_msg_t *msg,
 						     cred_arg->user_name,
 						     &cred_arg->gids);
 
-	flags = O_WRONLY | O_CREAT;
+	if (req->file_hash && (cache_dir = _bcast_cache_dir()))
+		cache_fd = _bcast_cache_open(cache_dir, key->uid,
+					     req->file_hash, req->file_size);
+
+	/* the cache copy is made from this fd after the last block */
+	flags = (req->file_hash && cache_dir) ? O_RDWR : O_WRONLY;
+	flags |= O_CREAT;
 	if (req->force)
 		flags |= O_TRUNC;
 	else
@@ -4191,6 +4686,9 @@ static int _file_bcast_register_file(slurm_msg_t *msg,
 				 key->job_id, key->uid, key->gid,
 				 cred_arg->ngids, cred_arg->gids)) == -1) {
 		error("Unable to open %s: Permission denied", req->fname);
+		if (cache_fd >= 0)
+			close(cache_fd);
+		xfree(cache_dir);
 		return SLURM_ERROR;
 	}
 
@@ -4201,13 +4699,38 @@ static int _file_bcast_register_file(slurm_msg_t *msg,
 	file_info->gid = key->gid;
 	file_info->job_id = key->job_id;
 	file_info->last_update = file_info->start_time = time(NULL);
+	file_info->file_size = req->file_size;
+	if (cache_dir)
+		file_info->file_hash = req->file_hash;
+
+	if ((cache_fd >= 0) &&
+	    (_bcast_copy_fd(cache_fd, fd, req->file_size, 0) == 0)) {
+		debug("sbcast: uid:%u copied `%s` from cache",
+		      key->uid, req->fname);
+		_bcast_set_file_attrs(fd, req, key);
+		close(fd);
+		file_info->fd = 0;
+		file_info->cached = true;
+		rc = ESLURMD_FILE_CACHED;
+	} else if ((cache_fd >= 0) && (ftruncate(fd, 0) < 0)) {
+		error("sbcast: uid:%u can't truncate `%s`: %m",
+		      key->uid, req->fname);
+	}
+	if (cache_fd >= 0)
+		close(cache_fd);
+	xfree(cache_dir);
 
 	//TODO: mmap the file here
 	_fb_wrlock();
-	list_append(file_bcast_list, file_info);
+	/* a new first block replaces any stale transfer of the same file */
+	list_delete_all(file_bcast_list, _bcast_find_in_list, key);
+	if (file_info->cached && req->last_block)
+		_free_file_bcast_info_t(file_info);
+	else
+		list_append(file_bcast_list, file_info);
 	_fb_wrunlock();
 
-	return SLURM_SUCCESS;
+	return rc;
 }
 
 static void
@@ -4657,6 +5180,253 @@ static int _epilog_complete(uint32_t jobid, int rc)
 	return SLURM_SUCCESS;
 }
 
+static void _epilog_aggr_free(void *x)
+{
+	epilog_aggr_t *aggr = (epilog_aggr_t *) x;
+
+	hostlist_destroy(aggr->hl);
+	xfree(aggr->parent);
+	xfree(aggr);
+}
+
+static int _epilog_aggr_find(void *x, void *key)
+{
+	epilog_aggr_t *aggr = (epilog_aggr_t *) x;
+
+	return (aggr->job_id == *(uint32_t *) key);
+}
+
+/* Send completed nodes to the parent slurmd, or to slurmctld */
+static void _epilog_aggr_send(uint32_t jobid, char *nodes, char *parent)
+{
+	slurm_msg_t msg;
+	epilog_complete_msg_t req;
+
+	if (parent) {
+		_epilog_complete_msg_setup(&msg, &req, jobid, SLURM_SUCCESS);
+		req.node_name = nodes;
+		if ((slurm_conf_get_addr(parent, &msg.address, msg.flags) ==
+		     SLURM_SUCCESS) &&
+		    (slurm_send_only_node_msg(&msg) == SLURM_SUCCESS)) {
+			debug("JobId=%u: sent epilog complete msg for %s to %s",
+			      jobid, nodes, parent);
+			return;
+		}
+		verbose("JobId=%u: unable to send epilog complete msg to %s, sending it to slurmctld: %m",
+			jobid, parent);
+	}
+
+	_epilog_complete_msg_setup(&msg, &req, jobid, SLURM_SUCCESS);
+	req.node_name = nodes;
+	if (slurm_send_only_controller_msg(&msg, working_cluster_rec) < 0)
+		error("Unable to send epilog complete message: %m");
+	else
+		debug("JobId=%u: sent epilog complete msg for %s",
+		      jobid, nodes);
+}
+
+/*
+ * Forward the completions of jobs whose subtree reported or which waited
+ * EPILOG_AGGR_WAIT seconds, or of all jobs if "all" is set.
+ */
+static void _epilog_aggr_flush(bool all)
+{
+	List send_list = NULL;
+	ListIterator iter;
+	epilog_aggr_t *aggr, *send;
+	time_t now = time(NULL);
+	char *nodes;
+
+	slurm_mutex_lock(&epilog_aggr_mutex);
+	if (!epilog_aggr_list) {
+		slurm_mutex_unlock(&epilog_aggr_mutex);
+		return;
+	}
+	iter = list_iterator_create(epilog_aggr_list);
+	while ((aggr = list_next(iter))) {
+		if (aggr->sent) {
+			if (difftime(now, aggr->sent) >= EPILOG_AGGR_KEEP)
+				list_delete_item(iter);
+			continue;
+		}
+		if (!all &&
+		    ((aggr->children < 0) ||
+		     (aggr->reported < aggr->children)) &&
+		    (difftime(now, aggr->start) < EPILOG_AGGR_WAIT))
+			continue;
+
+		if (!send_list)
+			send_list = list_create(_epilog_aggr_free);
+		send = xmalloc(sizeof(*send));
+		send->job_id = aggr->job_id;
+		send->hl = aggr->hl;
+		send->parent = aggr->parent;
+		list_append(send_list, send);
+		aggr->hl = hostlist_create(NULL);
+		aggr->parent = NULL;
+		aggr->sent = now;
+		epilog_aggr_pending--;
+	}
+	list_iterator_destroy(iter);
+	slurm_mutex_unlock(&epilog_aggr_mutex);
+
+	if (!send_list)
+		return;
+	while ((send = list_pop(send_list))) {
+		nodes = hostlist_ranged_string_xmalloc(send->hl);
+		_epilog_aggr_send(send->job_id, nodes, send->parent);
+		xfree(nodes);
+		_epilog_aggr_free(send);
+	}
+	FREE_NULL_LIST(send_list);
+}
+
+static void *_epilog_aggr_thread(void *arg)
+{
+	struct timespec ts = {0, 0};
+
+	slurm_mutex_lock(&epilog_aggr_mutex);
+	while (epilog_aggr_pending > 0) {
+		ts.tv_sec = time(NULL) + 1;
+		slurm_cond_timedwait(&epilog_aggr_cond, &epilog_aggr_mutex,
+				     &ts);
+		slurm_mutex_unlock(&epilog_aggr_mutex);
+		_epilog_aggr_flush(false);
+		slurm_mutex_lock(&epilog_aggr_mutex);
+	}
+	epilog_aggr_running = false;
+	slurm_mutex_unlock(&epilog_aggr_mutex);
+
+	return NULL;
+}
+
+/*
+ * Add the completed nodes of a job, either this node's own ("own" set,
+ * with its tree position) or those reported by a child. Returns false if
+ * the job's completions were already forwarded, in which case the caller
+ * must send them to slurmctld itself.
+ */
+static bool _epilog_aggr_add(uint32_t jobid, char *nodes, bool own,
+			     int children, char *parent)
+{
+	epilog_aggr_t *aggr;
+	bool ready;
+
+	slurm_mutex_lock(&epilog_aggr_mutex);
+	if (!epilog_aggr_list)
+		epilog_aggr_list = list_create(_epilog_aggr_free);
+	if (!(aggr = list_find_first(epilog_aggr_list, _epilog_aggr_find,
+				     &jobid))) {
+		aggr = xmalloc(sizeof(*aggr));
+		aggr->job_id = jobid;
+		aggr->hl = hostlist_create(NULL);
+		aggr->children = -1;
+		aggr->start = time(NULL);
+		list_append(epilog_aggr_list, aggr);
+		epilog_aggr_pending++;
+	} else if (aggr->sent) {
+		slurm_mutex_unlock(&epilog_aggr_mutex);
+		return false;
+	}
+
+	hostlist_push(aggr->hl, nodes);
+	if (own) {
+		aggr->children = children;
+		aggr->parent = xstrdup(parent);
+	} else
+		aggr->reported++;
+	ready = ((aggr->children >= 0) && (aggr->reported >= aggr->children));
+
+	if (!epilog_aggr_running) {
+		epilog_aggr_running = true;
+		slurm_thread_create_detached(NULL, _epilog_aggr_thread, NULL);
+	}
+	slurm_mutex_unlock(&epilog_aggr_mutex);
+
+	if (ready)
+		_epilog_aggr_flush(false);
+
+	return true;
+}
+
+/*
+ * With SlurmdParameters=aggregate_epilog, hand this node's successful
+ * epilog completion to the reverse tree of the job's nodes. Each node
+ * forwards its subtree's completions to its parent as one message carrying
+ * a hostlist, and the root sends them to slurmctld, so a large job's
+ * completion reaches the controller in a few RPCs.
+ * Returns false if the completion must be sent directly.
+ */
+static bool _epilog_aggr_own(kill_job_msg_t *req, int rc)
+{
+#ifdef HAVE_FRONT_END
+	return false;
+#else
+	hostset_t hosts;
+	int count, rank, parent_rank, children, depth, max_depth;
+	int child_ranks[REVERSE_TREE_WIDTH];
+	char *parent = NULL;
+	bool added = false;
+
+	if (rc || !req->nodes ||
+	    !xstrcasestr(slurm_conf.slurmd_params, "aggregate_epilog"))
+		return false;
+
+	if (!(hosts = hostset_create(req->nodes)))
+		return false;
+	count = hostset_count(hosts);
+	rank = hostset_find(hosts, conf->node_name);
+	if ((count > 1) && (rank >= 0)) {
+		reverse_tree_info(rank, count, REVERSE_TREE_WIDTH,
+				  &parent_rank, &children, &depth, &max_depth);
+		if (children >= 0) {
+			/*
+			 * reverse_tree_info() counts the whole subtree, but
+			 * each direct child reports its subtree at once.
+			 */
+			children = reverse_tree_direct_children(
+				rank, count, REVERSE_TREE_WIDTH, depth,
+				child_ranks);
+			if (parent_rank >= 0)
+				parent = hostset_nth(hosts, parent_rank);
+			added = _epilog_aggr_add(req->step_id.job_id,
+						 conf->node_name, true,
+						 children, parent);
+			if (parent)
+				free(parent);
+		}
+	}
+	hostset_destroy(hosts);
+
+	return added;
+#endif
+}
+
+/* Epilog completions of a child's subtree (SlurmdParameters=aggregate_epilog) */
+static void _rpc_epilog_complete(slurm_msg_t *msg)
+{
+	epilog_complete_msg_t *req = (epilog_complete_msg_t *) msg->data;
+	uid_t req_uid = g_slurm_auth_get_uid(msg->auth_cred);
+	slurm_msg_t fwd_msg;
+	epilog_complete_msg_t fwd_req;
+
+	if (!_slurm_authorized_user(req_uid)) {
+		error("Security violation, epilog complete RPC from uid %d",
+		      req_uid);
+		return;
+	}
+
+	if (!req->return_code &&
+	    _epilog_aggr_add(req->job_id, req->node_name, false, 0, NULL))
+		return;
+
+	_epilog_complete_msg_setup(&fwd_msg, &fwd_req, req->job_id,
+				   req->return_code);
+	fwd_req.node_name = req->node_name;
+	if (slurm_send_only_controller_msg(&fwd_msg, working_cluster_rec) < 0)
+		error("Unable to send epilog complete message: %m");
+}
+
 /* if a lock is granted to the job then return 1; else return 0 if
  * the lock for the job is already taken or there's no more locks */
 static int
@@ -5332,9 +6102,11 @@ _rpc_terminate_job(slurm_msg_t *msg)
 done:
 	_wait_state_completed(req->step_id.job_id, 5);
 	_waiter_complete(req->step_id.job_id);
-	_sync_messages_kill(req);
 
-	_epilog_complete(req->step_id.job_id, rc);
+	if (!_epilog_aggr_own(req, rc)) {
+		_sync_messages_kill(req);
+		_epilog_complete(req->step_id.job_id, rc);
+	}
 }
 
 /* On a parallel job, every slurmd may send the EPILOG_COMPLETE
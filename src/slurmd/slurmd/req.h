@@ -59,6 +59,13 @@ void gids_cache_purge(void);
 /* Add record for every launched job so we know they are ready for suspend */
 extern void record_launched_jobs(void);
 
+/*
+ * Start/stop the pre-forked slurmstepd used to launch steps when
+ * LaunchParameters=slurmstepd_zygote is configured
+ */
+extern void stepd_zygote_init(void);
+extern void stepd_zygote_fini(void);
+
 void file_bcast_init(void);
 void file_bcast_purge(void);
 
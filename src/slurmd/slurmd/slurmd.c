@@ -66,6 +66,10 @@
 #include <sys/utsname.h>
 #include <unistd.h>
 
+#if HAVE_SYS_PRCTL_H
+#  include <sys/prctl.h>
+#endif
+
 #include "src/common/assoc_mgr.h"
 #include "src/common/bitstring.h"
 #include "src/common/cpu_frequency.h"
@@ -91,6 +95,8 @@
 #include "src/common/slurm_auth.h"
 #include "src/common/slurm_cred.h"
 #include "src/common/slurm_acct_gather_energy.h"
+#include "src/common/slurm_acct_gather_filesystem.h"
+#include "src/common/slurm_acct_gather_interconnect.h"
 #include "src/common/slurm_jobacct_gather.h"
 #include "src/common/slurm_mcs.h"
 #include "src/common/slurm_protocol_api.h"
@@ -178,6 +184,13 @@ static sig_atomic_t _update_log = 0;
 static pthread_t msg_pthread = (pthread_t) 0;
 static time_t sent_reg_time = (time_t) 0;
 
+/* JobAcctGatherParams=NodeSampler thread */
+static pthread_t node_sampler_thread = (pthread_t) 0;
+static pthread_mutex_t node_sampler_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t node_sampler_cond = PTHREAD_COND_INITIALIZER;
+static bool node_sampler_stop = false;
+static uint16_t node_sampler_interval = 0;
+
 static void      _atfork_final(void);
 static void      _atfork_prepare(void);
 static int       _convert_spec_cores(void);
@@ -196,6 +209,9 @@ static bool      _is_core_spec_cray(void);
 static void      _kill_old_slurmd(void);
 static int       _memory_spec_init(void);
 static void      _msg_engine(void);
+static void     *_node_sampler(void *arg);
+static void      _node_sampler_fini(void);
+static void      _node_sampler_init(void);
 static void      _print_conf(void);
 static void      _print_config(void);
 static void      _print_gres(void);
@@ -388,6 +404,8 @@ main (int argc, char **argv)
 	_install_fork_handlers();
 	slurm_conf_install_fork_handlers();
 	record_launched_jobs();
+	stepd_zygote_init();
+	_node_sampler_init();
 
 	run_script_health_check();
 
@@ -442,6 +460,90 @@ _registration_engine(void *arg)
 	return NULL;
 }
 
+/*
+ * Read the node energy, filesystem and interconnect counters once per
+ * interval and publish them to the slurmstepds of the node through the
+ * shared ring, instead of every slurmstepd reading the same counters.
+ */
+static void *_node_sampler(void *arg)
+{
+	acct_gather_node_sample_t sample;
+	struct timespec ts = {0, 0};
+
+#if HAVE_SYS_PRCTL_H
+	if (prctl(PR_SET_NAME, "node_sampler", NULL, NULL, NULL) < 0)
+		error("%s: cannot set my name to %s %m",
+		      __func__, "node_sampler");
+#endif
+
+	slurm_mutex_lock(&node_sampler_mutex);
+	while (!node_sampler_stop) {
+		slurm_mutex_unlock(&node_sampler_mutex);
+
+		memset(&sample, 0, sizeof(sample));
+		acct_gather_energy_g_update_node_energy();
+		(void) acct_gather_energy_g_get_sum(ENERGY_DATA_NODE_ENERGY,
+						    &sample.energy);
+		(void) acct_gather_filesystem_g_get_node_data(
+			&sample.filesystem);
+		(void) acct_gather_interconnect_g_get_node_data(
+			&sample.interconnect);
+		sample.sample_time = time(NULL);
+		acct_gather_node_ring_publish(&sample);
+
+		slurm_mutex_lock(&node_sampler_mutex);
+		ts.tv_sec = time(NULL) + node_sampler_interval;
+		if (!node_sampler_stop)
+			slurm_cond_timedwait(&node_sampler_cond,
+					     &node_sampler_mutex, &ts);
+	}
+	slurm_mutex_unlock(&node_sampler_mutex);
+
+	return NULL;
+}
+
+static void _node_sampler_init(void)
+{
+	int freq;
+
+	if (!xstrcasestr(slurm_conf.job_acct_gather_params, "NodeSampler")) {
+		acct_gather_node_ring_remove(conf->spooldir);
+		return;
+	}
+
+	freq = acct_gather_parse_freq(PROFILE_TASK,
+				      slurm_conf.job_acct_gather_freq);
+	if (freq <= 0)
+		freq = 30;
+	node_sampler_interval = freq;
+
+	if (acct_gather_node_ring_create(conf->spooldir,
+					 node_sampler_interval) !=
+	    SLURM_SUCCESS) {
+		error("%s: node sampling disabled, slurmstepds will read the node counters themselves",
+		      __func__);
+		return;
+	}
+
+	node_sampler_stop = false;
+	slurm_thread_create(&node_sampler_thread, _node_sampler, NULL);
+}
+
+static void _node_sampler_fini(void)
+{
+	if (!node_sampler_thread)
+		return;
+
+	slurm_mutex_lock(&node_sampler_mutex);
+	node_sampler_stop = true;
+	slurm_cond_signal(&node_sampler_cond);
+	slurm_mutex_unlock(&node_sampler_mutex);
+	pthread_join(node_sampler_thread, NULL);
+	node_sampler_thread = (pthread_t) 0;
+
+	acct_gather_node_ring_fini();
+}
+
 static void
 _msg_engine(void)
 {
@@ -1143,6 +1245,13 @@ _reconfigure(void)
 	/* reconfigure energy */
 	acct_gather_energy_g_set_data(ENERGY_DATA_RECONFIG, NULL);
 
+	/* restart the slurmstepd zygote so it gets the new configuration */
+	stepd_zygote_fini();
+	stepd_zygote_init();
+
+	_node_sampler_fini();
+	_node_sampler_init();
+
 	/*
 	 * XXX: reopen slurmd port?
 	 */
@@ -1873,6 +1982,8 @@ cleanup:
 static int
 _slurmd_fini(void)
 {
+	_node_sampler_fini();
+	stepd_zygote_fini();
 	assoc_mgr_fini(false);
 	node_features_g_fini();
 	core_spec_g_fini();
@@ -56,6 +56,7 @@
 #include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <termios.h>
 #include <unistd.h>
 
@@ -192,14 +193,34 @@ static void *_window_manager(void *arg);
 /**********************************************************************
  * General declarations
  **********************************************************************/
+/*
+ * Stdio forwarding counters, reported when the IO thread exits. Only the
+ * IO thread touches these.
+ */
+static struct {
+	uint64_t task_bytes;	/* bytes read from task stdout/stderr */
+	uint64_t task_reads;	/* read()/readv() calls on task pipes */
+	uint64_t client_bytes;	/* bytes written to client sockets */
+	uint64_t client_msgs;	/* messages written to client sockets */
+	uint64_t client_writes;	/* writev() calls on client sockets */
+	uint32_t stalls;	/* times task output waited for buffers */
+	int max_outgoing;	/* high water mark of outgoing buffers */
+} io_stats;
+
+/* Task output is held in cbufs until an outgoing buffer is freed */
+static bool outgoing_stalled = false;
+
 static void *_io_thr(void *);
 static int _send_io_init_msg(int sock, srun_key_t *key, stepd_step_rec_t *job,
 			     bool init);
 static void _send_eof_msg(struct task_read_info *out);
 static struct io_buf *_task_build_message(struct task_read_info *out,
 					  stepd_step_rec_t *job, cbuf_t *cbuf);
+static void _task_pack_header(struct task_read_info *out, struct io_buf *msg,
+			      int length);
 static void *_io_thr(void *arg);
 static void _route_msg_task_to_client(eio_obj_t *obj);
+static void _enqueue_task_msg(struct task_read_info *out, struct io_buf *msg);
 static void _free_outgoing_msg(struct io_buf *msg, stepd_step_rec_t *job);
 static void _free_incoming_msg(struct io_buf *msg, stepd_step_rec_t *job);
 static void _free_all_outgoing_msgs(List msg_queue, stepd_step_rec_t *job);
@@ -422,14 +443,19 @@ _client_read(eio_obj_t *obj, List objs)
 }
 
 /*
- * Write outgoing packed messages to the client socket.
+ * Write outgoing packed messages to the client socket. The messages queued
+ * behind the current one are gathered into the same writev() so that a
+ * burst of small messages costs one system call rather than one per message.
  */
 static int
 _client_write(eio_obj_t *obj, List objs)
 {
 	struct client_io_info *client = (struct client_io_info *) obj->arg;
-	void *buf;
-	int n;
+	struct iovec iov[STDIO_MAX_IOV];
+	struct io_buf *msg;
+	ListIterator msgs;
+	int iovcnt;
+	ssize_t n;
 
 	xassert(client->magic == CLIENT_IO_MAGIC);
 
@@ -452,13 +478,23 @@ _client_write(eio_obj_t *obj, List objs)
 
 	debug5("  client->out_remaining = %d", client->out_remaining);
 
+	iov[0].iov_base = client->out_msg->data +
+		(client->out_msg->length - client->out_remaining);
+	iov[0].iov_len = client->out_remaining;
+	iovcnt = 1;
+	msgs = list_iterator_create(client->msg_queue);
+	while ((iovcnt < STDIO_MAX_IOV) && (msg = list_next(msgs))) {
+		iov[iovcnt].iov_base = msg->data;
+		iov[iovcnt].iov_len = msg->length;
+		iovcnt++;
+	}
+	list_iterator_destroy(msgs);
+
 	/*
-	 * Write message to socket.
+	 * Write messages to socket.
 	 */
-	buf = client->out_msg->data +
-		(client->out_msg->length - client->out_remaining);
 again:
-	if ((n = write(obj->fd, buf, client->out_remaining)) < 0) {
+	if ((n = writev(obj->fd, iov, iovcnt)) < 0) {
 		if (errno == EINTR) {
 			goto again;
 		} else if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
@@ -470,17 +506,21 @@ again:
 			return SLURM_SUCCESS;
 		}
 	}
-	if (n < client->out_remaining) {
-		error("Only wrote %d of %d bytes to socket",
-		      n, client->out_remaining);
-	} else
-		debug5("Wrote %d bytes to socket", n);
-	client->out_remaining -= n;
-	if (client->out_remaining > 0)
-		return SLURM_SUCCESS;
+	debug5("Wrote %zd bytes in %d messages to socket", n, iovcnt);
+	io_stats.client_writes++;
+	io_stats.client_bytes += n;
 
-	_free_outgoing_msg(client->out_msg, client->job);
-	client->out_msg = NULL;
+	/* Release the messages that were written whole */
+	while (client->out_msg && (n >= client->out_remaining)) {
+		n -= client->out_remaining;
+		_free_outgoing_msg(client->out_msg, client->job);
+		io_stats.client_msgs++;
+		if ((client->out_msg = list_dequeue(client->msg_queue)))
+			client->out_remaining = client->out_msg->length;
+		else
+			client->out_remaining = 0;
+	}
+	client->out_remaining -= n;
 
 	return SLURM_SUCCESS;
 }
@@ -740,6 +780,52 @@ _task_readable(eio_obj_t *obj)
 	return false;
 }
 
+/*
+ * Read unbuffered task output straight into outgoing message buffers,
+ * skipping the copy through the task's cbuf. Up to STDIO_MAX_IOV messages
+ * are filled by a single readv(). Returns the number of bytes read, 0 on
+ * eof or -1 on error.
+ */
+static int
+_task_read_direct(eio_obj_t *obj, struct task_read_info *out)
+{
+	stepd_step_rec_t *job = out->job;
+	struct iovec iov[STDIO_MAX_IOV];
+	struct io_buf *msgs[STDIO_MAX_IOV];
+	int cnt = 0, i;
+	ssize_t n, left;
+
+	while ((cnt < STDIO_MAX_IOV) && _outgoing_buf_free(job)) {
+		msgs[cnt] = list_dequeue(job->free_outgoing);
+		iov[cnt].iov_base = msgs[cnt]->data + io_hdr_packed_size();
+		iov[cnt].iov_len = MAX_MSG_LEN;
+		cnt++;
+	}
+
+again:
+	if ((n = readv(obj->fd, iov, cnt)) < 0) {
+		if (errno == EINTR)
+			goto again;
+	}
+	if (n > 0) {
+		io_stats.task_reads++;
+		io_stats.task_bytes += n;
+	}
+
+	left = n;
+	for (i = 0; i < cnt; i++) {
+		if (left <= 0) {
+			list_enqueue(job->free_outgoing, msgs[i]);
+			continue;
+		}
+		_task_pack_header(out, msgs[i], MIN(left, MAX_MSG_LEN));
+		left -= MAX_MSG_LEN;
+		_enqueue_task_msg(out, msgs[i]);
+	}
+
+	return n;
+}
+
 /*
  * Read output (stdout or stderr) from a task into a cbuf.  The cbuf
  * allows whole lines to be packed into messages if line buffering
@@ -756,7 +842,20 @@ _task_read(eio_obj_t *obj, List objs)
 
 	debug4("Entering _task_read for obj %zx", (size_t)obj);
 	len = cbuf_free(out->buf);
-	if (len > 0 && !out->eof) {
+	if (!out->eof && !(out->job->flags & LAUNCH_BUFFERED_IO) &&
+	    (cbuf_used(out->buf) == 0) && _outgoing_buf_free(out->job)) {
+		if ((rc = _task_read_direct(obj, out)) < 0) {
+			if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+				debug5("_task_read returned EAGAIN");
+				return SLURM_SUCCESS;
+			}
+			debug5("  error in _task_read: %m");
+		}
+		if (rc <= 0) {  /* got eof */
+			debug5("  got eof on task");
+			out->eof = true;
+		}
+	} else if (len > 0 && !out->eof) {
 again:
 		if ((rc = cbuf_write_from_fd(out->buf, obj->fd, len, NULL))
 		    < 0) {
@@ -771,6 +870,9 @@ again:
 		if (rc <= 0) {  /* got eof */
 			debug5("  got eof on task");
 			out->eof = true;
+		} else {
+			io_stats.task_reads++;
+			io_stats.task_bytes += rc;
 		}
 	}
 
@@ -1273,15 +1375,52 @@ _build_connection_okay_message(stepd_step_rec_t *job)
 
 
 
+/* Add a message of task output to the msg_queue of all its clients */
 static void
-_route_msg_task_to_client(eio_obj_t *obj)
+_enqueue_task_msg(struct task_read_info *out, struct io_buf *msg)
 {
-	struct task_read_info *out = (struct task_read_info *)obj->arg;
 	struct client_io_info *client;
-	struct io_buf *msg = NULL;
 	eio_obj_t *eio;
 	ListIterator clients;
 
+	clients = list_iterator_create(out->job->clients);
+	while ((eio = list_next(clients))) {
+		client = (struct client_io_info *)eio->arg;
+		if (client->out_eof == true)
+			continue;
+
+		/* Some clients only take certain I/O streams */
+		if (out->type==SLURM_IO_STDOUT) {
+			if (client->ltaskid_stdout != -1 &&
+			    client->ltaskid_stdout != out->ltaskid)
+				continue;
+		}
+		if (out->type==SLURM_IO_STDERR) {
+			if (client->ltaskid_stderr != -1 &&
+			    client->ltaskid_stderr != out->ltaskid)
+				continue;
+		}
+
+		debug5("======================== Enqueued message");
+		xassert(client->magic == CLIENT_IO_MAGIC);
+		if (list_enqueue(client->msg_queue, msg))
+			msg->ref_count++;
+	}
+	list_iterator_destroy(clients);
+
+	/* Update the outgoing message cache */
+	if (list_enqueue(out->job->outgoing_cache, msg)) {
+		msg->ref_count++;
+		_shrink_msg_cache(out->job->outgoing_cache, out->job);
+	}
+}
+
+static void
+_route_msg_task_to_client(eio_obj_t *obj)
+{
+	struct task_read_info *out = (struct task_read_info *)obj->arg;
+	struct io_buf *msg = NULL;
+
 	/* Pack task output into messages for transfer to a client */
 	while (cbuf_used(out->buf) > 0
 	       && _outgoing_buf_free(out->job)) {
@@ -1290,37 +1429,13 @@ _route_msg_task_to_client(eio_obj_t *obj)
 		if (msg == NULL)
 			return;
 
-		/* Add message to the msg_queue of all clients */
-		clients = list_iterator_create(out->job->clients);
-		while ((eio = list_next(clients))) {
-			client = (struct client_io_info *)eio->arg;
-			if (client->out_eof == true)
-				continue;
-
-			/* Some clients only take certain I/O streams */
-			if (out->type==SLURM_IO_STDOUT) {
-				if (client->ltaskid_stdout != -1 &&
-				    client->ltaskid_stdout != out->ltaskid)
-					continue;
-			}
-			if (out->type==SLURM_IO_STDERR) {
-				if (client->ltaskid_stderr != -1 &&
-				    client->ltaskid_stderr != out->ltaskid)
-					continue;
-			}
-
-			debug5("======================== Enqueued message");
-			xassert(client->magic == CLIENT_IO_MAGIC);
-			if (list_enqueue(client->msg_queue, msg))
-				msg->ref_count++;
-		}
-		list_iterator_destroy(clients);
+		_enqueue_task_msg(out, msg);
+	}
 
-		/* Update the outgoing message cache */
-		if (list_enqueue(out->job->outgoing_cache, msg)) {
-			msg->ref_count++;
-			_shrink_msg_cache(out->job->outgoing_cache, out->job);
-		}
+	/* Out of buffers, resume when one is freed */
+	if ((cbuf_used(out->buf) > 0) && !outgoing_stalled) {
+		outgoing_stalled = true;
+		io_stats.stalls++;
 	}
 }
 
@@ -1329,11 +1444,17 @@ _free_incoming_msg(struct io_buf *msg, stepd_step_rec_t *job)
 {
 	msg->ref_count--;
 	if (msg->ref_count == 0) {
-		/* Put the message back on the free List */
-		list_enqueue(job->free_incoming, msg);
-
-		/* Kick the event IO engine */
-		eio_signal_wakeup(job->eio);
+		/*
+		 * Put the message back on the free List, or release it if
+		 * the pool grew past its usual size. This only runs in the
+		 * IO thread, which polls again once the handler returns, so
+		 * there is no need to wake it up.
+		 */
+		if (job->incoming_count > STDIO_MAX_FREE_BUF) {
+			free_io_buf(msg);
+			job->incoming_count--;
+		} else
+			list_enqueue(job->free_incoming, msg);
 	}
 }
 
@@ -1344,26 +1465,30 @@ _free_outgoing_msg(struct io_buf *msg, stepd_step_rec_t *job)
 
 	msg->ref_count--;
 	if (msg->ref_count == 0) {
-		/* Put the message back on the free List */
-		list_enqueue(job->free_outgoing, msg);
+		/* Put the message back on the free List (see above) */
+		if (job->outgoing_count > STDIO_MAX_FREE_BUF) {
+			free_io_buf(msg);
+			job->outgoing_count--;
+		} else
+			list_enqueue(job->free_outgoing, msg);
 
-		/* Try packing messages from tasks' output cbufs */
-		if (job->task == NULL)
+		/*
+		 * Try packing messages from tasks' output cbufs, if any
+		 * were left waiting for a buffer
+		 */
+		if ((job->task == NULL) || !outgoing_stalled)
 			return;
+		outgoing_stalled = false;
 		for (i = 0; i < job->node_tasks; i++) {
-			if (job->task[i]->err != NULL) {
-				_route_msg_task_to_client(job->task[i]->err);
-				if (!_outgoing_buf_free(job))
-					break;
+			if (!_outgoing_buf_free(job)) {
+				outgoing_stalled = true;
+				break;
 			}
-			if (job->task[i]->out != NULL) {
+			if (job->task[i]->err != NULL)
+				_route_msg_task_to_client(job->task[i]->err);
+			if (job->task[i]->out != NULL)
 				_route_msg_task_to_client(job->task[i]->out);
-				if (!_outgoing_buf_free(job))
-					break;
-			}
 		}
-		/* Kick the event IO engine */
-		eio_signal_wakeup(job->eio);
 	}
 }
 
@@ -1473,6 +1598,13 @@ _io_thr(void *arg)
 	debug("IO handler started pid=%lu", (unsigned long) getpid());
 	rc = eio_handle_mainloop(job->eio);
 	debug("IO handler exited, rc=%d", rc);
+	debug("IO forwarded %"PRIu64" bytes from tasks in %"PRIu64" reads, "
+	      "%"PRIu64" bytes in %"PRIu64" messages to clients in %"PRIu64" "
+	      "writes, %u buffer stalls, %d outgoing buffers at most",
+	      io_stats.task_bytes, io_stats.task_reads,
+	      io_stats.client_bytes, io_stats.client_msgs,
+	      io_stats.client_writes, io_stats.stalls,
+	      io_stats.max_outgoing);
 	return (void *)1;
 }
 
@@ -1779,10 +1911,8 @@ static struct io_buf *_task_build_message(struct task_read_info *out,
 {
 	struct io_buf *msg;
 	char *ptr;
-	Buf packbuf;
 	bool must_truncate = false;
 	int avail;
-	struct slurm_io_header header;
 	int n;
 	bool buffered_stdio = job->flags & LAUNCH_BUFFERED_IO;
 
@@ -1826,16 +1956,29 @@ static struct io_buf *_task_build_message(struct task_read_info *out,
 		}
 	}
 
+	debug4("%s: header.length = %d", __func__, n);
+	_task_pack_header(out, msg, n);
+
+	debug4("%s: Leaving", __func__);
+	return msg;
+}
+
+/* Pack the header of a message holding length bytes of task output */
+static void _task_pack_header(struct task_read_info *out, struct io_buf *msg,
+			      int length)
+{
+	Buf packbuf;
+	struct slurm_io_header header;
+
 	header.type = out->type;
 	header.ltaskid = out->ltaskid;
 	header.gtaskid = out->gtaskid;
-	header.length = n;
+	header.length = length;
 
-	debug4("%s: header.length = %d", __func__, n);
 	packbuf = create_buf(msg->data, io_hdr_packed_size());
 	if (!packbuf) {
 		fatal("Failure to allocate memory for a message header");
-		return msg;	/* Fix for CLANG false positive error */
+		return;	/* Fix for CLANG false positive error */
 	}
 	io_hdr_pack(&header, packbuf);
 	msg->length = io_hdr_packed_size() + header.length;
@@ -1844,9 +1987,6 @@ static struct io_buf *_task_build_message(struct task_read_info *out,
 	/* free the Buf packbuf, but not the memory to which it points */
 	packbuf->head = NULL;	/* CLANG false positive bug here */
 	free_buf(packbuf);
-
-	debug4("%s: Leaving", __func__);
-	return msg;
 }
 
 struct io_buf *
@@ -1881,7 +2021,7 @@ _incoming_buf_free(stepd_step_rec_t *job)
 
 	if (list_count(job->free_incoming) > 0) {
 		return true;
-	} else if (job->incoming_count < STDIO_MAX_FREE_BUF) {
+	} else if (job->incoming_count < STDIO_MAX_BUF) {
 		buf = alloc_io_buf();
 		if (buf != NULL) {
 			list_enqueue(job->free_incoming, buf);
@@ -1900,11 +2040,13 @@ _outgoing_buf_free(stepd_step_rec_t *job)
 
 	if (list_count(job->free_outgoing) > 0) {
 		return true;
-	} else if (job->outgoing_count < STDIO_MAX_FREE_BUF) {
+	} else if (job->outgoing_count < STDIO_MAX_BUF) {
 		buf = alloc_io_buf();
 		if (buf != NULL) {
 			list_enqueue(job->free_outgoing, buf);
 			job->outgoing_count++;
+			io_stats.max_outgoing = MAX(io_stats.max_outgoing,
+						    job->outgoing_count);
 			return true;
 		}
 	}
@@ -46,10 +46,19 @@
 /*
  * The message cache uses up free message buffers, so STDIO_MAX_MSG_CACHE
  * must be a number smaller than STDIO_MAX_FREE_BUF.
+ *
+ * Up to STDIO_MAX_FREE_BUF message buffers per direction are kept for
+ * reuse. When clients drain more slowly than tasks write, the pool grows
+ * up to STDIO_MAX_BUF buffers before task output is throttled, and the
+ * extra buffers are released again as they drain.
  */
 #define STDIO_MAX_FREE_BUF 1024
+#define STDIO_MAX_BUF 16384
 #define STDIO_MAX_MSG_CACHE 128
 
+/* Most messages gathered into one readv()/writev() call */
+#define STDIO_MAX_IOV 16
+
 struct io_buf {
 	int ref_count;
 	uint32_t length;
@@ -1142,6 +1142,23 @@ fail1:
 	return rc;
 }
 
+extern int mgr_plugins_init(bool zygote)
+{
+	if ((!zygote && (acct_gather_conf_init() != SLURM_SUCCESS)) ||
+	    (core_spec_g_init() != SLURM_SUCCESS)		||
+	    (switch_init(1) != SLURM_SUCCESS)			||
+	    (slurm_proctrack_init() != SLURM_SUCCESS)		||
+	    (slurmd_task_init() != SLURM_SUCCESS)		||
+	    (jobacct_gather_init() != SLURM_SUCCESS)		||
+	    (!zygote && (acct_gather_profile_init() != SLURM_SUCCESS)) ||
+	    (slurm_cred_init() != SLURM_SUCCESS)		||
+	    (job_container_init() != SLURM_SUCCESS)		||
+	    (gres_plugin_init() != SLURM_SUCCESS))
+		return SLURM_ERROR;
+
+	return SLURM_SUCCESS;
+}
+
 /*
  * Executes the functions of the slurmd job manager process,
  * which runs as root and performs shared memory and interconnect
@@ -1171,16 +1188,7 @@ job_manager(stepd_step_rec_t *job)
 	 * Preload all plugins afterwards to avoid plugin changes
 	 * (i.e. due to a Slurm upgrade) after the process starts.
 	 */
-	if ((acct_gather_conf_init() != SLURM_SUCCESS)          ||
-	    (core_spec_g_init() != SLURM_SUCCESS)		||
-	    (switch_init(1) != SLURM_SUCCESS)			||
-	    (slurm_proctrack_init() != SLURM_SUCCESS)		||
-	    (slurmd_task_init() != SLURM_SUCCESS)		||
-	    (jobacct_gather_init() != SLURM_SUCCESS)		||
-	    (acct_gather_profile_init() != SLURM_SUCCESS)	||
-	    (slurm_cred_init() != SLURM_SUCCESS)		||
-	    (job_container_init() != SLURM_SUCCESS)		||
-	    (gres_plugin_init() != SLURM_SUCCESS)) {
+	if (mgr_plugins_init(false) != SLURM_SUCCESS) {
 		rc = SLURM_PLUGIN_NAME_INVALID;
 		goto fail1;
 	}
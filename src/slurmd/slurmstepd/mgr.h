@@ -78,6 +78,14 @@ void mgr_launch_batch_job_cleanup(stepd_step_rec_t *job, int rc);
  */
 int job_manager(stepd_step_rec_t *job);
 
+/*
+ * Load the plugins used by every step. Called by job_manager(), and once in
+ * zygote mode before any step is forked so each step starts warm. The
+ * zygote leaves out the acct_gather plugins, which take their baselines
+ * (e.g. energy counters) when they start, so each step loads its own.
+ */
+extern int mgr_plugins_init(bool zygote);
+
 /*
  * Register passwd entries so that we do not need to call initgroups(2)
  * frequently.
@@ -43,10 +43,12 @@
 #include <signal.h>
 #include <stdlib.h>
 #include <sys/mman.h>
+#include <sys/wait.h>
 #include <unistd.h>
 
 #include "src/common/assoc_mgr.h"
 #include "src/common/cpu_frequency.h"
+#include "src/common/fd.h"
 #include "src/common/gres.h"
 #include "src/common/node_select.h"
 #include "src/common/plugstack.h"
@@ -88,6 +90,7 @@ static stepd_step_rec_t *_step_setup(slurm_addr_t *cli, slurm_addr_t *self,
 static void _step_cleanup(stepd_step_rec_t *job, slurm_msg_t *msg, int rc);
 #endif
 static int _process_cmdline (int argc, char **argv);
+static void _zygote(int sock);
 
 /*
  *  List of signals to block in this process
@@ -102,6 +105,9 @@ int slurmstepd_blocked_signals[] = {
 slurmd_conf_t * conf;
 extern char  ** environ;
 
+static bool zygote_mode = false;	/* started as "slurmstepd zygote" */
+static bool conf_received = false;	/* configuration read by the zygote */
+
 int
 main (int argc, char **argv)
 {
@@ -130,9 +136,17 @@ main (int argc, char **argv)
 	if (slurm_auth_init(NULL) != SLURM_SUCCESS)
 		fatal( "failed to initialize authentication plugin" );
 
+	/* Only returns in a newly forked step, with stdin/stdout replaced */
+	if (zygote_mode)
+		_zygote(STDIN_FILENO);
+
 	/* Receive job parameters from the slurmd */
 	_init_from_slurmd(STDIN_FILENO, argv, &cli, &self, &msg);
 
+	/* Read the node counters sampled by the slurmd */
+	if (xstrcasestr(slurm_conf.job_acct_gather_params, "NodeSampler"))
+		(void) acct_gather_node_ring_attach(conf->spooldir);
+
 	/* Create the stepd_step_rec_t, mostly from info in a
 	 * launch_tasks_request_msg_t or a batch_job_launch_msg_t */
 	if (!(job = _step_setup(cli, self, msg))) {
@@ -430,9 +444,85 @@ static int _process_cmdline (int argc, char **argv)
 			exit (1);
 		exit (0);
 	}
+	if ((argc == 2) && (xstrcmp(argv[1], "zygote") == 0))
+		zygote_mode = true;
 	return (0);
 }
 
+/* Read the configuration which slurmd sends ahead of every step */
+static void _read_slurmd_confs(int sock)
+{
+	/* receive conf from slurmd */
+	if (!(conf = read_slurmd_conf_lite(sock)))
+		fatal("Failed to read conf from slurmd");
+
+	/* receive cgroup conf from slurmd */
+	if (xcgroup_read_conf(sock) != SLURM_SUCCESS)
+		fatal("Failed to read cgroup conf from slurmd");
+
+	/*
+	 * receive acct_gather conf from slurmd, a zygote leaves setting it up
+	 * to the steps it forks
+	 */
+	if ((zygote_mode ? acct_gather_recv_conf(sock) :
+	     acct_gather_read_conf(sock)) != SLURM_SUCCESS)
+		fatal("Failed to read acct_gather conf from slurmd");
+}
+
+/*
+ * Zygote mode: receive the configuration and load all plugins once, then
+ * fork a step manager for each pair of pipe fds sent by slurmd over sock.
+ * Each step is double forked so its parent is init, as when slurmd execs
+ * slurmstepd directly. Returns only in a forked step, with the step's pipes
+ * on stdin and stdout. Exits when slurmd closes its end of sock.
+ */
+static void _zygote(int sock)
+{
+	int fds[2], rc;
+	pid_t pid;
+
+	_read_slurmd_confs(sock);
+	conf_received = true;
+	setproctitle("zygote");
+
+	if (mgr_plugins_init(true) != SLURM_SUCCESS)
+		fatal("%s: failed to load plugins", __func__);
+	debug("%s: ready", __func__);
+
+	while ((rc = receive_fds_over_socket(sock, fds, 2)) == 2) {
+		if ((pid = fork()) < 0) {
+			error("%s: fork: %m", __func__);
+		} else if (pid == 0) {
+			(void) close(sock);
+			if (setsid() < 0)
+				error("%s: setsid: %m", __func__);
+			if ((pid = fork()) < 0) {
+				error("%s: Unable to fork grandchild: %m",
+				      __func__);
+				_exit(1);
+			} else if (pid > 0) {
+				_exit(0);
+			}
+			if ((dup2(fds[0], STDIN_FILENO) == -1) ||
+			    (dup2(fds[1], STDOUT_FILENO) == -1)) {
+				error("%s: dup2: %m", __func__);
+				_exit(1);
+			}
+			(void) close(fds[0]);
+			(void) close(fds[1]);
+			return;
+		}
+
+		(void) close(fds[0]);
+		(void) close(fds[1]);
+		if ((pid > 0) && (waitpid(pid, NULL, 0) < 0))
+			error("%s: waitpid: %m", __func__);
+	}
+
+	debug("%s: slurmd connection closed, exiting", __func__);
+	exit(rc ? 1 : 0);
+}
+
 
 static void
 _send_ok_to_slurmd(int sock)
@@ -517,17 +607,9 @@ _init_from_slurmd(int sock, char **argv,
 		.step_het_comp = NO_VAL,
 	};
 
-	/* receive conf from slurmd */
-	if (!(conf = read_slurmd_conf_lite(sock)))
-		fatal("Failed to read conf from slurmd");
-
-	/* receive cgroup conf from slurmd */
-	if (xcgroup_read_conf(sock) != SLURM_SUCCESS)
-		fatal("Failed to read cgroup conf from slurmd");
-
-	/* receive acct_gather conf from slurmd */
-	if (acct_gather_read_conf(sock) != SLURM_SUCCESS)
-		fatal("Failed to read acct_gather conf from slurmd");
+	/* the zygote already received the configuration */
+	if (!conf_received)
+		_read_slurmd_confs(sock);
 
 	/* receive job type from slurmd */
 	safe_read(sock, &step_type, sizeof(int));
@@ -246,6 +246,69 @@ static int   _step_start(slurmdbd_conn_t *slurmdbd_conn,
 __thread bool drop_priv = false;
 #endif
 
+/* Reporting RPCs running now, limited by max_report_rpcs */
+static pthread_mutex_t report_rpc_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t report_rpc_cond = PTHREAD_COND_INITIALIZER;
+static uint32_t report_rpcs = 0;
+
+/*
+ * Wait for one of the max_report_rpcs slots before running a reporting query
+ * so a few users running sacct or sreport can't take the database away from
+ * the slurmctlds. RPCs from slurmctld never wait, even before it registers
+ * (e.g. DBD_GET_TXN at startup), so neither do those on a connection opened
+ * by root or SlurmUser.
+ * RET true if a slot was taken, it must be given back with _report_rpc_end()
+ */
+static bool _report_rpc_begin(slurmdbd_conn_t *slurmdbd_conn,
+			      uint16_t msg_type, uint32_t uid)
+{
+	struct timespec ts = {0, 0};
+	bool waited = false;
+
+	if (!slurmdbd_conf->max_report_rpcs || slurmdbd_conn->conn->rem_port ||
+	    _validate_slurm_user(uid))
+		return false;
+
+	switch (msg_type) {
+	case DBD_GET_ASSOC_USAGE:
+	case DBD_GET_CLUSTER_USAGE:
+	case DBD_GET_EVENTS:
+	case DBD_GET_JOBS_COND:
+	case DBD_GET_RESVS:
+	case DBD_GET_TXN:
+	case DBD_GET_WCKEY_USAGE:
+		break;
+	default:
+		return false;
+	}
+
+	slurm_mutex_lock(&report_rpc_lock);
+	while (!shutdown_time &&
+	       (report_rpcs >= slurmdbd_conf->max_report_rpcs)) {
+		if (!waited) {
+			debug2("CONN:%u %s waiting for one of %u report RPC slots",
+			       slurmdbd_conn->conn->fd,
+			       slurmdbd_msg_type_2_str(msg_type, 1),
+			       slurmdbd_conf->max_report_rpcs);
+			waited = true;
+		}
+		ts.tv_sec = time(NULL) + 1;
+		slurm_cond_timedwait(&report_rpc_cond, &report_rpc_lock, &ts);
+	}
+	report_rpcs++;
+	slurm_mutex_unlock(&report_rpc_lock);
+
+	return true;
+}
+
+static void _report_rpc_end(void)
+{
+	slurm_mutex_lock(&report_rpc_lock);
+	report_rpcs--;
+	slurm_cond_signal(&report_rpc_cond);
+	slurm_mutex_unlock(&report_rpc_lock);
+}
+
 /* Process an incoming RPC
  * slurmdbd_conn IN/OUT - in will that the conn.fd set before
  *       calling and db_conn and conn.version will be filled in with the init.
@@ -263,10 +326,13 @@ proc_req(void *conn, persist_msg_t *msg,
 	int rc = SLURM_SUCCESS;
 	char *comment = NULL;
 	slurmdb_rpc_obj_t *rpc_obj;
+	bool report_rpc;
 
 	DEF_TIMERS;
 	START_TIMER;
 
+	report_rpc = _report_rpc_begin(slurmdbd_conn, msg->msg_type, *uid);
+
 	switch (msg->msg_type) {
 	case REQUEST_PERSIST_INIT:
 		rc = _unpack_persist_init(
@@ -552,18 +618,39 @@ proc_req(void *conn, persist_msg_t *msg,
 		break;
 	}
 
+	if (report_rpc)
+		_report_rpc_end();
+
 	if (rc == ESLURM_ACCESS_DENIED)
 		error("CONN:%u Security violation, %s",
 		      slurmdbd_conn->conn->fd,
 		      slurmdbd_msg_type_2_str(msg->msg_type, 1));
 	else if (slurmdbd_conn->conn->rem_port
-		 && !slurmdbd_conf->commit_delay) {
+		 && !slurmdbd_conf->commit_delay
+		 && !slurmdbd_conn->in_batch) {
 		/* If we are dealing with the slurmctld do the
 		   commit (SUCCESS or NOT) afterwards since we
 		   do transactions for performance reasons.
 		   (don't ever use autocommit with innodb)
+		   The records of a DBD_SEND_MULT_MSG are all
+		   committed at once after the batch.
 		*/
-		acct_storage_g_commit(slurmdbd_conn->db_conn, 1);
+		if ((acct_storage_g_commit(slurmdbd_conn->db_conn, 1) !=
+		     SLURM_SUCCESS) && (rc == SLURM_SUCCESS)) {
+			/*
+			 * The records were rolled back, so have the
+			 * slurmctld send them again instead of acking them.
+			 */
+			comment = "Commit failed";
+			error("CONN:%u %s for %s",
+			      slurmdbd_conn->conn->fd, comment,
+			      slurmdbd_msg_type_2_str(msg->msg_type, 1));
+			rc = SLURM_ERROR;
+			free_buf(*out_buffer);
+			*out_buffer = slurm_persist_make_rc_msg(
+				slurmdbd_conn->conn, rc, comment,
+				msg->msg_type);
+		}
 	}
 
 	END_TIMER;
@@ -3353,7 +3440,8 @@ static int   _send_mult_msg(slurmdbd_conn_t *slurmdbd_conn,
 	ListIterator itr = NULL;
 	Buf req_buf = NULL, ret_buf = NULL;
 	int rc = SLURM_SUCCESS;
-	/* DEF_TIMERS; */
+	uint32_t recs = 0;
+	DEF_TIMERS;
 
 	if (!_validate_slurm_user(*uid)) {
 		comment = "DBD_SEND_MULT_MSG message from invalid uid";
@@ -3366,7 +3454,12 @@ static int   _send_mult_msg(slurmdbd_conn_t *slurmdbd_conn,
 	}
 
 	list_msg.my_list = list_create(slurmdbd_free_buffer);
-	/* START_TIMER; */
+	START_TIMER;
+	/*
+	 * Keep the records in one transaction so the database can write the
+	 * rows of records of the same kind together, see mysql_db_defer().
+	 */
+	slurmdbd_conn->in_batch = true;
 	itr = list_iterator_create(get_msg->my_list);
 	while ((req_buf = list_next(itr))) {
 		persist_msg_t sub_msg;
@@ -3387,10 +3480,20 @@ static int   _send_mult_msg(slurmdbd_conn_t *slurmdbd_conn,
 			list_append(list_msg.my_list, ret_buf);
 		if (rc != SLURM_SUCCESS)
 			break;
+		recs++;
 	}
 	list_iterator_destroy(itr);
-	/* END_TIMER; */
-	/* info("%d multi took %s", list_count(get_msg->my_list), TIME_STR); */
+	slurmdbd_conn->in_batch = false;
+	END_TIMER;
+	debug2("%s: %u of %d records took %s", __func__, recs,
+	       list_count(get_msg->my_list), TIME_STR);
+
+	slurm_mutex_lock(&rpc_mutex);
+	rpc_stats.batch_cnt++;
+	rpc_stats.batch_recs += recs;
+	rpc_stats.batch_max = MAX(rpc_stats.batch_max, recs);
+	rpc_stats.batch_time += DELTA_TIMER;
+	slurm_mutex_unlock(&rpc_mutex);
 
 	*out_buffer = init_buf(1024);
 	pack16((uint16_t) DBD_GOT_MULT_MSG, *out_buffer);
@@ -97,6 +97,7 @@ static void _clear_slurmdbd_conf(void)
 		slurmdbd_conf->debug_level = LOG_LEVEL_INFO;
 		xfree(slurmdbd_conf->default_qos);
 		xfree(slurmdbd_conf->log_file);
+		slurmdbd_conf->max_report_rpcs = 0;
 		slurmdbd_conf->syslog_debug = LOG_LEVEL_END;
 		xfree(slurmdbd_conf->parameters);
 		xfree(slurmdbd_conf->pid_file);
@@ -311,10 +312,17 @@ extern int read_slurmdbd_conf(void)
 
 		s_p_get_string(&slurmdbd_conf->parameters, "Parameters", tbl);
 		if (slurmdbd_conf->parameters) {
+			char *tmp_ptr;
+
 			if (xstrcasestr(slurmdbd_conf->parameters,
 					"PreserveCaseUser"))
 				slurmdbd_conf->persist_conn_rc_flags |=
 					PERSIST_FLAG_P_USER_CASE;
+			/*                             0123456789012345 */
+			if ((tmp_ptr = xstrcasestr(slurmdbd_conf->parameters,
+						   "max_report_rpcs=")))
+				slurmdbd_conf->max_report_rpcs =
+					strtoul(tmp_ptr + 16, NULL, 10);
 		}
 
 		s_p_get_string(&slurmdbd_conf->pid_file, "PidFile", tbl);
@@ -68,6 +68,8 @@ typedef struct {
 	char *	 	default_qos;	/* default qos setting when
 					 * adding clusters              */
 	char *		log_file;	/* Log file			*/
+	uint32_t	max_report_rpcs; /* reporting RPCs run at once,
+					  * 0 is no limit		*/
 	uint32_t	max_time_range;	/* max time range for user queries */
 	char *		parameters;	/* parameters to change behavior with
 					 * the slurmdbd directly	*/